@@ -0,0 +1,277 @@
+/*  Copyright (c) 2026, GlobalPlatform Library contributors
+ *  This file is part of GlobalPlatform.
+ *
+ *  GlobalPlatform is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GlobalPlatform is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef WIN32
+#include "stdafx.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "globalplatform/cardprofile.h"
+#include "globalplatform/errorcodes.h"
+#include "globalplatform/stringify.h"
+#include "globalplatform/debug.h"
+
+/**
+ * Writes a buffer as hex string. An empty buffer is written as "-".
+ * \param file [in] The file to write to.
+ * \param buf [in] The buffer.
+ * \param bufLength [in] The length of the buffer.
+ */
+static void write_hex(FILE *file, PBYTE buf, DWORD bufLength) {
+	DWORD i;
+	if (bufLength == 0) {
+		fputs("-", file);
+	}
+	for (i=0; i<bufLength; i++) {
+		fprintf(file, "%02X", buf[i]);
+	}
+}
+
+/**
+ * Reads a hex string written by write_hex().
+ * \param hex [in] The hex string.
+ * \param buf [out] The buffer.
+ * \param bufLength [in, out] The size of the buffer and the number of bytes read.
+ * \return 0 if the hex string is valid, -1 otherwise.
+ */
+static int read_hex(const char *hex, PBYTE buf, PDWORD bufLength) {
+	DWORD i;
+	unsigned int b;
+	DWORD length = (DWORD)strlen(hex);
+	if (strcmp(hex, "-") == 0) {
+		*bufLength = 0;
+		return 0;
+	}
+	if (length % 2 != 0 || length/2 > *bufLength) {
+		return -1;
+	}
+	for (i=0; i<length/2; i++) {
+		if (sscanf(hex+2*i, "%2x", &b) != 1) {
+			return -1;
+		}
+		buf[i] = (BYTE)b;
+	}
+	*bufLength = length/2;
+	return 0;
+}
+
+/**
+ * Finds the index of a profile. If IIN is NULL only profiles without IIN match.
+ * \param database [in] The card profile database.
+ * \param ATR [in] The ATR.
+ * \param ATRLength [in] The length of the ATR.
+ * \param IIN [in] The IIN. Can be NULL.
+ * \param IINLength [in] The length of the IIN.
+ * \return The index of the profile or -1 if no profile is found.
+ */
+static LONG find_profile(OPGP_CARD_PROFILE_DATABASE *database, PBYTE ATR, DWORD ATRLength, PBYTE IIN, DWORD IINLength) {
+	DWORD i;
+	for (i=0; i<database->profilesLength; i++) {
+		OPGP_CARD_PROFILE *profile = database->profiles + i;
+		if (profile->ATRLength != ATRLength || memcmp(profile->ATR, ATR, ATRLength) != 0) {
+			continue;
+		}
+		if (profile->IINLength != IINLength || (IINLength > 0 && memcmp(profile->IIN, IIN, IINLength) != 0)) {
+			continue;
+		}
+		return (LONG)i;
+	}
+	return -1;
+}
+
+/**
+ * \param database [out] The card profile database.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_card_profile_database_init(OPGP_CARD_PROFILE_DATABASE *database) {
+	OPGP_ERROR_STATUS status;
+	database->profiles = NULL;
+	database->profilesLength = 0;
+	database->profilesSize = 0;
+	OPGP_ERROR_CREATE_NO_ERROR(status);
+	return status;
+}
+
+/**
+ * \param database [in, out] The card profile database.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_card_profile_database_release(OPGP_CARD_PROFILE_DATABASE *database) {
+	if (database->profiles != NULL) {
+		free(database->profiles);
+	}
+	return OPGP_card_profile_database_init(database);
+}
+
+/**
+ * A profile with the same IIN is preferred. If no such profile exists a profile without IIN for this ATR is returned.
+ * \param database [in] The card profile database.
+ * \param ATR [in] The ATR of the card.
+ * \param ATRLength [in] The length of the ATR.
+ * \param IIN [in] The Issuer Identification Number of the card. Can be NULL if unknown.
+ * \param IINLength [in] The length of the IIN.
+ * \param *profile [out] The found profile.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_card_profile_lookup(OPGP_CARD_PROFILE_DATABASE *database, PBYTE ATR, DWORD ATRLength,
+										   PBYTE IIN, DWORD IINLength, OPGP_CARD_PROFILE *profile) {
+	OPGP_ERROR_STATUS status;
+	LONG index = -1;
+	OPGP_LOG_START(_T("OPGP_card_profile_lookup"));
+	if (IIN != NULL && IINLength > 0) {
+		index = find_profile(database, ATR, ATRLength, IIN, IINLength);
+	}
+	if (index == -1) {
+		index = find_profile(database, ATR, ATRLength, NULL, 0);
+	}
+	if (index == -1) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CARD_PROFILE_NOT_FOUND, OPGP_stringify_error(OPGP_ERROR_CARD_PROFILE_NOT_FOUND)); goto end; }
+	}
+	memcpy(profile, database->profiles + index, sizeof(OPGP_CARD_PROFILE));
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("OPGP_card_profile_lookup"), status);
+	return status;
+}
+
+/**
+ * \param database [in, out] The card profile database.
+ * \param *profile [in] The profile to store. The profile is copied.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_card_profile_store(OPGP_CARD_PROFILE_DATABASE *database, OPGP_CARD_PROFILE *profile) {
+	OPGP_ERROR_STATUS status;
+	OPGP_CARD_PROFILE *profiles;
+	LONG index;
+	OPGP_LOG_START(_T("OPGP_card_profile_store"));
+	if (profile->ATRLength > MAX_ATR_SIZE || profile->IINLength > OPGP_MAX_IIN_SIZE) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_CARD_PROFILE, OPGP_stringify_error(OPGP_ERROR_INVALID_CARD_PROFILE)); goto end; }
+	}
+	index = find_profile(database, profile->ATR, profile->ATRLength, profile->IIN, profile->IINLength);
+	if (index == -1) {
+		if (database->profilesLength == database->profilesSize) {
+			profiles = (OPGP_CARD_PROFILE *)realloc(database->profiles,
+				sizeof(OPGP_CARD_PROFILE) * (database->profilesSize == 0 ? 8 : database->profilesSize * 2));
+			if (profiles == NULL) {
+				{ OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM)); goto end; }
+			}
+			database->profiles = profiles;
+			database->profilesSize = database->profilesSize == 0 ? 8 : database->profilesSize * 2;
+		}
+		index = (LONG)database->profilesLength++;
+	}
+	memcpy(database->profiles + index, profile, sizeof(OPGP_CARD_PROFILE));
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("OPGP_card_profile_store"), status);
+	return status;
+}
+
+/**
+ * Each line of the file contains one profile written by #OPGP_card_profile_database_save().
+ * \param database [in, out] The card profile database.
+ * \param fileName [in] The name of the file.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_card_profile_database_load(OPGP_CARD_PROFILE_DATABASE *database, OPGP_CSTRING fileName) {
+	OPGP_ERROR_STATUS status;
+	FILE *file = NULL;
+	char ATR[2*MAX_ATR_SIZE+1];
+	char IIN[2*OPGP_MAX_IIN_SIZE+1];
+	char format[32];
+	unsigned int secureChannelProtocol, secureChannelProtocolImpl, derivationMethod;
+	OPGP_CARD_PROFILE profile;
+	int rv;
+	OPGP_LOG_START(_T("OPGP_card_profile_database_load"));
+	// the field widths must follow the buffer sizes, the terminating 0 is not counted
+	snprintf(format, sizeof(format), "%%%lus %%%lus %%x %%x %%x",
+		(unsigned long)(sizeof(ATR)-1), (unsigned long)(sizeof(IIN)-1));
+	file = _tfopen(fileName, _T("r"));
+	if (file == NULL) {
+		OPGP_ERROR_CREATE_ERROR(status, errno, OPGP_stringify_error(errno)); goto end;
+	}
+	while ((rv = fscanf(file, format, ATR, IIN, &secureChannelProtocol,
+			&secureChannelProtocolImpl, &derivationMethod)) == 5) {
+		profile.ATRLength = sizeof(profile.ATR);
+		profile.IINLength = sizeof(profile.IIN);
+		if (read_hex(ATR, profile.ATR, &profile.ATRLength) || read_hex(IIN, profile.IIN, &profile.IINLength)) {
+			break;
+		}
+		profile.secureChannelProtocol = (BYTE)secureChannelProtocol;
+		profile.secureChannelProtocolImpl = (BYTE)secureChannelProtocolImpl;
+		profile.derivationMethod = (BYTE)derivationMethod;
+		status = OPGP_card_profile_store(database, &profile);
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
+		}
+	}
+	if (rv != EOF) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_CARD_PROFILE, OPGP_stringify_error(OPGP_ERROR_INVALID_CARD_PROFILE)); goto end; }
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	if (file != NULL) {
+		fclose(file);
+	}
+	OPGP_LOG_END(_T("OPGP_card_profile_database_load"), status);
+	return status;
+}
+
+/**
+ * Each profile is written as one line with the hex encoded ATR and IIN ("-" if no IIN is used),
+ * the Secure Channel Protocol, its implementation and the derivation method, each as hex byte.
+ * \param database [in] The card profile database.
+ * \param fileName [in] The name of the file.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_card_profile_database_save(OPGP_CARD_PROFILE_DATABASE *database, OPGP_CSTRING fileName) {
+	OPGP_ERROR_STATUS status;
+	FILE *file = NULL;
+	DWORD i;
+	OPGP_CARD_PROFILE *profile;
+	OPGP_LOG_START(_T("OPGP_card_profile_database_save"));
+	file = _tfopen(fileName, _T("w"));
+	if (file == NULL) {
+		OPGP_ERROR_CREATE_ERROR(status, errno, OPGP_stringify_error(errno)); goto end;
+	}
+	for (i=0; i<database->profilesLength; i++) {
+		profile = database->profiles + i;
+		write_hex(file, profile->ATR, profile->ATRLength);
+		fputs(" ", file);
+		write_hex(file, profile->IIN, profile->IINLength);
+		fprintf(file, " %02X %02X %02X\n", profile->secureChannelProtocol, profile->secureChannelProtocolImpl,
+			profile->derivationMethod);
+	}
+	if (fclose(file) != 0) {
+		file = NULL;
+		OPGP_ERROR_CREATE_ERROR(status, errno, OPGP_stringify_error(errno)); goto end;
+	}
+	file = NULL;
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	if (file != NULL) {
+		fclose(file);
+	}
+	OPGP_LOG_END(_T("OPGP_card_profile_database_save"), status);
+	return status;
+}
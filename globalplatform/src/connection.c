@@ -15,6 +15,8 @@
  *  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define OPGP_LOG_CATEGORY OPGP_LOG_CATEGORY_TRANSPORT //!< Category of the log messages of this file.
+
 #include "globalplatform/connection.h"
 #include "dyn_generic.h"
 #include "globalplatform/globalplatform.h"
@@ -22,25 +24,284 @@
 #include "globalplatform/stringify.h"
 #include "globalplatform/error.h"
 #include "crypto.h"
+#include "util.h"
 #include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <openssl/crypto.h>
+
+static OPGP_TRACE_SINK globalSink; //!< The process wide trace mode set with OPGP_enable_trace_mode(). Its buffer is not used.
+
+/**
+ * The sink of a card set with OPGP_set_sink(). The sinks are kept outside of OPGP_CARD_INFO,
+ * which is passed by value to the connection plugins.
+ */
+typedef struct CARD_SINK {
+	PVOID card; //!< The card handle, the librarySpecific member of the OPGP_CARD_INFO. Shared by its Logical Channels.
+	OPGP_TRACE_SINK *sink; //!< The sink.
+	struct CARD_SINK *next; //!< The next card with a sink.
+} CARD_SINK;
+
+static CARD_SINK *cardSinks = NULL; //!< The cards with an own sink.
+static CRYPTO_RWLOCK *cardSinksLock = NULL; //!< Protects cardSinks, the cards can be handled by several threads.
+static CRYPTO_ONCE cardSinksOnce = CRYPTO_ONCE_STATIC_INIT;
+
+/**
+ * Creates the lock of the card sinks. Executed once.
+ */
+static void init_card_sinks(void) {
+	cardSinksLock = CRYPTO_THREAD_lock_new();
+}
+
+/**
+ * Frees the card sinks left by not disconnected cards and their lock when the library is unloaded.
+ */
+static void DESTRUCTOR release_card_sinks(void) {
+	CARD_SINK *cardSink;
+	while (cardSinks != NULL) {
+		cardSink = cardSinks;
+		cardSinks = cardSink->next;
+		free(cardSink);
+	}
+	CRYPTO_THREAD_lock_free(cardSinksLock);
+	cardSinksLock = NULL;
+}
 
-static DWORD traceEnable; //!< Enable trace mode.
-static FILE *traceFile; //!< The trace file for trace mode.
+/**
+ * Returns the sink of a card.
+ * \param cardInfo [in] The card.
+ * \return The sink set with OPGP_set_sink() or the process wide sink.
+ */
+static OPGP_TRACE_SINK *get_card_sink(OPGP_CARD_INFO cardInfo) {
+	CARD_SINK *cardSink;
+	OPGP_TRACE_SINK *sink = &globalSink;
+	if (!CRYPTO_THREAD_run_once(&cardSinksOnce, init_card_sinks) || cardSinksLock == NULL
+			|| !CRYPTO_THREAD_read_lock(cardSinksLock)) {
+		return sink;
+	}
+	for (cardSink = cardSinks; cardSink != NULL; cardSink = cardSink->next) {
+		if (cardSink->card == cardInfo.librarySpecific) {
+			sink = cardSink->sink;
+			break;
+		}
+	}
+	CRYPTO_THREAD_unlock(cardSinksLock);
+	return sink;
+}
 
 /**
+ * Replaces the sink of a card.
+ * \param cardInfo [in] The card.
+ * \param sink [in] The new sink or NULL to remove the sink.
+ * \return The previous sink of the card or NULL.
+ */
+static OPGP_TRACE_SINK *replace_card_sink(OPGP_CARD_INFO cardInfo, OPGP_TRACE_SINK *sink) {
+	CARD_SINK **cardSink;
+	CARD_SINK *removed;
+	OPGP_TRACE_SINK *previous = NULL;
+	if (!CRYPTO_THREAD_run_once(&cardSinksOnce, init_card_sinks) || cardSinksLock == NULL
+			|| !CRYPTO_THREAD_write_lock(cardSinksLock)) {
+		return NULL;
+	}
+	for (cardSink = &cardSinks; *cardSink != NULL; cardSink = &(*cardSink)->next) {
+		if ((*cardSink)->card == cardInfo.librarySpecific) {
+			break;
+		}
+	}
+	if (*cardSink != NULL) {
+		previous = (*cardSink)->sink;
+		if (sink != NULL) {
+			(*cardSink)->sink = sink;
+		}
+		else {
+			removed = *cardSink;
+			*cardSink = removed->next;
+			free(removed);
+		}
+	}
+	else if (sink != NULL) {
+		*cardSink = (CARD_SINK *)malloc(sizeof(CARD_SINK));
+		if (*cardSink != NULL) {
+			(*cardSink)->card = cardInfo.librarySpecific;
+			(*cardSink)->sink = sink;
+			(*cardSink)->next = NULL;
+		}
+	}
+	CRYPTO_THREAD_unlock(cardSinksLock);
+	return previous;
+}
+
+#define TRACE_HEX_CHUNK 128 //!< The number of bytes converted into one hex chunk of a trace line.
+
+/**
+ * The prefixes of the text trace lines. Indexed by the record type. The trace file is written byte wise,
+ * so the lines are kept as char also in UNICODE builds.
+ */
+static const char *tracePrefixes[] = {NULL, "Command --> ", "Wrapped command --> ", "Response <-- "};
+
+/**
+ * Returns the trace file of a sink. Like for OPGP_enable_trace_mode() stdout is used if no file is set.
+ * \param sink [in] The sink.
+ * \return The trace file.
+ */
+static FILE *get_trace_file(OPGP_TRACE_SINK *sink) {
+	return sink->traceFile != NULL ? sink->traceFile : stdout;
+}
+
+/**
+ * Writes to the trace file of a sink. The output of the process wide sink is written directly,
+ * because it can be shared by several threads.
+ * \param sink [in, out] The sink.
+ * \param data [in] The data to write.
+ * \param dataLength [in] The length of the data.
+ */
+static void write_sink(OPGP_TRACE_SINK *sink, const void *data, DWORD dataLength) {
+	if (sink == &globalSink) {
+		fwrite(data, 1, dataLength, get_trace_file(sink));
+		return;
+	}
+	if (sink->bufferLength + dataLength > sizeof(sink->buffer)) {
+		OPGP_flush_sink(sink);
+		if (dataLength > sizeof(sink->buffer)) {
+			fwrite(data, 1, dataLength, get_trace_file(sink));
+			return;
+		}
+	}
+	memcpy(sink->buffer+sink->bufferLength, data, dataLength);
+	sink->bufferLength += dataLength;
+}
+
+/**
+ * Writes a trace line. The line is converted in chunks into a buffer which is written in one call per chunk.
+ * \param sink [in, out] The sink to write to.
+ * \param type [in] The record type. See #OPGP_TRACE_RECORD_COMMAND and related.
+ * \param data [in] The APDU.
+ * \param dataLength [in] The length of the APDU.
+ */
+static void write_text_trace(OPGP_TRACE_SINK *sink, BYTE type, PBYTE data, DWORD dataLength) {
+	char line[32 + 2*TRACE_HEX_CHUNK + 2];
+	TCHAR hex[2*TRACE_HEX_CHUNK];
+	DWORD lineLength;
+	DWORD hexLength;
+	DWORD chunkLength;
+	DWORD i = 0;
+	DWORD j;
+	lineLength = (DWORD)strlen(tracePrefixes[type]);
+	memcpy(line, tracePrefixes[type], lineLength);
+	do {
+		chunkLength = dataLength - i > TRACE_HEX_CHUNK ? TRACE_HEX_CHUNK : dataLength - i;
+		hexLength = to_hex(data+i, chunkLength, hex);
+		// the hex digits are ASCII
+		for (j=0; j<hexLength; j++) {
+			line[lineLength++] = (char)hex[j];
+		}
+		i += chunkLength;
+		if (i == dataLength) {
+			line[lineLength++] = '\n';
+		}
+		write_sink(sink, line, lineLength);
+		lineLength = 0;
+	} while (i < dataLength);
+}
+
+/**
+ * Writes an APDU to the trace file of the card or the process wide trace file if the trace mode is enabled.
+ * A binary record consists of the record type, the 2 byte big endian length and the APDU.
+ * \param cardInfo [in] The card.
+ * \param type [in] The record type. See #OPGP_TRACE_RECORD_COMMAND and related.
+ * \param data [in] The APDU.
+ * \param dataLength [in] The length of the APDU.
+ */
+static void trace(OPGP_CARD_INFO cardInfo, BYTE type, PBYTE data, DWORD dataLength) {
+	BYTE header[3];
+	OPGP_TRACE_SINK *sink = get_card_sink(cardInfo);
+	if (sink->traceMode == OPGP_TRACE_MODE_BINARY) {
+		header[0] = type;
+		header[1] = (BYTE)(dataLength >> 8);
+		header[2] = (BYTE)dataLength;
+		write_sink(sink, header, sizeof(header));
+		write_sink(sink, data, dataLength);
+	}
+	else if (sink->traceMode) {
+		write_text_trace(sink, type, data, dataLength);
+	}
+}
+
+/**
+ * The trace mode applies to all cards without an own sink set with OPGP_set_sink().
  * \param enable [in] Enables or disables the trace mode.
  * <ul>
  * <li>#OPGP_TRACE_MODE_ENABLE
+ * <li>#OPGP_TRACE_MODE_BINARY
  * <li>#OPGP_TRACE_MODE_DISABLE
  * </ul>
- * \param *out [out] The pointer to to FILE to print result.
+ * \param *out [out] The pointer to to FILE to print result. For #OPGP_TRACE_MODE_BINARY it must be opened in binary mode.
  */
 void OPGP_enable_trace_mode(DWORD enable, FILE *out) {
     if (out == NULL)
- 		traceFile = stdout;
+ 		globalSink.traceFile = stdout;
     else
- 		traceFile = out;
-    traceEnable = enable;
+ 		globalSink.traceFile = out;
+    globalSink.traceMode = enable;
+}
+
+/**
+ * The card uses the sink for its trace, also on the Logical Channels opened afterwards.
+ * The log destination is not changed, a thread handling one reader can redirect its log with OPGP_log_set_thread_file().
+ * So each reader can be handled in an own thread with separate trace and log files.
+ * The sink must stay valid until the card is disconnected with OPGP_card_disconnect(), which flushes it.
+ * \param *cardInfo [in, out] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *sink [in] The sink. NULL restores the process wide trace mode.
+ */
+void OPGP_set_sink(OPGP_CARD_INFO *cardInfo, OPGP_TRACE_SINK *sink) {
+	replace_card_sink(*cardInfo, sink);
+}
+
+/**
+ * The trace file is flushed as well.
+ * \param *sink [in, out] The sink.
+ */
+void OPGP_flush_sink(OPGP_TRACE_SINK *sink) {
+	FILE *traceFile = get_trace_file(sink);
+	if (sink->bufferLength > 0) {
+		fwrite(sink->buffer, 1, sink->bufferLength, traceFile);
+		sink->bufferLength = 0;
+	}
+	fflush(traceFile);
+}
+
+/**
+ * The output is the same as of #OPGP_TRACE_MODE_ENABLE.
+ * \param *in [in] The binary trace. Must be opened in binary mode.
+ * \param *out [in] The text trace.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_convert_binary_trace(FILE *in, FILE *out) {
+	OPGP_ERROR_STATUS status;
+	BYTE header[3];
+	BYTE data[65535];
+	OPGP_TRACE_SINK sink;
+	DWORD dataLength;
+	size_t read;
+	OPGP_LOG_START(_T("OPGP_convert_binary_trace"));
+	memset(&sink, 0, sizeof(sink));
+	sink.traceFile = out;
+	while ((read = fread(header, 1, sizeof(header), in)) == sizeof(header)) {
+		dataLength = (header[1] << 8) | header[2];
+		if (header[0] < OPGP_TRACE_RECORD_COMMAND || header[0] > OPGP_TRACE_RECORD_RESPONSE
+				|| fread(data, 1, dataLength, in) != dataLength) {
+			{ OPGP_ERROR_CREATE_ERROR(status, EINVAL, OPGP_stringify_error(EINVAL)); goto end; }
+		}
+		write_text_trace(&sink, header[0], data, dataLength);
+	}
+	if (read != 0) {
+		{ OPGP_ERROR_CREATE_ERROR(status, EINVAL, OPGP_stringify_error(EINVAL)); goto end; }
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_flush_sink(&sink);
+	OPGP_LOG_END(_T("OPGP_convert_binary_trace"), status);
+	return status;
 }
 
 /**
@@ -181,13 +442,92 @@ OPGP_ERROR_STATUS OPGP_card_connect(OPGP_CARD_CONTEXT cardContext, OPGP_CSTRING
 OPGP_ERROR_STATUS OPGP_card_disconnect(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO *cardInfo) {
     OPGP_ERROR_STATUS errorStatus;
     OPGP_ERROR_STATUS(*plugin_cardDisconnectFunction) (OPGP_CARD_CONTEXT, OPGP_CARD_INFO *);
+    OPGP_TRACE_SINK *sink;
     OPGP_LOG_START(_T("OPGP_card_disconnect"));
     plugin_cardDisconnectFunction = (OPGP_ERROR_STATUS(*)(OPGP_CARD_CONTEXT, OPGP_CARD_INFO *)) cardContext.connectionFunctions.cardDisconnect; ///<same here
+    sink = replace_card_sink(*cardInfo, NULL);
+    if (sink != NULL) {
+        OPGP_flush_sink(sink);
+    }
+    // the secure channel sessions end, the cached CMAC states of the thread must not keep the session keys
+    release_CMAC_key_states(NULL);
     errorStatus = (*plugin_cardDisconnectFunction) (cardContext, cardInfo);
     OPGP_LOG_END(_T("OPGP_card_disconnect"), errorStatus);
     return errorStatus;
 }
 
+/**
+ * Resolves the optional transaction functions of the connection plugin. They are looked up at each call,
+ * because OPGP_CONNECTION_FUNCTIONS is embedded in OPGP_CARD_CONTEXT and must not change its layout.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param *beginTransaction [out] The function to start a transaction. NULL if the plugin does not support transactions.
+ * \param *endTransaction [out] The function to end a transaction. NULL if the plugin does not support transactions.
+ */
+static void get_transaction_functions(OPGP_CARD_CONTEXT cardContext, PVOID *beginTransaction, PVOID *endTransaction) {
+	OPGP_ERROR_STATUS errorStatus;
+	*beginTransaction = NULL;
+	*endTransaction = NULL;
+	if (cardContext.libraryHandle == NULL) {
+		return;
+	}
+	errorStatus = DYN_GetAddress(cardContext.libraryHandle, beginTransaction, _T("OPGP_PL_begin_transaction"));
+	if (!OPGP_ERROR_CHECK(errorStatus)) {
+		errorStatus = DYN_GetAddress(cardContext.libraryHandle, endTransaction, _T("OPGP_PL_end_transaction"));
+	}
+	// a plugin must support both functions
+	if (OPGP_ERROR_CHECK(errorStatus)) {
+		*beginTransaction = NULL;
+		*endTransaction = NULL;
+	}
+}
+
+/**
+ * Other applications cannot access the card until #OPGP_end_transaction() is called.
+ * If the connection plugin does not support transactions nothing is done.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_begin_transaction(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo) {
+	OPGP_ERROR_STATUS errorStatus;
+	OPGP_ERROR_STATUS(*plugin_beginTransactionFunction) (OPGP_CARD_CONTEXT, OPGP_CARD_INFO);
+	PVOID beginTransaction, endTransaction;
+	OPGP_LOG_START(_T("OPGP_begin_transaction"));
+	get_transaction_functions(cardContext, &beginTransaction, &endTransaction);
+	plugin_beginTransactionFunction = (OPGP_ERROR_STATUS(*)(OPGP_CARD_CONTEXT, OPGP_CARD_INFO)) beginTransaction;
+	if (plugin_beginTransactionFunction == NULL) {
+		OPGP_ERROR_CREATE_NO_ERROR(errorStatus);
+	}
+	else {
+		errorStatus = (*plugin_beginTransactionFunction) (cardContext, cardInfo);
+	}
+	OPGP_LOG_END(_T("OPGP_begin_transaction"), errorStatus);
+	return errorStatus;
+}
+
+/**
+ * If the connection plugin does not support transactions nothing is done.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_end_transaction(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo) {
+	OPGP_ERROR_STATUS errorStatus;
+	OPGP_ERROR_STATUS(*plugin_endTransactionFunction) (OPGP_CARD_CONTEXT, OPGP_CARD_INFO);
+	PVOID beginTransaction, endTransaction;
+	OPGP_LOG_START(_T("OPGP_end_transaction"));
+	get_transaction_functions(cardContext, &beginTransaction, &endTransaction);
+	plugin_endTransactionFunction = (OPGP_ERROR_STATUS(*)(OPGP_CARD_CONTEXT, OPGP_CARD_INFO)) endTransaction;
+	if (plugin_endTransactionFunction == NULL) {
+		OPGP_ERROR_CREATE_NO_ERROR(errorStatus);
+	}
+	else {
+		errorStatus = (*plugin_endTransactionFunction) (cardContext, cardInfo);
+	}
+	OPGP_LOG_END(_T("OPGP_end_transaction"), errorStatus);
+	return errorStatus;
+}
+
 /**
  * If the transmission is successful then the APDU status word is returned as errorCode in the OPGP_ERROR_STATUS structure.
  * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
@@ -205,20 +545,13 @@ OPGP_ERROR_STATUS OPGP_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO c
 	OPGP_ERROR_STATUS(*plugin_sendAPDUFunction) (OPGP_CARD_CONTEXT, OPGP_CARD_INFO, PBYTE, DWORD, PBYTE, PDWORD);
 	BYTE apduCommand[261];
 	DWORD apduCommandLength = 261;
-	int i=0;
 
 	OPGP_LOG_START(_T("OPGP_send_APDU"));
 	plugin_sendAPDUFunction = (OPGP_ERROR_STATUS(*)(OPGP_CARD_CONTEXT, OPGP_CARD_INFO, PBYTE, DWORD, PBYTE, PDWORD)) cardContext.connectionFunctions.sendAPDU;
 
 	OPGP_LOG_HEX(_T("OPGP_send_APDU: Command --> "), capdu, capduLength);
 
-	if (traceEnable) {
-		_ftprintf(traceFile, _T("Command --> "));
-		for (i=0; (DWORD)i<capduLength; i++) {
-			_ftprintf(traceFile, _T("%02X"), capdu[i] & 0x00FF);
-		}
-		_ftprintf(traceFile, _T("\n"));
-	}
+	trace(cardInfo, OPGP_TRACE_RECORD_COMMAND, capdu, capduLength);
 
 	// wrap command
 	errorStatus = wrap_command(capdu, capduLength, apduCommand, &apduCommandLength, secInfo);
@@ -226,15 +559,10 @@ OPGP_ERROR_STATUS OPGP_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO c
 		goto end;
 	}
 
-	capdu[0] |= cardInfo.logicalChannel;
+	apduCommand[0] |= cardInfo.logicalChannel;
 
-	if (traceEnable) {
-		_ftprintf(traceFile, _T("Wrapped command --> "));
-		for (i=0; (DWORD)i<apduCommandLength; i++) {
-			_ftprintf(traceFile, _T("%02X"), apduCommand[i] & 0x00FF);
-		}
-		_ftprintf(traceFile, _T("\n"));
-	}
+	trace(cardInfo, OPGP_TRACE_RECORD_WRAPPED_COMMAND, apduCommand, apduCommandLength);
+	OPGP_flight_recorder_command(apduCommand, apduCommandLength);
 
     /* AC Bugfix: Don't attempt to call function if fpointer is null */
     if (plugin_sendAPDUFunction == NULL){
@@ -242,6 +570,7 @@ OPGP_ERROR_STATUS OPGP_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO c
         goto end;
     }else{
         errorStatus = (*plugin_sendAPDUFunction) (cardContext, cardInfo, apduCommand, apduCommandLength, rapdu, rapduLength);
+        OPGP_flight_recorder_response(rapdu, *rapduLength, errorStatus);
         if (OPGP_ERROR_CHECK(errorStatus)) {
             goto end;
         }
@@ -254,13 +583,7 @@ OPGP_ERROR_STATUS OPGP_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO c
 		goto securityFailed;
 	}
 
-	if (traceEnable) {
-		_ftprintf(traceFile, _T("Response <-- "));
-		for (i=0; (DWORD)i<*rapduLength; i++) {
-			_ftprintf(traceFile, _T("%02X"), rapdu[i] & 0x00FF);
-		}
-		_ftprintf(traceFile, _T("\n"));
-	}
+	trace(cardInfo, OPGP_TRACE_RECORD_RESPONSE, rapdu, *rapduLength);
 
 end:
 	OPGP_LOG_END(_T("OPGP_send_APDU"), errorStatus);
@@ -28,6 +28,8 @@
  * files in the program, then also delete it here.
  */
 
+#define OPGP_LOG_CATEGORY OPGP_LOG_CATEGORY_CRYPTO //!< Category of the log messages of this file.
+
 #include "crypto.h"
 #include "globalplatform/stringify.h"
 #include "globalplatform/errorcodes.h"
@@ -36,13 +38,277 @@
 #include "util.h"
 
 #include <string.h>
+#include <errno.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
 
 #include <openssl/err.h>
 #include <openssl/rand.h>
 #include <openssl/evp.h>
 #include <openssl/pem.h>
-#include <openssl/aes.h>
+#include <openssl/bn.h>
+
+/*
+ * OpenSSL 3 looks up the implementation of an algorithm at each EVP_EncryptInit_ex() with an
+ * EVP_des_ede_cbc() like cipher. The algorithms are fetched once instead and reused by all operations.
+ */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#define OPGP_OPENSSL_FETCH
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#else
 #include <openssl/cmac.h>
+#endif
+
+#define CIPHER_DES_ECB 0 //!< Single DES ECB.
+#define CIPHER_DES_CBC 1 //!< Single DES CBC.
+#define CIPHER_DES_EDE_ECB 2 //!< Two key triple DES ECB.
+#define CIPHER_DES_EDE_CBC 3 //!< Two key triple DES CBC.
+#define CIPHER_AES_128_CBC 4 //!< AES-128 CBC.
+#define CIPHER_AES_128_ECB 5 //!< AES-128 ECB.
+#define CIPHERS 6 //!< Number of ciphers.
+
+#define DIGEST_SHA1 0 //!< SHA-1.
+#define DIGEST_SHA256 1 //!< SHA-256.
+#define DIGESTS 2 //!< Number of digests.
+
+#ifdef OPGP_OPENSSL_FETCH
+/**
+ * The names of the fetched ciphers. Single DES is only contained in the legacy provider,
+ * it is calculated as two key triple DES with two equal key halves.
+ */
+static const char *cipherNames[CIPHERS] = {"DES-EDE", "DES-EDE-CBC", "DES-EDE", "DES-EDE-CBC", "AES-128-CBC", "AES-128-ECB"};
+static const char *digestNames[DIGESTS] = {"SHA1", "SHA256"};
+static char cmacCipherName[] = "AES-128-CBC"; //!< The cipher of the CMAC.
+static EVP_CIPHER *ciphers[CIPHERS]; //!< The fetched ciphers.
+static EVP_MD *digests[DIGESTS]; //!< The fetched digests.
+static EVP_MAC_CTX *cmacTemplate = NULL; //!< An AES CMAC context with a zero key. Duplicated and rekeyed for each CMAC calculation.
+static CRYPTO_ONCE fetchOnce = CRYPTO_ONCE_STATIC_INIT;
+
+/**
+ * Fetches the algorithms from the default library context. Executed once.
+ */
+static void fetch_algorithms(void) {
+	int i;
+	EVP_MAC *mac;
+	OSSL_PARAM params[2];
+	BYTE zeroKey[16];
+	for (i=0; i<CIPHERS; i++) {
+		ciphers[i] = EVP_CIPHER_fetch(NULL, cipherNames[i], NULL);
+	}
+	for (i=0; i<DIGESTS; i++) {
+		digests[i] = EVP_MD_fetch(NULL, digestNames[i], NULL);
+	}
+	mac = EVP_MAC_fetch(NULL, "CMAC", NULL);
+	if (mac == NULL) {
+		return;
+	}
+	cmacTemplate = EVP_MAC_CTX_new(mac);
+	// the context keeps its own reference
+	EVP_MAC_free(mac);
+	params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_CIPHER, cmacCipherName, 0);
+	params[1] = OSSL_PARAM_construct_end();
+	// a CMAC context can only be duplicated after a key is set
+	memset(zeroKey, 0, sizeof(zeroKey));
+	if (cmacTemplate != NULL && EVP_MAC_init(cmacTemplate, zeroKey, 16, params) != 1) {
+		EVP_MAC_CTX_free(cmacTemplate);
+		cmacTemplate = NULL;
+	}
+}
+#endif
+
+/**
+ * Returns a cipher.
+ * \param cipher [in] The cipher. See #CIPHER_DES_ECB and related.
+ * \return The cipher or NULL if it is not available.
+ */
+static const EVP_CIPHER *get_cipher(int cipher) {
+#ifdef OPGP_OPENSSL_FETCH
+	if (!CRYPTO_THREAD_run_once(&fetchOnce, fetch_algorithms)) {
+		return NULL;
+	}
+	return ciphers[cipher];
+#else
+	switch (cipher) {
+		case CIPHER_DES_ECB:
+			return EVP_des_ecb();
+		case CIPHER_DES_CBC:
+			return EVP_des_cbc();
+		case CIPHER_DES_EDE_ECB:
+			return EVP_des_ede();
+		case CIPHER_DES_EDE_CBC:
+			return EVP_des_ede_cbc();
+		case CIPHER_AES_128_CBC:
+			return EVP_aes_128_cbc();
+		case CIPHER_AES_128_ECB:
+			return EVP_aes_128_ecb();
+		default:
+			return NULL;
+	}
+#endif
+}
+
+/**
+ * Returns a message digest.
+ * \param digest [in] The digest. See #DIGEST_SHA1 and #DIGEST_SHA256.
+ * \return The message digest or NULL if it is not available.
+ */
+static const EVP_MD *get_digest(int digest) {
+#ifdef OPGP_OPENSSL_FETCH
+	if (!CRYPTO_THREAD_run_once(&fetchOnce, fetch_algorithms)) {
+		return NULL;
+	}
+	return digests[digest];
+#else
+	switch (digest) {
+		case DIGEST_SHA1:
+			return EVP_sha1();
+		case DIGEST_SHA256:
+			return EVP_sha256();
+		default:
+			return NULL;
+	}
+#endif
+}
+
+/**
+ * Initializes a cipher context for encryption without padding.
+ * \param ctx [in, out] The cipher context.
+ * \param cipher [in] The cipher. See #CIPHER_DES_ECB and related.
+ * \param key [in] The key. 8 bytes for single DES, 16 bytes otherwise.
+ * \param iv [in] The initial chaining vector. NULL for ECB.
+ * \return 1 on success, 0 otherwise.
+ */
+static int encrypt_init(EVP_CIPHER_CTX *ctx, int cipher, const BYTE *key, const BYTE *iv) {
+	const EVP_CIPHER *evpCipher = get_cipher(cipher);
+	int result;
+#ifdef OPGP_OPENSSL_FETCH
+	BYTE doubleKey[16];
+#endif
+	if (evpCipher == NULL) {
+		return 0;
+	}
+#ifdef OPGP_OPENSSL_FETCH
+	if (cipher == CIPHER_DES_ECB || cipher == CIPHER_DES_CBC) {
+		memcpy(doubleKey, key, 8);
+		memcpy(doubleKey+8, key, 8);
+		result = EVP_EncryptInit_ex(ctx, evpCipher, NULL, doubleKey, iv);
+		OPENSSL_cleanse(doubleKey, 16);
+		if (result == 1) {
+			result = EVP_CIPHER_CTX_set_padding(ctx, 0);
+		}
+		return result;
+	}
+#endif
+	result = EVP_EncryptInit_ex(ctx, evpCipher, NULL, key, iv);
+	if (result == 1) {
+		result = EVP_CIPHER_CTX_set_padding(ctx, 0);
+	}
+	return result;
+}
+
+#ifdef OPGP_OPENSSL_FETCH
+typedef EVP_MAC_CTX AES_CMAC_CTX; //!< An AES CMAC context.
+#else
+typedef CMAC_CTX AES_CMAC_CTX; //!< An AES CMAC context.
+#endif
+
+/**
+ * Creates an AES CMAC context for the key.
+ * \param key [in] The AES-128 key.
+ * \return The context or NULL on error. Must be released with aes_cmac_free().
+ */
+static AES_CMAC_CTX *aes_cmac_new(const BYTE key[16]) {
+	AES_CMAC_CTX *ctx;
+#ifdef OPGP_OPENSSL_FETCH
+	if (!CRYPTO_THREAD_run_once(&fetchOnce, fetch_algorithms) || cmacTemplate == NULL) {
+		return NULL;
+	}
+	ctx = EVP_MAC_CTX_dup(cmacTemplate);
+	if (ctx != NULL && EVP_MAC_init(ctx, key, 16, NULL) != 1) {
+		EVP_MAC_CTX_free(ctx);
+		ctx = NULL;
+	}
+#else
+	ctx = CMAC_CTX_new();
+	if (ctx != NULL && CMAC_Init(ctx, key, 16, EVP_aes_128_cbc(), NULL) != 1) {
+		CMAC_CTX_free(ctx);
+		ctx = NULL;
+	}
+#endif
+	return ctx;
+}
+
+/**
+ * Adds data to an AES CMAC.
+ * \return 1 on success, 0 otherwise.
+ */
+static int aes_cmac_update(AES_CMAC_CTX *ctx, const BYTE *data, size_t dataLength) {
+#ifdef OPGP_OPENSSL_FETCH
+	return EVP_MAC_update(ctx, data, dataLength);
+#else
+	return CMAC_Update(ctx, data, dataLength);
+#endif
+}
+
+/**
+ * Finishes an AES CMAC.
+ * \return 1 on success, 0 otherwise.
+ */
+static int aes_cmac_final(AES_CMAC_CTX *ctx, BYTE mac[16]) {
+	size_t outl;
+#ifdef OPGP_OPENSSL_FETCH
+	return EVP_MAC_final(ctx, mac, &outl, 16);
+#else
+	return CMAC_Final(ctx, mac, &outl);
+#endif
+}
+
+/**
+ * Releases an AES CMAC context. ctx can be NULL.
+ */
+static void aes_cmac_free(AES_CMAC_CTX *ctx) {
+#ifdef OPGP_OPENSSL_FETCH
+	EVP_MAC_CTX_free(ctx);
+#else
+	CMAC_CTX_free(ctx);
+#endif
+}
+
+static OPGP_CRYPTO_PROVIDER cryptoProvider; //!< The crypto provider set with OPGP_set_crypto_provider(). execute is NULL if OpenSSL is used directly.
+static THREAD_LOCAL int cryptoProviderBypass = 0; //!< Set while the software crypto provider executes a request with OpenSSL. Only needed for RSA signing, the other operations executed for the provider never call it.
+
+/**
+ * Checks if the operations with long term keys must be passed to a crypto provider.
+ * \return 1 if a crypto provider is set and not bypassed, 0 otherwise.
+ */
+static int crypto_provider_active() {
+	return cryptoProvider.execute != NULL && !cryptoProviderBypass;
+}
+
+/**
+ * Initializes a request for the crypto provider.
+ * \param request [out] The request.
+ * \param operation [in] The operation. See #OPGP_CRYPTO_OPERATION_DERIVE_KEY and related.
+ * \param key [in] The key handle. NULL for RSA signing.
+ * \param data [in] The input data.
+ * \param dataLength [in] The length of the input data.
+ * \param result [out] The buffer for the result.
+ * \param resultLength [in] The size of the result buffer.
+ */
+static void init_crypto_request(OPGP_CRYPTO_REQUEST *request, DWORD operation, BYTE key[16],
+								PBYTE data, DWORD dataLength, PBYTE result, DWORD resultLength) {
+	memset(request, 0, sizeof(OPGP_CRYPTO_REQUEST));
+	request->operation = operation;
+	if (key != NULL) {
+		memcpy(request->key, key, 16);
+	}
+	request->data = data;
+	request->dataLength = dataLength;
+	request->result = result;
+	request->resultLength = resultLength;
+}
 
 /** 
  * \brief Creates a MAC for commands (APDUs) using CMAC AES. 
@@ -64,41 +330,237 @@
 OPGP_ERROR_STATUS calculate_CMAC_aes(BYTE sMacKey[16], BYTE *message, int messageLength, BYTE chainingValue[16], BYTE mac[16]) {
 	LONG result;
 	OPGP_ERROR_STATUS status;
-	size_t outl;
-	CMAC_CTX *ctx = CMAC_CTX_new();
+	AES_CMAC_CTX *ctx = NULL;
 	OPGP_LOG_START(_T("calculate_CMAC_aes"));
-
-	result = CMAC_Init(ctx, sMacKey, 16, EVP_aes_128_cbc(), NULL);
-	if (result != 1) {
+	ctx = aes_cmac_new(sMacKey);
+	if (ctx == NULL) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 	/*
 	 * The input for CMAC is: chainingValue|message.
 	 * The chaining value is 16 bytes long.
 	*/
-	result = CMAC_Update(ctx, chainingValue, 16);
+	result = aes_cmac_update(ctx, chainingValue, 16);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	result = CMAC_Update(ctx, message, messageLength);
+	result = aes_cmac_update(ctx, message, messageLength);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 
 	// Write the final block to the mac
-	result = CMAC_Final(ctx, mac, &outl);
+	result = aes_cmac_final(ctx, mac);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	CMAC_CTX_free(ctx);
+	aes_cmac_free(ctx);
 
 	OPGP_LOG_END(_T("calculate_CMAC_aes"), status);
 	return status;
 
 }
 
+/**
+ * Doubles a value in GF(2^128) for the CMAC subkey generation.
+ * \param in [in] The value.
+ * \param out [out] The doubled value.
+ */
+static void double_CMAC_block(BYTE in[16], BYTE out[16]) {
+	int i;
+	BYTE carry = in[0] & 0x80;
+	for (i=0; i<15; i++) {
+		out[i] = (BYTE)((in[i] << 1) | (in[i+1] >> 7));
+	}
+	out[15] = (BYTE)(in[15] << 1);
+	if (carry) {
+		out[15] ^= 0x87;
+	}
+}
+
+#define CMAC_KEY_STATES 8 //!< The number of cached CMAC key states of a thread, e.g. of secure channels to several cards.
+
+/**
+ * The AES context and the CMAC subkeys of a SCP03 session key. They are computed at the first use of the key,
+ * so each secure channel session derives them only once.
+ */
+typedef struct {
+	BYTE key[16]; //!< The key the state is computed for.
+	BYTE subkey1[16]; //!< The CMAC subkey K1.
+	BYTE subkey2[16]; //!< The CMAC subkey K2.
+	EVP_CIPHER_CTX *ctx; //!< The AES-128-ECB encryption context keyed with key. NULL if the state is unused.
+} CMAC_KEY_STATE;
+
+static THREAD_LOCAL CMAC_KEY_STATE cmacKeyStates[CMAC_KEY_STATES]; //!< The cached CMAC key states of the calling thread. A secure channel is only used by one thread at a time, so no lock is needed.
+static THREAD_LOCAL DWORD nextCmacKeyState = 0; //!< The cached state replaced next.
+
+/**
+ * Frees and cleanses a cached CMAC key state.
+ * \param keyState [in, out] The key state.
+ */
+static void clear_cmac_key_state(CMAC_KEY_STATE *keyState) {
+	EVP_CIPHER_CTX_free(keyState->ctx);
+	OPENSSL_cleanse(keyState, sizeof(CMAC_KEY_STATE));
+}
+
+/**
+ * Releases the cached CMAC key state of a session key of the calling thread when its secure channel session ends.
+ * The AES context and the subkeys are freed and cleansed.
+ * \param key [in] The session key or NULL to release all states of the calling thread.
+ */
+void release_CMAC_key_states(BYTE key[16]) {
+	DWORD i;
+	for (i=0; i<CMAC_KEY_STATES; i++) {
+		if (cmacKeyStates[i].ctx != NULL && (key == NULL || CRYPTO_memcmp(cmacKeyStates[i].key, key, 16) == 0)) {
+			clear_cmac_key_state(cmacKeyStates + i);
+		}
+	}
+}
+
+/**
+ * Encrypts one AES block with an AES-128-ECB context.
+ * \return 1 on success, 0 otherwise.
+ */
+static int aes_encrypt_block(EVP_CIPHER_CTX *ctx, const BYTE in[16], BYTE out[16]) {
+	int outl;
+	return EVP_EncryptUpdate(ctx, out, &outl, in, 16);
+}
+
+/**
+ * Returns the cached CMAC key state of a key. If the key is not cached the least recently computed state is
+ * replaced.
+ * \param key [in] The AES-128 key.
+ * \return The key state or NULL on error.
+ */
+static CMAC_KEY_STATE *get_cmac_key_state(BYTE key[16]) {
+	CMAC_KEY_STATE *keyState;
+	BYTE block[16];
+	DWORD i;
+	for (i=0; i<CMAC_KEY_STATES; i++) {
+		if (cmacKeyStates[i].ctx != NULL && memcmp(cmacKeyStates[i].key, key, 16) == 0) {
+			return cmacKeyStates + i;
+		}
+	}
+	keyState = cmacKeyStates + nextCmacKeyState;
+	nextCmacKeyState = (nextCmacKeyState + 1) % CMAC_KEY_STATES;
+	// the replaced key must not stay in memory
+	clear_cmac_key_state(keyState);
+	keyState->ctx = EVP_CIPHER_CTX_new();
+	if (keyState->ctx == NULL) {
+		return NULL;
+	}
+	memset(block, 0, 16);
+	if (encrypt_init(keyState->ctx, CIPHER_AES_128_ECB, key, NULL) != 1
+		|| aes_encrypt_block(keyState->ctx, block, block) != 1) {
+		clear_cmac_key_state(keyState);
+		return NULL;
+	}
+	double_CMAC_block(block, keyState->subkey1);
+	double_CMAC_block(keyState->subkey1, keyState->subkey2);
+	OPENSSL_cleanse(block, 16);
+	memcpy(keyState->key, key, 16);
+	return keyState;
+}
+
+/**
+ * Calculates a AES CMAC (NIST SP 800-38B) of chainingValue|message like calculate_CMAC_aes().
+ * The AES context and the subkeys of the key are cached for the calling thread, so only the data blocks are
+ * encrypted for each message of a session. release_CMAC_key_states() releases the cached state when the session ends.
+ * \param sMacKey [in] The S-MAC key.
+ * \param *message [in] The message.
+ * \param messageLength [in] The length of the message.
+ * \param chainingValue [in] The 16 byte chaining value prepended to the message. NULL if no chaining value is prepended.
+ * \param mac [out] The 16 byte CMAC.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS calculate_CMAC_aes_with_state(BYTE sMacKey[16], BYTE *message,
+								int messageLength, BYTE chainingValue[16],
+								BYTE mac[16]) {
+	OPGP_ERROR_STATUS status;
+	CMAC_KEY_STATE *keyState;
+	BYTE block[16];
+	BYTE state[16]; // the CMAC is computed here, mac may overlap the chaining value
+	PBYTE lastBlock = message;
+	int lastBlockLength = messageLength;
+	int i, offset = 0;
+	OPGP_LOG_START(_T("calculate_CMAC_aes_with_state"));
+	keyState = get_cmac_key_state(sMacKey);
+	if (keyState == NULL) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
+	}
+	memset(state, 0, 16);
+	if (chainingValue != NULL) {
+		// the chaining value is a complete block, it is the last block of an empty message
+		if (messageLength == 0) {
+			lastBlock = chainingValue;
+			lastBlockLength = 16;
+		}
+		else if (aes_encrypt_block(keyState->ctx, chainingValue, state) != 1) {
+			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
+		}
+	}
+	while (lastBlockLength - offset > 16) {
+		for (i=0; i<16; i++) {
+			state[i] ^= lastBlock[offset+i];
+		}
+		if (aes_encrypt_block(keyState->ctx, state, state) != 1) {
+			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
+		}
+		offset += 16;
+	}
+	// last block, complete blocks use K1, padded blocks K2, also the single padded block of an empty input
+	memset(block, 0, 16);
+	memcpy(block, lastBlock+offset, lastBlockLength-offset);
+	if (lastBlockLength - offset == 16) {
+		for (i=0; i<16; i++) {
+			block[i] ^= keyState->subkey1[i];
+		}
+	}
+	else {
+		block[lastBlockLength-offset] = 0x80;
+		for (i=0; i<16; i++) {
+			block[i] ^= keyState->subkey2[i];
+		}
+	}
+	for (i=0; i<16; i++) {
+		state[i] ^= block[i];
+	}
+	if (aes_encrypt_block(keyState->ctx, state, state) != 1) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
+	}
+	memcpy(mac, state, 16);
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPENSSL_cleanse(block, 16);
+	OPENSSL_cleanse(state, 16);
+	OPGP_LOG_END(_T("calculate_CMAC_aes_with_state"), status);
+	return status;
+}
+
+/**
+ * Releases the fetched algorithms and the cached CMAC key states of the unloading thread when the library is unloaded.
+ */
+static void DESTRUCTOR release_crypto(void) {
+#ifdef OPGP_OPENSSL_FETCH
+	DWORD i;
+#endif
+	release_CMAC_key_states(NULL);
+#ifdef OPGP_OPENSSL_FETCH
+	for (i=0; i<CIPHERS; i++) {
+		EVP_CIPHER_free(ciphers[i]);
+		ciphers[i] = NULL;
+	}
+	for (i=0; i<DIGESTS; i++) {
+		EVP_MD_free(digests[i]);
+		digests[i] = NULL;
+	}
+	EVP_MAC_CTX_free(cmacTemplate);
+	cmacTemplate = NULL;
+#endif
+}
+
 /**
  * Calculates the encryption of a message in CBC mode for SCP02.
  * Pads the message with 0x80 and additional 0x00 until message length is a multiple of 8.
@@ -114,18 +576,19 @@ OPGP_ERROR_STATUS calculate_enc_cbc_SCP02(BYTE key[16], BYTE *message, int messa
 	OPGP_ERROR_STATUS status;
 	int result;
 	int i,outl;
-	EVP_CIPHER_CTX ctx;
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
 	OPGP_LOG_START(_T("calculate_enc_cbc_SCP02"));
-	EVP_CIPHER_CTX_init(&ctx);
+	if (ctx == NULL) {
+		{ OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM)); goto end; }
+	}
 	*encryptionLength = 0;
 
-	result = EVP_EncryptInit_ex(&ctx, EVP_des_ede_cbc(), NULL, key, icv);
+	result = encrypt_init(ctx, CIPHER_DES_EDE_CBC, key, icv);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
 	for (i=0; i<messageLength/8; i++) {
-		result = EVP_EncryptUpdate(&ctx, encryption+*encryptionLength,
+		result = EVP_EncryptUpdate(ctx, encryption+*encryptionLength,
 			&outl, message+i*8, 8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
@@ -133,20 +596,20 @@ OPGP_ERROR_STATUS calculate_enc_cbc_SCP02(BYTE key[16], BYTE *message, int messa
 		*encryptionLength+=outl;
 	}
 	if (messageLength%8 != 0) {
-		result = EVP_EncryptUpdate(&ctx, encryption+*encryptionLength,
+		result = EVP_EncryptUpdate(ctx, encryption+*encryptionLength,
 			&outl, message+i*8, messageLength%8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 		}
 		*encryptionLength+=outl;
 	}
-	result = EVP_EncryptUpdate(&ctx, encryption+*encryptionLength,
+	result = EVP_EncryptUpdate(ctx, encryption+*encryptionLength,
 		&outl, padding, 8 - (messageLength%8));
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 	*encryptionLength+=outl;
-	result = EVP_EncryptFinal_ex(&ctx, encryption+*encryptionLength,
+	result = EVP_EncryptFinal_ex(ctx, encryption+*encryptionLength,
 		&outl);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
@@ -154,9 +617,7 @@ OPGP_ERROR_STATUS calculate_enc_cbc_SCP02(BYTE key[16], BYTE *message, int messa
 	*encryptionLength+=outl;
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	if (EVP_CIPHER_CTX_cleanup(&ctx) != 1) {
-		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); }
-	}
+	EVP_CIPHER_CTX_free(ctx);
 
 	OPGP_LOG_END(_T("calculate_enc_cbc_SCP02"), status);
 	return status;
@@ -406,6 +867,25 @@ end:
 	return status;
 }
 
+/**
+ * Prepares the crypto provider request for a session key for SCP01.
+ * \param request [out] The request.
+ * \param key [in] The Secure Channel Encryption Key or Secure Channel Message
+ * Authentication Code Key for calculating the corresponding session key.
+ * \param cardChallenge [in] The card challenge.
+ * \param hostChallenge [in] The host challenge.
+ * \param derivationData [out] The buffer for the derivation data. Must stay valid until the request is completed.
+ * \param sessionKey [out] The buffer for the 3DES session key.
+ */
+void prepare_session_key_request_SCP01(OPGP_CRYPTO_REQUEST *request, BYTE key[16], BYTE cardChallenge[8],
+							   BYTE hostChallenge[8], BYTE derivationData[16], BYTE sessionKey[16]) {
+	memcpy(derivationData, cardChallenge+4, 4);
+	memcpy(derivationData+4, hostChallenge, 4);
+	memcpy(derivationData+8, cardChallenge, 4);
+	memcpy(derivationData+12, hostChallenge+4, 4);
+	init_crypto_request(request, OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP01, key, derivationData, 16, sessionKey, 16);
+}
+
 /**
  * Creates the session key for SCP01.
  * \param key [in] The Secure Channel Encryption Key or Secure Channel Message
@@ -418,16 +898,12 @@ end:
 OPGP_ERROR_STATUS create_session_key_SCP01(BYTE key[16], BYTE cardChallenge[8],
 							   BYTE hostChallenge[8], BYTE sessionKey[16]) {
 	OPGP_ERROR_STATUS status;
+	OPGP_CRYPTO_REQUEST request;
 	BYTE derivation_data[16];
-	int outl;
 
 	OPGP_LOG_START(_T("create_session_key_SCP01"));
-	memcpy(derivation_data, cardChallenge+4, 4);
-	memcpy(derivation_data+4, hostChallenge, 4);
-	memcpy(derivation_data+8, cardChallenge, 4);
-	memcpy(derivation_data+12, hostChallenge+4, 4);
-
-	status = calculate_enc_ecb_two_key_triple_des(key, derivation_data, 16, sessionKey, &outl);
+	prepare_session_key_request_SCP01(&request, key, cardChallenge, hostChallenge, derivation_data, sessionKey);
+	status = OPGP_crypto_execute(&request);
 	if (OPGP_ERROR_CHECK(status)) {
 		goto end;
 	}
@@ -438,6 +914,24 @@ end:
 	return status;
 }
 
+/**
+ * Prepares the crypto provider request for a session key for SCP02.
+ * \param request [out] The request.
+ * \param key [in] The Secure Channel Encryption Key or Secure Channel Message
+ * Authentication Code Key or Data Encryption Key for calculating the corresponding session key.
+ * \param constant [in] The constant for the corresponding session key.
+ * \param sequenceCounter [in] The sequence counter.
+ * \param derivationData [out] The buffer for the derivation data. Must stay valid until the request is completed.
+ * \param sessionKey [out] The buffer for the 3DES session key.
+ */
+void prepare_session_key_request_SCP02(OPGP_CRYPTO_REQUEST *request, BYTE key[16], BYTE constant[2],
+							   BYTE sequenceCounter[2], BYTE derivationData[16], BYTE sessionKey[16]) {
+	memcpy(derivationData, constant, 2);
+	memcpy(derivationData+2, sequenceCounter, 2);
+	memset(derivationData+4, 0, 12);
+	init_crypto_request(request, OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP02, key, derivationData, 16, sessionKey, 16);
+}
+
 /**
  * Creates the session key for SCP02.
  * \param key [in] The Secure Channel Encryption Key or Secure Channel Message
@@ -450,18 +944,12 @@ end:
 OPGP_ERROR_STATUS create_session_key_SCP02(BYTE key[16], BYTE constant[2],
 									BYTE sequenceCounter[2], BYTE sessionKey[16]) {
 	OPGP_ERROR_STATUS status;
+	OPGP_CRYPTO_REQUEST request;
 	BYTE derivation_data[16];
-	int outl;
-	int i;
 
 	OPGP_LOG_START(_T("create_session_key_SCP02"));
-	memcpy(derivation_data, constant, 2);
-	memcpy(derivation_data+2, sequenceCounter, 2);
-	for (i=4; i< 16; i++) {
-		derivation_data[i] = 0x00;
-	}
-
-	status = calculate_enc_cbc(key, derivation_data, 16, sessionKey, &outl);
+	prepare_session_key_request_SCP02(&request, key, constant, sequenceCounter, derivation_data, sessionKey);
+	status = OPGP_crypto_execute(&request);
 	if (OPGP_ERROR_CHECK(status)) {
 		goto end;
 	}
@@ -472,6 +960,31 @@ end:
 	return status;
 }
 
+/**
+ * Prepares the crypto provider request for an AES-128 session key for SCP03.
+ * \param request [out] The request.
+ * \param key [in] The Secure Channel Encryption Key or Secure Channel Message
+ * Authentication Code Key for calculating the corresponding session key.
+ * \param derivationConstant [in] The derivation constant, as defined in "Table 4-1: Data derivation constants" of SCP03.
+ * \param cardChallenge [in] The card challenge.
+ * \param hostChallenge [in] The host challenge.
+ * \param derivationData [out] The buffer for the derivation data. Must stay valid until the request is completed.
+ * \param sessionKey [out] The buffer for the AES session key.
+ */
+void prepare_session_key_request_SCP03(OPGP_CRYPTO_REQUEST *request, BYTE key[16], BYTE derivationConstant,
+							   BYTE cardChallenge[8], BYTE hostChallenge[8], BYTE derivationData[32], BYTE sessionKey[16]) {
+	memset(derivationData, 0, 11); //<! "label"
+	derivationData[11] = derivationConstant; //<! "derivation constant" part of label
+	derivationData[12] = 0x00;     // <! "separation indicator"
+	derivationData[13] = 0x00;     // <! First byte of key length
+	derivationData[14] = 0x80;     // <! Second byte of key length - only 128 bit keys supported
+	derivationData[15] = 0x01;     // <! byte counter "i" - only 128 bit keys supported
+
+	memcpy(derivationData+16, hostChallenge, 8);
+	memcpy(derivationData+24, cardChallenge, 8);
+	init_crypto_request(request, OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP03, key, derivationData, 32, sessionKey, 16);
+}
+
 /**
  * Creates an AES-128 session key for SCP03.
  * \param key [in] The Secure Channel Encryption Key or Secure Channel Message
@@ -485,20 +998,12 @@ end:
 OPGP_ERROR_STATUS create_session_key_SCP03(BYTE key[16], BYTE derivationConstant, BYTE cardChallenge[8],
 							   BYTE hostChallenge[8], BYTE sessionKey[16]) {
 	OPGP_ERROR_STATUS status;
+	OPGP_CRYPTO_REQUEST request;
 	BYTE derivation_data[32];
 
 	OPGP_LOG_START(_T("create_session_key_SCP03"));
-	memset(derivation_data, 0, 11); //<! "label" 
-	derivation_data[11] = derivationConstant; //<! "derivation constant" part of label
-	derivation_data[12] = 0x00;     // <! "separation indicator"
-	derivation_data[13] = 0x00;     // <! First byte of key length 
-	derivation_data[14] = 0x80;     // <! Second byte of key length - only 128 bit keys supported
-	derivation_data[15] = 0x01;     // <! byte counter "i" - only 128 bit keys supported
-
-	memcpy(derivation_data+16, hostChallenge, 8);
-	memcpy(derivation_data+24, cardChallenge, 8);
-
-	status = calculate_MAC_aes(key, derivation_data, 32, sessionKey);
+	prepare_session_key_request_SCP03(&request, key, derivationConstant, cardChallenge, hostChallenge, derivation_data, sessionKey);
+	status = OPGP_crypto_execute(&request);
 	if (OPGP_ERROR_CHECK(status)) {
 		goto end;
 	}
@@ -509,6 +1014,39 @@ end:
 	return status;
 }
 
+/**
+ * Derives the static keys S-ENC, S-MAC and DEK from a master key. The three derivations are submitted to the
+ * crypto provider as one batch.
+ * \param masterKey [in] The master key or its key handle.
+ * \param keyDiversificationData [in] The 16 byte key diversification data for S-ENC, S-MAC and DEK.
+ * \param S_ENC [out] The static Encryption key.
+ * \param S_MAC [out] The static Message Authentication Code key.
+ * \param DEK [out] The static Key Encryption Key.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS derive_static_keys(BYTE masterKey[16], BYTE keyDiversificationData[3][16],
+									 BYTE S_ENC[16], BYTE S_MAC[16], BYTE DEK[16]) {
+	OPGP_ERROR_STATUS status;
+	OPGP_CRYPTO_REQUEST requests[3];
+
+	OPGP_LOG_START(_T("derive_static_keys"));
+	init_crypto_request(&requests[0], OPGP_CRYPTO_OPERATION_DERIVE_KEY, masterKey, keyDiversificationData[0], 16, S_ENC, 16);
+	init_crypto_request(&requests[1], OPGP_CRYPTO_OPERATION_DERIVE_KEY, masterKey, keyDiversificationData[1], 16, S_MAC, 16);
+	init_crypto_request(&requests[2], OPGP_CRYPTO_OPERATION_DERIVE_KEY, masterKey, keyDiversificationData[2], 16, DEK, 16);
+	status = OPGP_crypto_submit(requests, 3);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = OPGP_crypto_wait(requests, 3);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("derive_static_keys"), status);
+	return status;
+}
+
 /**
  * Calculates the encryption of a message in ECB mode with two key triple DES.
  * Pads the message with 0x80 and additional 0x00 if message length is not a multiple of 8.
@@ -524,18 +1062,19 @@ OPGP_ERROR_STATUS calculate_enc_ecb_two_key_triple_des(BYTE key[16], BYTE *messa
 	int result;
 	OPGP_ERROR_STATUS status;
 	int i,outl;
-	EVP_CIPHER_CTX ctx;
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
 	OPGP_LOG_START(_T("calculate_enc_ecb_two_key_triple_des"));
-	EVP_CIPHER_CTX_init(&ctx);
+	if (ctx == NULL) {
+		{ OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM)); goto end; }
+	}
 	*encryptionLength = 0;
 
-	result = EVP_EncryptInit_ex(&ctx, EVP_des_ede(), NULL, key, icv);
+	result = encrypt_init(ctx, CIPHER_DES_EDE_ECB, key, icv);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
 	for (i=0; i<messageLength/8; i++) {
-		result = EVP_EncryptUpdate(&ctx, encryption+*encryptionLength,
+		result = EVP_EncryptUpdate(ctx, encryption+*encryptionLength,
 			&outl, message+i*8, 8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
@@ -543,21 +1082,21 @@ OPGP_ERROR_STATUS calculate_enc_ecb_two_key_triple_des(BYTE key[16], BYTE *messa
 		*encryptionLength+=outl;
 	}
 	if (messageLength%8 != 0) {
-		result = EVP_EncryptUpdate(&ctx, encryption+*encryptionLength,
+		result = EVP_EncryptUpdate(ctx, encryption+*encryptionLength,
 			&outl, message+i*8, messageLength%8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 		}
 		*encryptionLength+=outl;
 
-		result = EVP_EncryptUpdate(&ctx, encryption+*encryptionLength,
+		result = EVP_EncryptUpdate(ctx, encryption+*encryptionLength,
 			&outl, padding, 8 - (messageLength%8));
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 		}
 		*encryptionLength+=outl;
 	}
-	result = EVP_EncryptFinal_ex(&ctx, encryption+*encryptionLength,
+	result = EVP_EncryptFinal_ex(ctx, encryption+*encryptionLength,
 		&outl);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
@@ -566,9 +1105,7 @@ OPGP_ERROR_STATUS calculate_enc_ecb_two_key_triple_des(BYTE key[16], BYTE *messa
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
 
-	if (EVP_CIPHER_CTX_cleanup(&ctx) != 1) {
-		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); }
-	}
+	EVP_CIPHER_CTX_free(ctx);
 	OPGP_LOG_END(_T("calculate_enc_ecb_two_key_triple_des"), status);
 	return status;
 }
@@ -588,18 +1125,19 @@ OPGP_ERROR_STATUS calculate_enc_ecb_single_des(BYTE key[8], BYTE *message, int m
 	int result;
 	OPGP_ERROR_STATUS status;
 	int i,outl;
-	EVP_CIPHER_CTX ctx;
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
 	OPGP_LOG_START(_T("calculate_enc_ecb_single_des"));
-	EVP_CIPHER_CTX_init(&ctx);
+	if (ctx == NULL) {
+		{ OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM)); goto end; }
+	}
 	*encryptionLength = 0;
 
-	result = EVP_EncryptInit_ex(&ctx, EVP_des_ecb(), NULL, key, NULL);
+	result = encrypt_init(ctx, CIPHER_DES_ECB, key, NULL);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
 	for (i=0; i<messageLength/8; i++) {
-		result = EVP_EncryptUpdate(&ctx, encryption+*encryptionLength,
+		result = EVP_EncryptUpdate(ctx, encryption+*encryptionLength,
 			&outl, message+i*8, 8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
@@ -607,21 +1145,21 @@ OPGP_ERROR_STATUS calculate_enc_ecb_single_des(BYTE key[8], BYTE *message, int m
 		*encryptionLength+=outl;
 	}
 	if (messageLength%8 != 0) {
-		result = EVP_EncryptUpdate(&ctx, encryption+*encryptionLength,
+		result = EVP_EncryptUpdate(ctx, encryption+*encryptionLength,
 			&outl, message+i*8, messageLength%8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 		}
 		*encryptionLength+=outl;
 
-		result = EVP_EncryptUpdate(&ctx, encryption+*encryptionLength,
+		result = EVP_EncryptUpdate(ctx, encryption+*encryptionLength,
 			&outl, padding, 8 - (messageLength%8));
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 		}
 		*encryptionLength+=outl;
 	}
-	result = EVP_EncryptFinal_ex(&ctx, encryption+*encryptionLength,
+	result = EVP_EncryptFinal_ex(ctx, encryption+*encryptionLength,
 		&outl);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
@@ -629,9 +1167,7 @@ OPGP_ERROR_STATUS calculate_enc_ecb_single_des(BYTE key[8], BYTE *message, int m
 	*encryptionLength+=outl;
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	if (EVP_CIPHER_CTX_cleanup(&ctx) != 1) {
-		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); }
-	}
+	EVP_CIPHER_CTX_free(ctx);
 
 	OPGP_LOG_END(_T("calculate_enc_ecb_single_des"), status);
 	return status;
@@ -652,44 +1188,43 @@ OPGP_ERROR_STATUS calculate_MAC(BYTE sessionKey[16], BYTE *message, int messageL
 	LONG result;
 	OPGP_ERROR_STATUS status;
 	int i,outl;
-	EVP_CIPHER_CTX ctx;
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
 	OPGP_LOG_START(_T("calculate_MAC"));
-	EVP_CIPHER_CTX_init(&ctx);
+	if (ctx == NULL) {
+		{ OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM)); goto end; }
+	}
 
-	result = EVP_EncryptInit_ex(&ctx, EVP_des_ede_cbc(), NULL, sessionKey, icv);
+	result = encrypt_init(ctx, CIPHER_DES_EDE_CBC, sessionKey, icv);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
 	for (i=0; i<messageLength/8; i++) {
-		result = EVP_EncryptUpdate(&ctx, mac,
+		result = EVP_EncryptUpdate(ctx, mac,
 			&outl, message+i*8, 8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 		}
 	}
 	if (messageLength%8 != 0) {
-		result = EVP_EncryptUpdate(&ctx, mac,
+		result = EVP_EncryptUpdate(ctx, mac,
 			&outl, message+i*8, messageLength%8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 		}
 	}
-	result = EVP_EncryptUpdate(&ctx, mac,
+	result = EVP_EncryptUpdate(ctx, mac,
 		&outl, padding, 8 - (messageLength%8));
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	result = EVP_EncryptFinal_ex(&ctx, mac,
+	result = EVP_EncryptFinal_ex(ctx, mac,
 		&outl);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	if (EVP_CIPHER_CTX_cleanup(&ctx) != 1) {
-		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); }
-	}
+	EVP_CIPHER_CTX_free(ctx);
 
 	OPGP_LOG_END(_T("calculate_MAC"), status);
 	return status;
@@ -706,27 +1241,26 @@ end:
 OPGP_ERROR_STATUS calculate_MAC_aes(BYTE key[16], BYTE *message, int messageLength, BYTE mac[16]) {
 	LONG result;
 	OPGP_ERROR_STATUS status;
-	size_t outl;
-	CMAC_CTX *ctx = CMAC_CTX_new();
+	AES_CMAC_CTX *ctx = NULL;
 	OPGP_LOG_START(_T("calculate_MAC_aes"));
 
-	result = CMAC_Init(ctx, key, 16, EVP_aes_128_cbc(), NULL);
-	if (result != 1) {
+	ctx = aes_cmac_new(key);
+	if (ctx == NULL) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	result = CMAC_Update(ctx, message, messageLength);
+	result = aes_cmac_update(ctx, message, messageLength);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 
 	// Write the final block to the mac
-	result = CMAC_Final(ctx, mac, &outl);
+	result = aes_cmac_final(ctx, mac);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	CMAC_CTX_free(ctx);
+	aes_cmac_free(ctx);
 
 	OPGP_LOG_END(_T("calculate_MAC_aes"), status);
 	return status;
@@ -747,18 +1281,19 @@ OPGP_ERROR_STATUS calculate_enc_cbc(BYTE key[16], BYTE *message, int messageLeng
 	LONG result;
 	OPGP_ERROR_STATUS status;
 	int i,outl;
-	EVP_CIPHER_CTX ctx;
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
 	OPGP_LOG_START(_T("calculate_enc_cbc"));
-	EVP_CIPHER_CTX_init(&ctx);
+	if (ctx == NULL) {
+		{ OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM)); goto end; }
+	}
 	*encryptionLength = 0;
 
-	result = EVP_EncryptInit_ex(&ctx, EVP_des_ede_cbc(), NULL, key, icv);
+	result = encrypt_init(ctx, CIPHER_DES_EDE_CBC, key, icv);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
 	for (i=0; i<messageLength/8; i++) {
-		result = EVP_EncryptUpdate(&ctx, encryption+*encryptionLength,
+		result = EVP_EncryptUpdate(ctx, encryption+*encryptionLength,
 			&outl, message+i*8, 8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
@@ -766,21 +1301,21 @@ OPGP_ERROR_STATUS calculate_enc_cbc(BYTE key[16], BYTE *message, int messageLeng
 		*encryptionLength+=outl;
 	}
 	if (messageLength%8 != 0) {
-		result = EVP_EncryptUpdate(&ctx, encryption+*encryptionLength,
+		result = EVP_EncryptUpdate(ctx, encryption+*encryptionLength,
 			&outl, message+i*8, messageLength%8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 		}
 		*encryptionLength+=outl;
 
-		result = EVP_EncryptUpdate(&ctx, encryption+*encryptionLength,
+		result = EVP_EncryptUpdate(ctx, encryption+*encryptionLength,
 			&outl, padding, 8 - (messageLength%8));
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 		}
 		*encryptionLength+=outl;
 	}
-	result = EVP_EncryptFinal_ex(&ctx, encryption+*encryptionLength,
+	result = EVP_EncryptFinal_ex(ctx, encryption+*encryptionLength,
 		&outl);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
@@ -788,9 +1323,7 @@ OPGP_ERROR_STATUS calculate_enc_cbc(BYTE key[16], BYTE *message, int messageLeng
 	*encryptionLength+=outl;
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	if (EVP_CIPHER_CTX_cleanup(&ctx) != 1) {
-		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); }
-	}
+	EVP_CIPHER_CTX_free(ctx);
 
 	OPGP_LOG_END(_T("calculate_enc_cbc"), status);
 	return status;
@@ -810,12 +1343,22 @@ OPGP_ERROR_STATUS calculate_rsa_signature(PBYTE message, DWORD messageLength, OP
 									char *passPhrase, BYTE signature[128]) {
 	LONG result;
 	OPGP_ERROR_STATUS status;
+	OPGP_CRYPTO_REQUEST request;
 	EVP_PKEY *key = NULL;
 	FILE *PEMKeyFile = NULL;
-	EVP_MD_CTX mdctx;
+	EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
 	unsigned int signatureLength=0;
 	OPGP_LOG_START(_T("calculate_rsa_signature"));
-	EVP_MD_CTX_init(&mdctx);
+	if (mdctx == NULL) {
+		{ OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM)); goto end; }
+	}
+	if (crypto_provider_active()) {
+		init_crypto_request(&request, OPGP_CRYPTO_OPERATION_SIGN_RSA, NULL, message, messageLength, signature, 128);
+		request.keyName = PEMKeyFileName;
+		request.passPhrase = passPhrase;
+		status = OPGP_crypto_execute(&request);
+		goto end;
+	}
 	if (passPhrase == NULL)
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_PASSWORD, OPGP_stringify_error(OPGP_ERROR_INVALID_PASSWORD)); goto end; }
 	if ((PEMKeyFileName == NULL) || (_tcslen(PEMKeyFileName) == 0))
@@ -828,25 +1371,25 @@ OPGP_ERROR_STATUS calculate_rsa_signature(PBYTE message, DWORD messageLength, OP
 	if (!PEM_read_PrivateKey(PEMKeyFile, &key, NULL, passPhrase)) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	};
-	result = EVP_SignInit_ex(&mdctx, EVP_sha1(), NULL);
+	result = EVP_SignInit_ex(mdctx, get_digest(DIGEST_SHA1), NULL);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	result = EVP_SignUpdate(&mdctx, message, messageLength);
+	result = EVP_SignUpdate(mdctx, message, messageLength);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 	if (EVP_PKEY_size(key) > 128) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_BUFFER, OPGP_stringify_error(OPGP_ERROR_INSUFFICIENT_BUFFER)); goto end; }
 	}
-	result = EVP_SignFinal(&mdctx, signature, &signatureLength, key);
+	result = EVP_SignFinal(mdctx, signature, &signatureLength, key);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	if (EVP_MD_CTX_cleanup(&mdctx) != 1) {
-		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); }
+	if (mdctx != NULL) {
+		EVP_MD_CTX_destroy(mdctx);
 	}
 
 	if (PEMKeyFile) {
@@ -875,11 +1418,13 @@ OPGP_ERROR_STATUS calculate_MAC_des_3des(BYTE _3des_key[16], BYTE *message, int
 	LONG result;
 	OPGP_ERROR_STATUS status;
 	int i,outl;
-	EVP_CIPHER_CTX ctx;
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
 	BYTE des_key[8];
 	BYTE _icv[8];
 	OPGP_LOG_START(_T("calculate_MAC_des_3des"));
-	EVP_CIPHER_CTX_init(&ctx);
+	if (ctx == NULL) {
+		{ OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM)); goto end; }
+	}
 	if (initialICV == NULL) {
 		memcpy(_icv, icv, 8);
 	}
@@ -890,56 +1435,47 @@ OPGP_ERROR_STATUS calculate_MAC_des_3des(BYTE _3des_key[16], BYTE *message, int
 	memcpy(mac, initialICV, 8);
 //  DES CBC mode
 	memcpy(des_key, _3des_key, 8);
-	result = EVP_EncryptInit_ex(&ctx, EVP_des_cbc(), NULL, des_key, _icv);
+	result = encrypt_init(ctx, CIPHER_DES_CBC, des_key, _icv);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
 	for (i=0; i<messageLength/8; i++) {
-		result = EVP_EncryptUpdate(&ctx, mac,
+		result = EVP_EncryptUpdate(ctx, mac,
 			&outl, message+i*8, 8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 		}
 	}
-	result = EVP_EncryptFinal_ex(&ctx, mac,
+	result = EVP_EncryptFinal_ex(ctx, mac,
 		&outl);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	result = EVP_CIPHER_CTX_cleanup(&ctx);
-	if (result != 1) {
-		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
-	}
 //  3DES mode
-	EVP_CIPHER_CTX_init(&ctx);
-	result = EVP_EncryptInit_ex(&ctx, EVP_des_ede_cbc(), NULL, _3des_key, mac);
+	result = encrypt_init(ctx, CIPHER_DES_EDE_CBC, _3des_key, mac);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
 	if (messageLength%8 != 0) {
-		result = EVP_EncryptUpdate(&ctx, mac,
+		result = EVP_EncryptUpdate(ctx, mac,
 			&outl, message+i*8, messageLength%8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 		}
 	}
-	result = EVP_EncryptUpdate(&ctx, mac,
+	result = EVP_EncryptUpdate(ctx, mac,
 		&outl, padding, 8 - (messageLength%8));
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	result = EVP_EncryptFinal_ex(&ctx, mac,
+	result = EVP_EncryptFinal_ex(ctx, mac,
 		&outl);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	if (EVP_CIPHER_CTX_cleanup(&ctx) != 1) {
-		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); }
-	}
+	EVP_CIPHER_CTX_free(ctx);
 
 	OPGP_LOG_END(_T("calculate_MAC_des_3des"), status);
 	return status;
@@ -1015,6 +1551,37 @@ end:
 	return status;
 }
 
+/**
+ * Calculates the encryption of a message in ECB mode with two key triple DES and the Data Encryption Key of the
+ * secure channel. SCP02 uses a DEK session key which is used directly. SCP01 and SCP03 use the static DEK, which is
+ * a key handle if a crypto provider is set, so the encryption is done by the crypto provider.
+ * Pads the message with 0x80 and additional 0x00 if message length is not a multiple of 8.
+ * \param *secInfo [in] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param *message [in] The message to encrypt.
+ * \param messageLength [in] The length of the message.
+ * \param *encryption [out] The encryption.
+ * \param *encryptionLength [out] The length of the encryption.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS calculate_enc_ecb_DEK(GP211_SECURITY_INFO *secInfo, BYTE *message, int messageLength,
+							  BYTE *encryption, int *encryptionLength) {
+	OPGP_ERROR_STATUS status;
+	OPGP_CRYPTO_REQUEST request;
+	OPGP_LOG_START(_T("calculate_enc_ecb_DEK"));
+	if (secInfo->secureChannelProtocol == GP211_SCP02) {
+		status = calculate_enc_ecb_two_key_triple_des(secInfo->dataEncryptionSessionKey, message, messageLength,
+			encryption, encryptionLength);
+		goto end;
+	}
+	init_crypto_request(&request, OPGP_CRYPTO_OPERATION_ENC_3DES_ECB, secInfo->dataEncryptionSessionKey,
+		message, messageLength, encryption, (messageLength+7)/8*8);
+	status = OPGP_crypto_execute(&request);
+	*encryptionLength = (int)request.resultLength;
+end:
+	OPGP_LOG_END(_T("calculate_enc_ecb_DEK"), status);
+	return status;
+}
+
 OPGP_ERROR_STATUS get_key_data_field(GP211_SECURITY_INFO *secInfo,
 							 PBYTE keyData,
 							 DWORD keyDataLength,
@@ -1054,7 +1621,7 @@ OPGP_ERROR_STATUS get_key_data_field(GP211_SECURITY_INFO *secInfo,
 				status = calculate_enc_cbc_SCP02(secInfo->dataEncryptionSessionKey, keyData, keyDataLength, encrypted_key, &encrypted_key_length);
 		}
 		else {
-			status = calculate_enc_ecb_two_key_triple_des(secInfo->dataEncryptionSessionKey, keyData, keyDataLength, encrypted_key, &encrypted_key_length);
+			status = calculate_enc_ecb_DEK(secInfo, keyData, keyDataLength, encrypted_key, &encrypted_key_length);
 		}
 		if (OPGP_ERROR_CHECK(status)) {
 			goto end;
@@ -1110,6 +1677,9 @@ OPGP_ERROR_STATUS wrap_command(PBYTE apduCommand, DWORD apduCommandLength, PBYTE
 	DWORD caseAPDU;
 	BYTE C_MAC_ICV[8];
 	int C_MAC_ICVLength = 8;
+	PBYTE macData = wrappedApduCommand;
+	DWORD macDataLength;
+	BYTE unmodifiedHeader[5];
 	OPGP_LOG_START(_T("wrap_command"));
 	if (*wrappedApduCommandLength < apduCommandLength)
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_BUFFER, OPGP_stringify_error(OPGP_ERROR_INSUFFICIENT_BUFFER)); goto end; }
@@ -1301,9 +1871,29 @@ OPGP_ERROR_STATUS wrap_command(PBYTE apduCommand, DWORD apduCommandLength, PBYTE
 			}
 		}
 
+		// the C-MAC on an unmodified APDU covers the header and data as they are, case 1 and 2 commands with Lc '00'
+		if (secInfo->secureChannelProtocolImpl == GP211_SCP02_IMPL_i0A
+			|| secInfo->secureChannelProtocolImpl == GP211_SCP02_IMPL_i0B
+			|| secInfo->secureChannelProtocolImpl == GP211_SCP02_IMPL_i1A
+			|| secInfo->secureChannelProtocolImpl == GP211_SCP02_IMPL_i1B) {
+			if (caseAPDU == 1 || caseAPDU == 2) {
+				memcpy(unmodifiedHeader, apduCommand, 4);
+				unmodifiedHeader[4] = 0x00;
+				macData = unmodifiedHeader;
+				macDataLength = 5;
+			}
+			else {
+				macDataLength = wrappedLength;
+			}
+		}
+		else {
+			// the space for the C-MAC is already added
+			macDataLength = wrappedLength-8;
+		}
+
 		// MAC calculation
 		if (secInfo->secureChannelProtocol == GP211_SCP02) {
-			status = calculate_MAC_des_3des(secInfo->C_MACSessionKey, wrappedApduCommand, wrappedLength-8,
+			status = calculate_MAC_des_3des(secInfo->C_MACSessionKey, macData, macDataLength,
 				C_MAC_ICV, mac);
 			if (OPGP_ERROR_CHECK(status)) {
 				goto end;
@@ -1311,7 +1901,7 @@ OPGP_ERROR_STATUS wrap_command(PBYTE apduCommand, DWORD apduCommandLength, PBYTE
 		}
 		// Philip Wendland: Added SCP01 check as this would apply to SCP03 otherwise.
 		else if (secInfo->secureChannelProtocol == GP211_SCP01){
-			status = calculate_MAC(secInfo->C_MACSessionKey, wrappedApduCommand, wrappedLength-8,
+			status = calculate_MAC(secInfo->C_MACSessionKey, macData, macDataLength,
 				C_MAC_ICV, mac);
 			if (OPGP_ERROR_CHECK(status)) {
 				goto end;
@@ -1321,9 +1911,11 @@ OPGP_ERROR_STATUS wrap_command(PBYTE apduCommand, DWORD apduCommandLength, PBYTE
 		
 			// TODO SCP03 with encryption encrypts FIRST, calculates MAC AFTERWARDS
 			if (secInfo->securityLevel == GP211_SCP03_SECURITY_LEVEL_C_MAC){
-				// wrappedLength-8: We don't want to CMAC the MAC
-				calculate_CMAC_aes(secInfo->C_MACSessionKey, wrappedApduCommand, 
-									wrappedLength-8, secInfo->lastC_MAC, mac);
+				status = calculate_CMAC_aes_with_state(secInfo->C_MACSessionKey,
+									macData, macDataLength, secInfo->lastC_MAC, mac);
+				if (OPGP_ERROR_CHECK(status)) {
+					goto end;
+				}
 			} 			
 		}
 		if(secInfo->secureChannelProtocol != GP211_SCP03){
@@ -1662,6 +2254,10 @@ OPGP_ERROR_STATUS read_public_rsa_key(OPGP_STRING PEMKeyFileName, char *passPhra
 	OPGP_ERROR_STATUS status;
 	EVP_PKEY *key;
 	FILE *PEMKeyFile;
+#ifdef OPGP_OPENSSL_FETCH
+	BIGNUM *e = NULL;
+	BIGNUM *n = NULL;
+#endif
 	OPGP_LOG_START(_T("read_public_rsa_key"));
 	if (passPhrase == NULL)
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_PASSWORD, OPGP_stringify_error(OPGP_ERROR_INVALID_PASSWORD)); goto end; }
@@ -1679,8 +2275,22 @@ OPGP_ERROR_STATUS read_public_rsa_key(OPGP_STRING PEMKeyFileName, char *passPhra
 	};
 	fclose(PEMKeyFile);
 	// only 3 and 65337 are supported
+#ifdef OPGP_OPENSSL_FETCH
+	if (EVP_PKEY_get_bn_param(key, OSSL_PKEY_PARAM_RSA_E, &e) != 1
+			|| EVP_PKEY_get_bn_param(key, OSSL_PKEY_PARAM_RSA_N, &n) != 1
+			|| BN_bn2binpad(n, rsaModulus, 128) != 128) {
+		BN_free(e);
+		BN_free(n);
+		EVP_PKEY_free(key);
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
+	}
+	*rsaExponent = (LONG)BN_get_word(e);
+	BN_free(e);
+	BN_free(n);
+#else
 	*rsaExponent = (LONG)key->pkey.rsa->e->d[0];
 	memcpy(rsaModulus, key->pkey.rsa->n->d, sizeof(unsigned long)*key->pkey.rsa->n->top);
+#endif
 	EVP_PKEY_free(key);
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
@@ -1697,32 +2307,165 @@ end:
 OPGP_ERROR_STATUS calculate_sha1_hash(PBYTE message, DWORD messageLength, BYTE hash[20]) {
 	int result;
 	OPGP_ERROR_STATUS status;
-	EVP_MD_CTX mdctx;
+	EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
 	OPGP_LOG_START(_T("calculate_sha1_hash"));
-	EVP_MD_CTX_init(&mdctx);
-	result = EVP_DigestInit_ex(&mdctx, EVP_sha1(), NULL);
+	if (mdctx == NULL) {
+		{ OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM)); goto end; }
+	}
+	result = EVP_DigestInit_ex(mdctx, get_digest(DIGEST_SHA1), NULL);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 
-	result = EVP_DigestUpdate(&mdctx, message, messageLength);
+	result = EVP_DigestUpdate(mdctx, message, messageLength);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 
-	result = EVP_DigestFinal_ex(&mdctx, hash, NULL);
+	result = EVP_DigestFinal_ex(mdctx, hash, NULL);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	if (EVP_MD_CTX_cleanup(&mdctx) != 1) {
-		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); }
+	if (mdctx != NULL) {
+		EVP_MD_CTX_destroy(mdctx);
 	}
 	OPGP_LOG_END(_T("calculate_sha1_hash"), status);
 	return status;
 }
 
+/**
+ * Returns the message digest of a hash algorithm.
+ * \param hashAlgorithm [in] The hash algorithm. See #GP211_HASH_ALGORITHM_SHA1 and #GP211_HASH_ALGORITHM_SHA256.
+ * \return The message digest or NULL if the hash algorithm is not supported.
+ */
+static const EVP_MD *get_hash_md(BYTE hashAlgorithm) {
+	switch (hashAlgorithm) {
+		case GP211_HASH_ALGORITHM_SHA1:
+			return get_digest(DIGEST_SHA1);
+		case GP211_HASH_ALGORITHM_SHA256:
+			return get_digest(DIGEST_SHA256);
+		default:
+			return NULL;
+	}
+}
+
+/**
+ * Starts an incremental hash calculation. The context must be released with free_hash().
+ * \param hashAlgorithm [in] The hash algorithm. See #GP211_HASH_ALGORITHM_SHA1 and #GP211_HASH_ALGORITHM_SHA256.
+ * \param *hashContext [out] The hash context.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS init_hash(BYTE hashAlgorithm, PVOID *hashContext) {
+	OPGP_ERROR_STATUS status;
+	const EVP_MD *md = get_hash_md(hashAlgorithm);
+	EVP_MD_CTX *mdctx = NULL;
+	OPGP_LOG_START(_T("init_hash"));
+	*hashContext = NULL;
+	if (md == NULL) {
+		{ OPGP_ERROR_CREATE_ERROR(status, EINVAL, OPGP_stringify_error(EINVAL)); goto end; }
+	}
+	mdctx = EVP_MD_CTX_create();
+	if (mdctx == NULL) {
+		{ OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM)); goto end; }
+	}
+	if (EVP_DigestInit_ex(mdctx, md, NULL) != 1) {
+		EVP_MD_CTX_destroy(mdctx);
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
+	}
+	*hashContext = mdctx;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("init_hash"), status);
+	return status;
+}
+
+/**
+ * Adds data to an incremental hash calculation.
+ * \param hashContext [in] The hash context returned by init_hash().
+ * \param message [in] The data.
+ * \param messageLength [in] The length of the data.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS update_hash(PVOID hashContext, PBYTE message, DWORD messageLength) {
+	OPGP_ERROR_STATUS status;
+	OPGP_LOG_START(_T("update_hash"));
+	if (EVP_DigestUpdate((EVP_MD_CTX *)hashContext, message, messageLength) != 1) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("update_hash"), status);
+	return status;
+}
+
+/**
+ * Finishes an incremental hash calculation. The context must still be released with free_hash().
+ * \param hashContext [in] The hash context returned by init_hash().
+ * \param hash [out] The hash value.
+ * \param hashLength [in, out] The size of the hash buffer and the length of the hash value.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS final_hash(PVOID hashContext, PBYTE hash, PDWORD hashLength) {
+	OPGP_ERROR_STATUS status;
+	unsigned int length;
+	OPGP_LOG_START(_T("final_hash"));
+	if (*hashLength < (DWORD)EVP_MD_CTX_size((EVP_MD_CTX *)hashContext)) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_BUFFER, OPGP_stringify_error(OPGP_ERROR_INSUFFICIENT_BUFFER)); goto end; }
+	}
+	if (EVP_DigestFinal_ex((EVP_MD_CTX *)hashContext, hash, &length) != 1) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
+	}
+	*hashLength = length;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("final_hash"), status);
+	return status;
+}
+
+/**
+ * Releases the context of an incremental hash calculation.
+ * \param hashContext [in] The hash context returned by init_hash(). Can be NULL.
+ */
+void free_hash(PVOID hashContext) {
+	if (hashContext != NULL) {
+		EVP_MD_CTX_destroy((EVP_MD_CTX *)hashContext);
+	}
+}
+
+/**
+ * Calculates a hash with the given hash algorithm.
+ * \param hashAlgorithm [in] The hash algorithm. See #GP211_HASH_ALGORITHM_SHA1 and #GP211_HASH_ALGORITHM_SHA256.
+ * \param message [in] The message to generate the hash for.
+ * \param messageLength [in] The length of the message buffer.
+ * \param hash [out] The hash value.
+ * \param hashLength [in, out] The size of the hash buffer and the length of the hash value.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS calculate_hash(BYTE hashAlgorithm, PBYTE message, DWORD messageLength, PBYTE hash, PDWORD hashLength) {
+	OPGP_ERROR_STATUS status;
+	PVOID hashContext = NULL;
+	OPGP_LOG_START(_T("calculate_hash"));
+	status = init_hash(hashAlgorithm, &hashContext);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = update_hash(hashContext, message, messageLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = final_hash(hashContext, hash, hashLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	free_hash(hashContext);
+	OPGP_LOG_END(_T("calculate_hash"), status);
+	return status;
+}
+
 /**
  * \param key [in] A 3DES key used to sign. For DES the right half of the key is used.
  * \param *message [in] The message to authenticate.
@@ -1737,19 +2480,20 @@ OPGP_ERROR_STATUS calculate_MAC_right_des_3des(BYTE key[16], BYTE *message, int
 	int i;
 	int outl;
 	BYTE des_key[8];
-	EVP_CIPHER_CTX ctx;
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
 	OPGP_LOG_START(_T("calculate_MAC_des_final_3des"));
-	EVP_CIPHER_CTX_init(&ctx);
+	if (ctx == NULL) {
+		{ OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM)); goto end; }
+	}
 // DES CBC mode
 	memcpy(des_key, key+8, 8);
-	result = EVP_EncryptInit_ex(&ctx, EVP_des_cbc(), NULL, des_key, icv);
+	result = encrypt_init(ctx, CIPHER_DES_CBC, des_key, icv);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
 
 	for (i=0; i<messageLength/8; i++) {
-		result = EVP_EncryptUpdate(&ctx, mac,
+		result = EVP_EncryptUpdate(ctx, mac,
 			&outl, message+i*8, 8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
@@ -1758,36 +2502,30 @@ OPGP_ERROR_STATUS calculate_MAC_right_des_3des(BYTE key[16], BYTE *message, int
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	result = EVP_EncryptFinal_ex(&ctx, mac, &outl);
+	result = EVP_EncryptFinal_ex(ctx, mac, &outl);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
 
-	result = EVP_CIPHER_CTX_cleanup(&ctx);
-	if (result != 1) {
-		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
-	}
-	EVP_CIPHER_CTX_init(&ctx);
 
 	// 3DES CBC mode
-	result = EVP_EncryptInit_ex(&ctx, EVP_des_ede_cbc(), NULL, key, icv);
+	result = encrypt_init(ctx, CIPHER_DES_EDE_CBC, key, icv);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	EVP_CIPHER_CTX_set_padding(&ctx, 0);
 	if (messageLength%8 != 0) {
-		result = EVP_EncryptUpdate(&ctx, mac,
+		result = EVP_EncryptUpdate(ctx, mac,
 			&outl, message+i*8, messageLength%8);
 		if (result != 1) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 		}
 	}
-	result = EVP_EncryptUpdate(&ctx, mac,
+	result = EVP_EncryptUpdate(ctx, mac,
 		&outl, padding, 8 - (messageLength%8));
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
 	}
-	result = EVP_EncryptFinal_ex(&ctx, mac,
+	result = EVP_EncryptFinal_ex(ctx, mac,
 		&outl);
 	if (result != 1) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
@@ -1795,9 +2533,7 @@ OPGP_ERROR_STATUS calculate_MAC_right_des_3des(BYTE key[16], BYTE *message, int
 
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	if (EVP_CIPHER_CTX_cleanup(&ctx) != 1) {
-		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); }
-	}
+	EVP_CIPHER_CTX_free(ctx);
 	OPGP_LOG_END(_T("calculate_MAC_des_final_3des"), status);
 	return status;
 }
@@ -1822,3 +2558,353 @@ end:
 	return status;
 }
 
+#define RANDOM_POOL_SIZE 256 //!< Size of the per thread random pool. Holds 32 host challenges.
+
+static THREAD_LOCAL BYTE randomPool[RANDOM_POOL_SIZE]; //!< Random bytes not handed out yet.
+static THREAD_LOCAL int randomPoolAvailable = 0; //!< Number of random bytes at the start of randomPool not handed out yet.
+#ifndef WIN32
+static THREAD_LOCAL pid_t randomPoolPid = 0; //!< The process which filled the pool. A forked child must not reuse the parent's pool.
+#endif
+
+/**
+ * Returns random bytes from a per thread pool which is refilled in bulk with RAND_bytes().
+ * No lock is taken for the bytes handed out from the pool. Each byte is handed out only once and is cleared
+ * from the pool afterwards. After a fork the pool of the parent is discarded.
+ * \param random [out] The random bytes.
+ * \param randomLength [in] The number of random bytes. If larger than the pool get_random() is used.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS get_pooled_random(BYTE *random, int randomLength)
+{
+	OPGP_ERROR_STATUS status;
+	OPGP_LOG_START(_T("get_pooled_random"));
+	if (randomLength > RANDOM_POOL_SIZE) {
+		status = get_random(random, randomLength);
+		goto end;
+	}
+#ifndef WIN32
+	if (randomPoolPid != getpid()) {
+		memset(randomPool, 0, RANDOM_POOL_SIZE);
+		randomPoolAvailable = 0;
+		randomPoolPid = getpid();
+	}
+#endif
+	if (randomPoolAvailable < randomLength) {
+		if (RAND_bytes(randomPool, RANDOM_POOL_SIZE) != 1) {
+			memset(randomPool, 0, RANDOM_POOL_SIZE);
+			randomPoolAvailable = 0;
+			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CRYPT, OPGP_stringify_error(OPGP_ERROR_CRYPT)); goto end; }
+		}
+		randomPoolAvailable = RANDOM_POOL_SIZE;
+	}
+	randomPoolAvailable -= randomLength;
+	memcpy(random, randomPool+randomPoolAvailable, randomLength);
+	memset(randomPool+randomPoolAvailable, 0, randomLength);
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("get_pooled_random"), status);
+	return status;
+}
+
+
+/**
+ * Executes a crypto provider request with OpenSSL.
+ * \param request [in, out] The request. The key must be the key value.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+static OPGP_ERROR_STATUS execute_builtin_crypto_request(OPGP_CRYPTO_REQUEST *request) {
+	OPGP_ERROR_STATUS status;
+	int outl = 0;
+	DWORD minResultLength;
+	OPGP_LOG_START(_T("execute_builtin_crypto_request"));
+	switch (request->operation) {
+		case OPGP_CRYPTO_OPERATION_DERIVE_KEY:
+		case OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP01:
+		case OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP02:
+		case OPGP_CRYPTO_OPERATION_ENC_3DES_ECB:
+			minResultLength = (request->dataLength+7)/8*8;
+			break;
+		case OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP03:
+			minResultLength = 16;
+			break;
+		case OPGP_CRYPTO_OPERATION_SIGN_RSA:
+			minResultLength = 128;
+			break;
+		default:
+			{ OPGP_ERROR_CREATE_ERROR(status, EINVAL, OPGP_stringify_error(EINVAL)); goto end; }
+	}
+	if (request->resultLength < minResultLength) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_BUFFER, OPGP_stringify_error(OPGP_ERROR_INSUFFICIENT_BUFFER)); goto end; }
+	}
+	switch (request->operation) {
+		case OPGP_CRYPTO_OPERATION_DERIVE_KEY:
+		case OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP01:
+		case OPGP_CRYPTO_OPERATION_ENC_3DES_ECB:
+			status = calculate_enc_ecb_two_key_triple_des(request->key, request->data, (int)request->dataLength,
+				request->result, &outl);
+			break;
+		case OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP02:
+			status = calculate_enc_cbc(request->key, request->data, (int)request->dataLength, request->result, &outl);
+			break;
+		case OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP03:
+			status = calculate_MAC_aes(request->key, request->data, (int)request->dataLength, request->result);
+			outl = 16;
+			break;
+		default:
+			status = calculate_rsa_signature(request->data, request->dataLength, request->keyName, request->passPhrase,
+				request->result);
+			outl = 128;
+			break;
+	}
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	request->resultLength = (DWORD)outl;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	request->status = status;
+	OPGP_LOG_END(_T("execute_builtin_crypto_request"), status);
+	return status;
+}
+
+/**
+ * Sets the crypto provider used for the operations with the long term keys of the library. The operations with
+ * the session keys are always calculated with OpenSSL.
+ * The provider must be set before any card operation is started and must not be changed while other threads use the library.
+ * The provider structure is copied, the parameters must stay valid while the provider is set.
+ * \param provider [in] The crypto provider or NULL to use OpenSSL directly.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_set_crypto_provider(OPGP_CRYPTO_PROVIDER *provider) {
+	OPGP_ERROR_STATUS status;
+	OPGP_LOG_START(_T("OPGP_set_crypto_provider"));
+	if (provider == NULL) {
+		memset(&cryptoProvider, 0, sizeof(OPGP_CRYPTO_PROVIDER));
+		{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+	}
+	if (provider->execute == NULL || (provider->submit == NULL) != (provider->wait == NULL)) {
+		{ OPGP_ERROR_CREATE_ERROR(status, EINVAL, OPGP_stringify_error(EINVAL)); goto end; }
+	}
+	cryptoProvider = *provider;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("OPGP_set_crypto_provider"), status);
+	return status;
+}
+
+/**
+ * Executes a request synchronously with the crypto provider or with OpenSSL if no provider is set.
+ * \param request [in, out] The request. The status of the request is set.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_crypto_execute(OPGP_CRYPTO_REQUEST *request) {
+	OPGP_ERROR_STATUS status;
+	OPGP_ERROR_STATUS(*provider_execute) (PVOID, OPGP_CRYPTO_REQUEST *);
+	OPGP_LOG_START(_T("OPGP_crypto_execute"));
+	if (!crypto_provider_active()) {
+		status = execute_builtin_crypto_request(request);
+		goto end;
+	}
+	provider_execute = (OPGP_ERROR_STATUS(*)(PVOID, OPGP_CRYPTO_REQUEST *)) cryptoProvider.execute;
+	status = (*provider_execute) (cryptoProvider.parameters, request);
+	request->status = status;
+end:
+	OPGP_LOG_END(_T("OPGP_crypto_execute"), status);
+	return status;
+}
+
+/**
+ * Submits a batch of requests to the crypto provider. If the provider supports asynchronous processing this
+ * function returns immediately and the card can be accessed while the provider processes the requests.
+ * Otherwise the requests are executed before this function returns.
+ * #OPGP_crypto_wait() must be called before the results are used.
+ * \param requests [in, out] The requests. The requests must stay valid until #OPGP_crypto_wait() returns.
+ * \param requestsLength [in] The number of requests.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_crypto_submit(OPGP_CRYPTO_REQUEST *requests, DWORD requestsLength) {
+	OPGP_ERROR_STATUS status;
+	OPGP_ERROR_STATUS(*provider_submit) (PVOID, OPGP_CRYPTO_REQUEST *, DWORD);
+	DWORD i;
+	OPGP_LOG_START(_T("OPGP_crypto_submit"));
+	if (crypto_provider_active() && cryptoProvider.submit != NULL) {
+		provider_submit = (OPGP_ERROR_STATUS(*)(PVOID, OPGP_CRYPTO_REQUEST *, DWORD)) cryptoProvider.submit;
+		status = (*provider_submit) (cryptoProvider.parameters, requests, requestsLength);
+		goto end;
+	}
+	// the errors are reported per request by OPGP_crypto_wait()
+	for (i=0; i<requestsLength; i++) {
+		OPGP_crypto_execute(&requests[i]);
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("OPGP_crypto_submit"), status);
+	return status;
+}
+
+/**
+ * Waits until a batch of requests submitted with #OPGP_crypto_submit() is completed.
+ * \param requests [in, out] The requests.
+ * \param requestsLength [in] The number of requests.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise the status of the first failed request
+ */
+OPGP_ERROR_STATUS OPGP_crypto_wait(OPGP_CRYPTO_REQUEST *requests, DWORD requestsLength) {
+	OPGP_ERROR_STATUS status;
+	OPGP_ERROR_STATUS(*provider_wait) (PVOID, OPGP_CRYPTO_REQUEST *, DWORD);
+	DWORD i;
+	OPGP_LOG_START(_T("OPGP_crypto_wait"));
+	if (crypto_provider_active() && cryptoProvider.wait != NULL) {
+		provider_wait = (OPGP_ERROR_STATUS(*)(PVOID, OPGP_CRYPTO_REQUEST *, DWORD)) cryptoProvider.wait;
+		status = (*provider_wait) (cryptoProvider.parameters, requests, requestsLength);
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
+		}
+	}
+	for (i=0; i<requestsLength; i++) {
+		if (OPGP_ERROR_CHECK(requests[i].status)) {
+			status = requests[i].status;
+			goto end;
+		}
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("OPGP_crypto_wait"), status);
+	return status;
+}
+
+/**
+ * Executes a request of the software crypto provider. The key handle is replaced by its key value.
+ * \param parameters [in] The OPGP_SOFTWARE_CRYPTO_PROVIDER.
+ * \param request [in, out] The request.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+static OPGP_ERROR_STATUS execute_software_crypto_request(PVOID parameters, OPGP_CRYPTO_REQUEST *request) {
+	OPGP_ERROR_STATUS status;
+	OPGP_SOFTWARE_CRYPTO_PROVIDER *softwareProvider = (OPGP_SOFTWARE_CRYPTO_PROVIDER *)parameters;
+	OPGP_CRYPTO_REQUEST keyRequest;
+	DWORD i;
+	OPGP_LOG_START(_T("execute_software_crypto_request"));
+	keyRequest = *request;
+	// RSA signing names its key with keyName
+	if (request->operation != OPGP_CRYPTO_OPERATION_SIGN_RSA) {
+		for (i=0; i<softwareProvider->keysLength; i++) {
+			if (memcmp(softwareProvider->keys[i].keyHandle, request->key, 16) == 0) {
+				memcpy(keyRequest.key, softwareProvider->keys[i].keyValue, 16);
+				break;
+			}
+		}
+		if (i == softwareProvider->keysLength) {
+			OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_UNKNOWN_KEY_HANDLE, OPGP_stringify_error(OPGP_ERROR_UNKNOWN_KEY_HANDLE));
+			goto end;
+		}
+	}
+	// the OpenSSL functions must not pass the request back to this provider
+	cryptoProviderBypass = 1;
+	status = execute_builtin_crypto_request(&keyRequest);
+	cryptoProviderBypass = 0;
+	OPENSSL_cleanse(keyRequest.key, 16);
+	request->resultLength = keyRequest.resultLength;
+end:
+	request->status = status;
+	OPGP_LOG_END(_T("execute_software_crypto_request"), status);
+	return status;
+}
+
+/**
+ * Submits requests to the software crypto provider. Like an HSM the provider does not complete them
+ * before they are waited for, so a caller using the results too early is noticed.
+ * \param parameters [in] The OPGP_SOFTWARE_CRYPTO_PROVIDER.
+ * \param requests [in, out] The requests.
+ * \param requestsLength [in] The number of requests.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+static OPGP_ERROR_STATUS submit_software_crypto_requests(PVOID parameters, OPGP_CRYPTO_REQUEST *requests, DWORD requestsLength) {
+	OPGP_ERROR_STATUS status;
+	OPGP_SOFTWARE_CRYPTO_PROVIDER *softwareProvider = (OPGP_SOFTWARE_CRYPTO_PROVIDER *)parameters;
+	OPGP_LOG_START(_T("submit_software_crypto_requests"));
+	softwareProvider->pendingRequestsLength += requestsLength;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("submit_software_crypto_requests"), status);
+	return status;
+}
+
+/**
+ * Completes requests submitted to the software crypto provider. The errors are reported per request.
+ * \param parameters [in] The OPGP_SOFTWARE_CRYPTO_PROVIDER.
+ * \param requests [in, out] The requests.
+ * \param requestsLength [in] The number of requests.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+static OPGP_ERROR_STATUS wait_software_crypto_requests(PVOID parameters, OPGP_CRYPTO_REQUEST *requests, DWORD requestsLength) {
+	OPGP_ERROR_STATUS status;
+	OPGP_SOFTWARE_CRYPTO_PROVIDER *softwareProvider = (OPGP_SOFTWARE_CRYPTO_PROVIDER *)parameters;
+	DWORD i;
+	OPGP_LOG_START(_T("wait_software_crypto_requests"));
+	for (i=0; i<requestsLength; i++) {
+		execute_software_crypto_request(parameters, &requests[i]);
+	}
+	softwareProvider->pendingRequestsLength -= requestsLength < softwareProvider->pendingRequestsLength
+		? requestsLength : softwareProvider->pendingRequestsLength;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("wait_software_crypto_requests"), status);
+	return status;
+}
+
+/**
+ * Initializes the software crypto provider. The software crypto provider executes the requests with OpenSSL and
+ * resolves the key handles added with #OPGP_software_crypto_provider_add_key(). Submitted requests are only
+ * executed when they are waited for. It can be used to test
+ * applications written for an HSM without the HSM.
+ * \param softwareProvider [out] The software crypto provider.
+ * \param provider [out] The provider functions to pass to #OPGP_set_crypto_provider().
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_software_crypto_provider_init(OPGP_SOFTWARE_CRYPTO_PROVIDER *softwareProvider,
+													 OPGP_CRYPTO_PROVIDER *provider) {
+	OPGP_ERROR_STATUS status;
+	OPGP_LOG_START(_T("OPGP_software_crypto_provider_init"));
+	memset(softwareProvider, 0, sizeof(OPGP_SOFTWARE_CRYPTO_PROVIDER));
+	memset(provider, 0, sizeof(OPGP_CRYPTO_PROVIDER));
+	provider->execute = (PVOID)execute_software_crypto_request;
+	provider->submit = (PVOID)submit_software_crypto_requests;
+	provider->wait = (PVOID)wait_software_crypto_requests;
+	provider->parameters = softwareProvider;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("OPGP_software_crypto_provider_init"), status);
+	return status;
+}
+
+/**
+ * Adds a key handle with its key value to the software crypto provider. A key handle which is already known is
+ * assigned the new key value.
+ * \param softwareProvider [in, out] The software crypto provider.
+ * \param keyHandle [in] The key handle.
+ * \param keyValue [in] The key value.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_software_crypto_provider_add_key(OPGP_SOFTWARE_CRYPTO_PROVIDER *softwareProvider,
+														BYTE keyHandle[16], BYTE keyValue[16]) {
+	OPGP_ERROR_STATUS status;
+	DWORD i;
+	OPGP_LOG_START(_T("OPGP_software_crypto_provider_add_key"));
+	for (i=0; i<softwareProvider->keysLength; i++) {
+		if (memcmp(softwareProvider->keys[i].keyHandle, keyHandle, 16) == 0) {
+			break;
+		}
+	}
+	if (i == OPGP_SOFTWARE_CRYPTO_PROVIDER_MAX_KEYS) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_BUFFER, OPGP_stringify_error(OPGP_ERROR_INSUFFICIENT_BUFFER)); goto end; }
+	}
+	memcpy(softwareProvider->keys[i].keyHandle, keyHandle, 16);
+	memcpy(softwareProvider->keys[i].keyValue, keyValue, 16);
+	if (i == softwareProvider->keysLength) {
+		softwareProvider->keysLength++;
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("OPGP_software_crypto_provider_add_key"), status);
+	return status;
+}
@@ -36,6 +36,7 @@ extern "C"
 #include "globalplatform/unicode.h"
 #include "globalplatform/error.h"
 #include "globalplatform/security.h"
+#include "globalplatform/cryptoprovider.h"
 
 static const BYTE padding[8] = {(char) 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}; //!< Applied padding pattern.
 static const BYTE icv[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}; //!< Initial chaining vector.
@@ -53,6 +54,18 @@ OPGP_ERROR_STATUS calculate_CMAC_aes(BYTE sMacKey[16], BYTE *message,
 								int messageLength, BYTE chainingValue[16], 
 								BYTE mac[16]);
 
+OPGP_NO_API
+OPGP_ERROR_STATUS calculate_CMAC_aes_with_state(BYTE sMacKey[16], BYTE *message,
+								int messageLength, BYTE chainingValue[16],
+								BYTE mac[16]);
+
+OPGP_NO_API
+void release_CMAC_key_states(BYTE key[16]);
+
+OPGP_NO_API
+OPGP_ERROR_STATUS calculate_enc_ecb_DEK(GP211_SECURITY_INFO *secInfo, BYTE *message, int messageLength,
+							  BYTE *encryption, int *encryptionLength);
+
 OPGP_NO_API
 OPGP_ERROR_STATUS get_key_data_field(GP211_SECURITY_INFO *secInfo,
 								 PBYTE keyData,
@@ -67,6 +80,22 @@ OPGP_NO_API
 OPGP_ERROR_STATUS create_session_key_SCP01(BYTE key[16], BYTE cardChallenge[8],
 							   BYTE hostChallenge[8], BYTE sessionKey[16]);
 
+OPGP_NO_API
+void prepare_session_key_request_SCP01(OPGP_CRYPTO_REQUEST *request, BYTE key[16], BYTE cardChallenge[8],
+							   BYTE hostChallenge[8], BYTE derivationData[16], BYTE sessionKey[16]);
+
+OPGP_NO_API
+void prepare_session_key_request_SCP02(OPGP_CRYPTO_REQUEST *request, BYTE key[16], BYTE constant[2],
+							   BYTE sequenceCounter[2], BYTE derivationData[16], BYTE sessionKey[16]);
+
+OPGP_NO_API
+void prepare_session_key_request_SCP03(OPGP_CRYPTO_REQUEST *request, BYTE key[16], BYTE derivationConstant,
+							   BYTE cardChallenge[8], BYTE hostChallenge[8], BYTE derivationData[32], BYTE sessionKey[16]);
+
+OPGP_NO_API
+OPGP_ERROR_STATUS derive_static_keys(BYTE masterKey[16], BYTE keyDiversificationData[3][16],
+									 BYTE S_ENC[16], BYTE S_MAC[16], BYTE DEK[16]);
+
 OPGP_NO_API
 OPGP_ERROR_STATUS create_session_key_SCP02(BYTE key[16], BYTE constant[2],
 							   BYTE sequenceCounter[2], BYTE sessionKey[16]);
@@ -205,6 +234,26 @@ OPGP_ERROR_STATUS read_public_rsa_key(OPGP_STRING PEMKeyFileName, char *passPhra
 OPGP_NO_API
 OPGP_ERROR_STATUS calculate_sha1_hash(PBYTE message, DWORD messageLength, BYTE hash[20]);
 
+//! \brief Starts an incremental hash calculation.
+OPGP_NO_API
+OPGP_ERROR_STATUS init_hash(BYTE hashAlgorithm, PVOID *hashContext);
+
+//! \brief Adds data to an incremental hash calculation.
+OPGP_NO_API
+OPGP_ERROR_STATUS update_hash(PVOID hashContext, PBYTE message, DWORD messageLength);
+
+//! \brief Finishes an incremental hash calculation.
+OPGP_NO_API
+OPGP_ERROR_STATUS final_hash(PVOID hashContext, PBYTE hash, PDWORD hashLength);
+
+//! \brief Releases the context of an incremental hash calculation.
+OPGP_NO_API
+void free_hash(PVOID hashContext);
+
+//! \brief Calculates a hash with the given hash algorithm.
+OPGP_NO_API
+OPGP_ERROR_STATUS calculate_hash(BYTE hashAlgorithm, PBYTE message, DWORD messageLength, PBYTE hash, PDWORD hashLength);
+
 //! \brief Calculates a MAC using first DES and 3DES for the final round when the padding is applied.
 OPGP_NO_API
 OPGP_ERROR_STATUS calculate_MAC_right_des_3des(BYTE key[16], BYTE *message, int messageLength, BYTE mac[8]);
@@ -212,6 +261,9 @@ OPGP_ERROR_STATUS calculate_MAC_right_des_3des(BYTE key[16], BYTE *message, int
 OPGP_NO_API
 OPGP_ERROR_STATUS get_random(BYTE *random, int randomLength);
 
+OPGP_NO_API
+OPGP_ERROR_STATUS get_pooled_random(BYTE *random, int randomLength);
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,11 +29,304 @@
 #include <string.h>
 #include "globalplatform/debug.h"
 #include "globalplatform/error.h"
+#include "util.h"
 
 #ifdef HAVE_VSYSLOG
 #include <syslog.h>
 #endif
 
+#define MAX_APDU_LENGTH 261 //!< The maximum length of a short APDU. Hex dumps up to this length do not need an allocation.
+
+/**
+ * All bits are set until the settings are read from the environment, so the log macros call OPGP_log_is_enabled().
+ */
+DWORD OPGP_log_mask = (DWORD)0xFFFFFFFFL;
+
+static int logInitialized = 0; //!< If the settings have been read from the environment or set with OPGP_log_set_level().
+
+static OPGP_SPAN_HOOKS spanHooks; //!< The span hooks set with OPGP_set_span_hooks().
+
+static FILE *flightRecorderFile = NULL; //!< The file the flight recorder is dumped to on errors.
+
+/**
+ * An APDU exchange kept by the flight recorder.
+ */
+typedef struct {
+	OPGP_TIMESTAMP commandTime; //!< The time the command was sent.
+	OPGP_TIMESTAMP responseTime; //!< The time the response or the error was received.
+	BYTE command[MAX_APDU_LENGTH]; //!< The command APDU.
+	DWORD commandLength; //!< The length of the command APDU.
+	BYTE response[MAX_APDU_LENGTH]; //!< The response APDU.
+	DWORD responseLength; //!< The length of the response APDU. 0 if no response was received.
+	LONG errorCode; //!< The error code if no response was received.
+} FLIGHT_RECORD;
+
+static THREAD_LOCAL FLIGHT_RECORD flightRecords[OPGP_FLIGHT_RECORDER_SIZE]; //!< The ring buffer of the flight recorder.
+static THREAD_LOCAL DWORD flightRecordsCount = 0; //!< The number of commands recorded by the calling thread.
+static THREAD_LOCAL DWORD flightRecordsDumped = 0; //!< flightRecordsCount at the last automatic dump.
+
+static THREAD_LOCAL FILE *threadLogFile = NULL; //!< The log file of the calling thread set with OPGP_log_set_thread_file().
+
+/**
+ * Log level names for <code>GLOBALPLATFORM_LOG_LEVEL</code>.
+ */
+static const TCHAR *levelNames[] = {_T("off"), _T("error"), _T("info"), _T("debug"), _T("trace")};
+
+/**
+ * Log category names for <code>GLOBALPLATFORM_LOG_CATEGORIES</code>.
+ */
+static const TCHAR *categoryNames[] = {_T("api"), _T("transport"), _T("crypto"), _T("load")};
+
+/**
+ * \param mask [in] The current mask.
+ * \param level [in] The log level. See #OPGP_LOG_LEVEL_OFF and related.
+ * \param categories [in] The categories. See #OPGP_LOG_CATEGORY_API and related.
+ * \return The mask with the level set for the categories.
+ */
+static DWORD set_level(DWORD mask, DWORD level, DWORD categories) {
+	DWORD i;
+	categories &= OPGP_LOG_CATEGORY_ALL;
+	for (i=OPGP_LOG_LEVEL_ERROR; i<=OPGP_LOG_LEVEL_TRACE; i++) {
+		if (i <= level) {
+			mask |= OPGP_LOG_BIT(i, categories);
+		}
+		else {
+			mask &= ~OPGP_LOG_BIT(i, categories);
+		}
+	}
+	return mask;
+}
+
+/**
+ * Reads the settings from the environment.
+ * <code>GLOBALPLATFORM_LOG_LEVEL</code> can be off, error, info, debug or trace,
+ * <code>GLOBALPLATFORM_LOG_CATEGORIES</code> a comma separated list of api, transport, crypto and load.
+ * If only <code>GLOBALPLATFORM_DEBUG</code> is set everything is logged.
+ */
+static void init_log() {
+	TCHAR *levelName = _tgetenv(_T("GLOBALPLATFORM_LOG_LEVEL"));
+	TCHAR *categoryList = _tgetenv(_T("GLOBALPLATFORM_LOG_CATEGORIES"));
+	DWORD level = OPGP_LOG_LEVEL_OFF;
+	DWORD categories = OPGP_LOG_CATEGORY_ALL;
+	DWORD i;
+	if (levelName != NULL) {
+		for (i=0; i<sizeof(levelNames)/sizeof(levelNames[0]); i++) {
+			if (_tcscmp(levelName, levelNames[i]) == 0) {
+				level = i;
+			}
+		}
+	}
+	else if (_tgetenv(_T("GLOBALPLATFORM_DEBUG"))) {
+		level = OPGP_LOG_LEVEL_TRACE;
+	}
+	if (categoryList != NULL) {
+		categories = 0;
+		for (i=0; i<sizeof(categoryNames)/sizeof(categoryNames[0]); i++) {
+			if (_tcsstr(categoryList, categoryNames[i]) != NULL) {
+				categories |= 1 << i;
+			}
+		}
+	}
+	OPGP_log_mask = set_level((spanHooks.start != NULL || spanHooks.end != NULL ? OPGP_LOG_SPAN_HOOKS : 0)
+		| (flightRecorderFile != NULL ? OPGP_LOG_FLIGHT_RECORDER_DUMP : 0), level, categories);
+	logInitialized = 1;
+}
+
+/**
+ * The environment is only read if OPGP_log_is_enabled() has not been called before.
+ * \param level [in] The log level. See #OPGP_LOG_LEVEL_OFF and related.
+ * \param categories [in] The categories. See #OPGP_LOG_CATEGORY_API and related.
+ */
+void OPGP_log_set_level(DWORD level, DWORD categories) {
+	if (!logInitialized) {
+		init_log();
+	}
+	OPGP_log_mask = set_level(OPGP_log_mask, level, categories);
+}
+
+/**
+ * Parallel sessions in different threads can so log to separate files without sharing one stream.
+ * The file is not flushed after each message and must stay open until it is replaced or reset.
+ * \param file [in] The log file of the calling thread. NULL restores the default log destination.
+ */
+void OPGP_log_set_thread_file(FILE *file) {
+	threadLogFile = file;
+}
+
+/**
+ * \return The monotonic time in nanoseconds.
+ */
+static OPGP_TIMESTAMP get_timestamp() {
+#ifdef WIN32
+	LARGE_INTEGER counter;
+	LARGE_INTEGER frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (OPGP_TIMESTAMP)(counter.QuadPart / frequency.QuadPart) * 1000000000
+		+ (OPGP_TIMESTAMP)(counter.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (OPGP_TIMESTAMP)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+/**
+ * The hooks should be set before the library is used by several threads.
+ * \param *hooks [in] The hooks. The structure is copied. NULL removes the hooks.
+ */
+void OPGP_set_span_hooks(OPGP_SPAN_HOOKS *hooks) {
+	if (!logInitialized) {
+		init_log();
+	}
+	if (hooks != NULL && (hooks->start != NULL || hooks->end != NULL)) {
+		spanHooks = *hooks;
+		OPGP_log_mask |= OPGP_LOG_SPAN_HOOKS;
+	}
+	else {
+		OPGP_log_mask &= ~OPGP_LOG_SPAN_HOOKS;
+		memset(&spanHooks, 0, sizeof(spanHooks));
+	}
+}
+
+/**
+ * The command is copied without any formatting. The oldest exchange is overwritten.
+ * \param capdu [in] The command APDU as sent to the card.
+ * \param capduLength [in] The length of the command APDU.
+ */
+void OPGP_flight_recorder_command(PBYTE capdu, DWORD capduLength) {
+	FLIGHT_RECORD *record = flightRecords + flightRecordsCount % OPGP_FLIGHT_RECORDER_SIZE;
+	record->commandTime = get_timestamp();
+	record->commandLength = capduLength > MAX_APDU_LENGTH ? MAX_APDU_LENGTH : capduLength;
+	memcpy(record->command, capdu, record->commandLength);
+	record->responseLength = 0;
+	record->responseTime = 0;
+	record->errorCode = 0;
+	flightRecordsCount++;
+}
+
+/**
+ * \param rapdu [in] The response APDU.
+ * \param rapduLength [in] The length of the response APDU.
+ * \param status [in] The status of the transmission. If it is an error the response is not recorded.
+ */
+void OPGP_flight_recorder_response(PBYTE rapdu, DWORD rapduLength, OPGP_ERROR_STATUS status) {
+	FLIGHT_RECORD *record;
+	if (flightRecordsCount == 0) {
+		return;
+	}
+	record = flightRecords + (flightRecordsCount - 1) % OPGP_FLIGHT_RECORDER_SIZE;
+	record->responseTime = get_timestamp();
+	if (OPGP_ERROR_CHECK(status)) {
+		record->errorCode = status.errorCode;
+		return;
+	}
+	record->responseLength = rapduLength > MAX_APDU_LENGTH ? MAX_APDU_LENGTH : rapduLength;
+	memcpy(record->response, rapdu, record->responseLength);
+}
+
+/**
+ * The exchanges are written from the oldest to the newest. The times are relative to the oldest command.
+ * \param out [in] The file to write to.
+ */
+void OPGP_dump_flight_recorder(FILE *out) {
+	TCHAR hex[2*MAX_APDU_LENGTH+1];
+	DWORD count = flightRecordsCount < OPGP_FLIGHT_RECORDER_SIZE ? flightRecordsCount : OPGP_FLIGHT_RECORDER_SIZE;
+	DWORD i;
+	FLIGHT_RECORD *record;
+	OPGP_TIMESTAMP start;
+	if (count == 0) {
+		return;
+	}
+	start = flightRecords[(flightRecordsCount - count) % OPGP_FLIGHT_RECORDER_SIZE].commandTime;
+	_ftprintf(out, _T("Flight recorder: last %lu of %lu APDUs\n"), (unsigned long)count, (unsigned long)flightRecordsCount);
+	for (i=flightRecordsCount - count; i<flightRecordsCount; i++) {
+		record = flightRecords + i % OPGP_FLIGHT_RECORDER_SIZE;
+		hex[to_hex(record->command, record->commandLength, hex)] = _T('\0');
+		_ftprintf(out, _T("+%llu ns Command --> %s\n"), record->commandTime - start, hex);
+		if (record->responseTime == 0) {
+			_ftprintf(out, _T("No response\n"));
+		}
+		else if (record->responseLength == 0) {
+			_ftprintf(out, _T("+%llu ns Error 0x%08lX\n"), record->responseTime - start, (unsigned long)record->errorCode);
+		}
+		else {
+			hex[to_hex(record->response, record->responseLength, hex)] = _T('\0');
+			_ftprintf(out, _T("+%llu ns Response <-- %s\n"), record->responseTime - start, hex);
+		}
+	}
+	fflush(out);
+}
+
+/**
+ * The flight recorder of the thread is dumped when a library function returns an error and
+ * APDUs have been exchanged since the last automatic dump. So a failing call chain only produces one dump.
+ * The library must be compiled with OPGP_DEBUG, which is the default.
+ * \param out [in] The file to write to. NULL disables the automatic dump.
+ */
+void OPGP_set_flight_recorder_file(FILE *out) {
+	if (!logInitialized) {
+		init_log();
+	}
+	flightRecorderFile = out;
+	if (out != NULL) {
+		OPGP_log_mask |= OPGP_LOG_FLIGHT_RECORDER_DUMP;
+	}
+	else {
+		OPGP_log_mask &= ~OPGP_LOG_FLIGHT_RECORDER_DUMP;
+	}
+}
+
+/**
+ * \param func [in] The function name.
+ * \param file [in] The source file.
+ * \param line [in] The line number in the source file.
+ * \param category [in] The log category of the source file.
+ */
+void OPGP_log_start_function(OPGP_CSTRING func, OPGP_CSTRING file, int line, DWORD category) {
+	void (*start)(PVOID, OPGP_CSTRING, OPGP_TIMESTAMP) = (void (*)(PVOID, OPGP_CSTRING, OPGP_TIMESTAMP))spanHooks.start;
+	if (start != NULL) {
+		(*start)(spanHooks.parameters, func, get_timestamp());
+	}
+	if (OPGP_log_is_enabled(OPGP_LOG_LEVEL_DEBUG, category)) {
+		OPGP_log_Start((OPGP_STRING)func, (OPGP_STRING)file, line);
+	}
+}
+
+/**
+ * \param func [in] The function name.
+ * \param file [in] The source file.
+ * \param line [in] The line number in the source file.
+ * \param category [in] The log category of the source file.
+ * \param status [in] The return value of the function.
+ */
+void OPGP_log_end_function(OPGP_CSTRING func, OPGP_CSTRING file, int line, DWORD category, OPGP_ERROR_STATUS status) {
+	void (*end)(PVOID, OPGP_CSTRING, OPGP_TIMESTAMP, LONG, LONG) = (void (*)(PVOID, OPGP_CSTRING, OPGP_TIMESTAMP, LONG, LONG))spanHooks.end;
+	if (end != NULL) {
+		(*end)(spanHooks.parameters, func, get_timestamp(), status.errorStatus, status.errorCode);
+	}
+	if (OPGP_ERROR_CHECK(status) && flightRecorderFile != NULL && flightRecordsDumped != flightRecordsCount) {
+		flightRecordsDumped = flightRecordsCount;
+		OPGP_dump_flight_recorder(flightRecorderFile);
+	}
+	if (OPGP_log_is_enabled(OPGP_LOG_LEVEL_DEBUG, category)
+			|| (OPGP_ERROR_CHECK(status) && OPGP_log_is_enabled(OPGP_LOG_LEVEL_ERROR, category))) {
+		OPGP_log_End((OPGP_STRING)func, (OPGP_STRING)file, line, status);
+	}
+}
+
+/**
+ * \param level [in] The log level. See #OPGP_LOG_LEVEL_OFF and related.
+ * \param category [in] The category. See #OPGP_LOG_CATEGORY_API and related.
+ * \return 1 if the level is enabled for the category, 0 otherwise.
+ */
+int OPGP_log_is_enabled(DWORD level, DWORD category) {
+	if (!logInitialized) {
+		init_log();
+	}
+	return (OPGP_log_mask & OPGP_LOG_BIT(level, category)) != 0;
+}
+
 /**
 * The call is redirected to log_Log().
 * \param func [in] The function name.
@@ -51,18 +344,18 @@ void OPGP_log_Start(OPGP_STRING func, OPGP_STRING file, int line)
  * \param bufferLength [in] The length of the buffer.
  */
 void OPGP_log_Hex(OPGP_STRING msg, PBYTE buffer, DWORD bufferLength) {
-	TCHAR *bufferMsg;
-	int i;
+	TCHAR stackMsg[2*MAX_APDU_LENGTH+1];
+	TCHAR *bufferMsg = stackMsg;
 	// each hex string needs the double size + termination
-	bufferMsg = (TCHAR *)malloc(bufferLength * sizeof(TCHAR)*2 + 1);
-	// allocation did not succeed
-	if (bufferMsg == NULL) {
-		OPGP_log_Msg(_T("%sLOG ERROR: Could not allocate log buffer."), msg);
-		return;
-	}
-	for (i=0; (DWORD)i<bufferLength; i++) {
-		_sntprintf(bufferMsg+(i*2), (bufferLength-i)*sizeof(TCHAR)*2+1, _T("%02X"), (buffer[i] & 0x00FF));
+	if (bufferLength > MAX_APDU_LENGTH) {
+		bufferMsg = (TCHAR *)malloc((bufferLength*2 + 1) * sizeof(TCHAR));
+		// allocation did not succeed
+		if (bufferMsg == NULL) {
+			OPGP_log_Msg(_T("%sLOG ERROR: Could not allocate log buffer."), msg);
+			return;
+		}
 	}
+	bufferMsg[to_hex(buffer, bufferLength, bufferMsg)] = _T('\0');
 	// print msg or not
 	if ((msg == NULL) || (_tcslen(msg) == 0)) {
 		OPGP_log_Msg(_T("%s"), bufferMsg);
@@ -70,6 +363,9 @@ void OPGP_log_Hex(OPGP_STRING msg, PBYTE buffer, DWORD bufferLength) {
 	else {
 		OPGP_log_Msg(_T("%s%s"), msg, bufferMsg);
 	}
+	if (bufferMsg != stackMsg) {
+		free(bufferMsg);
+	}
 }
 
 /**
@@ -86,11 +382,12 @@ void OPGP_log_End(OPGP_STRING func, OPGP_STRING file, int line, OPGP_ERROR_STATU
 
 /**
 * In Unix systems which have a syslog facility the msg is stored there.
-* The environment varibale <code>GLOBALPLATFORM_DEBUG</code> must be set to enable the logging.
+* Some log level must be enabled, see OPGP_log_is_enabled(). The log macros also check the level and category of the message.
 * With the environment variable <code>GLOBALPLATFORM_LOGFILE</code> an explicit log file name can
 * be set. If a no log file name has been set impilictly <code>/tmp/GlobalPlatform.log</code>
 * or <code>C:\\TEMP\\GlobalPlatform.log</code> under Windows will be used. If a log file name
 * is given the syslog if available will not be used.
+* A log file set for the calling thread with OPGP_log_set_thread_file() takes precedence.
 * \param msg The formatted message which will be stored.
 * \param ... Variable argument list
 */
@@ -102,8 +399,14 @@ void OPGP_log_Msg(OPGP_STRING msg, ...)
     struct tm *time_s;
     TCHAR format[256];
 
-    if (_tgetenv(_T("GLOBALPLATFORM_DEBUG")))
+    if (!logInitialized)
+        init_log();
+    if ((OPGP_log_mask & ~(OPGP_LOG_SPAN_HOOKS | OPGP_LOG_FLIGHT_RECORDER_DUMP)) != 0)
     {
+    if (threadLogFile != NULL) {
+	fp = threadLogFile;
+	goto write;
+    }
     #ifdef HAVE_VSYSLOG
     if (getenv("GLOBALPLATFORM_LOGFILE")) {
 	goto filelog;
@@ -126,6 +429,7 @@ filelog:
 	fp = stderr;
 	_ftprintf(fp, _T("Error, could not open log file: %s\n"), OPGP_LOG_FILENAME);
     }
+write:
     time(&t);
     time_s = localtime(&t);
 
@@ -147,6 +451,10 @@ filelog:
     _fputts(_T("\n"), fp);
     #endif // WIN32
 
+    // the log file of a thread is buffered and flushed by its owner
+    if (fp == threadLogFile)
+        return;
+
     fflush(fp); /* Fixme: more accurate, but slows logging */
 
     if (fp != stderr)
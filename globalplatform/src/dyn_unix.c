@@ -23,6 +23,8 @@
  * @brief This abstracts dynamic library loading functions and timing.
  */
 
+#define OPGP_LOG_CATEGORY OPGP_LOG_CATEGORY_TRANSPORT //!< Category of the log messages of this file.
+
 #include <stdio.h>
 #include <string.h>
 #ifdef HAVE_DLFCN_H
@@ -59,7 +61,7 @@ OPGP_ERROR_STATUS DYN_LoadLibrary(PVOID *libraryHandle, LPCTSTR libraryName, LPC
 	TCHAR internalLibraryName[MAX_LIBRARY_NAME_SIZE];
 	OPGP_LOG_START(_T("DYN_LoadLibrary"));
 
-	OPGP_log_Msg(_T("DYN_LoadLibrary: Using library name \"%s\" and version \"%s\"."), libraryName, version);
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_TRANSPORT, _T("DYN_LoadLibrary: Using library name \"%s\" and version \"%s\"."), libraryName, version);
 
 	_tcsncpy(internalLibraryName, LIBRARY_NAME_PREFIX, MAX_LIBRARY_NAME_SIZE);
 	offset += _tcslen(LIBRARY_NAME_PREFIX);
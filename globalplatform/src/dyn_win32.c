@@ -24,6 +24,8 @@
  * @brief This abstracts dynamic library loading functions.
  */
 
+#define OPGP_LOG_CATEGORY OPGP_LOG_CATEGORY_TRANSPORT //!< Category of the log messages of this file.
+
 #ifdef WIN32
 #include <string.h>
 
@@ -54,6 +54,7 @@
 #include "util.h"
 #include "crypto.h"
 #include "loadfile.h"
+#include <openssl/crypto.h>
 
 // 255 bytes minus 8 byte MAC minus 8 byte encryption padding
 #define MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING 239
@@ -191,6 +192,19 @@ OPGP_ERROR_STATUS load_from_buffer(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO
 				 PBYTE loadFileBuf, DWORD loadFileBufSize,
 				 GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable, OPGP_PROGRESS_CALLBACK *callback);
 
+OPGP_NO_API
+OPGP_ERROR_STATUS run_operation(OPGP_CARD_CONTEXT cardContext, OPGP_OPERATION *operation);
+
+OPGP_NO_API
+OPGP_ERROR_STATUS build_load_command(OPGP_OPERATION *operation);
+
+OPGP_NO_API
+OPGP_ERROR_STATUS build_delete_command(OPGP_OPERATION *operation);
+
+OPGP_NO_API
+OPGP_ERROR_STATUS begin_delete_application(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				   OPGP_AID *AIDs, DWORD AIDsLength, GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataLength, DWORD mode);
+
 OPGP_NO_API
 OPGP_ERROR_STATUS VISA2_derive_keys_get_data(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo, PBYTE AID, DWORD AIDLength, BYTE masterKey[16],
 							BYTE S_ENC[16], BYTE S_MAC[16], BYTE DEK[16]);
@@ -212,11 +226,45 @@ OPGP_ERROR_STATUS EMV_CPS11_derive_keys_get_data(OPGP_CARD_CONTEXT cardContext,
 	goto end; \
 }
 
+#define OPERATION_MUTUAL_AUTHENTICATION 1 //!< Mutual authentication operation.
+#define OPERATION_GET_STATUS 2 //!< GET STATUS operation.
+#define OPERATION_LOAD 3 //!< LOAD operation.
+#define OPERATION_DELETE 4 //!< DELETE operation.
+#define OPERATION_INSTALL 5 //!< INSTALL operation.
+
 /**
  * ATR for a broken JCOP21 to handle it correctly.
  */
 static const BYTE JCOP21V22_ATR[14] = {0x3B, 0x79, 0x18, 0x00, 0x00, 0x4A, 0x43, 0x4F, 0x50, 0x32, 0x31, 0x56, 0x32, 0x32};
 
+/**
+ * Known quirks of card products by ATR.
+ */
+static const struct {
+	const BYTE *ATR;
+	DWORD ATRLength;
+	DWORD quirks;
+} BUILTIN_CARD_QUIRKS[] = {
+	{JCOP21V22_ATR, sizeof(JCOP21V22_ATR), OPGP_CARD_QUIRK_INSTALL_NO_LE}
+};
+
+/**
+ * Returns the built-in quirks of a card.
+ * \param ATR [in] The ATR of the card.
+ * \param ATRLength [in] The length of the ATR.
+ * \return The quirks, see #OPGP_CARD_QUIRK_INSTALL_NO_LE.
+ */
+OPGP_NO_API
+DWORD get_card_quirks(PBYTE ATR, DWORD ATRLength) {
+	DWORD i;
+	for (i=0; i<sizeof(BUILTIN_CARD_QUIRKS)/sizeof(BUILTIN_CARD_QUIRKS[0]); i++) {
+		if (BUILTIN_CARD_QUIRKS[i].ATRLength == ATRLength && memcmp(BUILTIN_CARD_QUIRKS[i].ATR, ATR, ATRLength) == 0) {
+			return BUILTIN_CARD_QUIRKS[i].quirks;
+		}
+	}
+	return 0;
+}
+
 OPGP_NO_API
 void mapOP201ToGP211SecurityInfo(OP201_SECURITY_INFO op201secInfo,
 										GP211_SECURITY_INFO *gp211secInfo) {
@@ -389,6 +437,59 @@ DWORD fillReceipt(PBYTE buf, GP211_RECEIPT_DATA *receiptData) {
 	return j;
 }
 
+/**
+ * Initializes a resumable operation.
+ * \param *operation [out] The operation to initialize.
+ * \param type [in] The kind of operation.
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure used for wrapping the commands. Can be NULL.
+ */
+OPGP_NO_API
+void init_operation(OPGP_OPERATION *operation, DWORD type, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo) {
+	memset(operation, 0, sizeof(OPGP_OPERATION));
+	operation->type = type;
+	operation->cardInfo = cardInfo;
+	operation->secInfo = secInfo;
+}
+
+/**
+ * Marks a resumable operation as finished. A progress callback of a load operation is notified about the end of the task.
+ * \param *operation [in, out] The operation to finish.
+ */
+OPGP_NO_API
+void finish_operation(OPGP_OPERATION *operation) {
+	OPGP_PROGRESS_CALLBACK_PARAMETERS callbackParameters;
+	OPGP_PROGRESS_CALLBACK *callback = operation->data.load.callback;
+	operation->finished = OPGP_OPERATION_FINISHED;
+	if (operation->type == OPERATION_LOAD && callback != NULL && !operation->data.load.callbackFinished) {
+		INIT_PROGRESS_CALLBACK_PARAMETERS(callbackParameters, callback);
+		callbackParameters.currentWork = operation->data.load.total;
+		callbackParameters.totalWork = operation->data.load.loadFileBufSize;
+		callbackParameters.finished = OPGP_TASK_FINISHED;
+		operation->data.load.callbackFinished = 1;
+		((void(*)(OPGP_PROGRESS_CALLBACK_PARAMETERS))(callback->callback))(callbackParameters);
+	}
+	if (operation->type == OPERATION_LOAD && operation->data.load.hashContext != NULL) {
+		free_hash(operation->data.load.hashContext);
+		operation->data.load.hashContext = NULL;
+	}
+	// the crypto provider must not write to the buffers of the requests after the operation is finished
+	if (operation->type == OPERATION_MUTUAL_AUTHENTICATION && operation->data.mutualAuthentication.pendingRequestsLength > 0) {
+		OPGP_crypto_wait(operation->data.mutualAuthentication.pendingRequests,
+			operation->data.mutualAuthentication.pendingRequestsLength);
+		operation->data.mutualAuthentication.pendingRequestsLength = 0;
+	}
+	// the static keys and the copies in the requests must not stay in the operation
+	if (operation->type == OPERATION_MUTUAL_AUTHENTICATION) {
+		OPENSSL_cleanse(operation->data.mutualAuthentication.baseKey, sizeof(operation->data.mutualAuthentication.baseKey));
+		OPENSSL_cleanse(operation->data.mutualAuthentication.sEnc, sizeof(operation->data.mutualAuthentication.sEnc));
+		OPENSSL_cleanse(operation->data.mutualAuthentication.sMac, sizeof(operation->data.mutualAuthentication.sMac));
+		OPENSSL_cleanse(operation->data.mutualAuthentication.dek, sizeof(operation->data.mutualAuthentication.dek));
+		OPENSSL_cleanse(operation->data.mutualAuthentication.pendingRequests, sizeof(operation->data.mutualAuthentication.pendingRequests));
+		OPENSSL_cleanse(operation->data.mutualAuthentication.pendingDerivationData, sizeof(operation->data.mutualAuthentication.pendingDerivationData));
+	}
+}
+
 /**
  * The secInfo pointer can also be null and so this function can be used for arbitrary cards.
  * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
@@ -984,12 +1085,13 @@ end:
  * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
  * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
  * \param AIDs [in] A pointer to the an array of OPGP_AID structures describing the applications and load files to delete.
+ * As many AIDs as fit are sent in one DELETE command, the remaining AIDs are sent in further commands.
  * \param AIDsLength [in] The number of OPGP_AID structures.
  * \param *receiptData [out] A GP211_RECEIPT_DATA array. If the deletion is performed by a
  * security domain with delegated management privilege
  * this structure contains the according data for each deleted application or package.
  * \param receiptDataLength [in, out] A pointer to the length of the receiptData array.
- * If no receiptData is available this length is 0;
+ * If no receiptData is available this length is 0; Receipts not fitting into the array are discarded.
  * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
  */
 OPGP_ERROR_STATUS GP211_delete_application(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
@@ -1003,27 +1105,101 @@ OPGP_ERROR_STATUS GP211_delete_application(OPGP_CARD_CONTEXT cardContext, OPGP_C
 OPGP_ERROR_STATUS delete_application(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
 				   OPGP_AID *AIDs, DWORD AIDsLength, GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataLength, DWORD mode) {
 	OPGP_ERROR_STATUS status;
-	DWORD count=0;
-	BYTE sendBuffer[261];
-	DWORD sendBufferLength;
-	DWORD recvBufferLength=255;
-	BYTE recvBuffer[255];
-	DWORD j,i=0;
+	OPGP_OPERATION operation;
 	OPGP_LOG_START(_T("delete_application"));
+	status = begin_delete_application(&operation, cardInfo, secInfo, AIDs, AIDsLength, receiptData, receiptDataLength, mode);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = run_operation(cardContext, &operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("delete_application"), status);
+	return status;
+}
+
+/**
+ * See GP211_delete_application().
+ * \param *operation [out] The operation to start.
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param AIDs [in] A pointer to the an array of OPGP_AID structures describing the applications and load files to delete.
+ * As many AIDs as fit are sent in one DELETE command, the remaining AIDs are sent in further commands.
+ * \param AIDsLength [in] The number of OPGP_AID structures.
+ * \param *receiptData [out] A GP211_RECEIPT_DATA array. If the deletion is performed by a
+ * security domain with delegated management privilege
+ * this structure contains the according data for each deleted application or package.
+ * \param receiptDataLength [in, out] A pointer to the length of the receiptData array.
+ * If no receiptData is available this length is 0; Receipts not fitting into the array are discarded.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_begin_delete_application(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						OPGP_AID *AIDs, DWORD AIDsLength, GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataLength) {
+	return begin_delete_application(operation, cardInfo, secInfo, AIDs, AIDsLength, receiptData, receiptDataLength, GP_211);
+}
+
+/**
+* \param mode OpenPlatform 2.0.1' or GlobalPlatform 2.1.1 delete command.
+*/
+OPGP_ERROR_STATUS begin_delete_application(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				   OPGP_AID *AIDs, DWORD AIDsLength, GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataLength, DWORD mode) {
+	OPGP_ERROR_STATUS status;
+	OPGP_LOG_START(_T("begin_delete_application"));
+	init_operation(operation, OPERATION_DELETE, cardInfo, secInfo);
+	operation->data.deletion.receiptData = receiptData;
+	operation->data.deletion.receiptDataLength = receiptDataLength;
+	operation->data.deletion.receiptDataSize = receiptData == NULL ? 0 : *receiptDataLength;
+	operation->data.deletion.AIDs = AIDs;
+	operation->data.deletion.AIDsLength = AIDsLength;
+	operation->data.deletion.mode = mode;
+	*receiptDataLength = 0;
+	status = build_delete_command(operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	if (OPGP_ERROR_CHECK(status)) {
+		finish_operation(operation);
+	}
+	OPGP_LOG_END(_T("begin_delete_application"), status);
+	return status;
+}
+
+/**
+ * Prepares a DELETE command with as many of the remaining AIDs as fit into the data field.
+ * \param *operation [in, out] The delete operation.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_NO_API
+OPGP_ERROR_STATUS build_delete_command(OPGP_OPERATION *operation) {
+	OPGP_ERROR_STATUS status;
+	PBYTE sendBuffer = operation->command;
+	OPGP_AID *AIDs = operation->data.deletion.AIDs;
+	DWORD j=operation->data.deletion.nextAID, i=0;
+	OPGP_LOG_START(_T("build_delete_command"));
 	sendBuffer[i++] = 0x80;
 	sendBuffer[i++] = 0xE4;
 	sendBuffer[i++] = 0x00;
-	if (mode == OP_201)
+	if (operation->data.deletion.mode == OP_201)
 		sendBuffer[i++] = 0x00;
 	else
 		sendBuffer[i++] = 0x80;
 	sendBuffer[i++] = 0x00;
-	for (j=0; j< AIDsLength; j++) {
-		if (i + AIDs[j].AIDLength+2 > 260) {
-			*receiptDataLength = 0;
+	for (; j<operation->data.deletion.AIDsLength; j++) {
+		if (AIDs[j].AIDLength > 16) {
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_COMMAND_TOO_LARGE, OPGP_stringify_error(OPGP_ERROR_COMMAND_TOO_LARGE)); goto end; }
 		}
-		OPGP_LOG_HEX(_T("delete_application: AID to delete: "), AIDs[j].AID, AIDs[j].AIDLength);
+		// the remaining AIDs are deleted with the next command, the data field must leave room for a MAC
+		if (sendBuffer[4] + AIDs[j].AIDLength+2 > MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING) {
+			break;
+		}
+		OPGP_LOG_HEX(_T("build_delete_command: AID to delete: "), AIDs[j].AID, AIDs[j].AIDLength);
 		sendBuffer[4] += AIDs[j].AIDLength+2;
 		sendBuffer[i++] = 0x4F;
 		sendBuffer[i++] = AIDs[j].AIDLength;
@@ -1031,28 +1207,48 @@ OPGP_ERROR_STATUS delete_application(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_IN
 		i+=AIDs[j].AIDLength;
 	}
 	sendBuffer[i++] = 0x00;
-	sendBufferLength = i;
+	operation->data.deletion.nextAID = j;
+	operation->commandLength = i;
 
-	status = OPGP_send_APDU(cardContext, cardInfo, secInfo, sendBuffer, sendBufferLength, recvBuffer, &recvBufferLength);
-	if (OPGP_ERROR_CHECK(status)) {
-		*receiptDataLength = 0;
-		goto end;
-	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("build_delete_command"), status);
+	return status;
+}
+
+/**
+ * Processes the response of the DELETE command. If AIDs are left the next DELETE command is prepared.
+ * \param *operation [in, out] The delete operation.
+ * \param recvBuffer [in] The response APDU.
+ * \param recvBufferLength [in] The length of the response APDU.
+ * \param status [in] The status containing the status word of the response APDU.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_NO_API
+OPGP_ERROR_STATUS process_delete(OPGP_OPERATION *operation, PBYTE recvBuffer, DWORD recvBufferLength, OPGP_ERROR_STATUS status) {
+	DWORD count=0;
+	GP211_RECEIPT_DATA *receiptData = operation->data.deletion.receiptData;
+	PDWORD receiptDataLength = operation->data.deletion.receiptDataLength;
+	OPGP_LOG_START(_T("process_delete"));
 	CHECK_SW_9000(recvBuffer, recvBufferLength, status);
-	if (recvBufferLength-count > sizeof(GP211_RECEIPT_DATA)) { // assumption that a GP211_RECEIPT_DATA structure is returned in a delegated management deletion
-		*receiptDataLength=0;
-		while (recvBufferLength-count > sizeof(GP211_RECEIPT_DATA)) {
-			count+=fillReceipt(recvBuffer, receiptData + *receiptDataLength++);
+	// with delegated management the response data contains the deletion receipts of the deleted objects
+	while (recvBufferLength-count > sizeof(GP211_RECEIPT_DATA) && *receiptDataLength < operation->data.deletion.receiptDataSize) {
+		count+=fillReceipt(recvBuffer+count, receiptData + *receiptDataLength);
+		(*receiptDataLength)++;
+	}
+	if (operation->data.deletion.nextAID < operation->data.deletion.AIDsLength) {
+		status = build_delete_command(operation);
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
 		}
 	}
 	else {
-		*receiptDataLength = 0;
-		goto end;
+		finish_operation(operation);
 	}
 
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	OPGP_LOG_END(_T("delete_application"), status);
+	OPGP_LOG_END(_T("process_delete"), status);
 	return status;
 }
 
@@ -1286,6 +1482,55 @@ end:
 	return status;
 }
 
+/**
+ * All GET DATA commands are sent while holding a card transaction, so no other application can interleave commands
+ * and the reader is not reacquired for each command.
+ * The result of each data object is returned in its status member. A data object not present on the card
+ * (e.g. 6A88) does not stop the batch, only a transmission error or a broken secure channel does.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication(). Can be NULL.
+ * \param *requests [in, out] The requested data objects.
+ * \param requestsLength [in] The number of requested data objects.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_get_data_batch(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+			  GP211_GET_DATA_REQUEST *requests, DWORD requestsLength) {
+	OPGP_ERROR_STATUS status;
+	OPGP_ERROR_STATUS endStatus;
+	DWORD i;
+	OPGP_LOG_START(_T("GP211_get_data_batch"));
+	status = OPGP_begin_transaction(cardContext, cardInfo);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	for (i=0; i<requestsLength; i++) {
+		if (requests[i].iso7816) {
+			requests[i].status = GP211_get_data_iso7816_4(cardContext, cardInfo, requests[i].identifier,
+				requests[i].data, &requests[i].dataLength);
+		}
+		else {
+			requests[i].status = get_data(cardContext, cardInfo, secInfo, requests[i].identifier,
+				requests[i].data, &requests[i].dataLength);
+		}
+		// only status words are acceptable, everything else leaves the card or the secure channel in an unknown state
+		if (OPGP_ERROR_CHECK(requests[i].status)
+				&& (requests[i].status.errorCode & 0xFFFF0000) != OPGP_ISO7816_ERROR_PREFIX
+				&& requests[i].status.errorCode != OPGP_ERROR_INSUFFICIENT_BUFFER) {
+			status = requests[i].status;
+			break;
+		}
+	}
+	endStatus = OPGP_end_transaction(cardContext, cardInfo);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = endStatus;
+end:
+	OPGP_LOG_END(_T("GP211_get_data_batch"), status);
+	return status;
+}
+
 /**
  * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
  * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
@@ -1442,6 +1687,57 @@ end:
 	return status;
 }
 
+/**
+ * If a profile for the card is found in the database no command is sent to the card.
+ * Otherwise the Secure Channel Protocol details are read from the card and the resulting profile is stored in the database.
+ * The derivation method of a discovered profile is #OPGP_DERIVATION_METHOD_NONE, the caller can update and store the profile again
+ * after the key derivation method was determined.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param database [in, out] The card profile database.
+ * \param IIN [in] The Issuer Identification Number of the card if the profile should be specific to it. Can be NULL.
+ * \param IINLength [in] The length of the IIN.
+ * \param *profile [out] The profile of the card.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_discover_card_profile(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo,
+										 OPGP_CARD_PROFILE_DATABASE *database, PBYTE IIN, DWORD IINLength,
+										 OPGP_CARD_PROFILE *profile) {
+	OPGP_ERROR_STATUS status;
+	OPGP_LOG_START(_T("OPGP_discover_card_profile"));
+	if (cardInfo.ATRLength > MAX_ATR_SIZE || (IIN != NULL && IINLength > OPGP_MAX_IIN_SIZE)) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_CARD_PROFILE, OPGP_stringify_error(OPGP_ERROR_INVALID_CARD_PROFILE)); goto end; }
+	}
+	status = OPGP_card_profile_lookup(database, cardInfo.ATR, cardInfo.ATRLength, IIN, IINLength, profile);
+	if (!OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	if (status.errorCode != OPGP_ERROR_CARD_PROFILE_NOT_FOUND) {
+		goto end;
+	}
+	memset(profile, 0, sizeof(OPGP_CARD_PROFILE));
+	memcpy(profile->ATR, cardInfo.ATR, cardInfo.ATRLength);
+	profile->ATRLength = cardInfo.ATRLength;
+	if (IIN != NULL) {
+		memcpy(profile->IIN, IIN, IINLength);
+		profile->IINLength = IINLength;
+	}
+	status = GP211_get_secure_channel_protocol_details(cardContext, cardInfo,
+		&profile->secureChannelProtocol, &profile->secureChannelProtocolImpl);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	profile->derivationMethod = OPGP_DERIVATION_METHOD_NONE;
+	status = OPGP_card_profile_store(database, profile);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("OPGP_discover_card_profile"), status);
+	return status;
+}
+
 /**
  * The card must support the optional report of key information templates.
  * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
@@ -1502,10 +1798,10 @@ OPGP_ERROR_STATUS get_key_information_templates(OPGP_CARD_CONTEXT cardContext, O
 	*keyInformationLength = i;
 #ifdef OPGP_DEBUG
 	for (i=0; i<*keyInformationLength; i++) {
-		OPGP_log_Msg(_T("get_key_information_templates: Key index: 0x%02x\n"), keyInformation[i].keyIndex);
-		OPGP_log_Msg(_T("get_key_information_templates: Key set version: 0x%02x\n"), keyInformation[i].keySetVersion);
-		OPGP_log_Msg(_T("get_key_information_templates: Key type: 0x%02x\n"), keyInformation[i].keyType);
-		OPGP_log_Msg(_T("get_key_information_templates: Key length: 0x%02x\n"), keyInformation[i].keyLength);
+		OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_API, _T("get_key_information_templates: Key index: 0x%02x\n"), keyInformation[i].keyIndex);
+		OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_API, _T("get_key_information_templates: Key set version: 0x%02x\n"), keyInformation[i].keySetVersion);
+		OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_API, _T("get_key_information_templates: Key type: 0x%02x\n"), keyInformation[i].keyType);
+		OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_API, _T("get_key_information_templates: Key length: 0x%02x\n"), keyInformation[i].keyLength);
 	}
 #endif
 
@@ -1574,13 +1870,47 @@ end:
  */
 OPGP_ERROR_STATUS GP211_get_status(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo, BYTE cardElement, GP211_APPLICATION_DATA *applData, GP211_EXECUTABLE_MODULES_DATA *executableData, PDWORD dataLength) {
 	OPGP_ERROR_STATUS status;
-	DWORD sendBufferLength=8;
-	DWORD recvBufferLength=256;
-	BYTE recvBuffer[256];
-	BYTE sendBuffer[8];
-	BYTE numExecutableModules;
-	DWORD j=0, k=0, i=0;
+	OPGP_OPERATION operation;
 	OPGP_LOG_START(_T("get_status"));
+	status = GP211_begin_get_status(&operation, cardInfo, secInfo, cardElement, applData, executableData, dataLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = run_operation(cardContext, &operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("get_status"), status);
+	return status;
+}
+
+/**
+ * See GP211_get_status(). The GET STATUS command is repeated as long as the card has more data available.
+ * \param *operation [out] The operation to start.
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param cardElement [in] Identifier to retrieve data for Load Files, Applications or the Card Manager.
+ * See GP211_STATUS_APPLICATIONS and related.
+ * \param *applData [out] The GP211_APPLICATION_DATA structure.
+ * \param *executableData [out] The GP211_APPLICATION_DATA structure.
+ * \param dataLength [in, out] The number of GP211_APPLICATION_DATA or GP211_EXECUTABLE_MODULES_DATA passed and returned.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_begin_get_status(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						   BYTE cardElement, GP211_APPLICATION_DATA *applData, GP211_EXECUTABLE_MODULES_DATA *executableData,
+						   PDWORD dataLength) {
+	OPGP_ERROR_STATUS status;
+	PBYTE sendBuffer = operation->command;
+	DWORD i=0;
+	OPGP_LOG_START(_T("begin_get_status"));
+	init_operation(operation, OPERATION_GET_STATUS, cardInfo, secInfo);
+	operation->data.getStatus.cardElement = cardElement;
+	operation->data.getStatus.applData = applData;
+	operation->data.getStatus.executableData = executableData;
+	operation->data.getStatus.dataLength = dataLength;
 	sendBuffer[i++] = 0x80;
 	sendBuffer[i++] = 0xF2;
 	sendBuffer[i++] = cardElement;
@@ -1588,125 +1918,524 @@ OPGP_ERROR_STATUS GP211_get_status(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO
 	sendBuffer[i++] = 2;
 	sendBuffer[i++] = 0x4F;
 	sendBuffer[i++] = 0x00;
-	sendBuffer[i] = 0x00;
-	i=0;
-	do {
-		recvBufferLength=256;
-
-		status = OPGP_send_APDU(cardContext, cardInfo, secInfo,sendBuffer, sendBufferLength, recvBuffer, &recvBufferLength);
-		if ( OPGP_ERROR_CHECK(status)) {
-			goto end;
-		}
-		if (status.errorCode != OPGP_ISO7816_ERROR_MORE_DATA_AVAILABLE) {
-			CHECK_SW_9000(recvBuffer, recvBufferLength, status);
-		}
-		for (j=0; j<recvBufferLength-2; ) {
-			if (*dataLength <= i ) {
-				{ OPGP_ERROR_CREATE_ERROR(status, GP211_ERROR_MORE_APPLICATION_DATA, OPGP_stringify_error(GP211_ERROR_MORE_APPLICATION_DATA)); goto end; }
-			}
-			if (cardElement == GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES) {
-				/* Length of Executable Load File AID */
-				executableData[i].AIDLength = recvBuffer[j++];
-
-                /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
-                if (executableData[i].AIDLength > recvBufferLength - j - 2){
-                    executableData[i].AIDLength = (BYTE)(recvBufferLength - j - 2);
-                }
-
-				/* Executable Load File AID */
-                /* BUGFIX: Don't write beyond AID array bounds */
-                memcpy(executableData[i].AID, recvBuffer+j, (executableData[i].AIDLength > 16) ? 16 : executableData[i].AIDLength);
-				j+=executableData[i].AIDLength;
-
-                /* Executable Load File Life Cycle State */
-                /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
-                if (j >= recvBufferLength - 2){
-                    executableData[i].lifeCycleState = 0xFF;
-                }else{
-                    executableData[i].lifeCycleState = recvBuffer[j++];
-                }
-
-				/* Ignore Application Privileges */
-				j++;
-
-				/* Number of associated Executable Modules */
-                /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
-                if (j >= recvBufferLength - 2){
-                    numExecutableModules = 0;
-                }else{
-                    numExecutableModules = recvBuffer[j++];
-                }
-
-				for (k=0; k<numExecutableModules && (j<recvBufferLength-2); k++) {
-					/* Length of Executable Module AID */
-					executableData[i].executableModules[k].AIDLength = recvBuffer[j++];
-
-                    /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
-                    if (executableData[i].executableModules[k].AIDLength > recvBufferLength - j - 2){
-                        executableData[i].executableModules[k].AIDLength = (BYTE)(recvBufferLength - j - 2);
-                    }
-
-					/* Executable Module AID */
-                    /* BUGFIX: Don't write beyond AID array bounds */
-                    memcpy(executableData[i].executableModules[k].AID, recvBuffer+j, (executableData[i].executableModules[k].AIDLength > 16) ? 16 : executableData[i].executableModules[k].AIDLength);
-					j+=executableData[i].executableModules[k].AIDLength;
-				}
-				executableData[i].numExecutableModules = numExecutableModules;
-			}
-			else {
-				applData[i].AIDLength = recvBuffer[j++];
-
-                /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
-                if (applData[i].AIDLength > recvBufferLength - j - 2){
-                    applData[i].AIDLength = (BYTE)(recvBufferLength - j - 2);
-                }
-
-                /* BUGFIX: Don't write beyond AID array bounds */
-                memcpy(applData[i].AID, recvBuffer+j, (applData[i].AIDLength > 16) ? 16 : applData[i].AIDLength);
-				j+=applData[i].AIDLength;
-
-                /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
-                if (j >= recvBufferLength - 2){
-                    applData[i].lifeCycleState = 0xFF;
-                }else{
-                    applData[i].lifeCycleState = recvBuffer[j++];
-                }
-
-				if (cardElement != GP211_STATUS_LOAD_FILES) {
-                    /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
-                    if (j >= recvBufferLength - 2){
-                        applData[i].privileges = 0xFF;
-                    }else{
-                        applData[i].privileges = recvBuffer[j++];
-                    }
-				}
-				else {
-					applData[i].privileges = 0x00;
-					j++;
-				}
-			}
-			i++;
-		}
-		sendBuffer[3]=0x01;
-	} while (status.errorCode == OPGP_ISO7816_ERROR_MORE_DATA_AVAILABLE);
+	sendBuffer[i++] = 0x00;
+	operation->commandLength = i;
 
-	*dataLength = i;
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	OPGP_LOG_END(_T("get_status"), status);
+	OPGP_LOG_END(_T("begin_get_status"), status);
 	return status;
 }
 
 /**
- * If loadFileBuf is NULL the loadFileBufSize is ignored and the necessary buffer size
- * is returned in loadFileBufSize and the functions returns.
- * \param fileName [in] The name of the CAP file.
- * \param loadFileBuf [out] The destination buffer with the Executable Load File contents.
- * \param loadFileBufSize [in, out] The size of the loadFileBuf.
- * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
- */
-OPGP_ERROR_STATUS OPGP_extract_cap_file(OPGP_CSTRING fileName, PBYTE loadFileBuf, PDWORD loadFileBufSize) {
-	return extract_cap_file(fileName, loadFileBuf, loadFileBufSize);
+ * The entries are parsed from each response as it arrives and passed to the callback one at a time,
+ * so no array must be sized in advance and the memory used does not depend on the number of entries.
+ * The listing can be stopped by returning #GP211_GET_STATUS_STOP from the callback.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param cardElement [in] Identifier to retrieve data for Load Files, Applications or the Card Manager.
+ * See GP211_STATUS_APPLICATIONS and related.
+ * \param *callback [in] The callback receiving the entries.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_get_status_with_callback(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				BYTE cardElement, GP211_GET_STATUS_CALLBACK *callback) {
+	OPGP_ERROR_STATUS status;
+	OPGP_OPERATION operation;
+	OPGP_LOG_START(_T("get_status_with_callback"));
+	status = GP211_begin_get_status_with_callback(&operation, cardInfo, secInfo, cardElement, callback);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = run_operation(cardContext, &operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("get_status_with_callback"), status);
+	return status;
+}
+
+/**
+ * See GP211_get_status_with_callback().
+ * \param *operation [out] The operation to start.
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param cardElement [in] Identifier to retrieve data for Load Files, Applications or the Card Manager.
+ * See GP211_STATUS_APPLICATIONS and related.
+ * \param *callback [in] The callback receiving the entries.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_begin_get_status_with_callback(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						   BYTE cardElement, GP211_GET_STATUS_CALLBACK *callback) {
+	OPGP_ERROR_STATUS status;
+	OPGP_LOG_START(_T("begin_get_status_with_callback"));
+	status = GP211_begin_get_status_with_criteria(operation, cardInfo, secInfo, cardElement, NULL, 0, GP211_STATUS_FORMAT_LEGACY, callback);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("begin_get_status_with_callback"), status);
+	return status;
+}
+
+/**
+ * The card only returns the entries whose AID starts with the given AID, so checking if a single
+ * application is present takes one command. If no entry matches no callback is made and no error is returned.
+ * With #GP211_STATUS_FORMAT_TLV the card returns GlobalPlatform 2.2 E3 templates instead of the
+ * GlobalPlatform 2.1.1 format. Only the AID, life cycle state, first privileges byte and
+ * Executable Module AIDs of the templates are passed to the callback.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param cardElement [in] Identifier to retrieve data for Load Files, Applications or the Card Manager.
+ * See GP211_STATUS_APPLICATIONS and related.
+ * \param AID [in] The AID or the beginning of the AIDs to list. If NULL all entries are listed.
+ * \param AIDLength [in] The length of the AID. At most 16.
+ * \param format [in] The response data format. #GP211_STATUS_FORMAT_LEGACY or #GP211_STATUS_FORMAT_TLV.
+ * \param *callback [in] The callback receiving the entries.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_get_status_with_criteria(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				BYTE cardElement, PBYTE AID, DWORD AIDLength, BYTE format, GP211_GET_STATUS_CALLBACK *callback) {
+	OPGP_ERROR_STATUS status;
+	OPGP_OPERATION operation;
+	OPGP_LOG_START(_T("get_status_with_criteria"));
+	status = GP211_begin_get_status_with_criteria(&operation, cardInfo, secInfo, cardElement, AID, AIDLength, format, callback);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = run_operation(cardContext, &operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("get_status_with_criteria"), status);
+	return status;
+}
+
+/**
+ * See GP211_get_status_with_criteria().
+ * \param *operation [out] The operation to start.
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param cardElement [in] Identifier to retrieve data for Load Files, Applications or the Card Manager.
+ * See GP211_STATUS_APPLICATIONS and related.
+ * \param AID [in] The AID or the beginning of the AIDs to list. If NULL all entries are listed.
+ * \param AIDLength [in] The length of the AID. At most 16.
+ * \param format [in] The response data format. #GP211_STATUS_FORMAT_LEGACY or #GP211_STATUS_FORMAT_TLV.
+ * \param *callback [in] The callback receiving the entries.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_begin_get_status_with_criteria(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						   BYTE cardElement, PBYTE AID, DWORD AIDLength, BYTE format, GP211_GET_STATUS_CALLBACK *callback) {
+	OPGP_ERROR_STATUS status;
+	PBYTE sendBuffer = operation->command;
+	DWORD i=0;
+	OPGP_LOG_START(_T("begin_get_status_with_criteria"));
+	if (callback == NULL || AIDLength > 16 || (format != GP211_STATUS_FORMAT_LEGACY && format != GP211_STATUS_FORMAT_TLV)) {
+		{ OPGP_ERROR_CREATE_ERROR(status, EINVAL, OPGP_stringify_error(EINVAL)); goto end; }
+	}
+	if (AID == NULL) {
+		AIDLength = 0;
+	}
+	init_operation(operation, OPERATION_GET_STATUS, cardInfo, secInfo);
+	operation->data.getStatus.cardElement = cardElement;
+	operation->data.getStatus.callback = callback;
+	operation->data.getStatus.format = format;
+	sendBuffer[i++] = 0x80;
+	sendBuffer[i++] = 0xF2;
+	sendBuffer[i++] = cardElement;
+	sendBuffer[i++] = format;
+	sendBuffer[i++] = (BYTE)(2 + AIDLength);
+	sendBuffer[i++] = 0x4F;
+	sendBuffer[i++] = (BYTE)AIDLength;
+	if (AIDLength > 0) {
+		memcpy(sendBuffer+i, AID, AIDLength);
+		i+=AIDLength;
+	}
+	sendBuffer[i++] = 0x00;
+	operation->commandLength = i;
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("begin_get_status_with_criteria"), status);
+	return status;
+}
+
+/**
+ * \param inventory [out] The inventory.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_load_file_inventory_init(GP211_LOAD_FILE_INVENTORY *inventory) {
+	OPGP_ERROR_STATUS status;
+	memset(inventory, 0, sizeof(GP211_LOAD_FILE_INVENTORY));
+	OPGP_ERROR_CREATE_NO_ERROR(status);
+	return status;
+}
+
+/**
+ * \param inventory [in, out] The inventory.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_load_file_inventory_release(GP211_LOAD_FILE_INVENTORY *inventory) {
+	if (inventory->loadFiles != NULL) {
+		free(inventory->loadFiles);
+	}
+	if (inventory->executableModules != NULL) {
+		free(inventory->executableModules);
+	}
+	return GP211_load_file_inventory_init(inventory);
+}
+
+/**
+ * Parameters of add_to_load_file_inventory().
+ */
+typedef struct {
+	GP211_LOAD_FILE_INVENTORY *inventory; //!< The inventory to fill.
+	DWORD errorCode; //!< The error code if the memory could not be allocated, otherwise 0.
+} LOAD_FILE_INVENTORY_PARAMETERS;
+
+/**
+ * GET STATUS callback appending an Executable Load File and its Executable Modules to an inventory.
+ * \param *callbackParameters [in] The GET STATUS entry.
+ * \return 0 or #GP211_GET_STATUS_STOP if the memory could not be allocated.
+ */
+OPGP_NO_API
+DWORD add_to_load_file_inventory(GP211_GET_STATUS_CALLBACK_PARAMETERS *callbackParameters) {
+	LOAD_FILE_INVENTORY_PARAMETERS *parameters = (LOAD_FILE_INVENTORY_PARAMETERS *)callbackParameters->parameters;
+	GP211_LOAD_FILE_INVENTORY *inventory = parameters->inventory;
+	GP211_EXECUTABLE_MODULES_DATA *executableData = callbackParameters->executableData;
+	GP211_LOAD_FILE_DATA *loadFile;
+	PVOID buffer;
+	DWORD size;
+	if (inventory->loadFilesLength == inventory->loadFilesSize) {
+		size = inventory->loadFilesSize == 0 ? 16 : inventory->loadFilesSize * 2;
+		buffer = realloc(inventory->loadFiles, size * sizeof(GP211_LOAD_FILE_DATA));
+		if (buffer == NULL) {
+			parameters->errorCode = ENOMEM;
+			return GP211_GET_STATUS_STOP;
+		}
+		inventory->loadFiles = (GP211_LOAD_FILE_DATA *)buffer;
+		inventory->loadFilesSize = size;
+	}
+	if (inventory->executableModulesLength + executableData->numExecutableModules > inventory->executableModulesSize) {
+		size = inventory->executableModulesSize == 0 ? 32 : inventory->executableModulesSize * 2;
+		while (size < inventory->executableModulesLength + executableData->numExecutableModules) {
+			size *= 2;
+		}
+		buffer = realloc(inventory->executableModules, size * sizeof(OPGP_AID));
+		if (buffer == NULL) {
+			parameters->errorCode = ENOMEM;
+			return GP211_GET_STATUS_STOP;
+		}
+		inventory->executableModules = (OPGP_AID *)buffer;
+		inventory->executableModulesSize = size;
+	}
+	loadFile = inventory->loadFiles + inventory->loadFilesLength++;
+	loadFile->AIDLength = executableData->AIDLength;
+	memcpy(loadFile->AID, executableData->AID, sizeof(loadFile->AID));
+	loadFile->lifeCycleState = executableData->lifeCycleState;
+	loadFile->numExecutableModules = executableData->numExecutableModules;
+	loadFile->executableModulesOffset = inventory->executableModulesLength;
+	memcpy(inventory->executableModules + inventory->executableModulesLength, executableData->executableModules,
+		executableData->numExecutableModules * sizeof(OPGP_AID));
+	inventory->executableModulesLength += executableData->numExecutableModules;
+	return 0;
+}
+
+/**
+ * Uses GET STATUS for GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES. Instead of a GP211_EXECUTABLE_MODULES_DATA
+ * with space for 256 Executable Modules per Executable Load File, the Executable Modules of all Executable Load Files
+ * are stored contiguously and referenced by offset. Previous contents of the inventory are replaced.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param *inventory [in, out] The inventory initialized with GP211_load_file_inventory_init().
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_get_load_file_inventory(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				GP211_LOAD_FILE_INVENTORY *inventory) {
+	OPGP_ERROR_STATUS status;
+	GP211_GET_STATUS_CALLBACK callback;
+	LOAD_FILE_INVENTORY_PARAMETERS parameters;
+	OPGP_LOG_START(_T("get_load_file_inventory"));
+	inventory->loadFilesLength = 0;
+	inventory->executableModulesLength = 0;
+	parameters.inventory = inventory;
+	parameters.errorCode = 0;
+	callback.callback = (PVOID)add_to_load_file_inventory;
+	callback.parameters = &parameters;
+	status = GP211_get_status_with_callback(cardContext, cardInfo, secInfo, GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES, &callback);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	if (parameters.errorCode != 0) {
+		{ OPGP_ERROR_CREATE_ERROR(status, parameters.errorCode, OPGP_stringify_error(parameters.errorCode)); goto end; }
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("get_load_file_inventory"), status);
+	return status;
+}
+
+/**
+ * Parses one GlobalPlatform 2.2 E3 template of a GET STATUS response.
+ * \param buffer [in] The response data starting with the template.
+ * \param length [in] The length of the response data.
+ * \param cardElement [in] The requested card element.
+ * \param *applData [out] The entry if cardElement is not GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES.
+ * \param *executableData [out] The entry if cardElement is GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES.
+ * \return -1 in case of error, the length of the template otherwise.
+ */
+OPGP_NO_API
+LONG parse_get_status_template(PBYTE buffer, DWORD length, BYTE cardElement, GP211_APPLICATION_DATA *applData,
+							   GP211_EXECUTABLE_MODULES_DATA *executableData) {
+	LONG result;
+	DWORD tag, templateLength, valueLength, offset;
+	PBYTE AID;
+	PBYTE AIDLength;
+	PBYTE lifeCycleState;
+	OPGP_AID *module;
+	result = read_BER_TLV_header(buffer, length, &tag, &templateLength);
+	if (result == -1 || tag != 0xE3) {
+		result = -1;
+		goto end;
+	}
+	offset = (DWORD)result;
+	if (cardElement == GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES) {
+		memset(executableData, 0, sizeof(GP211_EXECUTABLE_MODULES_DATA));
+		AID = executableData->AID;
+		AIDLength = &executableData->AIDLength;
+		lifeCycleState = &executableData->lifeCycleState;
+	}
+	else {
+		memset(applData, 0, sizeof(GP211_APPLICATION_DATA));
+		AID = applData->AID;
+		AIDLength = &applData->AIDLength;
+		lifeCycleState = &applData->lifeCycleState;
+	}
+	templateLength += offset;
+	while (offset < templateLength) {
+		result = read_BER_TLV_header(buffer+offset, templateLength-offset, &tag, &valueLength);
+		if (result == -1) {
+			goto end;
+		}
+		offset += result;
+		switch (tag) {
+			case 0x4F:
+				*AIDLength = (BYTE)(valueLength > 16 ? 16 : valueLength);
+				memcpy(AID, buffer+offset, *AIDLength);
+				break;
+			case 0x9F70:
+				if (valueLength > 0) {
+					*lifeCycleState = buffer[offset];
+				}
+				break;
+			case 0xC5:
+				if (valueLength > 0 && cardElement != GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES) {
+					applData->privileges = buffer[offset];
+				}
+				break;
+			case 0x84:
+				if (cardElement == GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES && executableData->numExecutableModules < 255) {
+					module = executableData->executableModules + executableData->numExecutableModules++;
+					module->AIDLength = (BYTE)(valueLength > 16 ? 16 : valueLength);
+					memcpy(module->AID, buffer+offset, module->AIDLength);
+				}
+				break;
+		}
+		offset += valueLength;
+	}
+	result = (LONG)templateLength;
+end:
+	return result;
+}
+
+/**
+ * Processes the response of a GET STATUS command. If more data is available the next GET STATUS command is prepared.
+ * \param *operation [in, out] The GET STATUS operation.
+ * \param recvBuffer [in] The response APDU.
+ * \param recvBufferLength [in] The length of the response APDU.
+ * \param status [in] The status containing the status word of the response APDU.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_NO_API
+OPGP_ERROR_STATUS process_get_status(OPGP_OPERATION *operation, PBYTE recvBuffer, DWORD recvBufferLength, OPGP_ERROR_STATUS status) {
+	BYTE cardElement = operation->data.getStatus.cardElement;
+	GP211_APPLICATION_DATA *applData = operation->data.getStatus.applData;
+	GP211_EXECUTABLE_MODULES_DATA *executableData = operation->data.getStatus.executableData;
+	PDWORD dataLength = operation->data.getStatus.dataLength;
+	GP211_GET_STATUS_CALLBACK *callback = operation->data.getStatus.callback;
+	GP211_GET_STATUS_CALLBACK_PARAMETERS callbackParameters;
+	GP211_APPLICATION_DATA streamApplData;
+	GP211_EXECUTABLE_MODULES_DATA streamExecutableData;
+	GP211_APPLICATION_DATA *application = NULL;
+	GP211_EXECUTABLE_MODULES_DATA *executable = NULL;
+	BYTE numExecutableModules;
+	DWORD j=0, k=0, i=operation->data.getStatus.count;
+	LONG result;
+	OPGP_LOG_START(_T("process_get_status"));
+	if (callback != NULL && status.errorCode == OPGP_ISO7816_ERROR_DATA_NOT_FOUND) {
+		// no entry matches the search criteria
+		finish_operation(operation);
+		{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+	}
+	if (status.errorCode != OPGP_ISO7816_ERROR_MORE_DATA_AVAILABLE) {
+		CHECK_SW_9000(recvBuffer, recvBufferLength, status);
+	}
+	for (j=0; j<recvBufferLength-2; ) {
+		if (callback != NULL) {
+			// entries are only passed to the callback, so one buffer is reused
+			application = &streamApplData;
+			executable = &streamExecutableData;
+		}
+		else {
+			if (*dataLength <= i ) {
+				{ OPGP_ERROR_CREATE_ERROR(status, GP211_ERROR_MORE_APPLICATION_DATA, OPGP_stringify_error(GP211_ERROR_MORE_APPLICATION_DATA)); goto end; }
+			}
+			if (cardElement == GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES) {
+				executable = executableData + i;
+			}
+			else {
+				application = applData + i;
+			}
+		}
+		if (operation->data.getStatus.format == GP211_STATUS_FORMAT_TLV) {
+			result = parse_get_status_template(recvBuffer+j, recvBufferLength-2-j, cardElement, application, executable);
+			if (result == -1) {
+				{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_RESPONSE_DATA, OPGP_stringify_error(OPGP_ERROR_INVALID_RESPONSE_DATA)); goto end; }
+			}
+			j+=result;
+		}
+		else if (cardElement == GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES) {
+			/* Length of Executable Load File AID */
+			executable->AIDLength = recvBuffer[j++];
+
+            /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
+            if (executable->AIDLength > recvBufferLength - j - 2){
+                executable->AIDLength = (BYTE)(recvBufferLength - j - 2);
+            }
+
+			/* Executable Load File AID */
+            /* BUGFIX: Don't write beyond AID array bounds */
+            memcpy(executable->AID, recvBuffer+j, (executable->AIDLength > 16) ? 16 : executable->AIDLength);
+			j+=executable->AIDLength;
+
+            /* Executable Load File Life Cycle State */
+            /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
+            if (j >= recvBufferLength - 2){
+                executable->lifeCycleState = 0xFF;
+            }else{
+                executable->lifeCycleState = recvBuffer[j++];
+            }
+
+			/* Ignore Application Privileges */
+			j++;
+
+			/* Number of associated Executable Modules */
+            /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
+            if (j >= recvBufferLength - 2){
+                numExecutableModules = 0;
+            }else{
+                numExecutableModules = recvBuffer[j++];
+            }
+
+			for (k=0; k<numExecutableModules && (j<recvBufferLength-2); k++) {
+				/* Length of Executable Module AID */
+				executable->executableModules[k].AIDLength = recvBuffer[j++];
+
+                /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
+                if (executable->executableModules[k].AIDLength > recvBufferLength - j - 2){
+                    executable->executableModules[k].AIDLength = (BYTE)(recvBufferLength - j - 2);
+                }
+
+				/* Executable Module AID */
+                /* BUGFIX: Don't write beyond AID array bounds */
+                memcpy(executable->executableModules[k].AID, recvBuffer+j, (executable->executableModules[k].AIDLength > 16) ? 16 : executable->executableModules[k].AIDLength);
+				j+=executable->executableModules[k].AIDLength;
+			}
+			executable->numExecutableModules = numExecutableModules;
+		}
+		else {
+			application->AIDLength = recvBuffer[j++];
+
+            /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
+            if (application->AIDLength > recvBufferLength - j - 2){
+                application->AIDLength = (BYTE)(recvBufferLength - j - 2);
+            }
+
+            /* BUGFIX: Don't write beyond AID array bounds */
+            memcpy(application->AID, recvBuffer+j, (application->AIDLength > 16) ? 16 : application->AIDLength);
+			j+=application->AIDLength;
+
+            /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
+            if (j >= recvBufferLength - 2){
+                application->lifeCycleState = 0xFF;
+            }else{
+                application->lifeCycleState = recvBuffer[j++];
+            }
+
+			if (cardElement != GP211_STATUS_LOAD_FILES) {
+                /* BUGFIX: Don't read beyond recvBuffer array bounds or into 0x9000 */
+                if (j >= recvBufferLength - 2){
+                    application->privileges = 0xFF;
+                }else{
+                    application->privileges = recvBuffer[j++];
+                }
+			}
+			else {
+				application->privileges = 0x00;
+				j++;
+			}
+		}
+		i++;
+		if (callback != NULL) {
+			callbackParameters.cardElement = cardElement;
+			callbackParameters.applData = cardElement == GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES ? NULL : application;
+			callbackParameters.executableData = cardElement == GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES ? executable : NULL;
+			callbackParameters.parameters = callback->parameters;
+			if (((DWORD(*)(GP211_GET_STATUS_CALLBACK_PARAMETERS *))(callback->callback))(&callbackParameters) == GP211_GET_STATUS_STOP) {
+				finish_operation(operation);
+				{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+			}
+		}
+	}
+	operation->data.getStatus.count = i;
+	if (status.errorCode == OPGP_ISO7816_ERROR_MORE_DATA_AVAILABLE) {
+		operation->command[3] = operation->data.getStatus.format | 0x01;
+	}
+	else {
+		if (callback == NULL) {
+			*dataLength = i;
+		}
+		finish_operation(operation);
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("process_get_status"), status);
+	return status;
+}
+
+/**
+ * If loadFileBuf is NULL the loadFileBufSize is ignored and the necessary buffer size
+ * is returned in loadFileBufSize and the functions returns.
+ * \param fileName [in] The name of the CAP file.
+ * \param loadFileBuf [out] The destination buffer with the Executable Load File contents.
+ * \param loadFileBufSize [in, out] The size of the loadFileBuf.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_extract_cap_file(OPGP_CSTRING fileName, PBYTE loadFileBuf, PDWORD loadFileBufSize) {
+	return extract_cap_file(fileName, loadFileBuf, loadFileBufSize);
 }
 
 /**
@@ -1747,7 +2476,7 @@ OPGP_ERROR_STATUS OPGP_read_executable_load_file_parameters_from_buffer(PBYTE lo
  * \param *loadFileDataBlockSignature [in] A pointer to GP211_DAP_BLOCK structure(s).
  * \param loadFileDataBlockSignatureLength [in] The number of GP211_DAP_BLOCK structure(s).
  * \param executableLoadFileName [in] The name of the CAP or IJC file (Executable Load File) to load.
- * \param *receiptData [out] If the deletion is performed by a security domain with delegated management privilege
+ * \param *receiptData [out] If the load is performed by a security domain with delegated management privilege
  * this structure contains the according data.
  * Can be validated with validate_load_receipt().
  * \param receiptDataAvailable [out] 0 if no receiptData is available.
@@ -1775,7 +2504,7 @@ OPGP_ERROR_STATUS GP211_load(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardI
  * \param loadFileDataBlockSignatureLength [in] The number of GP211_DAP_BLOCK structure(s).
  * \param loadFileBuf [in] buffer with the contents of a Executable Load File.
  * \param loadFileBufSize [in] size of loadFileBuf.
- * \param *receiptData [out] If the deletion is performed by a security domain with delegated management privilege
+ * \param *receiptData [out] If the load is performed by a security domain with delegated management privilege
  * this structure contains the according data.
  * Can be validated with validate_load_receipt().
  * \param receiptDataAvailable [out] 0 if no receiptData is available.
@@ -1797,274 +2526,329 @@ OPGP_ERROR_STATUS load_from_buffer(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO
 				 PBYTE loadFileBuf, DWORD loadFileBufSize,
 				 GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable, OPGP_PROGRESS_CALLBACK *callback) {
 	OPGP_ERROR_STATUS status;
-	DWORD sendBufferLength;
-	DWORD recvBufferLength=256;
-	BYTE recvBuffer[256];
-	BYTE sendBuffer[261];
-	BYTE dapBuf[256];
-	DWORD dapBufSize=sizeof(dapBuf);
-
-	DWORD total=0;
-	DWORD fileSizeSize;
-	DWORD j,k,i=0,count;
-	OPGP_PROGRESS_CALLBACK_PARAMETERS callbackParameters;
-	BYTE sequenceNumber=0x00;
-    INIT_PROGRESS_CALLBACK_PARAMETERS(callbackParameters, callback);
+	OPGP_OPERATION operation;
 	OPGP_LOG_START(_T("load_from_buffer"));
+	status = GP211_begin_load_from_buffer(&operation, cardInfo, secInfo, loadFileDataBlockSignature,
+		loadFileDataBlockSignatureLength, loadFileBuf, loadFileBufSize, receiptData, receiptDataAvailable, callback);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = run_operation(cardContext, &operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
 
-	*receiptDataAvailable = 0;
-	sendBuffer[0] = 0x80;
-	sendBuffer[1] = 0xE8;
-	j=0;
-	for (i=0; i<loadFileDataBlockSignatureLength; i++) {
-		k = dapBufSize;
-		status = read_load_file_data_block_signature(dapBuf, &k, loadFileDataBlockSignature[i]);
-		if (OPGP_ERROR_CHECK(status)) {
-			goto end;
-		}
-		if (k > MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING) {
-			OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_COMMAND_SECURE_MESSAGING_TOO_LARGE, OPGP_stringify_error(OPGP_ERROR_COMMAND_SECURE_MESSAGING_TOO_LARGE)); goto end;
-			goto end;
-		}
-		if (j+k <= MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING) {
-			memcpy(sendBuffer+5+j, dapBuf, k);
-			j+=k;
-		}
-		else {
-			sendBufferLength=5+j;
-			sendBuffer[2] = 0x00;
-			sendBuffer[3] = sequenceNumber++;
-			sendBuffer[4]=(BYTE)j;
-			// CFlex behavior strange, so commented out
-			//sendBufferLength++;
-			//sendBuffer[sendBufferLength-1] = 0x00;
-
-			status = OPGP_send_APDU(cardContext, cardInfo, secInfo, sendBuffer, sendBufferLength, recvBuffer, &recvBufferLength);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
-			CHECK_SW_9000(recvBuffer, recvBufferLength, status);
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("load_from_buffer"), status);
+	return status;
+}
 
-			/* Start with new APDU */
-			j=0;
-			// The current data block i is not sent so must be handled again
-			i--;
-		}
-	}
-	// send load file data block
+/**
+ * See GP211_load_from_buffer(). One LOAD command is prepared for each block.
+ * \param *operation [out] The operation to start.
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param *loadFileDataBlockSignature [in] A pointer to GP211_DAP_BLOCK structure(s).
+ * \param loadFileDataBlockSignatureLength [in] The number of GP211_DAP_BLOCK structure(s).
+ * \param loadFileBuf [in] buffer with the contents of a Executable Load File.
+ * \param loadFileBufSize [in] size of loadFileBuf.
+ * \param *receiptData [out] If the load is performed by a security domain with delegated management privilege
+ * this structure contains the according data.
+ * Can be validated with validate_load_receipt().
+ * \param receiptDataAvailable [out] 0 if no receiptData is available.
+ * \param *callback [in] An optional callback for measuring the progress. Can be NULL if not needed.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_begin_load_from_buffer(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				 GP211_DAP_BLOCK *loadFileDataBlockSignature, DWORD loadFileDataBlockSignatureLength,
+				 PBYTE loadFileBuf, DWORD loadFileBufSize,
+				 GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable, OPGP_PROGRESS_CALLBACK *callback) {
+	OPGP_ERROR_STATUS status;
+	OPGP_LOG_START(_T("begin_load_from_buffer"));
+	init_operation(operation, OPERATION_LOAD, cardInfo, secInfo);
+	operation->data.load.loadFileDataBlockSignature = loadFileDataBlockSignature;
+	operation->data.load.loadFileDataBlockSignatureLength = loadFileDataBlockSignatureLength;
+	operation->data.load.loadFileBuf = loadFileBuf;
+	operation->data.load.loadFileBufSize = loadFileBufSize;
+	operation->data.load.callback = callback;
+	operation->data.load.receiptData = receiptData;
+	operation->data.load.receiptDataAvailable = receiptDataAvailable;
 
+	*receiptDataAvailable = 0;
 	if (loadFileBufSize < 128L) {
-		fileSizeSize=1;
+		operation->data.load.fileSizeSize=1;
 	}
 	else if (loadFileBufSize < 256L) {
-		fileSizeSize=2;
+		operation->data.load.fileSizeSize=2;
 	}
 	else if (loadFileBufSize < 65536L) {
-		fileSizeSize=3;
+		operation->data.load.fileSizeSize=3;
 	}
 	else {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_APPLICATION_TOO_BIG, OPGP_stringify_error(OPGP_ERROR_APPLICATION_TOO_BIG)); goto end; }
 	}
-	// load file can only have 256 blocks (minus the already sent blocks)
-	// times the maximum APDU size minus the tag and length and the current position in the APDU
-	if (((256-sequenceNumber) * MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING - j - 1 - fileSizeSize) < loadFileBufSize) {
-		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_APPLICATION_TOO_BIG, OPGP_stringify_error(OPGP_ERROR_APPLICATION_TOO_BIG)); goto end; }
+	status = build_load_command(operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
 	}
 
-	// Enough space left to start load file data block
-
-	if ((MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING-j) > fileSizeSize+1+1) { // At least one byte of the load file data block must be sent.
-		sendBuffer[5+j++] = 0xC4;
-		switch(fileSizeSize) {
-			case 1: {
-				sendBuffer[5+j++] = (BYTE)loadFileBufSize;
-				break;
-					}
-			case 2: {
-				sendBuffer[5+j++] = 0x81;
-				sendBuffer[5+j++] = (BYTE)loadFileBufSize;
-				break;
-					}
-			case 3: {
-				sendBuffer[5+j++] = 0x82;
-				sendBuffer[5+j++] = (BYTE)(loadFileBufSize >> 8);
-				sendBuffer[5+j++] = (BYTE)(loadFileBufSize - (sendBuffer[5+j-1] << 8));
-					}
-		}
-		if (loadFileBufSize > MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING-j) {
-			count=MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING-j;
-		}
-		else {
-			count=loadFileBufSize;
-		}
-
-		memcpy(sendBuffer+5+j, loadFileBuf, count);
-		j+=count;
-		total+=count;
-		sendBufferLength=5+j;
-		sendBuffer[2] = 0x00;
-		sendBuffer[3] = (BYTE)sequenceNumber++;
-		sendBuffer[4]=(BYTE)j;
-		if (count == loadFileBufSize) {
-			sendBuffer[2]=0x80;
-			sendBufferLength++;
-			sendBuffer[sendBufferLength-1] = 0x00;
-		}
-		else {
-			sendBuffer[2]=0x00;
-			/* CyberFlex e-gate 32k cards do not behave standard conform and accept the Le field (?) */
-			//sendBufferLength++;
-			//sendBuffer[sendBufferLength-1] = 0x00;
-		}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	if (OPGP_ERROR_CHECK(status)) {
+		finish_operation(operation);
+	}
+	OPGP_LOG_END(_T("begin_load_from_buffer"), status);
+	return status;
+}
 
-		recvBufferLength=256;
+/**
+ * Like GP211_load_from_buffer() but calculates the Load File Data Block Hash incrementally over the blocks
+ * accepted by the card, so the Executable Load File is not read a second time, e.g. for checking a receipt or for an audit log.
+ * If the hash is needed for the INSTALL [for load] command use GP211_calculate_load_file_data_block_hash_from_buffer()
+ * on the same buffer instead.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param *loadFileDataBlockSignature [in] A pointer to GP211_DAP_BLOCK structure(s).
+ * \param loadFileDataBlockSignatureLength [in] The number of GP211_DAP_BLOCK structure(s).
+ * \param loadFileBuf [in] buffer with the contents of a Executable Load File.
+ * \param loadFileBufSize [in] size of loadFileBuf.
+ * \param hashAlgorithm [in] The hash algorithm. See #GP211_HASH_ALGORITHM_SHA1 and #GP211_HASH_ALGORITHM_SHA256.
+ * \param hash [out] The Load File Data Block Hash. Should be #GP211_MAX_HASH_LENGTH bytes long.
+ * \param hashLength [in, out] The size of the hash buffer and the length of the hash.
+ * \param *receiptData [out] If the load is performed by a security domain with delegated management privilege
+ * this structure contains the according data.
+ * Can be validated with validate_load_receipt().
+ * \param receiptDataAvailable [out] 0 if no receiptData is available.
+ * \param *callback [in] An optional callback for measuring the progress. Can be NULL if not needed.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_load_from_buffer_with_hash(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				 GP211_DAP_BLOCK *loadFileDataBlockSignature, DWORD loadFileDataBlockSignatureLength,
+				 PBYTE loadFileBuf, DWORD loadFileBufSize, BYTE hashAlgorithm, PBYTE hash, PDWORD hashLength,
+				 GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable, OPGP_PROGRESS_CALLBACK *callback) {
+	OPGP_ERROR_STATUS status;
+	OPGP_OPERATION operation;
+	OPGP_LOG_START(_T("GP211_load_from_buffer_with_hash"));
+	status = GP211_begin_load_from_buffer_with_hash(&operation, cardInfo, secInfo, loadFileDataBlockSignature,
+		loadFileDataBlockSignatureLength, loadFileBuf, loadFileBufSize, hashAlgorithm, hash, hashLength,
+		receiptData, receiptDataAvailable, callback);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = run_operation(cardContext, &operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
 
-		status = OPGP_send_APDU(cardContext, cardInfo, secInfo, sendBuffer, sendBufferLength, recvBuffer, &recvBufferLength);
-		if (OPGP_ERROR_CHECK(status)) {
-			goto end;
-		}
-		CHECK_SW_9000(recvBuffer, recvBufferLength, status);
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("GP211_load_from_buffer_with_hash"), status);
+	return status;
+}
 
-		if(callback != NULL) {
-			callbackParameters.currentWork = total;
-			callbackParameters.totalWork = loadFileBufSize;
-			((void(*)(OPGP_PROGRESS_CALLBACK_PARAMETERS))(callback->callback))(callbackParameters);
-		}
+/**
+ * See GP211_load_from_buffer_with_hash(). The hash is available when the operation is finished without error.
+ * \param *operation [out] The operation to start.
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param *loadFileDataBlockSignature [in] A pointer to GP211_DAP_BLOCK structure(s).
+ * \param loadFileDataBlockSignatureLength [in] The number of GP211_DAP_BLOCK structure(s).
+ * \param loadFileBuf [in] buffer with the contents of a Executable Load File.
+ * \param loadFileBufSize [in] size of loadFileBuf.
+ * \param hashAlgorithm [in] The hash algorithm. See #GP211_HASH_ALGORITHM_SHA1 and #GP211_HASH_ALGORITHM_SHA256.
+ * \param hash [out] The Load File Data Block Hash. Must stay valid until the operation is finished.
+ * \param hashLength [in, out] The size of the hash buffer and the length of the hash. Must stay valid until the operation is finished.
+ * \param *receiptData [out] If the load is performed by a security domain with delegated management privilege
+ * this structure contains the according data.
+ * Can be validated with validate_load_receipt().
+ * \param receiptDataAvailable [out] 0 if no receiptData is available.
+ * \param *callback [in] An optional callback for measuring the progress. Can be NULL if not needed.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_begin_load_from_buffer_with_hash(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				 GP211_DAP_BLOCK *loadFileDataBlockSignature, DWORD loadFileDataBlockSignatureLength,
+				 PBYTE loadFileBuf, DWORD loadFileBufSize, BYTE hashAlgorithm, PBYTE hash, PDWORD hashLength,
+				 GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable, OPGP_PROGRESS_CALLBACK *callback) {
+	OPGP_ERROR_STATUS status;
+	OPGP_LOG_START(_T("GP211_begin_load_from_buffer_with_hash"));
+	status = GP211_begin_load_from_buffer(operation, cardInfo, secInfo, loadFileDataBlockSignature,
+		loadFileDataBlockSignatureLength, loadFileBuf, loadFileBufSize, receiptData, receiptDataAvailable, callback);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	operation->data.load.hash = hash;
+	operation->data.load.hashLength = hashLength;
+	status = init_hash(hashAlgorithm, &operation->data.load.hashContext);
+	if (OPGP_ERROR_CHECK(status)) {
+		finish_operation(operation);
+		goto end;
 	}
-	// Not enough space to start load file data block. First send data then start load file data block.
 
-	else {
-		sendBufferLength=5+j;
-		sendBuffer[2] = 0x00;
-		sendBuffer[3] = sequenceNumber++;
-		sendBuffer[4]=(BYTE)j;
-		recvBufferLength=256;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("GP211_begin_load_from_buffer_with_hash"), status);
+	return status;
+}
 
-		status = OPGP_send_APDU(cardContext, cardInfo, secInfo, sendBuffer, sendBufferLength, recvBuffer, &recvBufferLength);
+/**
+ * Prepares the next LOAD command. The Load File Data Block Signatures are sent first, a signature is never split.
+ * The Load File Data Block tag and length are only sent together with at least one byte of the Load File Data Block.
+ * \param *operation [in, out] The load operation.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_NO_API
+OPGP_ERROR_STATUS build_load_command(OPGP_OPERATION *operation) {
+	OPGP_ERROR_STATUS status;
+	PBYTE sendBuffer = operation->command;
+	DWORD sendBufferLength;
+	BYTE dapBuf[256];
+	DWORD j=0, k, count=0;
+	PBYTE loadFileBuf = operation->data.load.loadFileBuf;
+	DWORD loadFileBufSize = operation->data.load.loadFileBufSize;
+	DWORD total = operation->data.load.total;
+	DWORD fileSizeSize = operation->data.load.fileSizeSize;
+	OPGP_LOG_START(_T("build_load_command"));
+	sendBuffer[0] = 0x80;
+	sendBuffer[1] = 0xE8;
+	while (operation->data.load.signatureIndex < operation->data.load.loadFileDataBlockSignatureLength) {
+		k = sizeof(dapBuf);
+		status = read_load_file_data_block_signature(dapBuf, &k, operation->data.load.loadFileDataBlockSignature[operation->data.load.signatureIndex]);
 		if (OPGP_ERROR_CHECK(status)) {
 			goto end;
 		}
-		CHECK_SW_9000(recvBuffer, recvBufferLength, status);
-
-		j=0;
-		sendBuffer[5+j++] = 0xC4;
-		switch(fileSizeSize) {
-			case 1: {
-				sendBuffer[5+j++] = (BYTE)loadFileBufSize;
-				break;
-				}
-			case 2: {
-				sendBuffer[5+j++] = 0x81;
-				sendBuffer[5+j++] = (BYTE)loadFileBufSize;
-				break;
-				}
-			case 3: {
-				sendBuffer[5+j++] = 0x82;
-				sendBuffer[5+j++] = (BYTE)(loadFileBufSize >> 8);
-				sendBuffer[5+j++] = (BYTE)(loadFileBufSize - (sendBuffer[5+j-1] << 8));
-				}
-		}
-		if (loadFileBufSize > MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING-1-fileSizeSize) {
-			count=MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING-1-fileSizeSize;
-		}
-		else {
-			count=loadFileBufSize;
-		}
-
-		memcpy(sendBuffer+5+j, loadFileBuf, count);
-		j+=count;
-		total+=count;
-
-		sendBufferLength=5+j;
-		sendBuffer[2] = 0x00;
-		sendBuffer[3] = sequenceNumber++;
-		sendBuffer[4]=(BYTE)j;
-		if (total == loadFileBufSize) {
-			sendBuffer[2]=0x80;
-			sendBufferLength++;
-			sendBuffer[sendBufferLength-1] = 0x00;
+		if (k > MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING) {
+			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_COMMAND_SECURE_MESSAGING_TOO_LARGE, OPGP_stringify_error(OPGP_ERROR_COMMAND_SECURE_MESSAGING_TOO_LARGE)); goto end; }
 		}
-		else {
-			sendBuffer[2]=0x00;
-			/* CyberFlex e-gate 32k cards do not behave standard conform and accept the Le field (?) */
-			//sendBufferLength++;
-			//sendBuffer[sendBufferLength-1] = 0x00;
+		// The data block is sent with the next APDU
+		if (j+k > MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING) {
+			break;
 		}
-
-		recvBufferLength=256;
-
-		status = OPGP_send_APDU(cardContext, cardInfo, secInfo, sendBuffer, sendBufferLength, recvBuffer, &recvBufferLength);
-		if (OPGP_ERROR_CHECK(status)) {
-			goto end;
+		memcpy(sendBuffer+5+j, dapBuf, k);
+		j+=k;
+		operation->data.load.signatureIndex++;
+	}
+	if (operation->data.load.signatureIndex == operation->data.load.loadFileDataBlockSignatureLength
+		&& !operation->data.load.headerSent) {
+		// load file can only have 256 blocks (minus the already sent blocks)
+		// times the maximum APDU size minus the tag and length and the current position in the APDU
+		if (((256-operation->data.load.sequenceNumber) * MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING - j - 1 - fileSizeSize) < loadFileBufSize) {
+			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_APPLICATION_TOO_BIG, OPGP_stringify_error(OPGP_ERROR_APPLICATION_TOO_BIG)); goto end; }
 		}
-		CHECK_SW_9000(recvBuffer, recvBufferLength, status);
-
-		if(callback != NULL) {
-			callbackParameters.currentWork = total;
-			callbackParameters.totalWork = loadFileBufSize;
-			((void(*)(OPGP_PROGRESS_CALLBACK_PARAMETERS))(callback->callback))(callbackParameters);
+		// Enough space left to start load file data block, otherwise first send data then start load file data block.
+		if ((MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING-j) > fileSizeSize+1+1) { // At least one byte of the load file data block must be sent.
+			sendBuffer[5+j++] = 0xC4;
+			switch(fileSizeSize) {
+				case 1: {
+					sendBuffer[5+j++] = (BYTE)loadFileBufSize;
+					break;
+						}
+				case 2: {
+					sendBuffer[5+j++] = 0x81;
+					sendBuffer[5+j++] = (BYTE)loadFileBufSize;
+					break;
+						}
+				case 3: {
+					sendBuffer[5+j++] = 0x82;
+					sendBuffer[5+j++] = (BYTE)(loadFileBufSize >> 8);
+					sendBuffer[5+j++] = (BYTE)(loadFileBufSize - (sendBuffer[5+j-1] << 8));
+						}
+			}
+			operation->data.load.headerSent = 1;
 		}
 	}
-	// The rest of the load file data block
-
-	while(!(total == loadFileBufSize)) {
-		j = 0;
-		OPGP_LOG_MSG(_T("load_from_buffer: left: %d"), loadFileBufSize-total);
-		if (loadFileBufSize-total > MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING) {
-			count=MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING;
+	if (operation->data.load.headerSent) {
+		OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("build_load_command: left: %d"), loadFileBufSize-total);
+		if (loadFileBufSize-total > MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING-j) {
+			count=MAX_APDU_DATA_SIZE_FOR_SECURE_MESSAGING-j;
 		}
 		else {
 			count=loadFileBufSize-total;
 		}
-
 		memcpy(sendBuffer+5+j, loadFileBuf+total, count);
 		j+=count;
-		total+=count;
-
-		sendBufferLength=5+j;
-		sendBuffer[3] = sequenceNumber++;
-		sendBuffer[4] = (BYTE)j;
-		if (loadFileBufSize == total) {
-			sendBuffer[2]=0x80;
-			sendBufferLength++;
-			sendBuffer[sendBufferLength-1] = 0x00;
-		}
-		else {
-			sendBuffer[2]=0x00;
-			/* CyberFlex e-gate 32k cards do not behave standard conform and accept the Le field (?) */
-			//sendBufferLength++;
-			//sendBuffer[sendBufferLength-1] = 0x00;
-		}
+	}
+	operation->data.load.commandTotal = total+count;
 
-		recvBufferLength=256;
-		status = OPGP_send_APDU(cardContext, cardInfo, secInfo, sendBuffer, sendBufferLength, recvBuffer, &recvBufferLength);
+	sendBufferLength=5+j;
+	sendBuffer[3] = operation->data.load.sequenceNumber;
+	sendBuffer[4] = (BYTE)j;
+	if (operation->data.load.headerSent && operation->data.load.commandTotal == loadFileBufSize) {
+		sendBuffer[2]=0x80;
+		sendBufferLength++;
+		sendBuffer[sendBufferLength-1] = 0x00;
+	}
+	else {
+		sendBuffer[2]=0x00;
+		/* CyberFlex e-gate 32k cards do not behave standard conform and accept the Le field (?) */
+		//sendBufferLength++;
+		//sendBuffer[sendBufferLength-1] = 0x00;
+	}
+	operation->commandLength = sendBufferLength;
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("build_load_command"), status);
+	return status;
+}
+
+/**
+ * Processes the response of a LOAD command and prepares the next LOAD command.
+ * \param *operation [in, out] The load operation.
+ * \param recvBuffer [in] The response APDU.
+ * \param recvBufferLength [in] The length of the response APDU.
+ * \param status [in] The status containing the status word of the response APDU.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_NO_API
+OPGP_ERROR_STATUS process_load(OPGP_OPERATION *operation, PBYTE recvBuffer, DWORD recvBufferLength, OPGP_ERROR_STATUS status) {
+	OPGP_PROGRESS_CALLBACK_PARAMETERS callbackParameters;
+	OPGP_PROGRESS_CALLBACK *callback = operation->data.load.callback;
+	OPGP_LOG_START(_T("process_load"));
+	CHECK_SW_9000(recvBuffer, recvBufferLength, status);
+	// only the blocks accepted by the card are hashed
+	if (operation->data.load.hashContext != NULL) {
+		status = update_hash(operation->data.load.hashContext, operation->data.load.loadFileBuf+operation->data.load.total,
+			operation->data.load.commandTotal-operation->data.load.total);
 		if (OPGP_ERROR_CHECK(status)) {
 			goto end;
 		}
-		CHECK_SW_9000(recvBuffer, recvBufferLength, status);
+	}
+	operation->data.load.total = operation->data.load.commandTotal;
+	operation->data.load.sequenceNumber++;
 
+	if (operation->data.load.headerSent) {
 		if(callback != NULL) {
-			callbackParameters.currentWork = total;
-			callbackParameters.totalWork = loadFileBufSize;
+			INIT_PROGRESS_CALLBACK_PARAMETERS(callbackParameters, callback);
+			callbackParameters.currentWork = operation->data.load.total;
+			callbackParameters.totalWork = operation->data.load.loadFileBufSize;
 			((void(*)(OPGP_PROGRESS_CALLBACK_PARAMETERS))(callback->callback))(callbackParameters);
 		}
+		if (operation->data.load.total == operation->data.load.loadFileBufSize) {
+			if (recvBufferLength > sizeof(GP211_RECEIPT_DATA)) { // with delegated management the last LOAD response contains the load receipt
+				fillReceipt(recvBuffer, operation->data.load.receiptData);
+				*operation->data.load.receiptDataAvailable = 1;
+			}
+			if (operation->data.load.hashContext != NULL) {
+				status = final_hash(operation->data.load.hashContext, operation->data.load.hash, operation->data.load.hashLength);
+				if (OPGP_ERROR_CHECK(status)) {
+					goto end;
+				}
+			}
+			finish_operation(operation);
+			{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+		}
 	}
-	if (recvBufferLength > sizeof(GP211_RECEIPT_DATA)) { // assumption that a GP211_RECEIPT_DATA structure is returned in a delegated management deletion
-		fillReceipt(recvBuffer, receiptData);
-		*receiptDataAvailable = 1;
+	status = build_load_command(operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
 	}
 
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	if(callback != NULL) {
-		callbackParameters.currentWork = total;
-		callbackParameters.totalWork = loadFileBufSize;
-		callbackParameters.finished = OPGP_TASK_FINISHED;
-		((void(*)(OPGP_PROGRESS_CALLBACK_PARAMETERS))(callback->callback))(callbackParameters);
-	}
-	OPGP_LOG_END(_T("load_from_buffer"), status);
+	OPGP_LOG_END(_T("process_load"), status);
 	return status;
-
 }
 
 OPGP_ERROR_STATUS load(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
@@ -2152,14 +2936,55 @@ OPGP_ERROR_STATUS install_for_load(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO
 					  DWORD nonVolatileDataSpaceLimit)
 {
 	OPGP_ERROR_STATUS status;
-	DWORD sendBufferLength = 0;
-	DWORD recvBufferLength=256;
-	BYTE recvBuffer[256];
-	BYTE sendBuffer[261];
+	OPGP_OPERATION operation;
+	OPGP_LOG_START(_T("install_for_load"));
+	status = GP211_begin_install_for_load(&operation, cardInfo, secInfo,
+		executableLoadFileAID, executableLoadFileAIDLength, securityDomainAID,
+		securityDomainAIDLength, loadFileDataBlockHash, loadToken,
+		nonVolatileCodeSpaceLimit, volatileDataSpaceLimit, nonVolatileDataSpaceLimit);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = run_operation(cardContext, &operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("install_for_load"), status);
+	return status;
+}
+
+/**
+ * See GP211_install_for_load().
+ * \param *operation [out] The operation to start.
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param executableLoadFileAID [in] A buffer with AID of the Executable Load File to INSTALL [for load].
+ * \param executableLoadFileAIDLength [in] The length of the Executable Load File AID.
+ * \param securityDomainAID [in] A buffer containing the AID of the intended associated Security Domain.
+ * \param securityDomainAIDLength [in] The length of the Security Domain AID.
+ * \param loadFileDataBlockHash [in] The Load File Data Block Hash of the Executable Load File to INSTALL [for load].
+ * \param loadToken [in] The Load Token. This is a 1024 bit (=128 byte) RSA Signature.
+ * \param nonVolatileCodeSpaceLimit [in] The minimum amount of space that must be available to store the package.
+ * \param volatileDataSpaceLimit [in] The minimum amount of RAM space that must be available.
+ * \param nonVolatileDataSpaceLimit [in] The minimum amount of space for objects of the application, i.e. the data allocated in its lifetime.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_begin_install_for_load(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+					  PBYTE executableLoadFileAID, DWORD executableLoadFileAIDLength, PBYTE securityDomainAID,
+					  DWORD securityDomainAIDLength, BYTE loadFileDataBlockHash[20], BYTE loadToken[128],
+					  DWORD nonVolatileCodeSpaceLimit, DWORD volatileDataSpaceLimit,
+					  DWORD nonVolatileDataSpaceLimit)
+{
+	OPGP_ERROR_STATUS status;
+	PBYTE sendBuffer = operation->command;
 	DWORD i=0;
 	BYTE buf[256];
 	DWORD bufLength = sizeof(buf);
-	OPGP_LOG_START(_T("install_for_load"));
+	OPGP_LOG_START(_T("begin_install_for_load"));
+	init_operation(operation, OPERATION_INSTALL, cardInfo, secInfo);
 	sendBuffer[i++] = 0x80;
 	sendBuffer[i++] = 0xE6;
 	status = get_load_data(executableLoadFileAID, executableLoadFileAIDLength, securityDomainAID,
@@ -2180,17 +3005,39 @@ OPGP_ERROR_STATUS install_for_load(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO
 	}
 	sendBuffer[4] = (BYTE)i-5; // Lc
 	sendBuffer[i++] = 0x00; // Le
-	sendBufferLength = i;
+	operation->commandLength = i;
 
-	status = OPGP_send_APDU(cardContext, cardInfo, secInfo,sendBuffer, sendBufferLength, recvBuffer, &recvBufferLength);
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
 	if (OPGP_ERROR_CHECK(status)) {
-		goto end;
+		finish_operation(operation);
 	}
+	OPGP_LOG_END(_T("begin_install_for_load"), status);
+	return status;
+}
+
+/**
+ * Processes the response of an INSTALL command.
+ * \param *operation [in, out] The install operation.
+ * \param recvBuffer [in] The response APDU.
+ * \param recvBufferLength [in] The length of the response APDU.
+ * \param status [in] The status containing the status word of the response APDU.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_NO_API
+OPGP_ERROR_STATUS process_install(OPGP_OPERATION *operation, PBYTE recvBuffer, DWORD recvBufferLength, OPGP_ERROR_STATUS status) {
+	OPGP_LOG_START(_T("process_install"));
 	CHECK_SW_9000(recvBuffer, recvBufferLength, status);
+	// INSTALL [for load] does not return a receipt
+	if (operation->data.receipt.receiptData != NULL && recvBufferLength > sizeof(GP211_RECEIPT_DATA)) { // with delegated management the INSTALL response contains the install receipt
+		fillReceipt(recvBuffer, operation->data.receipt.receiptData);
+		*operation->data.receipt.receiptDataLength = 1;
+	}
+	finish_operation(operation);
 
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	OPGP_LOG_END(_T("install_for_load"), status);
+	OPGP_LOG_END(_T("process_install"), status);
 	return status;
 }
 
@@ -2218,7 +3065,7 @@ end:
  * \param installParameters [in] Applet install parameters for the install() method of the application.
  * \param installParametersLength [in] The length of the installParameters buffer.
  * \param installToken [in] The Install Token. This is a 1024 bit (=128 byte) RSA Signature.
- * \param *receiptData [out] If the deletion is performed by a security domain with delegated management privilege
+ * \param *receiptData [out] If the installation is performed by a security domain with delegated management privilege
  * this structure contains the according data.
  * \param receiptDataAvailable [out] 0 if no receiptData is available.
  * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
@@ -2250,14 +3097,66 @@ OPGP_ERROR_STATUS install_for_install(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_I
 						 PBYTE installParameters, DWORD installParametersLength,
 						 BYTE installToken[128], GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable) {
 	OPGP_ERROR_STATUS status;
-	DWORD sendBufferLength = 0;
-	DWORD recvBufferLength=256;
-	BYTE recvBuffer[256];
-	BYTE sendBuffer[261];
+	OPGP_OPERATION operation;
+	OPGP_LOG_START(_T("install_for_install"));
+	status = GP211_begin_install_for_install(&operation, cardInfo, secInfo,
+		executableLoadFileAID, executableLoadFileAIDLength, executableModuleAID,
+		executableModuleAIDLength, applicationAID, applicationAIDLength, applicationPrivileges,
+		volatileDataSpaceLimit, nonVolatileDataSpaceLimit, installParameters,
+		installParametersLength, installToken, receiptData, receiptDataAvailable);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = run_operation(cardContext, &operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("install_for_install"), status);
+	return status;
+}
+
+/**
+ * See GP211_install_for_install().
+ * \param *operation [out] The operation to start.
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param executableLoadFileAID [in] A buffer with AID of the Executable Load File to INSTALL [for install].
+ * \param executableLoadFileAIDLength [in] The length of the Executable Load File AID.
+ * \param executableModuleAID [in] The AID of the application class in the package.
+ * \param executableModuleAIDLength [in] The length of the executableModuleAID buffer.
+ * \param applicationAID [in] The AID of the installed application.
+ * \param applicationAIDLength [in] The length of the application instance AID.
+ * \param applicationPrivileges [in] The application privileges. Can be an OR of multiple privileges. See GP211_APPLICATION_PRIVILEGE_SECURITY_DOMAIN.
+ * \param volatileDataSpaceLimit [in] The minimum amount of RAM space that must be available.
+ * \param nonVolatileDataSpaceLimit [in] The minimum amount of space for objects of the application, i.e. the data allocated in its lifetime.
+ * \param installParameters [in] Applet install parameters for the install() method of the application.
+ * \param installParametersLength [in] The length of the installParameters buffer.
+ * \param installToken [in] The Install Token. This is a 1024 bit (=128 byte) RSA Signature.
+ * \param *receiptData [out] If the installation is performed by a security domain with delegated management privilege
+ * this structure contains the according data.
+ * \param receiptDataAvailable [out] 0 if no receiptData is available.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_begin_install_for_install(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						 PBYTE executableLoadFileAID, DWORD executableLoadFileAIDLength,
+						 PBYTE executableModuleAID,
+						 DWORD executableModuleAIDLength, PBYTE applicationAID,
+						 DWORD applicationAIDLength, BYTE applicationPrivileges,
+						 DWORD volatileDataSpaceLimit, DWORD nonVolatileDataSpaceLimit,
+						 PBYTE installParameters, DWORD installParametersLength,
+						 BYTE installToken[128], GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable) {
+	OPGP_ERROR_STATUS status;
+	PBYTE sendBuffer = operation->command;
 	DWORD i=0;
 	BYTE buf[256];
 	DWORD bufLength = sizeof(buf);
-	OPGP_LOG_START(_T("install_for_install"));
+	OPGP_LOG_START(_T("begin_install_for_install"));
+	init_operation(operation, OPERATION_INSTALL, cardInfo, secInfo);
+	operation->data.receipt.receiptData = receiptData;
+	operation->data.receipt.receiptDataLength = receiptDataAvailable;
 	*receiptDataAvailable = 0;
 	sendBuffer[i++] = 0x80;
 	sendBuffer[i++] = 0xE6;
@@ -2281,33 +3180,96 @@ OPGP_ERROR_STATUS install_for_install(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_I
 	}
 	sendBuffer[4] = (BYTE)i-5; // Lc
 	sendBuffer[i++] = 0x00; // Le
-	sendBufferLength = i;
+	operation->commandLength = i;
 
-	status = OPGP_send_APDU(cardContext, cardInfo, secInfo,sendBuffer, sendBufferLength, recvBuffer, &recvBufferLength);
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	if (OPGP_ERROR_CHECK(status)) {
+		finish_operation(operation);
+	}
+	OPGP_LOG_END(_T("begin_install_for_install"), status);
+	return status;
+}
+
+/**
+ * In the case of delegated management an Install Token authorizing the INSTALL [for install and make selectable] must be included.
+ * Otherwise installToken must be NULL. See GP211_calculate_install_token().
+ * volatileDataSpaceLimit and nonVolatileDataSpaceLimit can be 0, if the card does not need or support this tag.
+ * For Security domains look in your manual what parameters are necessary.
+ * If the tag for application install parameters is mandatory for your card, but you have no install parameters
+ * for the install() method of the application anyway you have to use at least a dummy parameter.
+ * If executableModuleAID is NULL and executableModuleAIDLength is 0 applicationAID is assumed for executableModuleAID.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param executableLoadFileAID [in] A buffer with AID of the Executable Load File to INSTALL [for install].
+ * \param executableLoadFileAIDLength [in] The length of the Executable Load File AID.
+ * \param executableModuleAID [in] The AID of the application class in the package.
+ * \param executableModuleAIDLength [in] The length of the executableModuleAID buffer.
+ * \param applicationAID [in] The AID of the installed application.
+ * \param applicationAIDLength [in] The length of the application instance AID.
+ * \param applicationPrivileges [in] The application privileges. Can be an OR of multiple privileges. See GP211_APPLICATION_PRIVILEGE_SECURITY_DOMAIN.
+ * \param volatileDataSpaceLimit [in] The minimum amount of RAM space that must be available.
+ * \param nonVolatileDataSpaceLimit [in] The minimum amount of space for objects of the application, i.e. the data allocated in its lifetime.
+ * \param installParameters [in] Applet install parameters for the install() method of the application.
+ * \param installParametersLength [in] The length of the installParameters buffer.
+ * \param installToken [in] The Install Token. This is a 1024 bit (=128 byte) RSA Signature.
+ * \param *receiptData [out] If the installation is performed by a security domain with delegated management privilege
+ * this structure contains the according data.
+ * \param receiptDataAvailable [out] 0 if no receiptData is available.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_install_for_install_and_make_selectable(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						 PBYTE executableLoadFileAID, DWORD executableLoadFileAIDLength, PBYTE executableModuleAID,
+						 DWORD executableModuleAIDLength, PBYTE applicationAID,
+						 DWORD applicationAIDLength, BYTE applicationPrivileges,
+						 DWORD volatileDataSpaceLimit, DWORD nonVolatileDataSpaceLimit,
+						 PBYTE installParameters, DWORD installParametersLength,
+						 BYTE installToken[128], GP211_RECEIPT_DATA *receiptData,
+						 PDWORD receiptDataAvailable) {
+	return install_for_install_and_make_selectable(cardContext, cardInfo, secInfo,
+						 executableLoadFileAID, executableLoadFileAIDLength, executableModuleAID,
+						 executableModuleAIDLength, applicationAID,
+						 applicationAIDLength, applicationPrivileges,
+						 volatileDataSpaceLimit, nonVolatileDataSpaceLimit,
+						 installParameters, installParametersLength,
+						 installToken, receiptData,
+						 receiptDataAvailable);
+}
+
+OPGP_ERROR_STATUS install_for_install_and_make_selectable(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						 PBYTE executableLoadFileAID, DWORD executableLoadFileAIDLength, PBYTE executableModuleAID,
+						 DWORD executableModuleAIDLength, PBYTE applicationAID,
+						 DWORD applicationAIDLength, BYTE applicationPrivileges,
+						 DWORD volatileDataSpaceLimit, DWORD nonVolatileDataSpaceLimit,
+						 PBYTE installParameters, DWORD installParametersLength,
+						 BYTE installToken[128], GP211_RECEIPT_DATA *receiptData,
+						 PDWORD receiptDataAvailable) {
+	OPGP_ERROR_STATUS status;
+	OPGP_OPERATION operation;
+	OPGP_LOG_START(_T("install_for_install_and_make_selectable"));
+	status = GP211_begin_install_for_install_and_make_selectable(&operation, cardInfo, secInfo,
+		executableLoadFileAID, executableLoadFileAIDLength, executableModuleAID,
+		executableModuleAIDLength, applicationAID, applicationAIDLength, applicationPrivileges,
+		volatileDataSpaceLimit, nonVolatileDataSpaceLimit, installParameters,
+		installParametersLength, installToken, receiptData, receiptDataAvailable);
 	if (OPGP_ERROR_CHECK(status)) {
 		goto end;
 	}
-	CHECK_SW_9000(recvBuffer, recvBufferLength, status);
-	if (recvBufferLength > sizeof(GP211_RECEIPT_DATA)) { // assumption that a GP211_RECEIPT_DATA structure is returned in a delegated management deletion
-		fillReceipt(recvBuffer, receiptData);
-		*receiptDataAvailable = 1;
+	status = run_operation(cardContext, &operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
 	}
 
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	OPGP_LOG_END(_T("install_for_install"), status);
+	OPGP_LOG_END(_T("install_for_install_and_make_selectable"), status);
 	return status;
 }
 
 /**
- * In the case of delegated management an Install Token authorizing the INSTALL [for install and make selectable] must be included.
- * Otherwise installToken must be NULL. See GP211_calculate_install_token().
- * volatileDataSpaceLimit and nonVolatileDataSpaceLimit can be 0, if the card does not need or support this tag.
- * For Security domains look in your manual what parameters are necessary.
- * If the tag for application install parameters is mandatory for your card, but you have no install parameters
- * for the install() method of the application anyway you have to use at least a dummy parameter.
- * If executableModuleAID is NULL and executableModuleAIDLength is 0 applicationAID is assumed for executableModuleAID.
- * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * See GP211_install_for_install_and_make_selectable().
+ * \param *operation [out] The operation to start.
  * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
  * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
  * \param executableLoadFileAID [in] A buffer with AID of the Executable Load File to INSTALL [for install].
@@ -2322,30 +3284,12 @@ end:
  * \param installParameters [in] Applet install parameters for the install() method of the application.
  * \param installParametersLength [in] The length of the installParameters buffer.
  * \param installToken [in] The Install Token. This is a 1024 bit (=128 byte) RSA Signature.
- * \param *receiptData [out] If the deletion is performed by a security domain with delegated management privilege
+ * \param *receiptData [out] If the installation is performed by a security domain with delegated management privilege
  * this structure contains the according data.
  * \param receiptDataAvailable [out] 0 if no receiptData is available.
  * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
  */
-OPGP_ERROR_STATUS GP211_install_for_install_and_make_selectable(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
-						 PBYTE executableLoadFileAID, DWORD executableLoadFileAIDLength, PBYTE executableModuleAID,
-						 DWORD executableModuleAIDLength, PBYTE applicationAID,
-						 DWORD applicationAIDLength, BYTE applicationPrivileges,
-						 DWORD volatileDataSpaceLimit, DWORD nonVolatileDataSpaceLimit,
-						 PBYTE installParameters, DWORD installParametersLength,
-						 BYTE installToken[128], GP211_RECEIPT_DATA *receiptData,
-						 PDWORD receiptDataAvailable) {
-	return install_for_install_and_make_selectable(cardContext, cardInfo, secInfo,
-						 executableLoadFileAID, executableLoadFileAIDLength, executableModuleAID,
-						 executableModuleAIDLength, applicationAID,
-						 applicationAIDLength, applicationPrivileges,
-						 volatileDataSpaceLimit, nonVolatileDataSpaceLimit,
-						 installParameters, installParametersLength,
-						 installToken, receiptData,
-						 receiptDataAvailable);
-}
-
-OPGP_ERROR_STATUS install_for_install_and_make_selectable(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+OPGP_ERROR_STATUS GP211_begin_install_for_install_and_make_selectable(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
 						 PBYTE executableLoadFileAID, DWORD executableLoadFileAIDLength, PBYTE executableModuleAID,
 						 DWORD executableModuleAIDLength, PBYTE applicationAID,
 						 DWORD applicationAIDLength, BYTE applicationPrivileges,
@@ -2354,14 +3298,14 @@ OPGP_ERROR_STATUS install_for_install_and_make_selectable(OPGP_CARD_CONTEXT card
 						 BYTE installToken[128], GP211_RECEIPT_DATA *receiptData,
 						 PDWORD receiptDataAvailable) {
 	OPGP_ERROR_STATUS status;
-	DWORD sendBufferLength=0;
-	DWORD recvBufferLength=256;
-	BYTE recvBuffer[256];
-	BYTE sendBuffer[261];
+	PBYTE sendBuffer = operation->command;
 	DWORD i=0;
 	BYTE buf[256];
 	DWORD bufLength = sizeof(buf);
-	OPGP_LOG_START(_T("install_for_install_and_make_selectable"));
+	OPGP_LOG_START(_T("begin_install_for_install_and_make_selectable"));
+	init_operation(operation, OPERATION_INSTALL, cardInfo, secInfo);
+	operation->data.receipt.receiptData = receiptData;
+	operation->data.receipt.receiptDataLength = receiptDataAvailable;
 	*receiptDataAvailable = 0;
 	sendBuffer[i++] = 0x80;
 	sendBuffer[i++] = 0xE6;
@@ -2384,24 +3328,278 @@ OPGP_ERROR_STATUS install_for_install_and_make_selectable(OPGP_CARD_CONTEXT card
 		sendBuffer[i++] = 0x00; // Length of install token
 	}
 	sendBuffer[4] = (BYTE)i-5; // Lc
-	if (memcmp(JCOP21V22_ATR, cardInfo.ATR, max(cardInfo.ATRLength, sizeof(JCOP21V22_ATR))) != 0) {
+	if (!(get_card_quirks(cardInfo.ATR, cardInfo.ATRLength) & OPGP_CARD_QUIRK_INSTALL_NO_LE)) {
 		sendBuffer[i++] = 0x00; // Le
 	}
-	sendBufferLength = i;
+	operation->commandLength = i;
 
-	status = OPGP_send_APDU(cardContext, cardInfo, secInfo,sendBuffer, sendBufferLength, recvBuffer, &recvBufferLength);
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	if (OPGP_ERROR_CHECK(status)) {
+		finish_operation(operation);
+	}
+	OPGP_LOG_END(_T("begin_install_for_install_and_make_selectable"), status);
+	return status;
+}
+
+/**
+ * Converts a big endian number of up to 4 bytes.
+ * \param buffer [in] The number.
+ * \param length [in] The length of the number.
+ * \return The number or GP211_FREE_MEMORY_UNKNOWN if it is longer than 4 bytes.
+ */
+static DWORD get_memory_size(PBYTE buffer, DWORD length) {
+	DWORD i, size = 0;
+	if (length == 0 || length > 4) {
+		return GP211_FREE_MEMORY_UNKNOWN;
+	}
+	for (i=0; i<length; i++) {
+		size = (size << 8) | buffer[i];
+	}
+	return size;
+}
+
+/**
+ * Reads a free memory data object returned by GET DATA. Some cards return the value with its tag, others the plain value.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param identifier [in] The data object.
+ * \param *freeMemory [out] The free memory or GP211_FREE_MEMORY_UNKNOWN if the card does not know the data object.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+static OPGP_ERROR_STATUS get_free_memory_data_object(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						 const BYTE identifier[2], PDWORD freeMemory) {
+	OPGP_ERROR_STATUS status;
+	BYTE recvBuffer[256];
+	DWORD recvBufferLength = sizeof(recvBuffer);
+	*freeMemory = GP211_FREE_MEMORY_UNKNOWN;
+	status = get_data(cardContext, cardInfo, secInfo, (PBYTE)identifier, recvBuffer, &recvBufferLength);
 	if (OPGP_ERROR_CHECK(status)) {
+		if ((status.errorCode & 0xFFFF0000) == OPGP_ISO7816_ERROR_PREFIX) {
+			OPGP_ERROR_CREATE_NO_ERROR(status);
+		}
+		return status;
+	}
+	if (recvBufferLength > 2 && recvBuffer[0] == identifier[1] && recvBuffer[1] == recvBufferLength - 2) {
+		*freeMemory = get_memory_size(recvBuffer+2, recvBufferLength-2);
+	}
+	else {
+		*freeMemory = get_memory_size(recvBuffer, recvBufferLength);
+	}
+	return status;
+}
+
+/**
+ * The Extended Card Resources Information of GlobalPlatform Amendment C is used if the card supports it.
+ * Otherwise the proprietary data objects #GP211_GET_DATA_FREE_EEPROM_MEMORY_SPACE and #GP211_GET_DATA_FREE_COR_RAM are read.
+ * If the card does not report a value #GP211_FREE_MEMORY_UNKNOWN is returned for it.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param *freeNonVolatileMemory [out] The free non volatile memory in bytes.
+ * \param *freeVolatileMemory [out] The free volatile memory in bytes.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_get_free_memory(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						 PDWORD freeNonVolatileMemory, PDWORD freeVolatileMemory) {
+	OPGP_ERROR_STATUS status;
+	BYTE recvBuffer[256];
+	DWORD recvBufferLength = sizeof(recvBuffer);
+	DWORD tag, valueLength, templateLength;
+	DWORD offset;
+	LONG result;
+	OPGP_LOG_START(_T("GP211_get_free_memory"));
+	*freeNonVolatileMemory = GP211_FREE_MEMORY_UNKNOWN;
+	*freeVolatileMemory = GP211_FREE_MEMORY_UNKNOWN;
+	status = get_data(cardContext, cardInfo, secInfo, (PBYTE)GP211_GET_DATA_EXTENDED_CARD_RESOURCES_INFORMATION,
+		recvBuffer, &recvBufferLength);
+	if (!OPGP_ERROR_CHECK(status)) {
+		result = read_BER_TLV_header(recvBuffer, recvBufferLength, &tag, &templateLength);
+		if (result == -1 || tag != 0xFF21) {
+			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_RESPONSE_DATA, OPGP_stringify_error(OPGP_ERROR_INVALID_RESPONSE_DATA)); goto end; }
+		}
+		offset = (DWORD)result;
+		templateLength += offset;
+		while (offset < templateLength) {
+			result = read_BER_TLV_header(recvBuffer+offset, templateLength-offset, &tag, &valueLength);
+			if (result == -1) {
+				{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_RESPONSE_DATA, OPGP_stringify_error(OPGP_ERROR_INVALID_RESPONSE_DATA)); goto end; }
+			}
+			offset += (DWORD)result;
+			if (tag == 0x82) {
+				*freeNonVolatileMemory = get_memory_size(recvBuffer+offset, valueLength);
+			}
+			else if (tag == 0x83) {
+				*freeVolatileMemory = get_memory_size(recvBuffer+offset, valueLength);
+			}
+			offset += valueLength;
+		}
+		{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+	}
+	if ((status.errorCode & 0xFFFF0000) != OPGP_ISO7816_ERROR_PREFIX) {
 		goto end;
 	}
-	CHECK_SW_9000(recvBuffer, recvBufferLength, status);
-	if (recvBufferLength > sizeof(GP211_RECEIPT_DATA)) { // assumption that a GP211_RECEIPT_DATA structure is returned in a delegated management deletion
-		fillReceipt(recvBuffer, receiptData);
-		*receiptDataAvailable = 1;
+	status = get_free_memory_data_object(cardContext, cardInfo, secInfo, GP211_GET_DATA_FREE_EEPROM_MEMORY_SPACE, freeNonVolatileMemory);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = get_free_memory_data_object(cardContext, cardInfo, secInfo, GP211_GET_DATA_FREE_COR_RAM, freeVolatileMemory);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
 	}
 
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	OPGP_LOG_END(_T("install_for_install_and_make_selectable"), status);
+	OPGP_LOG_END(_T("GP211_get_free_memory"), status);
+	return status;
+}
+
+/**
+ * Only values reported by the card are checked, if the card does not report its free memory no error is returned.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param nonVolatileMemoryRequired [in] The required non volatile memory, e.g. the Load File size and the non volatile data space limit.
+ * \param volatileMemoryRequired [in] The required volatile memory.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_check_free_memory(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						 DWORD nonVolatileMemoryRequired, DWORD volatileMemoryRequired) {
+	OPGP_ERROR_STATUS status;
+	DWORD freeNonVolatileMemory, freeVolatileMemory;
+	OPGP_LOG_START(_T("GP211_check_free_memory"));
+	status = GP211_get_free_memory(cardContext, cardInfo, secInfo, &freeNonVolatileMemory, &freeVolatileMemory);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	OPGP_LOG_MSG(_T("GP211_check_free_memory: Free non volatile memory: %lu Free volatile memory: %lu"),
+		(unsigned long)freeNonVolatileMemory, (unsigned long)freeVolatileMemory);
+	if ((freeNonVolatileMemory != GP211_FREE_MEMORY_UNKNOWN && freeNonVolatileMemory < nonVolatileMemoryRequired)
+			|| (freeVolatileMemory != GP211_FREE_MEMORY_UNKNOWN && freeVolatileMemory < volatileMemoryRequired)) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_CARD_MEMORY, OPGP_stringify_error(OPGP_ERROR_INSUFFICIENT_CARD_MEMORY)); goto end; }
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("GP211_check_free_memory"), status);
+	return status;
+}
+
+/**
+ * Executes INSTALL [for load], LOAD and INSTALL [for install and make selectable] within one card transaction.
+ * The Executable Load File is only read from the passed buffer and the Load File Data Block Hash is calculated
+ * from the same buffer. No Load File Data Block Signatures, Load Tokens or Install Tokens are used,
+ * for delegated management or DAP verification the single functions must be used.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param checkFreeMemory [in] If not 0 GP211_check_free_memory() is called first with the Load File size and the data space limits,
+ * so a full card is rejected before the Executable Load File is transferred.
+ * \param loadFileBuf [in] Buffer with the contents of the Executable Load File.
+ * \param loadFileBufSize [in] The size of loadFileBuf.
+ * \param *loadFileParams [in] The parameters of the Executable Load File returned by OPGP_read_executable_load_file_parameters_from_buffer().
+ * Can be NULL, then the parameters are read from loadFileBuf.
+ * \param securityDomainAID [in] A buffer containing the AID of the intended associated Security Domain.
+ * \param securityDomainAIDLength [in] The length of the Security Domain AID.
+ * \param loadFileDataBlockHash [out] If not NULL the Load File Data Block Hash is calculated, sent in the INSTALL [for load] command
+ * and returned. Must be NULL if the card does not support a Load File Data Block Hash in this situation.
+ * \param executableModuleAID [in] The AID of the application class in the package. If NULL the first applet of the Executable Load File is used.
+ * \param executableModuleAIDLength [in] The length of the executableModuleAID buffer.
+ * \param applicationAID [in] The AID of the installed application. If NULL the executableModuleAID is used.
+ * \param applicationAIDLength [in] The length of the application instance AID.
+ * \param applicationPrivileges [in] The application privileges. Can be an OR of multiple privileges. See GP211_APPLICATION_PRIVILEGE_SECURITY_DOMAIN.
+ * \param volatileDataSpaceLimit [in] The minimum amount of RAM space that must be available.
+ * \param nonVolatileDataSpaceLimit [in] The minimum amount of space for objects of the application, i.e. the data allocated in its lifetime.
+ * \param installParameters [in] Applet install parameters for the install() method of the application.
+ * \param installParametersLength [in] The length of the installParameters buffer.
+ * \param *loadReceiptData [out] The receipt of the LOAD if the card returns one.
+ * \param loadReceiptDataAvailable [out] 0 if no load receipt is available.
+ * \param *installReceiptData [out] The receipt of the INSTALL [for install and make selectable] if the card returns one.
+ * \param installReceiptDataAvailable [out] 0 if no install receipt is available.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_deploy(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						 BYTE checkFreeMemory, PBYTE loadFileBuf, DWORD loadFileBufSize, OPGP_LOAD_FILE_PARAMETERS *loadFileParams,
+						 PBYTE securityDomainAID, DWORD securityDomainAIDLength, BYTE loadFileDataBlockHash[20],
+						 PBYTE executableModuleAID, DWORD executableModuleAIDLength, PBYTE applicationAID,
+						 DWORD applicationAIDLength, BYTE applicationPrivileges,
+						 DWORD volatileDataSpaceLimit, DWORD nonVolatileDataSpaceLimit,
+						 PBYTE installParameters, DWORD installParametersLength,
+						 GP211_RECEIPT_DATA *loadReceiptData, PDWORD loadReceiptDataAvailable,
+						 GP211_RECEIPT_DATA *installReceiptData, PDWORD installReceiptDataAvailable) {
+	OPGP_ERROR_STATUS status;
+	OPGP_ERROR_STATUS endStatus;
+	OPGP_OPERATION operation;
+	OPGP_LOAD_FILE_PARAMETERS parsedLoadFileParams;
+	OPGP_LOG_START(_T("GP211_deploy"));
+	*loadReceiptDataAvailable = 0;
+	*installReceiptDataAvailable = 0;
+	if (loadFileParams == NULL) {
+		status = read_executable_load_file_parameters_from_buffer(loadFileBuf, loadFileBufSize, &parsedLoadFileParams);
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
+		}
+		loadFileParams = &parsedLoadFileParams;
+	}
+	if (executableModuleAID == NULL) {
+		if (loadFileParams->numAppletAIDs == 0) {
+			{ OPGP_ERROR_CREATE_ERROR(status, EINVAL, OPGP_stringify_error(EINVAL)); goto end; }
+		}
+		executableModuleAID = loadFileParams->appletAIDs[0].AID;
+		executableModuleAIDLength = loadFileParams->appletAIDs[0].AIDLength;
+	}
+	if (applicationAID == NULL) {
+		applicationAID = executableModuleAID;
+		applicationAIDLength = executableModuleAIDLength;
+	}
+	if (loadFileDataBlockHash != NULL) {
+		status = calculate_sha1_hash(loadFileBuf, loadFileBufSize, loadFileDataBlockHash);
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
+		}
+	}
+
+	status = OPGP_begin_transaction(cardContext, cardInfo);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	if (checkFreeMemory) {
+		status = GP211_check_free_memory(cardContext, cardInfo, secInfo,
+			loadFileParams->loadFileSize + nonVolatileDataSpaceLimit, volatileDataSpaceLimit);
+	}
+	if (!OPGP_ERROR_CHECK(status)) {
+		status = GP211_begin_install_for_load(&operation, cardInfo, secInfo,
+			loadFileParams->loadFileAID.AID, loadFileParams->loadFileAID.AIDLength, securityDomainAID,
+			securityDomainAIDLength, loadFileDataBlockHash, NULL, 0, 0, 0);
+	}
+	if (!OPGP_ERROR_CHECK(status)) {
+		status = run_operation(cardContext, &operation);
+	}
+	if (!OPGP_ERROR_CHECK(status)) {
+		status = GP211_begin_load_from_buffer(&operation, cardInfo, secInfo, NULL, 0, loadFileBuf, loadFileBufSize,
+			loadReceiptData, loadReceiptDataAvailable, NULL);
+	}
+	if (!OPGP_ERROR_CHECK(status)) {
+		status = run_operation(cardContext, &operation);
+	}
+	if (!OPGP_ERROR_CHECK(status)) {
+		status = GP211_begin_install_for_install_and_make_selectable(&operation, cardInfo, secInfo,
+			loadFileParams->loadFileAID.AID, loadFileParams->loadFileAID.AIDLength, executableModuleAID,
+			executableModuleAIDLength, applicationAID, applicationAIDLength, applicationPrivileges,
+			volatileDataSpaceLimit, nonVolatileDataSpaceLimit, installParameters, installParametersLength,
+			NULL, installReceiptData, installReceiptDataAvailable);
+	}
+	if (!OPGP_ERROR_CHECK(status)) {
+		status = run_operation(cardContext, &operation);
+	}
+	endStatus = OPGP_end_transaction(cardContext, cardInfo);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = endStatus;
+end:
+	OPGP_LOG_END(_T("GP211_deploy"), status);
 	return status;
 }
 
@@ -2418,7 +3616,7 @@ end:
  * \param applicationAIDLength [in] The length of the application instance AID.
 GP211_APPLICATION_PRIVILEGE_SECURITY_DOMAIN.
  * \param extraditionToken [in] The Install Token. This is a 1024 bit (=128 byte) RSA Signature.
- * \param *receiptData [out] If the deletion is performed by a security domain with delegated management privilege
+ * \param *receiptData [out] If the extradition is performed by a security domain with delegated management privilege
  * this structure contains the according data.
  * \param receiptDataAvailable [out] 0 if no receiptData is available.
  * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
@@ -2467,7 +3665,7 @@ OPGP_ERROR_STATUS GP211_install_for_extradition(OPGP_CARD_CONTEXT cardContext, O
 		goto end;
 	}
 	CHECK_SW_9000(recvBuffer, recvBufferLength, status);
-	if (recvBufferLength > sizeof(GP211_RECEIPT_DATA)) { // assumption that a GP211_RECEIPT_DATA structure is returned in a delegated management deletion
+	if (recvBufferLength > sizeof(GP211_RECEIPT_DATA)) { // with delegated management INSTALL [for extradition] returns an extradition receipt
 		fillReceipt(recvBuffer, receiptData);
 		*receiptDataAvailable = 1;
 	}
@@ -2540,7 +3738,7 @@ end:
  * \param applicationAIDLength [in] The length of the application instance AID.
  * \param applicationPrivileges [in] The application privileges. Can be an OR of multiple privileges. See GP211_APPLICATION_PRIVILEGE_SECURITY_DOMAIN.
  * \param installToken [in] The Install Token. This is a 1024 bit (=128 byte) RSA Signature.
- * \param *receiptData [out] If the deletion is performed by a security domain with delegated management privilege
+ * \param *receiptData [out] If the installation is performed by a security domain with delegated management privilege
  * this structure contains the according data.
  * \param receiptDataAvailable [out] 0 if no receiptData is available.
  * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
@@ -2597,7 +3795,7 @@ OPGP_ERROR_STATUS install_for_make_selectable(OPGP_CARD_CONTEXT cardContext, OPG
 		sendBuffer[i++] = 0x00; // Length of install token
 	}
 	sendBuffer[4] = (BYTE)i-5; // Lc
-	if (memcmp(JCOP21V22_ATR, cardInfo.ATR, max(cardInfo.ATRLength, sizeof(JCOP21V22_ATR))) != 0) {
+	if (!(get_card_quirks(cardInfo.ATR, cardInfo.ATRLength) & OPGP_CARD_QUIRK_INSTALL_NO_LE)) {
 		sendBuffer[i++] = 0x00; // Le
 	}
 	sendBufferLength = i;
@@ -2607,7 +3805,7 @@ OPGP_ERROR_STATUS install_for_make_selectable(OPGP_CARD_CONTEXT cardContext, OPG
 		goto end;
 	}
 	CHECK_SW_9000(recvBuffer, recvBufferLength, status);
-	if (recvBufferLength > sizeof(GP211_RECEIPT_DATA)) { // assumption that a GP211_RECEIPT_DATA structure is returned in a delegated management deletion
+	if (recvBufferLength > sizeof(GP211_RECEIPT_DATA)) { // with delegated management INSTALL [for make selectable] returns a receipt
 		fillReceipt(recvBuffer, receiptData);
 		*receiptDataAvailable = 1;
 	}
@@ -2929,22 +4127,29 @@ OPGP_ERROR_STATUS GP211_get_load_token_signature_data(PBYTE executableLoadFileAI
 	memcpy(loadTokenSignatureData, buf, i);
 	*loadTokenSignatureDataLength = i;
 #ifdef OPGP_DEBUG
-	OPGP_log_Msg(_T("GP211_get_load_token_signature_data: Reference control parameter P1: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_log_Msg(_T("GP211_get_load_token_signature_data: Reference control parameter P2: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_log_Msg(_T("GP211_get_load_token_signature_data: Length of the following fields: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_log_Msg(_T("GP211_get_load_token_signature_data: Load file AID length: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_LOG_HEX(_T("GP211_get_load_token_signature_data: Load file AID: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("GP211_get_load_token_signature_data: Reference control parameter P1: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("GP211_get_load_token_signature_data: Reference control parameter P2: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("GP211_get_load_token_signature_data: Length of the following fields: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("GP211_get_load_token_signature_data: Load file AID length: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_LOAD, _T("GP211_get_load_token_signature_data: Load file AID: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
 
 	j+=loadTokenSignatureData[j-1];
-	OPGP_log_Msg(_T("GP211_get_load_token_signature_data: Security Domain AID length: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_LOG_HEX(_T("GP211_get_load_token_signature_data: Security Domain AID: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("GP211_get_load_token_signature_data: Security Domain AID length: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_LOAD, _T("GP211_get_load_token_signature_data: Security Domain AID: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
 	j+=loadTokenSignatureData[j-1];
-	OPGP_log_Msg(_T("GP211_get_load_token_signature_data: Length of the Load File Data Block Hash: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_LOG_HEX(_T("GP211_get_load_token_signature_data: Load File Data Block Hash: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("GP211_get_load_token_signature_data: Length of the Load File Data Block Hash: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_LOAD, _T("GP211_get_load_token_signature_data: Load File Data Block Hash: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
 	j+=loadTokenSignatureData[j-1];
 
-	OPGP_log_Msg(_T("GP211_get_load_token_signature_data: Load parameters field length: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_LOG_HEX(_T("GP211_get_load_token_signature_data: Load parameters field: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("GP211_get_load_token_signature_data: Load parameters field length: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_LOAD, _T("GP211_get_load_token_signature_data: Load parameters field: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
 	j+=loadTokenSignatureData[j-1];
 
 #endif
@@ -3037,6 +4242,30 @@ end:
 	return status;
 }
 
+/**
+ * Calculates the Load File Data Block Hash of an Executable Load File which is already in memory, e.g. the buffer
+ * which is passed to GP211_load_from_buffer() afterwards. The file is not read again.
+ * \param loadFileBuf [in] buffer with the contents of a Executable Load File.
+ * \param loadFileBufSize [in] size of loadFileBuf.
+ * \param hashAlgorithm [in] The hash algorithm. See #GP211_HASH_ALGORITHM_SHA1 and #GP211_HASH_ALGORITHM_SHA256.
+ * \param hash [out] The hash value. Should be #GP211_MAX_HASH_LENGTH bytes long.
+ * \param hashLength [in, out] The size of the hash buffer and the length of the hash.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_calculate_load_file_data_block_hash_from_buffer(PBYTE loadFileBuf, DWORD loadFileBufSize,
+							 BYTE hashAlgorithm, PBYTE hash, PDWORD hashLength) {
+	OPGP_ERROR_STATUS status;
+	OPGP_LOG_START(_T("GP211_calculate_load_file_data_block_hash_from_buffer"));
+	status = calculate_hash(hashAlgorithm, loadFileBuf, loadFileBufSize, hash, hashLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("GP211_calculate_load_file_data_block_hash_from_buffer"), status);
+	return status;
+}
+
 /**
  * If a security domain has DAP verification privilege the security domain validates this DAP.
  * The loadFileDataBlockHash can be calculated using calculate_load_file_data_block_hash().
@@ -3302,7 +4531,7 @@ OPGP_ERROR_STATUS VISA2_derive_keys_get_data(OPGP_CARD_CONTEXT cardContext, OPGP
 
 	OPGP_LOG_START(_T("VISA2_derive_keys_get_data"));
 
-	OPGP_LOG_HEX(_T("VISA2_derive_keys_get_data: Card Manager AID: "), AID, AIDLength);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("VISA2_derive_keys_get_data: Card Manager AID: "), AID, AIDLength);
 
 	status = GP211_get_data(cardContext, cardInfo, secInfo, (PBYTE)OP201_GET_DATA_CPLC_WHOLE_CPLC,
 		cardCPLCData, &cplcDataLen);
@@ -3341,12 +4570,12 @@ end:
 OPGP_ERROR_STATUS VISA2_derive_keys(BYTE baseKeyDiversificationData[10], BYTE masterKey[16],
 							BYTE S_ENC[16], BYTE S_MAC[16], BYTE DEK[16]) {
 	OPGP_ERROR_STATUS status;
-	int outl;
 	BYTE keyDiversificationData[16];
+	BYTE keyDiversificationDataSet[3][16];
 
 	OPGP_LOG_START(_T("VISA2_derive_keys"));
 
-	OPGP_LOG_HEX(_T("VISA2_derive_keys: Base Key Diversification Data: "), baseKeyDiversificationData, 10);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("VISA2_derive_keys: Base Key Diversification Data: "), baseKeyDiversificationData, 10);
 
 	/* Key Diversification data VISA 2
 	KDCAUTH/ENC xxh xxh || IC serial number || F0h 01h ||xxh xxh || IC serial number
@@ -3371,12 +4600,9 @@ OPGP_ERROR_STATUS VISA2_derive_keys(BYTE baseKeyDiversificationData[10], BYTE ma
  	keyDiversificationData[14] = 0x0F;
  	keyDiversificationData[15] = 0x01;
 
-	OPGP_LOG_HEX(_T("VISA2_derive_keys: Key Diversification Data for ENC: "), keyDiversificationData, 16);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("VISA2_derive_keys: Key Diversification Data for ENC: "), keyDiversificationData, 16);
 
-	status = calculate_enc_ecb_two_key_triple_des(masterKey, keyDiversificationData, 16, S_ENC, &outl);
-	if (OPGP_ERROR_CHECK(status)) {
-		goto end;
-	}
+	memcpy(keyDiversificationDataSet[0], keyDiversificationData, 16);
 
 	// left for MAC
 	keyDiversificationData[6] = 0xF0;
@@ -3385,12 +4611,9 @@ OPGP_ERROR_STATUS VISA2_derive_keys(BYTE baseKeyDiversificationData[10], BYTE ma
 	keyDiversificationData[14] = 0x0F;
 	keyDiversificationData[15] = 0x02;
 
-	OPGP_LOG_HEX(_T("VISA2_derive_keys: Key Diversification Data: for MAC "), keyDiversificationData, 16);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("VISA2_derive_keys: Key Diversification Data: for MAC "), keyDiversificationData, 16);
 
-	status = calculate_enc_ecb_two_key_triple_des(masterKey, keyDiversificationData, 16, S_MAC, &outl);
-	if (OPGP_ERROR_CHECK(status)) {
-		goto end;
-	}
+	memcpy(keyDiversificationDataSet[1], keyDiversificationData, 16);
 
 	// DEK
 
@@ -3401,9 +4624,12 @@ OPGP_ERROR_STATUS VISA2_derive_keys(BYTE baseKeyDiversificationData[10], BYTE ma
 	keyDiversificationData[14] = 0x0F;
 	keyDiversificationData[15] = 0x03;
 
-	OPGP_LOG_HEX(_T("VISA2_derive_keys: Key Diversification Data for DEK: "), keyDiversificationData, 16);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("VISA2_derive_keys: Key Diversification Data for DEK: "), keyDiversificationData, 16);
 
-	status = calculate_enc_ecb_two_key_triple_des(masterKey, keyDiversificationData, 16, DEK, &outl);
+	memcpy(keyDiversificationDataSet[2], keyDiversificationData, 16);
+
+	// the three derivations are passed to the crypto provider at once
+	status = derive_static_keys(masterKey, keyDiversificationDataSet, S_ENC, S_MAC, DEK);
 	if (OPGP_ERROR_CHECK(status)) {
 		goto end;
 	}
@@ -3497,12 +4723,12 @@ end:
 OPGP_ERROR_STATUS VISA1_derive_keys(BYTE cardSerialNumber[8], BYTE masterKey[16],
 							BYTE S_ENC[16], BYTE S_MAC[16], BYTE DEK[16]) {
 	OPGP_ERROR_STATUS status;
-	int outl;
 	BYTE keyDiversificationData[16];
+	BYTE keyDiversificationDataSet[3][16];
 
 	OPGP_LOG_START(_T("VISA1_derive_keys"));
 
-	OPGP_LOG_HEX(_T("VISA1_derive_keys: Base Key Diversification Data: "), cardSerialNumber, 10);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("VISA1_derive_keys: Base Key Diversification Data: "), cardSerialNumber, 10);
 
 	/*
 	Key Diversification data VISA 1
@@ -3518,33 +4744,30 @@ OPGP_ERROR_STATUS VISA1_derive_keys(BYTE cardSerialNumber[8], BYTE masterKey[16]
  	keyDiversificationData[10] = 0x01;
 	memset(keyDiversificationData+11, 0x00, 5);
 
-	OPGP_LOG_HEX(_T("VISA1_derive_keys: Key Diversification Data for ENC: "), keyDiversificationData, 16);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("VISA1_derive_keys: Key Diversification Data for ENC: "), keyDiversificationData, 16);
 
-	status = calculate_enc_ecb_two_key_triple_des(masterKey, keyDiversificationData, 16, S_ENC, &outl);
-	if (OPGP_ERROR_CHECK(status)) {
-		goto end;
-	}
+	memcpy(keyDiversificationDataSet[0], keyDiversificationData, 16);
 
 	// MAC
 	keyDiversificationData[0] = 0x00;
 	keyDiversificationData[1] = 0x00;
  	keyDiversificationData[10] = 0x02;
 
-	OPGP_LOG_HEX(_T("VISA1_derive_keys: Key Diversification Data: for MAC "), keyDiversificationData, 16);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("VISA1_derive_keys: Key Diversification Data: for MAC "), keyDiversificationData, 16);
 
-	status = calculate_enc_ecb_two_key_triple_des(masterKey, keyDiversificationData, 16, S_MAC, &outl);
-	if (OPGP_ERROR_CHECK(status)) {
-		goto end;
-	}
+	memcpy(keyDiversificationDataSet[1], keyDiversificationData, 16);
 
 	// DEK
 	keyDiversificationData[0] = 0xF0;
 	keyDiversificationData[1] = 0xF0;
  	keyDiversificationData[10] = 0x03;
 
-	OPGP_LOG_HEX(_T("VISA1_derive_keys: Key Diversification Data for DEK: "), keyDiversificationData, 16);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("VISA1_derive_keys: Key Diversification Data for DEK: "), keyDiversificationData, 16);
+
+	memcpy(keyDiversificationDataSet[2], keyDiversificationData, 16);
 
-	status = calculate_enc_ecb_two_key_triple_des(masterKey, keyDiversificationData, 16, DEK, &outl);
+	// the three derivations are passed to the crypto provider at once
+	status = derive_static_keys(masterKey, keyDiversificationDataSet, S_ENC, S_MAC, DEK);
 	if (OPGP_ERROR_CHECK(status)) {
 		goto end;
 	}
@@ -3626,8 +4849,8 @@ end:
 OPGP_ERROR_STATUS EMV_CPS11_derive_keys(BYTE baseKeyDiversificationData[10], BYTE masterKey[16],
 							BYTE S_ENC[16], BYTE S_MAC[16], BYTE DEK[16]) {
 	OPGP_ERROR_STATUS status;
-	int outl;
 	BYTE keyDiversificationData[16];
+	BYTE keyDiversificationDataSet[3][16];
 
 	OPGP_LOG_START(_T("EMV_CPS11_derive_keys"));
 
@@ -3671,12 +4894,9 @@ OPGP_ERROR_STATUS EMV_CPS11_derive_keys(BYTE baseKeyDiversificationData[10], BYT
     keyDiversificationData[14] = 0x0F;
     keyDiversificationData[15] = 0x01;
 
-	OPGP_LOG_HEX(_T("EMV_CPS11_derive_keys: Key Diversification Data: "), keyDiversificationData, 16);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("EMV_CPS11_derive_keys: Key Diversification Data: "), keyDiversificationData, 16);
 
-	status = calculate_enc_ecb_two_key_triple_des(masterKey, keyDiversificationData, 16, S_ENC, &outl);
-	if (OPGP_ERROR_CHECK(status)) {
-		goto end;
-	}
+	memcpy(keyDiversificationDataSet[0], keyDiversificationData, 16);
 
 	// left for MAC
 	keyDiversificationData[6] = 0xF0;
@@ -3685,12 +4905,9 @@ OPGP_ERROR_STATUS EMV_CPS11_derive_keys(BYTE baseKeyDiversificationData[10], BYT
 	keyDiversificationData[14] = 0x0F;
 	keyDiversificationData[15] = 0x02;
 
-	OPGP_LOG_HEX(_T("EMV_CPS11_derive_keys: Key Diversification Data: "), keyDiversificationData, 16);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("EMV_CPS11_derive_keys: Key Diversification Data: "), keyDiversificationData, 16);
 
-	status = calculate_enc_ecb_two_key_triple_des(masterKey, keyDiversificationData, 16, S_MAC, &outl);
-	if (OPGP_ERROR_CHECK(status)) {
-		goto end;
-	}
+	memcpy(keyDiversificationDataSet[1], keyDiversificationData, 16);
 
 	// DEK
 
@@ -3701,9 +4918,12 @@ OPGP_ERROR_STATUS EMV_CPS11_derive_keys(BYTE baseKeyDiversificationData[10], BYT
 	keyDiversificationData[14] = 0x0F;
 	keyDiversificationData[15] = 0x03;
 
-	OPGP_LOG_HEX(_T("EMV_CPS11_derive_keys: Key Diversification Data: "), keyDiversificationData, 16);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("EMV_CPS11_derive_keys: Key Diversification Data: "), keyDiversificationData, 16);
 
-	status = calculate_enc_ecb_two_key_triple_des(masterKey, keyDiversificationData, 16, DEK, &outl);
+	memcpy(keyDiversificationDataSet[2], keyDiversificationData, 16);
+
+	// the three derivations are passed to the crypto provider at once
+	status = derive_static_keys(masterKey, keyDiversificationDataSet, S_ENC, S_MAC, DEK);
 	if (OPGP_ERROR_CHECK(status)) {
 		goto end;
 	}
@@ -3769,79 +4989,161 @@ OPGP_ERROR_STATUS mutual_authentication(OPGP_CARD_CONTEXT cardContext, OPGP_CARD
 						   BYTE derivationMethod,
 						   GP211_SECURITY_INFO *secInfo) {
 	OPGP_ERROR_STATUS status;
-	DWORD i=0;
-
-	BYTE hostChallenge[8];
-
-	BYTE keyDiversificationData[10];
-	BYTE keyInformationData[3]; 
-	int keyInformationDataLength;
-	BYTE sequenceCounter[3];
-	BYTE cardChallenge[8]; // only the first 6 used by SCP02
-	int cardChallengeLength;
-	BYTE cardCryptogram[8];
-
-	BYTE cardCryptogramVer[8];
-	BYTE hostCryptogram[8];
-    /* Philip Wendland: SCP03 appends the first 8 Bytes of 16 Byte CMAC output to the message, 
-	 * but the chaining value is the full 16 byte output. So 16 Bytes are needed.
-	 */
-    BYTE mac[16]; // Philip Wendland: Only the fist 8 byte used by SCP01/02
-
-	BYTE sMac[16];
-	BYTE sEnc[16];
-	BYTE dek[16];
+	OPGP_OPERATION operation;
+	OPGP_LOG_START(_T("mutual_authentication"));
+	status = GP211_begin_mutual_authentication(&operation, cardInfo, baseKey, S_ENC, S_MAC, DEK,
+		keySetVersion, keyIndex, secureChannelProtocol, secureChannelProtocolImpl, securityLevel,
+		derivationMethod, secInfo);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = run_operation(cardContext, &operation);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
 
-	DWORD sendBufferLength=256;
-	DWORD recvBufferLength=256;
-	BYTE recvBuffer[256];
-	BYTE sendBuffer[256];
-	// random for host challenge
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("mutual_authentication"), status);
+	return status;
+}
 
-	OPGP_LOG_START(_T("mutual_authentication"));
+/**
+ * The INITIALIZE UPDATE command is prepared and a new host challenge is generated.
+ * The operation does not use secure messaging. secInfo is established when the operation is finished.
+ * See GP211_mutual_authentication() for the meaning of the keys.
+ * \param *operation [out] The operation to start.
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param baseKey [in] Secure Channel base key or the master key for the key derivation.
+ * \param S_ENC [in] Secure Channel Encryption Key.
+ * \param S_MAC [in] Secure Channel Message Authentication Code Key.
+ * \param DEK [in] Data Encryption Key.
+ * \param keySetVersion [in] The key set version on the card to use for mutual authentication.
+ * \param keyIndex [in] The key index of the encryption key in the key set version on the card to use for
+ * mutual authentication.
+ * \param secureChannelProtocol [in] The Secure Channel Protocol.
+ * \param secureChannelProtocolImpl [in] The Secure Channel Protocol Implementation.
+ * \param securityLevel [in] The requested security level. See GP211_SCP01_SECURITY_LEVEL_C_DEC_C_MAC and others.
+ * \param derivationMethod [in] The derivation method to use for. See OPGP_DERIVATION_METHOD_VISA2.
+ * \param *secInfo [out] The returned GP211_SECURITY_INFO structure.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_begin_mutual_authentication(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, BYTE baseKey[16],
+						   BYTE S_ENC[16], BYTE S_MAC[16],
+						   BYTE DEK[16], BYTE keySetVersion,
+						   BYTE keyIndex, BYTE secureChannelProtocol,
+						   BYTE secureChannelProtocolImpl, BYTE securityLevel,
+						   BYTE derivationMethod,
+						   GP211_SECURITY_INFO *secInfo) {
+	OPGP_ERROR_STATUS status;
+	DWORD i=0;
+	PBYTE sendBuffer = operation->command;
+	OPGP_LOG_START(_T("begin_mutual_authentication"));
 
+	init_operation(operation, OPERATION_MUTUAL_AUTHENTICATION, cardInfo, NULL);
 	// copy keys to internal buffer
+	if (baseKey != NULL) {
+		memcpy(operation->data.mutualAuthentication.baseKey, baseKey, 16);
+	}
 	if (S_MAC != NULL) {
-		memcpy(sMac, S_MAC, 16);
+		memcpy(operation->data.mutualAuthentication.sMac, S_MAC, 16);
 	}
 	if (S_ENC != NULL) {
-		memcpy(sEnc, S_ENC, 16);
+		memcpy(operation->data.mutualAuthentication.sEnc, S_ENC, 16);
 	}
 	if (DEK != NULL) {
-		memcpy(dek, DEK, 16);
+		memcpy(operation->data.mutualAuthentication.dek, DEK, 16);
 	}
+	operation->data.mutualAuthentication.keySetVersion = keySetVersion;
+	operation->data.mutualAuthentication.keyIndex = keyIndex;
+	operation->data.mutualAuthentication.securityLevel = securityLevel;
+	operation->data.mutualAuthentication.derivationMethod = derivationMethod;
+	operation->data.mutualAuthentication.secInfo = secInfo;
 
 	secInfo->secureChannelProtocol = secureChannelProtocol;
 	secInfo->secureChannelProtocolImpl = secureChannelProtocolImpl;
 
 #ifdef OPGP_DEBUG
-	OPGP_log_Msg(_T("mutual_authentication: Secure Channel Protocol: 0x%02X"), secureChannelProtocol);
-	OPGP_log_Msg(_T("mutual_authentication: Secure Channel Protocol Implementation: 0x%02X"), secureChannelProtocolImpl);
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("begin_mutual_authentication: Secure Channel Protocol: 0x%02X"), secureChannelProtocol);
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("begin_mutual_authentication: Secure Channel Protocol Implementation: 0x%02X"), secureChannelProtocolImpl);
 #endif
 
-	status = get_random(hostChallenge, 8);
+	// random for host challenge
+	status = get_pooled_random(operation->data.mutualAuthentication.hostChallenge, 8);
 	if (OPGP_ERROR_CHECK(status)) {
 		goto end;
 	}
 
-	OPGP_LOG_HEX(_T("mutual_authentication: Generated Host Challenge: "), hostChallenge, 8);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("begin_mutual_authentication: Generated Host Challenge: "), operation->data.mutualAuthentication.hostChallenge, 8);
 
 	// INITIALIZE UPDATE
-	i=0;
-	sendBufferLength = 14;
 	sendBuffer[i++] = 0x80;
 	sendBuffer[i++] = 0x50;
 	sendBuffer[i++] = keySetVersion;
 	sendBuffer[i++] = keyIndex;
 	sendBuffer[i++] = 0x08;
-	memcpy(sendBuffer+i, hostChallenge, 8);
+	memcpy(sendBuffer+i, operation->data.mutualAuthentication.hostChallenge, 8);
 	i+=8;
-	sendBuffer[i] = 0x00;
+	sendBuffer[i++] = 0x00;
+	operation->commandLength = i;
 
-	status = OPGP_send_APDU(cardContext, cardInfo, NULL, sendBuffer, sendBufferLength, recvBuffer, &recvBufferLength);
-	if ( OPGP_ERROR_CHECK(status)) {
-		goto end;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	if (OPGP_ERROR_CHECK(status)) {
+		finish_operation(operation);
 	}
+	OPGP_LOG_END(_T("begin_mutual_authentication"), status);
+	return status;
+}
+
+/**
+ * Processes the response of the INITIALIZE UPDATE command. The session keys are derived, the card cryptogram is
+ * verified and the EXTERNAL AUTHENTICATE command is prepared.
+ * \param *operation [in, out] The mutual authentication operation.
+ * \param recvBuffer [in] The response APDU.
+ * \param recvBufferLength [in] The length of the response APDU.
+ * \param status [in] The status containing the status word of the response APDU.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_NO_API
+OPGP_ERROR_STATUS process_initialize_update(OPGP_OPERATION *operation, PBYTE recvBuffer, DWORD recvBufferLength, OPGP_ERROR_STATUS status) {
+	DWORD i=0;
+
+	GP211_SECURITY_INFO *secInfo = operation->data.mutualAuthentication.secInfo;
+	PBYTE hostChallenge = operation->data.mutualAuthentication.hostChallenge;
+	PBYTE baseKey = operation->data.mutualAuthentication.baseKey;
+	PBYTE sMac = operation->data.mutualAuthentication.sMac;
+	PBYTE sEnc = operation->data.mutualAuthentication.sEnc;
+	PBYTE dek = operation->data.mutualAuthentication.dek;
+	BYTE derivationMethod = operation->data.mutualAuthentication.derivationMethod;
+	BYTE securityLevel = operation->data.mutualAuthentication.securityLevel;
+
+	BYTE keyDiversificationData[10];
+	BYTE keyInformationData[3];
+	int keyInformationDataLength;
+	BYTE sequenceCounter[3];
+	BYTE cardChallenge[8]; // only the first 6 used by SCP02
+	int cardChallengeLength;
+	BYTE cardCryptogram[8];
+	OPGP_CRYPTO_REQUEST sessionKeyRequests[2];
+	DWORD sessionKeyRequestsLength = 0;
+	BYTE derivationData[2][32];
+	OPGP_CRYPTO_REQUEST *pendingRequests = operation->data.mutualAuthentication.pendingRequests;
+	DWORD pendingRequestsLength = 0;
+	BYTE (*pendingDerivationData)[32] = operation->data.mutualAuthentication.pendingDerivationData;
+
+	BYTE cardCryptogramVer[8];
+	BYTE hostCryptogram[8];
+    /* Philip Wendland: SCP03 appends the first 8 Bytes of 16 Byte CMAC output to the message,
+	 * but the chaining value is the full 16 byte output. So 16 Bytes are needed.
+	 */
+    BYTE mac[16]; // Philip Wendland: Only the fist 8 byte used by SCP01/02
+
+	DWORD sendBufferLength;
+	PBYTE sendBuffer = operation->command;
+
+	OPGP_LOG_START(_T("process_initialize_update"));
+
 	CHECK_SW_9000(recvBuffer, recvBufferLength, status);
 
 	// check receive buffer length, including SW it must be 30 bytes
@@ -3861,16 +5163,16 @@ OPGP_ERROR_STATUS mutual_authentication(OPGP_CARD_CONTEXT cardContext, OPGP_CARD
 	memcpy(keyInformationData, recvBuffer+10, 3); // Copy the 3rd byte regardless - ignored for SCP01/SCP02
 
 	// test if reported SCP is consistent with passed SCP
-	if (cardInfo.specVersion == GP_211) {
-		if (secureChannelProtocol != keyInformationData[1]) {
+	if (operation->cardInfo.specVersion == GP_211) {
+		if (secInfo->secureChannelProtocol != keyInformationData[1]) {
 			OPGP_ERROR_CREATE_ERROR(status, GP211_ERROR_INCONSISTENT_SCP, OPGP_stringify_error(GP211_ERROR_INCONSISTENT_SCP));
 			goto end;
 		}
 	}
-	
+
 	secInfo->keySetVersion = keyInformationData[0];
 	// the key index is only reported in OP201
-	if (cardInfo.specVersion == OP_201) {
+	if (operation->cardInfo.specVersion == OP_201) {
 		secInfo->keyIndex = keyInformationData[1];
 	}
 	else {
@@ -3905,20 +5207,20 @@ OPGP_ERROR_STATUS mutual_authentication(OPGP_CARD_CONTEXT cardContext, OPGP_CARD
 	}
 
 #ifdef OPGP_DEBUG
-	OPGP_LOG_HEX(_T("mutual_authentication: Key Diversification Data: "), keyDiversificationData, 10);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: Key Diversification Data: "), keyDiversificationData, 10);
 
-	OPGP_LOG_HEX(_T("mutual_authentication: Key Information Data: "), keyInformationData, keyInformationDataLength);
-	OPGP_LOG_HEX(_T("mutual_authentication: Card Challenge: "), cardChallenge, cardChallengeLength);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: Key Information Data: "), keyInformationData, keyInformationDataLength);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: Card Challenge: "), cardChallenge, cardChallengeLength);
 
 	if (secInfo->secureChannelProtocol == GP211_SCP02) {
-		OPGP_LOG_HEX(_T("mutual_authentication: Sequence Counter: "), sequenceCounter, 2);
+		OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: Sequence Counter: "), sequenceCounter, 2);
 	}
 	// only present when pseudo-random challenge generation is used
 	if (secInfo->secureChannelProtocol == GP211_SCP03 && recvBufferLength == 34) {
-		OPGP_LOG_HEX(_T("mutual_authentication: Sequence Counter: "), sequenceCounter, 3);
+		OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: Sequence Counter: "), sequenceCounter, 3);
 	}
 
-	OPGP_LOG_HEX(_T("mutual_authentication: Retrieved Card Cryptogram: "), cardCryptogram, 8);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: Retrieved Card Cryptogram: "), cardCryptogram, 8);
 
 #endif
 
@@ -3936,17 +5238,16 @@ OPGP_ERROR_STATUS mutual_authentication(OPGP_CARD_CONTEXT cardContext, OPGP_CARD
 		}
 	}
 
+	// the previous session of the security information ends, its cached CMAC state is released
+	release_CMAC_key_states(secInfo->C_MACSessionKey);
 	if (secInfo->secureChannelProtocol == GP211_SCP03) {
 		// TODO: add other parameters of table 5-1 for "i"
 		if (secInfo->secureChannelProtocolImpl == GP211_SCP03_IMPL_i00) {
-			status = create_session_key_SCP03(sEnc, S_ENC_DerivationConstant_SCP03, cardChallenge, hostChallenge, secInfo->encryptionSessionKey);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
-			status = create_session_key_SCP03(sMac, S_MAC_DerivationConstant_SCP03, cardChallenge, hostChallenge, secInfo->C_MACSessionKey);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
+			prepare_session_key_request_SCP03(&sessionKeyRequests[0], sMac, S_MAC_DerivationConstant_SCP03, cardChallenge, hostChallenge, derivationData[0], secInfo->C_MACSessionKey);
+			sessionKeyRequestsLength = 1;
+			// the encryption session key is not needed for the cryptograms
+			prepare_session_key_request_SCP03(&pendingRequests[0], sEnc, S_ENC_DerivationConstant_SCP03, cardChallenge, hostChallenge, pendingDerivationData[0], secInfo->encryptionSessionKey);
+			pendingRequestsLength = 1;
 			memcpy(secInfo->dataEncryptionSessionKey, sEnc, 16);
 		}
 		else {
@@ -3961,28 +5262,19 @@ OPGP_ERROR_STATUS mutual_authentication(OPGP_CARD_CONTEXT cardContext, OPGP_CARD
 			|| secInfo->secureChannelProtocolImpl == GP211_SCP02_IMPL_i44
 			|| secInfo->secureChannelProtocolImpl == GP211_SCP02_IMPL_i54) {
 			// calculation of encryption session key
-			status = create_session_key_SCP02(baseKey, ENCDerivationConstant, sequenceCounter, secInfo->encryptionSessionKey);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
+			prepare_session_key_request_SCP02(&sessionKeyRequests[0], baseKey, ENCDerivationConstant, sequenceCounter, derivationData[0], secInfo->encryptionSessionKey);
 
 			// calculation of C-MAC session key
-			status = create_session_key_SCP02(baseKey, C_MACDerivationConstant, sequenceCounter, secInfo->C_MACSessionKey);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
+			prepare_session_key_request_SCP02(&sessionKeyRequests[1], baseKey, C_MACDerivationConstant, sequenceCounter, derivationData[1], secInfo->C_MACSessionKey);
+
+			sessionKeyRequestsLength = 2;
 
 			// calculation of R-MAC session key
-			status = create_session_key_SCP02(baseKey, R_MACDerivationConstant, sequenceCounter, secInfo->R_MACSessionKey);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
+			prepare_session_key_request_SCP02(&pendingRequests[0], baseKey, R_MACDerivationConstant, sequenceCounter, pendingDerivationData[0], secInfo->R_MACSessionKey);
 
 			// calculation of data encryption session key
-			status = create_session_key_SCP02(baseKey, DEKDerivationConstant, sequenceCounter, secInfo->dataEncryptionSessionKey);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
+			prepare_session_key_request_SCP02(&pendingRequests[1], baseKey, DEKDerivationConstant, sequenceCounter, pendingDerivationData[1], secInfo->dataEncryptionSessionKey);
+			pendingRequestsLength = 2;
 
 		}
 		/* 3 Secure Channel Keys */
@@ -3991,28 +5283,19 @@ OPGP_ERROR_STATUS mutual_authentication(OPGP_CARD_CONTEXT cardContext, OPGP_CARD
 			|| secInfo->secureChannelProtocolImpl == GP211_SCP02_IMPL_i55
 			|| secInfo->secureChannelProtocolImpl == GP211_SCP02_IMPL_i45) {
 			// calculation of encryption session key
-			status = create_session_key_SCP02(sEnc, ENCDerivationConstant, sequenceCounter, secInfo->encryptionSessionKey);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
+			prepare_session_key_request_SCP02(&sessionKeyRequests[0], sEnc, ENCDerivationConstant, sequenceCounter, derivationData[0], secInfo->encryptionSessionKey);
 
 			// calculation of C-MAC session key
-			status = create_session_key_SCP02(sMac, C_MACDerivationConstant, sequenceCounter, secInfo->C_MACSessionKey);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
+			prepare_session_key_request_SCP02(&sessionKeyRequests[1], sMac, C_MACDerivationConstant, sequenceCounter, derivationData[1], secInfo->C_MACSessionKey);
+
+			sessionKeyRequestsLength = 2;
 
 			// calculation of R-MAC session key
-			status = create_session_key_SCP02(sMac, R_MACDerivationConstant, sequenceCounter, secInfo->R_MACSessionKey);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
+			prepare_session_key_request_SCP02(&pendingRequests[0], sMac, R_MACDerivationConstant, sequenceCounter, pendingDerivationData[0], secInfo->R_MACSessionKey);
 
 			// calculation of data encryption session key
-			status = create_session_key_SCP02(dek, DEKDerivationConstant, sequenceCounter, secInfo->dataEncryptionSessionKey);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
+			prepare_session_key_request_SCP02(&pendingRequests[1], dek, DEKDerivationConstant, sequenceCounter, pendingDerivationData[1], secInfo->dataEncryptionSessionKey);
+			pendingRequestsLength = 2;
 		}
 		else {
 			OPGP_ERROR_CREATE_ERROR(status, GP211_ERROR_INVALID_SCP_IMPL, OPGP_stringify_error(GP211_ERROR_INVALID_SCP_IMPL));
@@ -4023,18 +5306,13 @@ OPGP_ERROR_STATUS mutual_authentication(OPGP_CARD_CONTEXT cardContext, OPGP_CARD
 		if (secInfo->secureChannelProtocolImpl == GP211_SCP01_IMPL_i05
 			|| secInfo->secureChannelProtocolImpl == GP211_SCP01_IMPL_i15) {
 			// calculation of ENC session key
-			status = create_session_key_SCP01(sEnc, cardChallenge, hostChallenge, secInfo->encryptionSessionKey);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
+			prepare_session_key_request_SCP01(&sessionKeyRequests[0], sEnc, cardChallenge, hostChallenge, derivationData[0], secInfo->encryptionSessionKey);
 
 			// calculation of MAC session key
-			status = create_session_key_SCP01(sMac, cardChallenge, hostChallenge, secInfo->C_MACSessionKey);
-			if (OPGP_ERROR_CHECK(status)) {
-				goto end;
-			}
+			prepare_session_key_request_SCP01(&sessionKeyRequests[1], sMac, cardChallenge, hostChallenge, derivationData[1], secInfo->C_MACSessionKey);
+			sessionKeyRequestsLength = 2;
 
-			// DEK
+			// DEK, the static key is used
 			memcpy(secInfo->dataEncryptionSessionKey, dek, 16);
 		}
 		else {
@@ -4047,18 +5325,34 @@ OPGP_ERROR_STATUS mutual_authentication(OPGP_CARD_CONTEXT cardContext, OPGP_CARD
 		goto end;
 	}
 
+	/*
+	 * The session keys for the cryptograms and the EXTERNAL AUTHENTICATE C-MAC are needed now. The other session keys
+	 * are only needed after EXTERNAL AUTHENTICATE, so an asynchronous crypto provider derives them while the card
+	 * processes the command. They are waited for in process_external_authenticate().
+	 */
+	status = OPGP_crypto_submit(sessionKeyRequests, sessionKeyRequestsLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = OPGP_crypto_submit(pendingRequests, pendingRequestsLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		OPGP_crypto_wait(sessionKeyRequests, sessionKeyRequestsLength);
+		goto end;
+	}
+	operation->data.mutualAuthentication.pendingRequestsLength = pendingRequestsLength;
+	status = OPGP_crypto_wait(sessionKeyRequests, sessionKeyRequestsLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+
 #ifdef OPGP_DEBUG
-	OPGP_LOG_HEX(_T("mutual_authentication: S-ENC Session Key: "), secInfo->encryptionSessionKey, 16);
-	OPGP_LOG_HEX(_T("mutual_authentication: S-MAC Session Key: "), secInfo->C_MACSessionKey, 16);
+	if (secInfo->secureChannelProtocol != GP211_SCP03) {
+		OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: S-ENC Session Key: "), secInfo->encryptionSessionKey, 16);
+	}
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: S-MAC Session Key: "), secInfo->C_MACSessionKey, 16);
 
 	if (secInfo->secureChannelProtocol == GP211_SCP01) {
-		OPGP_LOG_HEX(_T("mutual_authentication: Data Encryption Key: "), secInfo->dataEncryptionSessionKey, 16);
-	}
-	if (secInfo->secureChannelProtocol == GP211_SCP02) {
-		OPGP_LOG_HEX(_T("mutual_authentication: R-MAC Session Key: "), secInfo->R_MACSessionKey, 16);
-	}
-	if (secInfo->secureChannelProtocol == GP211_SCP02) {
-		OPGP_LOG_HEX(_T("mutual_authentication: DEK Session Key: "), secInfo->dataEncryptionSessionKey, 16);
+		OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: Data Encryption Key: "), secInfo->dataEncryptionSessionKey, 16);
 	}
 #endif
 
@@ -4085,7 +5379,7 @@ OPGP_ERROR_STATUS mutual_authentication(OPGP_CARD_CONTEXT cardContext, OPGP_CARD
 		}
 	}
 
-	OPGP_LOG_HEX(_T("mutual_authentication: Card Cryptogram to compare: "), cardCryptogramVer, 8);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: Card Cryptogram to compare: "), cardCryptogramVer, 8);
 
 	if (memcmp(cardCryptogram, cardCryptogramVer, 8) != 0) {
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_CARD_CRYPTOGRAM_VERIFICATION, OPGP_stringify_error(OPGP_ERROR_CARD_CRYPTOGRAM_VERIFICATION)); goto end; }
@@ -4097,8 +5391,8 @@ OPGP_ERROR_STATUS mutual_authentication(OPGP_CARD_CONTEXT cardContext, OPGP_CARD
 		/*
 		 * Philip Wendland: SCP03 uses the S-MAC session key, not the S-ENC key for host cryptogram generation.
 		 */
-		calculate_host_cryptogram_SCP03(secInfo->C_MACSessionKey, cardChallenge, hostChallenge, 
-			hostCryptogram);	
+		calculate_host_cryptogram_SCP03(secInfo->C_MACSessionKey, cardChallenge, hostChallenge,
+			hostCryptogram);
 	}
 	else if (secInfo->secureChannelProtocol == GP211_SCP02) {
 		calculate_host_cryptogram_SCP02(secInfo->encryptionSessionKey, sequenceCounter,
@@ -4118,10 +5412,10 @@ OPGP_ERROR_STATUS mutual_authentication(OPGP_CARD_CONTEXT cardContext, OPGP_CARD
 	sendBuffer[i++] = 0x10;
 	memcpy(sendBuffer+i, hostCryptogram, 8);
 	i+=8;
- 
+
 	if (secInfo->secureChannelProtocol == GP211_SCP03) {
         // Philip Wendland: the MAC chaning value of EXTERNAL AUTHENTICATE is the initial chaining vector (16 Bytes '00')
-	    status = calculate_CMAC_aes(secInfo->C_MACSessionKey, sendBuffer, sendBufferLength-8, (PBYTE)SCP03_icv, mac);
+	    status = calculate_CMAC_aes_with_state(secInfo->C_MACSessionKey, sendBuffer, sendBufferLength-8, (PBYTE)SCP03_icv, mac);
 	    if (OPGP_ERROR_CHECK(status)) {
 	        goto end;
 	    }
@@ -4146,20 +5440,255 @@ OPGP_ERROR_STATUS mutual_authentication(OPGP_CARD_CONTEXT cardContext, OPGP_CARD
     // Philip Wendland: Moved secInfo update to if clause above as other lengths are used for SCP03.
 	memcpy(sendBuffer+i, mac, 8);
 	i+=8;
+	operation->commandLength = sendBufferLength;
+	operation->step++;
 
-	status = OPGP_send_APDU(cardContext, cardInfo, NULL, sendBuffer, sendBufferLength, recvBuffer, &recvBufferLength);
-	if ( OPGP_ERROR_CHECK(status)) {
-		goto end;
-	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	// the requests contain copies of the static keys
+	OPENSSL_cleanse(sessionKeyRequests, sizeof(sessionKeyRequests));
+	OPGP_LOG_END(_T("process_initialize_update"), status);
+	return status;
+}
+
+/**
+ * Processes the response of the EXTERNAL AUTHENTICATE command.
+ * \param *operation [in, out] The mutual authentication operation.
+ * \param recvBuffer [in] The response APDU.
+ * \param recvBufferLength [in] The length of the response APDU.
+ * \param status [in] The status containing the status word of the response APDU.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_NO_API
+OPGP_ERROR_STATUS process_external_authenticate(OPGP_OPERATION *operation, PBYTE recvBuffer, DWORD recvBufferLength, OPGP_ERROR_STATUS status) {
+	GP211_SECURITY_INFO *secInfo = operation->data.mutualAuthentication.secInfo;
+	OPGP_LOG_START(_T("process_external_authenticate"));
 	switch (status.errorCode) {
 		case OPGP_ISO7816_ERROR_6300:
 			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ISO7816_ERROR_HOST_CRYPTOGRAM_VERIFICATION, OPGP_stringify_error(OPGP_ISO7816_ERROR_HOST_CRYPTOGRAM_VERIFICATION)); goto end; }
 	}
 	CHECK_SW_9000(recvBuffer, recvBufferLength, status);
+	// session keys submitted at the INITIALIZE UPDATE response
+	status = OPGP_crypto_wait(operation->data.mutualAuthentication.pendingRequests,
+		operation->data.mutualAuthentication.pendingRequestsLength);
+	operation->data.mutualAuthentication.pendingRequestsLength = 0;
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+#ifdef OPGP_DEBUG
+	if (secInfo->secureChannelProtocol == GP211_SCP03) {
+		OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: S-ENC Session Key: "), secInfo->encryptionSessionKey, 16);
+	}
+	if (secInfo->secureChannelProtocol == GP211_SCP02) {
+		OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: R-MAC Session Key: "), secInfo->R_MACSessionKey, 16);
+		OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_CRYPTO, _T("mutual_authentication: DEK Session Key: "), secInfo->dataEncryptionSessionKey, 16);
+	}
+#endif
+	finish_operation(operation);
 
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
 end:
-	OPGP_LOG_END(_T("mutual_authentication"), status);
+	OPGP_LOG_END(_T("process_external_authenticate"), status);
+	return status;
+}
+
+/**
+ * Processes a response of a resumable operation and prepares the next command.
+ * If an error occurs the operation is finished.
+ * \param *operation [in, out] The operation.
+ * \param recvBuffer [in] The response APDU.
+ * \param recvBufferLength [in] The length of the response APDU.
+ * \param status [in] The status containing the status word of the response APDU.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_NO_API
+OPGP_ERROR_STATUS process_operation(OPGP_OPERATION *operation, PBYTE recvBuffer, DWORD recvBufferLength, OPGP_ERROR_STATUS status) {
+	switch (operation->type) {
+		case OPERATION_MUTUAL_AUTHENTICATION:
+			if (operation->step == 0) {
+				status = process_initialize_update(operation, recvBuffer, recvBufferLength, status);
+			}
+			else {
+				status = process_external_authenticate(operation, recvBuffer, recvBufferLength, status);
+			}
+			break;
+		case OPERATION_GET_STATUS:
+			status = process_get_status(operation, recvBuffer, recvBufferLength, status);
+			break;
+		case OPERATION_LOAD:
+			status = process_load(operation, recvBuffer, recvBufferLength, status);
+			break;
+		case OPERATION_DELETE:
+			status = process_delete(operation, recvBuffer, recvBufferLength, status);
+			break;
+		default:
+			status = process_install(operation, recvBuffer, recvBufferLength, status);
+	}
+	if (OPGP_ERROR_CHECK(status)) {
+		finish_operation(operation);
+	}
+	return status;
+}
+
+/**
+ * Executes a resumable operation synchronously by sending all commands with OPGP_send_APDU().
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param *operation [in, out] The operation to execute.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS run_operation(OPGP_CARD_CONTEXT cardContext, OPGP_OPERATION *operation) {
+	OPGP_ERROR_STATUS status;
+	DWORD recvBufferLength;
+	BYTE recvBuffer[258];
+	OPGP_LOG_START(_T("run_operation"));
+	while (operation->finished != OPGP_OPERATION_FINISHED) {
+		recvBufferLength = sizeof(recvBuffer);
+		status = OPGP_send_APDU(cardContext, operation->cardInfo, operation->secInfo, operation->command, operation->commandLength, recvBuffer, &recvBufferLength);
+		if (OPGP_ERROR_CHECK(status)) {
+			finish_operation(operation);
+			goto end;
+		}
+		status = process_operation(operation, recvBuffer, recvBufferLength, status);
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
+		}
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("run_operation"), status);
+	return status;
+}
+
+/**
+ * In each round one command of every unfinished operation is sent, so independent operations on different
+ * Logical Channels progress together. All commands are sent within one card transaction.
+ * A failing operation is finished and does not stop the others.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param *operations [in, out] The operations started with the GP211_begin_* functions. Each uses the card information
+ * and security information passed at its start, e.g. of an OPGP_LOGICAL_CHANNEL.
+ * \param operationsLength [in] The number of operations.
+ * \param *results [out] The result of each operation. Can be NULL.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message of the first failed operation are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_run_operations(OPGP_CARD_CONTEXT cardContext, OPGP_OPERATION *operations, DWORD operationsLength,
+						OPGP_ERROR_STATUS *results) {
+	OPGP_ERROR_STATUS status;
+	OPGP_ERROR_STATUS operationStatus;
+	OPGP_ERROR_STATUS failedStatus;
+	DWORD recvBufferLength;
+	BYTE recvBuffer[258];
+	DWORD i, pending;
+	OPGP_LOG_START(_T("OPGP_run_operations"));
+	OPGP_ERROR_CREATE_NO_ERROR(failedStatus);
+	if (operationsLength == 0) {
+		{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+	}
+	for (i=0; i<operationsLength; i++) {
+		if (results != NULL) {
+			OPGP_ERROR_CREATE_NO_ERROR(results[i]);
+		}
+	}
+	status = OPGP_begin_transaction(cardContext, operations[0].cardInfo);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	do {
+		pending = 0;
+		for (i=0; i<operationsLength; i++) {
+			if (operations[i].finished == OPGP_OPERATION_FINISHED) {
+				continue;
+			}
+			recvBufferLength = sizeof(recvBuffer);
+			operationStatus = OPGP_send_APDU(cardContext, operations[i].cardInfo, operations[i].secInfo,
+				operations[i].command, operations[i].commandLength, recvBuffer, &recvBufferLength);
+			if (OPGP_ERROR_CHECK(operationStatus)) {
+				finish_operation(operations + i);
+			}
+			else {
+				operationStatus = process_operation(operations + i, recvBuffer, recvBufferLength, operationStatus);
+			}
+			if (OPGP_ERROR_CHECK(operationStatus)) {
+				if (results != NULL) {
+					results[i] = operationStatus;
+				}
+				if (!OPGP_ERROR_CHECK(failedStatus)) {
+					failedStatus = operationStatus;
+				}
+			}
+			if (operations[i].finished != OPGP_OPERATION_FINISHED) {
+				pending++;
+			}
+		}
+	} while (pending > 0);
+	status = OPGP_end_transaction(cardContext, operations[0].cardInfo);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = failedStatus;
+end:
+	OPGP_LOG_END(_T("OPGP_run_operations"), status);
+	return status;
+}
+
+/**
+ * The command is already wrapped for the secure channel and contains the logical channel of the card.
+ * This function must be called exactly once for each command, because the MAC chaining value in the secure channel is updated.
+ * \param *operation [in, out] The operation started with one of the GP211_begin_* functions.
+ * \param capdu [out] The command APDU to transmit. The buffer should be 261 bytes long.
+ * \param capduLength [in, out] The size of capdu and the length of the command APDU.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_operation_get_command(OPGP_OPERATION *operation, PBYTE capdu, PDWORD capduLength) {
+	OPGP_ERROR_STATUS status;
+	OPGP_LOG_START(_T("OPGP_operation_get_command"));
+	if (operation->finished == OPGP_OPERATION_FINISHED) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_OPERATION_FINISHED, OPGP_stringify_error(OPGP_ERROR_OPERATION_FINISHED)); goto end; }
+	}
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_TRANSPORT, _T("OPGP_operation_get_command: Command --> "), operation->command, operation->commandLength);
+	status = wrap_command(operation->command, operation->commandLength, capdu, capduLength, operation->secInfo);
+	if (OPGP_ERROR_CHECK(status)) {
+		finish_operation(operation);
+		goto end;
+	}
+	capdu[0] |= operation->cardInfo.logicalChannel;
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("OPGP_operation_get_command"), status);
+	return status;
+}
+
+/**
+ * The response APDU must be complete, i.e. a 61xx or 6Cxx status word must have already been handled by the transport.
+ * If an error is returned the operation is finished. The operation is also finished if the last response was processed.
+ * \param *operation [in, out] The operation started with one of the GP211_begin_* functions.
+ * \param rapdu [in] The response APDU of the command returned by OPGP_operation_get_command().
+ * \param rapduLength [in] The length of the response APDU.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_operation_process_response(OPGP_OPERATION *operation, PBYTE rapdu, DWORD rapduLength) {
+	OPGP_ERROR_STATUS status;
+	DWORD sw;
+	OPGP_LOG_START(_T("OPGP_operation_process_response"));
+	if (operation->finished == OPGP_OPERATION_FINISHED) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_OPERATION_FINISHED, OPGP_stringify_error(OPGP_ERROR_OPERATION_FINISHED)); goto end; }
+	}
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_TRANSPORT, _T("OPGP_operation_process_response: Response <-- "), rapdu, rapduLength);
+	if (rapduLength < 2) {
+		finish_operation(operation);
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_RESPONSE_DATA, OPGP_stringify_error(OPGP_ERROR_INVALID_RESPONSE_DATA)); goto end; }
+	}
+	status = GP211_check_R_MAC(operation->command, operation->commandLength, rapdu, rapduLength, operation->secInfo);
+	if (OPGP_ERROR_CHECK(status)) {
+		finish_operation(operation);
+		goto end;
+	}
+	sw = (rapdu[rapduLength-2] << 8) | rapdu[rapduLength-1];
+	OPGP_ERROR_CREATE_NO_ERROR_WITH_CODE(status, OPGP_ISO7816_ERROR_PREFIX | sw, OPGP_stringify_error(OPGP_ISO7816_ERROR_PREFIX | sw));
+	status = process_operation(operation, rapdu, rapduLength, status);
+end:
+	OPGP_LOG_END(_T("OPGP_operation_process_response"), status);
 	return status;
 }
 
@@ -4211,13 +5740,13 @@ OPGP_ERROR_STATUS GP211_init_implicit_secure_channel(PBYTE AID, DWORD AIDLength,
 		}
 
 		// calculation of R-MAC session key
-		status = create_session_key_SCP02(baseKey, R_MACDerivationConstant, sequenceCounter, secInfo->C_MACSessionKey);
+		status = create_session_key_SCP02(baseKey, R_MACDerivationConstant, sequenceCounter, secInfo->R_MACSessionKey);
 		if (OPGP_ERROR_CHECK(status)) {
 			goto end;
 		}
 
 		// calculation of data encryption session key
-		status = create_session_key_SCP02(baseKey, DEKDerivationConstant, sequenceCounter, secInfo->C_MACSessionKey);
+		status = create_session_key_SCP02(baseKey, DEKDerivationConstant, sequenceCounter, secInfo->dataEncryptionSessionKey);
 		if (OPGP_ERROR_CHECK(status)) {
 			goto end;
 		}
@@ -4355,7 +5884,10 @@ OPGP_ERROR_STATUS pin_change(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardI
 			PINFormat[1+j/2] |= (0x0f) << 4*(1-j%2);
 		}
 		PINFormat[7] = 0xFF;
-		calculate_enc_ecb_two_key_triple_des(secInfo->dataEncryptionSessionKey, PINFormat, 8, encryption, &encryptionLength);
+		status = calculate_enc_ecb_DEK(secInfo, PINFormat, 8, encryption, &encryptionLength);
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
+		}
 		memcpy(sendBuffer+i, encryption, 8);
 		i+=8;
 	}
@@ -4451,6 +5983,53 @@ end:
 	return status;
 }
 
+/**
+ * The MANAGE CHANNEL command is sent on the Logical Channel of cardInfo, which is not changed.
+ * The new Logical Channel starts without a secure channel.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *channel [out] The opened Logical Channel.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_open_logical_channel(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, OPGP_LOGICAL_CHANNEL *channel) {
+	OPGP_ERROR_STATUS status;
+	BYTE channelNumberOpened;
+	OPGP_LOG_START(_T("OPGP_open_logical_channel"));
+	memset(&channel->secInfo, 0, sizeof(GP211_SECURITY_INFO));
+	channel->cardInfo = cardInfo;
+	status = OPGP_manage_channel(cardContext, &channel->cardInfo, NULL, GP211_MANAGE_CHANNEL_OPEN, 0, &channelNumberOpened);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("OPGP_open_logical_channel"), status);
+	return status;
+}
+
+/**
+ * The MANAGE CHANNEL command is sent on the Logical Channel of cardInfo.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *channel [in, out] The Logical Channel returned by OPGP_open_logical_channel().
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS OPGP_close_logical_channel(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, OPGP_LOGICAL_CHANNEL *channel) {
+	OPGP_ERROR_STATUS status;
+	BYTE channelNumberOpened;
+	OPGP_LOG_START(_T("OPGP_close_logical_channel"));
+	status = OPGP_manage_channel(cardContext, &cardInfo, NULL, GP211_MANAGE_CHANNEL_CLOSE,
+		channel->cardInfo.logicalChannel, &channelNumberOpened);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	memset(&channel->secInfo, 0, sizeof(GP211_SECURITY_INFO));
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("OPGP_close_logical_channel"), status);
+	return status;
+}
+
 /**
  * For an OPEN command, the channelNumberToClose is ignored.
  * For an CLOSE command, the channelNumberOpened is returned.
@@ -4912,7 +6491,7 @@ end:
  * \param *dapBlock [in] A pointer to OP201_DAP_BLOCK structure(s).
  * \param dapBlockLength [in] The number of OP201_DAP_BLOCK structure(s).
  * \param executableLoadFileName [in] The name of the CAP or IJC file to load.
- * \param *receiptData [out] If the deletion is performed by a security domain with delegated management privilege
+ * \param *receiptData [out] If the load is performed by a security domain with delegated management privilege
  * this structure contains the according data.
  * Can be validated with validate_load_receipt().
  * \param receiptDataAvailable [out] 0 if no receiptData is available.
@@ -4959,7 +6538,7 @@ end:
  * \param dapBlockLength [in] The number of OP201_DAP_BLOCK structure(s).
  * \param loadFileBuf [in] buffer with the contents of a Executable Load File.
  * \param loadFileBufSize [in] size of loadFileBuf.
- * \param *receiptData [out] If the deletion is performed by a security domain with delegated management privilege
+ * \param *receiptData [out] If the load is performed by a security domain with delegated management privilege
  * this structure contains the according data.
  * Can be validated with validate_load_receipt().
  * \param receiptDataAvailable [out] 0 if no receiptData is available.
@@ -5059,7 +6638,7 @@ OPGP_ERROR_STATUS OP201_install_for_load(OPGP_CARD_CONTEXT cardContext, OPGP_CAR
  * \param applicationInstallParameters [in] Applet install parameters for the install() method of the application.
  * \param applicationInstallParametersLength [in] The length of the applicationInstallParameters buffer.
  * \param installToken [in] The Install Token. This is a 1024 bit (=128 byte) RSA Signature.
- * \param *receiptData [out] If the deletion is performed by a security domain with delegated management privilege
+ * \param *receiptData [out] If the installation is performed by a security domain with delegated management privilege
  * this structure contains the according data.
  * \param receiptDataAvailable [out] 0 if no receiptData is available.
  * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
@@ -5110,7 +6689,7 @@ OPGP_ERROR_STATUS OP201_install_for_install(OPGP_CARD_CONTEXT cardContext, OPGP_
  * \param applicationInstallParameters [in] Applet install parameters for the install() method of the application.
  * \param applicationInstallParametersLength [in] The length of the applicationInstallParameters buffer.
  * \param installToken [in] The Install Token. This is a 1024 bit (=128 byte) RSA Signature.
- * \param *receiptData [out] If the deletion is performed by a security domain with delegated management privilege
+ * \param *receiptData [out] If the installation is performed by a security domain with delegated management privilege
  * this structure contains the according data.
  * \param receiptDataAvailable [out] 0 if no receiptData is available.
  * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
@@ -5149,7 +6728,7 @@ OPGP_ERROR_STATUS OP201_install_for_install_and_make_selectable(OPGP_CARD_CONTEX
  * \param applicationInstanceAIDLength [in] The length of the application instance AID.
  * \param applicationPrivileges [in] The application privileges. Can be an OR of multiple privileges. See OP201_APPLICATION_PRIVILEGE_SECURITY_DOMAIN.
  * \param installToken [in] The Install Token. This is a 1024 bit (=128 byte) RSA Signature.
- * \param *receiptData [out] If the deletion is performed by a security domain with delegated management privilege
+ * \param *receiptData [out] If the installation is performed by a security domain with delegated management privilege
  * this structure contains the according data.
  * \param receiptDataAvailable [out] 0 if no receiptData is available.
  * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
@@ -5353,19 +6932,25 @@ OPGP_ERROR_STATUS OP201_get_load_token_signature_data(PBYTE executableLoadFileAI
 	memcpy(loadTokenSignatureData, buf, i);
 	*loadTokenSignatureDataLength = i;
 #ifdef OPGP_DEBUG
-	OPGP_log_Msg(_T("OP201_get_load_token_signature_data: P1: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_log_Msg(_T("OP201_get_load_token_signature_data: P2: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_log_Msg(_T("OP201_get_load_token_signature_data: Lc: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_log_Msg(_T("OP201_get_load_token_signature_data: Load file AID length indicator: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_LOG_HEX(_T("OP201_get_load_token_signature_data: Load file AID: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("OP201_get_load_token_signature_data: P1: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("OP201_get_load_token_signature_data: P2: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("OP201_get_load_token_signature_data: Lc: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("OP201_get_load_token_signature_data: Load file AID length indicator: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_LOAD, _T("OP201_get_load_token_signature_data: Load file AID: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
 	j+=loadTokenSignatureData[j-1];
-	OPGP_log_Msg(_T("OP201_get_load_token_signature_data: Security Domain AID length indicator: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_LOG_HEX(_T("OP201_get_load_token_signature_data: Security Domain AID: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("OP201_get_load_token_signature_data: Security Domain AID length indicator: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_LOAD, _T("OP201_get_load_token_signature_data: Security Domain AID: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
 	j+=loadTokenSignatureData[j-1];
-	OPGP_log_Msg(_T("OP201_get_load_token_signature_data: Load parameters length indicator: 0x%02x"), loadTokenSignatureData[j++]);
-	OPGP_LOG_HEX(_T("OP201_get_load_token_signature_data: Load parameters: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("OP201_get_load_token_signature_data: Load parameters length indicator: 0x%02x"), loadTokenSignatureData[j]);
+	j++;
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_LOAD, _T("OP201_get_load_token_signature_data: Load parameters: "), loadTokenSignatureData+(j-1), *loadTokenSignatureDataLength-(j-1));
 	j+=loadTokenSignatureData[j-1];
-	OPGP_LOG_HEX(_T("OP201_get_load_token_signature_data: Hash of Load File: "), loadTokenSignatureData+j, 20);
+	OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_LOAD, _T("OP201_get_load_token_signature_data: Hash of Load File: "), loadTokenSignatureData+j, 20);
 	j+=loadTokenSignatureData[j-1];
 #endif
 	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
@@ -5451,7 +7036,7 @@ OPGP_ERROR_STATUS OP201_calculate_load_file_DAP(OP201_DAP_BLOCK *dapBlock, DWORD
 		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_FILENAME, OPGP_stringify_error(OPGP_ERROR_INVALID_FILENAME)); goto end; }
 
 	for (i=0; i<dapBlockLength; i++) {
-		OPGP_LOG_MSG(_T("OP201_calculate_load_file_DAP: Hashing DAP block %lu."), i);
+		OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_LOAD, _T("OP201_calculate_load_file_DAP: Hashing DAP block %lu."), i);
 		j=0;
 		k = dapBufSize;
 		status = readDAPBlock(dapBuf, &k, dapBlock[i]);
@@ -0,0 +1,96 @@
+/*  Copyright (c) 2026, GlobalPlatform Library contributors
+ *  This file is part of GlobalPlatform.
+ *
+ *  GlobalPlatform is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GlobalPlatform is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file
+ * This file contains the card profile database. A card profile caches the behaviour of a card product
+ * which was learned from the first card, so that cards with the same ATR can skip the discovery.
+*/
+
+#ifndef OPGP_CARDPROFILE_H
+#define OPGP_CARDPROFILE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifdef WIN32
+#include "stdafx.h"
+#endif
+
+#include "types.h"
+#include "library.h"
+#include "error.h"
+#include "connection.h"
+
+#define OPGP_CARD_QUIRK_INSTALL_NO_LE 0x00000001 //!< The card rejects the Le field of an INSTALL [for install and make selectable] command under T=0.
+
+#define OPGP_MAX_IIN_SIZE 16 //!< Maximum size of an Issuer Identification Number.
+
+/**
+ * The cached behaviour of a card product.
+ */
+typedef struct {
+	BYTE ATR[MAX_ATR_SIZE]; //!< The Answer To Reset of the card product.
+	DWORD ATRLength; //!< The length of the ATR.
+	BYTE IIN[OPGP_MAX_IIN_SIZE]; //!< The optional Issuer Identification Number of the card product.
+	DWORD IINLength; //!< The length of the IIN. 0 if the profile applies to all cards with this ATR.
+	BYTE secureChannelProtocol; //!< The Secure Channel Protocol of the Issuer Security Domain.
+	BYTE secureChannelProtocolImpl; //!< The implementation of the Secure Channel Protocol.
+	BYTE derivationMethod; //!< The key derivation method. See #OPGP_DERIVATION_METHOD_NONE and related.
+} OPGP_CARD_PROFILE;
+
+/**
+ * A card profile database. It must be initialized with #OPGP_card_profile_database_init().
+ * The database is not synchronized, concurrent threads must use their own database or a lock.
+ */
+typedef struct {
+	OPGP_CARD_PROFILE *profiles; //!< The profiles.
+	DWORD profilesLength; //!< The number of stored profiles.
+	DWORD profilesSize; //!< The number of allocated profiles.
+} OPGP_CARD_PROFILE_DATABASE;
+
+//! \brief Initializes an empty card profile database.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_card_profile_database_init(OPGP_CARD_PROFILE_DATABASE *database);
+
+//! \brief Releases all memory of a card profile database.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_card_profile_database_release(OPGP_CARD_PROFILE_DATABASE *database);
+
+//! \brief Looks up the profile of a card by its ATR and optional IIN.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_card_profile_lookup(OPGP_CARD_PROFILE_DATABASE *database, PBYTE ATR, DWORD ATRLength,
+										   PBYTE IIN, DWORD IINLength, OPGP_CARD_PROFILE *profile);
+
+//! \brief Adds a profile to the database or replaces the profile with the same ATR and IIN.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_card_profile_store(OPGP_CARD_PROFILE_DATABASE *database, OPGP_CARD_PROFILE *profile);
+
+//! \brief Adds the profiles stored in a file to the database.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_card_profile_database_load(OPGP_CARD_PROFILE_DATABASE *database, OPGP_CSTRING fileName);
+
+//! \brief Saves all profiles of the database to a file.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_card_profile_database_save(OPGP_CARD_PROFILE_DATABASE *database, OPGP_CSTRING fileName);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -45,6 +45,11 @@ extern "C"
 
 #define OPGP_TRACE_MODE_ENABLE 1 //!< Switch trace mode on
 #define OPGP_TRACE_MODE_DISABLE 0 //!< Switch trace mode off
+#define OPGP_TRACE_MODE_BINARY 2 //!< Switch trace mode on and write binary records which are converted with #OPGP_convert_binary_trace()
+
+#define OPGP_TRACE_RECORD_COMMAND 1 //!< Binary trace record of a command APDU.
+#define OPGP_TRACE_RECORD_WRAPPED_COMMAND 2 //!< Binary trace record of a wrapped command APDU.
+#define OPGP_TRACE_RECORD_RESPONSE 3 //!< Binary trace record of a response APDU.
 
 #define OPGP_CARD_PROTOCOL_T0 SCARD_PROTOCOL_T0 //!< Transport protocol T=0
 #define OPGP_CARD_PROTOCOL_T1 SCARD_PROTOCOL_T1 //!< Transport protocol T=1
@@ -74,6 +79,20 @@ typedef struct {
 	OPGP_CONNECTION_FUNCTIONS connectionFunctions; //!< Connection functions of the connection library. Is automatically filled in if the connection library can be loaded correctly.
 } OPGP_CARD_CONTEXT;
 
+#define OPGP_TRACE_SINK_BUFFER_SIZE 4096 //!< The size of the write buffer of a trace sink.
+
+/**
+ * The trace destination of a card set with #OPGP_set_sink(). Each sink has its own write buffer,
+ * so parallel sessions neither share a stream nor interleave their traces.
+ * The log of a thread is redirected separately with #OPGP_log_set_thread_file().
+ */
+typedef struct {
+	DWORD traceMode; //!< #OPGP_TRACE_MODE_ENABLE, #OPGP_TRACE_MODE_BINARY or #OPGP_TRACE_MODE_DISABLE.
+	FILE *traceFile; //!< The trace file. For #OPGP_TRACE_MODE_BINARY it must be opened in binary mode. If NULL stdout is used.
+	BYTE buffer[OPGP_TRACE_SINK_BUFFER_SIZE]; //!< Trace output not yet written to the trace file.
+	DWORD bufferLength; //!< The length of the buffered trace output.
+} OPGP_TRACE_SINK;
+
 /**
  * The card information returned by a #OPGP_card_connect() and modified by select_channel().
  */
@@ -91,6 +110,18 @@ typedef struct {
 OPGP_API
 void OPGP_enable_trace_mode(DWORD enable, FILE *out);
 
+//! \brief Sets the trace destination of a card.
+OPGP_API
+void OPGP_set_sink(OPGP_CARD_INFO *cardInfo, OPGP_TRACE_SINK *sink);
+
+//! \brief Writes the buffered output of a trace sink.
+OPGP_API
+void OPGP_flush_sink(OPGP_TRACE_SINK *sink);
+
+//! \brief Converts a trace written with #OPGP_TRACE_MODE_BINARY into the text trace.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_convert_binary_trace(FILE *in, FILE *out);
+
 //! \brief This function establishes a context to connection layer.
 OPGP_API
 OPGP_ERROR_STATUS OPGP_establish_context(OPGP_CARD_CONTEXT *cardContext);
@@ -111,6 +142,14 @@ OPGP_ERROR_STATUS OPGP_card_connect(OPGP_CARD_CONTEXT cardContext, OPGP_CSTRING
 OPGP_API
 OPGP_ERROR_STATUS OPGP_card_disconnect(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO *cardInfo);
 
+//! \brief This function gets exclusive access to the card until #OPGP_end_transaction() is called.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_begin_transaction(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo);
+
+//! \brief This function releases the exclusive access to the card obtained by #OPGP_begin_transaction().
+OPGP_API
+OPGP_ERROR_STATUS OPGP_end_transaction(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo);
+
 //! \brief This function sends an APDU.
 OPGP_API
 OPGP_ERROR_STATUS OPGP_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo, PBYTE capdu, DWORD capduLength, PBYTE rapdu, PDWORD rapduLength);
@@ -69,6 +69,14 @@ OPGP_ERROR_STATUS OPGP_PL_card_disconnect(OPGP_CARD_CONTEXT cardContext, OPGP_CA
 OPGP_PL_API
 OPGP_ERROR_STATUS OPGP_PL_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, PBYTE capdu, DWORD capduLength, PBYTE rapdu, PDWORD rapduLength);
 
+//! \brief This optional function gets exclusive access to the card.
+OPGP_PL_API
+OPGP_ERROR_STATUS OPGP_PL_begin_transaction(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo);
+
+//! \brief This optional function releases the exclusive access to the card.
+OPGP_PL_API
+OPGP_ERROR_STATUS OPGP_PL_end_transaction(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,131 @@
+/*  Copyright (c) 2026, GlobalPlatform Library contributors
+ *  This file is part of GlobalPlatform.
+ *
+ *  GlobalPlatform is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GlobalPlatform is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file
+ * This file contains the crypto provider interface. A crypto provider performs the operations with the long term keys
+ * of the library, e.g. in a Hardware Security Module: the derivation of static keys from a master key, the creation
+ * of session keys from the static keys, the encryption with a static Data Encryption Key and RSA signing.
+ * These keys are passed to the provider as key handles, i.e. the 16 byte key buffers of the library contain a
+ * reference to a key known by the provider instead of the key value.
+ * The session keys are returned by value. All operations with session keys, e.g. the C-MAC, R-MAC and encryption
+ * of each command, are calculated by the library itself and do not cause a call of the provider.
+*/
+
+#ifndef OPGP_CRYPTOPROVIDER_H
+#define OPGP_CRYPTOPROVIDER_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifdef WIN32
+#include "stdafx.h"
+#endif
+
+#include "types.h"
+#include "library.h"
+#include "unicode.h"
+#include "error.h"
+
+#define OPGP_CRYPTO_OPERATION_DERIVE_KEY 1 //!< Key derivation: Two key triple DES ECB encryption of the 16 byte diversification data with the master key.
+#define OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP01 2 //!< SCP01 session key: Two key triple DES ECB encryption of the 16 byte derivation data.
+#define OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP02 3 //!< SCP02 session key: Two key triple DES CBC encryption of the 16 byte derivation data with a zero ICV.
+#define OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP03 4 //!< SCP03 session key: AES CMAC of the 32 byte derivation data.
+#define OPGP_CRYPTO_OPERATION_ENC_3DES_ECB 5 //!< Two key triple DES ECB encryption with the static Data Encryption Key of SCP01 and SCP03, e.g. of a key for PUT KEY. The data is padded with 0x80 and 0x00 if it is not a multiple of 8.
+#define OPGP_CRYPTO_OPERATION_SIGN_RSA 6 //!< RSA PKCS#1 signature with SHA-1 using the key named by keyName.
+
+#define OPGP_SOFTWARE_CRYPTO_PROVIDER_MAX_KEYS 32 //!< Maximum number of key handles of the software crypto provider.
+
+/**
+ * A request to a crypto provider.
+ * The data and result buffers must stay valid until the request is completed.
+ */
+typedef struct {
+	DWORD operation; //!< The operation. See #OPGP_CRYPTO_OPERATION_DERIVE_KEY and related.
+	BYTE key[16]; //!< The handle of a key known by the provider.
+	OPGP_STRING keyName; //!< RSA signing: The name of the private key. The software crypto provider uses it as PEM file name.
+	char *passPhrase; //!< RSA signing: The pass phrase of the private key.
+	PBYTE data; //!< The input data.
+	DWORD dataLength; //!< The length of the input data.
+	PBYTE result; //!< The buffer for the result.
+	DWORD resultLength; //!< [in, out] The size of the result buffer and the length of the result after completion.
+	OPGP_ERROR_STATUS status; //!< The status of the request after completion.
+} OPGP_CRYPTO_REQUEST;
+
+/**
+ * A crypto provider.
+ * A provider with submit and wait functions processes batches of requests asynchronously, e.g. an HSM
+ * can derive the R-MAC and DEK session keys while the card is processing the EXTERNAL AUTHENTICATE command.
+ */
+typedef struct {
+	PVOID execute; //!< OPGP_ERROR_STATUS (*)(PVOID parameters, OPGP_CRYPTO_REQUEST *request). Executes a request synchronously.
+	PVOID submit; //!< Optional. OPGP_ERROR_STATUS (*)(PVOID parameters, OPGP_CRYPTO_REQUEST *requests, DWORD requestsLength). Starts the processing of the requests and returns.
+	PVOID wait; //!< Optional, must be set if submit is set. OPGP_ERROR_STATUS (*)(PVOID parameters, OPGP_CRYPTO_REQUEST *requests, DWORD requestsLength). Waits until the requests are completed.
+	PVOID parameters; //!< Parameters passed to the functions, e.g. an HSM session.
+} OPGP_CRYPTO_PROVIDER;
+
+/**
+ * A key of the software crypto provider.
+ */
+typedef struct {
+	BYTE keyHandle[16]; //!< The key handle.
+	BYTE keyValue[16]; //!< The key value.
+} OPGP_SOFTWARE_CRYPTO_KEY;
+
+/**
+ * The software crypto provider. It stands in for an HSM and executes the requests with OpenSSL.
+ * Requests with keys not added with #OPGP_software_crypto_provider_add_key() fail with #OPGP_ERROR_UNKNOWN_KEY_HANDLE.
+ * The provider is not synchronized and must only be used by one thread at a time.
+ */
+typedef struct {
+	OPGP_SOFTWARE_CRYPTO_KEY keys[OPGP_SOFTWARE_CRYPTO_PROVIDER_MAX_KEYS]; //!< The keys.
+	DWORD keysLength; //!< The number of keys.
+	DWORD pendingRequestsLength; //!< The number of submitted requests which are not yet completed by #OPGP_crypto_wait().
+} OPGP_SOFTWARE_CRYPTO_PROVIDER;
+
+//! \brief Sets the crypto provider used for the operations with the long term keys of the library.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_set_crypto_provider(OPGP_CRYPTO_PROVIDER *provider);
+
+//! \brief Executes a request synchronously with the crypto provider.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_crypto_execute(OPGP_CRYPTO_REQUEST *request);
+
+//! \brief Submits a batch of requests to the crypto provider without waiting for the completion.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_crypto_submit(OPGP_CRYPTO_REQUEST *requests, DWORD requestsLength);
+
+//! \brief Waits until a submitted batch of requests is completed.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_crypto_wait(OPGP_CRYPTO_REQUEST *requests, DWORD requestsLength);
+
+//! \brief Initializes the software crypto provider and the provider functions for #OPGP_set_crypto_provider().
+OPGP_API
+OPGP_ERROR_STATUS OPGP_software_crypto_provider_init(OPGP_SOFTWARE_CRYPTO_PROVIDER *softwareProvider,
+													 OPGP_CRYPTO_PROVIDER *provider);
+
+//! \brief Adds a key handle with its key value to the software crypto provider.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_software_crypto_provider_add_key(OPGP_SOFTWARE_CRYPTO_PROVIDER *softwareProvider,
+														BYTE keyHandle[16], BYTE keyValue[16]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -31,6 +31,7 @@ extern "C"
 #include "stdafx.h"
 #endif
 
+#include <stdio.h>
 #include "types.h"
 #include "library.h"
 #include "unicode.h"
@@ -42,18 +43,116 @@ extern "C"
 #define OPGP_LOG_FILENAME _T("/tmp/GlobalPlatform.log")
 #endif
 
+#define OPGP_LOG_LEVEL_OFF 0 //!< Nothing is logged.
+#define OPGP_LOG_LEVEL_ERROR 1 //!< Only functions returning an error are logged.
+#define OPGP_LOG_LEVEL_INFO 2 //!< Additionally informational messages are logged.
+#define OPGP_LOG_LEVEL_DEBUG 3 //!< Additionally the start and end of each function is logged.
+#define OPGP_LOG_LEVEL_TRACE 4 //!< Additionally hex dumps of APDUs, keys and other buffers are logged.
+
+#define OPGP_LOG_CATEGORY_API 0x01 //!< The card management functions.
+#define OPGP_LOG_CATEGORY_TRANSPORT 0x02 //!< The connection to the card and the connection plugins.
+#define OPGP_LOG_CATEGORY_CRYPTO 0x04 //!< Key derivation, secure channel and cryptographic functions.
+#define OPGP_LOG_CATEGORY_LOAD 0x08 //!< Reading and loading of Load Files.
+#define OPGP_LOG_CATEGORY_ALL 0x0F //!< All categories.
+
+/**
+ * The category of the log macros used in a source file. It can be defined before including this file.
+ */
+#ifndef OPGP_LOG_CATEGORY
+#define OPGP_LOG_CATEGORY OPGP_LOG_CATEGORY_API
+#endif
+
+/**
+ * The bit of a level and category in #OPGP_log_mask. Each level has 4 category bits.
+ */
+#define OPGP_LOG_BIT(level, category) ((DWORD)(category) << (4*((level)-1)))
+
+#define OPGP_LOG_SPAN_HOOKS ((DWORD)0x80000000L) //!< Set in #OPGP_log_mask if span hooks are registered with OPGP_set_span_hooks().
+#define OPGP_LOG_FLIGHT_RECORDER_DUMP ((DWORD)0x40000000L) //!< Set in #OPGP_log_mask if the flight recorder is dumped on errors, see OPGP_set_flight_recorder_file().
+
+/**
+ * Checks if a level and category is enabled. A disabled level costs a single test of #OPGP_log_mask.
+ * Until the settings are read from the environment all bits are set and OPGP_log_is_enabled() decides.
+ */
+#define OPGP_LOG_ENABLED(level, category) ((OPGP_log_mask & OPGP_LOG_BIT(level, category)) && OPGP_log_is_enabled(level, category))
+
 #ifdef OPGP_DEBUG
-#define OPGP_LOG_START(msg)        OPGP_log_Start(msg, _T(__FILE__), __LINE__)
-#define OPGP_LOG_MSG(...)	OPGP_log_Msg(__VA_ARGS__)
-#define OPGP_LOG_END(msg, status)       OPGP_log_End(msg, _T(__FILE__), __LINE__, status)
-#define OPGP_LOG_HEX(msg, buffer, bufferLength) OPGP_log_Hex(msg, buffer, bufferLength)
+#define OPGP_LOG_START(msg) do { if (OPGP_log_mask & (OPGP_LOG_BIT(OPGP_LOG_LEVEL_DEBUG, OPGP_LOG_CATEGORY) | OPGP_LOG_SPAN_HOOKS)) \
+		OPGP_log_start_function(msg, _T(__FILE__), __LINE__, OPGP_LOG_CATEGORY); } while (0)
+#define OPGP_LOG_MSG(...) OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY, __VA_ARGS__)
+#define OPGP_LOG_MSG_FOR(category, ...) do { if (OPGP_LOG_ENABLED(OPGP_LOG_LEVEL_INFO, category)) OPGP_log_Msg(__VA_ARGS__); } while (0)
+#define OPGP_LOG_END(msg, status) do { if (OPGP_log_mask & (OPGP_LOG_BIT(OPGP_LOG_LEVEL_DEBUG, OPGP_LOG_CATEGORY) | OPGP_LOG_SPAN_HOOKS \
+		| (OPGP_ERROR_CHECK(status) ? OPGP_LOG_BIT(OPGP_LOG_LEVEL_ERROR, OPGP_LOG_CATEGORY) | OPGP_LOG_FLIGHT_RECORDER_DUMP : 0))) \
+		OPGP_log_end_function(msg, _T(__FILE__), __LINE__, OPGP_LOG_CATEGORY, status); } while (0)
+#define OPGP_LOG_HEX(msg, buffer, bufferLength) OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY, msg, buffer, bufferLength)
+#define OPGP_LOG_HEX_FOR(category, msg, buffer, bufferLength) do { if (OPGP_LOG_ENABLED(OPGP_LOG_LEVEL_TRACE, category)) OPGP_log_Hex(msg, buffer, bufferLength); } while (0)
 #else
 #define OPGP_LOG_START(msg)
 #define OPGP_LOG_END(msg,rv)
 #define OPGP_LOG_HEX(msg, buffer, bufferLength)
+#define OPGP_LOG_HEX_FOR(category, msg, buffer, bufferLength)
 #define OPGP_LOG_MSG(...)
+#define OPGP_LOG_MSG_FOR(category, ...)
 #endif
 
+typedef unsigned long long OPGP_TIMESTAMP; //!< A monotonic time stamp in nanoseconds.
+
+#define OPGP_FLIGHT_RECORDER_SIZE 16 //!< The number of APDU exchanges kept by the flight recorder of each thread.
+
+/**
+ * Callbacks receiving the start and end of each library function bracketed by OPGP_LOG_START() and OPGP_LOG_END(),
+ * e.g. to feed spans into a profiler or tracing system. No message is formatted for the callbacks.
+ * The callbacks are called from the thread executing the function, so a caller can assign the spans to a card by its thread.
+ */
+typedef struct {
+	PVOID start; //!< void (*)(PVOID parameters, OPGP_CSTRING function, OPGP_TIMESTAMP timestamp). Called at the start of a function.
+	PVOID end; //!< void (*)(PVOID parameters, OPGP_CSTRING function, OPGP_TIMESTAMP timestamp, LONG errorStatus, LONG errorCode). Called at the end of a function.
+	PVOID parameters; //!< Parameters passed to the callbacks.
+} OPGP_SPAN_HOOKS;
+
+//! The enabled levels and categories, see #OPGP_LOG_BIT. Set it with OPGP_log_set_level().
+extern OPGP_API DWORD OPGP_log_mask;
+
+//! \brief Sets the log level for the given categories. Other categories keep their level.
+OPGP_API
+void OPGP_log_set_level(DWORD level, DWORD categories);
+
+//! \brief Registers the span hooks called at the start and end of each library function.
+OPGP_API
+void OPGP_set_span_hooks(OPGP_SPAN_HOOKS *hooks);
+
+//! \brief Records a command APDU in the flight recorder of the calling thread.
+OPGP_API
+void OPGP_flight_recorder_command(PBYTE capdu, DWORD capduLength);
+
+//! \brief Records the response APDU or the error of the last command in the flight recorder of the calling thread.
+OPGP_API
+void OPGP_flight_recorder_response(PBYTE rapdu, DWORD rapduLength, OPGP_ERROR_STATUS status);
+
+//! \brief Writes the APDU exchanges kept by the flight recorder of the calling thread.
+OPGP_API
+void OPGP_dump_flight_recorder(FILE *out);
+
+//! \brief Sets the file the flight recorder is dumped to when a library function returns an error.
+OPGP_API
+void OPGP_set_flight_recorder_file(FILE *out);
+
+//! \brief Calls the span hook and logs the start of a function. Used by OPGP_LOG_START().
+OPGP_API
+void OPGP_log_start_function(OPGP_CSTRING func, OPGP_CSTRING file, int line, DWORD category);
+
+//! \brief Calls the span hook and logs the end of a function. Used by OPGP_LOG_END().
+OPGP_API
+void OPGP_log_end_function(OPGP_CSTRING func, OPGP_CSTRING file, int line, DWORD category, OPGP_ERROR_STATUS status);
+
+//! \brief Checks if a log level is enabled for a category. Reads the settings from the environment on first use.
+OPGP_API
+int OPGP_log_is_enabled(DWORD level, DWORD category);
+
+//! \brief Sets the log file of the calling thread instead of the log file or syslog of the process.
+OPGP_API
+void OPGP_log_set_thread_file(FILE *file);
+
 //! \brief Logs something to a file or the syslog.
 OPGP_API
 void OPGP_log_Msg(OPGP_STRING msg, ...);
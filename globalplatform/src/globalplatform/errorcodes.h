@@ -48,6 +48,13 @@
 #define OPGP_ERROR_SCP03_SECURITY_LEVEL_3_NOT_SUPPORTED ((DWORD)0x8030F00EL) //!< SCP03 with security level 3 is not supported.
 // Philip Wendland: added this because security level 3 of SCP03 is not supported yet.
 #define OPGP_ERROR_SCP03_SECURITY_LEVEL_3_NOT_SUPPORTED ((DWORD)0x8030F00EL) //!< SCP03 with security level 3 is not supported.
+#define OPGP_ERROR_OPERATION_FINISHED ((DWORD)0x8030F00FL) //!< The operation is already finished and has no further command.
+#define OPGP_ERROR_CARD_PROFILE_NOT_FOUND ((DWORD)0x8030F010L) //!< No card profile is known for this card.
+#define OPGP_ERROR_INVALID_CARD_PROFILE ((DWORD)0x8030F011L) //!< A card profile or card profile database file is invalid.
+#define OPGP_ERROR_INSUFFICIENT_CARD_MEMORY ((DWORD)0x8030F012L) //!< The card has not enough free memory for the operation.
+#define OPGP_ERROR_INVALID_WRAPPED_SCRIPT ((DWORD)0x8030F013L) //!< A pre-wrapped script is invalid.
+#define OPGP_ERROR_WRAPPED_SCRIPT_NOT_FOUND ((DWORD)0x8030F014L) //!< No pre-wrapped script exists for this card.
+#define OPGP_ERROR_UNKNOWN_KEY_HANDLE ((DWORD)0x8030F015L) //!< The key handle is not known by the crypto provider.
 
 /* Open Platform 2.0.1' specific errors */
 
@@ -43,6 +43,8 @@ extern "C"
 #include "errorcodes.h"
 #include "library.h"
 #include "connection.h"
+#include "cardprofile.h"
+#include "cryptoprovider.h"
 #include "security.h"
 #include "stringify.h"
 
@@ -91,6 +93,9 @@ static const BYTE GP211_STATUS_ISSUER_SECURITY_DOMAIN = 0x80; //!< Indicate Issu
 static const BYTE GP211_STATUS_LOAD_FILES = 0x20; //!< Request GP211_APPLICATION_DATA for Executable Load Files in GP211_get_status().
 static const BYTE GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES = 0x10; //!< Request GP211_EXECUTABLE_MODULES_DATA for Executable Load Files and their Executable Modules in GP211_get_status().
 
+static const BYTE GP211_STATUS_FORMAT_LEGACY = 0x00; //!< GET STATUS response data in the format of GlobalPlatform 2.1.1 in GP211_get_status_with_criteria().
+static const BYTE GP211_STATUS_FORMAT_TLV = 0x02; //!< GET STATUS response data as tagged GlobalPlatform 2.2 E3 templates in GP211_get_status_with_criteria().
+
 
 
 
@@ -169,6 +174,10 @@ static const BYTE GP211_GET_DATA_WHOLE_EF_PROD[2] = {0xDF, 0x7F}; //!< Whole EF<
 
 static const BYTE GP211_GET_DATA_KEY_DIVERSIFICATION[2] = {0x00, 0xCF}; //!< Key diversification data. KMC_ID (6 bytes) + CSN (4 bytes). KMC_ID is usually the IIN (Issuer identification number). CSN is the card serial number.
 
+static const BYTE GP211_GET_DATA_EXTENDED_CARD_RESOURCES_INFORMATION[2] = {0xFF, 0x21}; //!< Extended Card Resources Information (GlobalPlatform Card Specification Amendment C).
+
+#define GP211_FREE_MEMORY_UNKNOWN 0xFFFFFFFF //!< The card does not report the free memory.
+
 
 
 
@@ -335,6 +344,237 @@ typedef struct {
 	OPGP_AID executableModules[256]; //!< Array for the maximum possible associated Executable Modules.
 } GP211_EXECUTABLE_MODULES_DATA;
 
+#define GP211_GET_STATUS_STOP 1 //!< Returned by a #GP211_GET_STATUS_CALLBACK to stop the listing.
+
+/**
+ * The structure is passed to the callback function for each entry returned by GET STATUS.
+ */
+typedef struct {
+	BYTE cardElement; //!< The requested card element.
+	GP211_APPLICATION_DATA *applData; //!< The entry if cardElement is not GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES, otherwise NULL.
+	GP211_EXECUTABLE_MODULES_DATA *executableData; //!< The entry if cardElement is GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES, otherwise NULL.
+	PVOID parameters; //!< Proprietary parameters for the function passed in with #GP211_GET_STATUS_CALLBACK.
+} GP211_GET_STATUS_CALLBACK_PARAMETERS;
+
+/**
+ * The structure is used for receiving the entries of GET STATUS one at a time.
+ */
+typedef struct {
+	PVOID callback; //!< The callback function. The must accept a #GP211_GET_STATUS_CALLBACK_PARAMETERS pointer and return a DWORD, so the function signature is: DWORD (*callback)(GP211_GET_STATUS_CALLBACK_PARAMETERS *). The entry is only valid during the call. Returning #GP211_GET_STATUS_STOP stops the listing.
+	PVOID parameters; //!< Proprietary parameters for the callback function. Passed in when the function is called.
+} GP211_GET_STATUS_CALLBACK;
+
+/**
+ * An Executable Load File of a #GP211_LOAD_FILE_INVENTORY. The Executable Modules are not embedded
+ * but stored contiguously in the executableModules array of the inventory.
+ */
+typedef struct {
+	BYTE AIDLength; //!< The length of the Executable Load File AID.
+	BYTE AID[16]; //!< The Executable Load File AID.
+	BYTE lifeCycleState; //!< The Executable Load File life cycle state.
+	BYTE numExecutableModules; //!< Number of associated Executable Modules.
+	DWORD executableModulesOffset; //!< Index of the first associated Executable Module in the executableModules array of the inventory.
+} GP211_LOAD_FILE_DATA;
+
+/**
+ * A compact listing of the Executable Load Files and their Executable Modules.
+ * It must be initialized with #GP211_load_file_inventory_init(). The memory is kept when the inventory is
+ * filled again, so one inventory can be reused for many cards without further allocations.
+ */
+typedef struct {
+	GP211_LOAD_FILE_DATA *loadFiles; //!< The Executable Load Files.
+	DWORD loadFilesLength; //!< The number of Executable Load Files.
+	DWORD loadFilesSize; //!< The number of allocated Executable Load Files.
+	OPGP_AID *executableModules; //!< The Executable Modules of all Executable Load Files.
+	DWORD executableModulesLength; //!< The number of Executable Modules.
+	DWORD executableModulesSize; //!< The number of allocated Executable Modules.
+} GP211_LOAD_FILE_INVENTORY;
+
+/**
+ * A package of a #GP211_MANIFEST.
+ */
+typedef struct {
+	OPGP_AID AID; //!< The Executable Load File AID.
+	OPGP_AID securityDomainAID; //!< The AID of the Security Domain the package is associated with.
+	PBYTE loadFileBuf; //!< The Executable Load File as passed to GP211_load_from_buffer().
+	DWORD loadFileBufSize; //!< The size of loadFileBuf.
+	PBYTE loadFileDataBlockHash; //!< The 20 byte Load File Data Block Hash for the INSTALL [for load] command. Can be NULL.
+	PDWORD dependencies; //!< Indices of the packages this package imports. These packages must be listed before this package.
+	DWORD dependenciesLength; //!< The number of dependencies.
+	DWORD reload; //!< If not 0 the package is reloaded even if it is present on the card, e.g. because the caller knows its hash changed.
+} GP211_MANIFEST_PACKAGE;
+
+/**
+ * An application instance of a #GP211_MANIFEST.
+ */
+typedef struct {
+	DWORD package; //!< The index of the package of the application in the manifest.
+	OPGP_AID moduleAID; //!< The Executable Module AID.
+	OPGP_AID AID; //!< The application instance AID.
+	BYTE privileges; //!< The application privileges. See #GP211_APPLICATION_PRIVILEGE_SECURITY_DOMAIN and related.
+	DWORD volatileDataSpaceLimit; //!< The minimum amount of RAM space that must be available.
+	DWORD nonVolatileDataSpaceLimit; //!< The minimum amount of space for objects of the application.
+	PBYTE installParameters; //!< The application install parameters. Can be NULL.
+	DWORD installParametersLength; //!< The length of the install parameters.
+} GP211_MANIFEST_INSTANCE;
+
+/**
+ * The desired content of a card. Content of the card not mentioned in the manifest is not changed.
+ */
+typedef struct {
+	GP211_MANIFEST_PACKAGE *packages; //!< The packages in the order of their dependencies.
+	DWORD packagesLength; //!< The number of packages.
+	GP211_MANIFEST_INSTANCE *instances; //!< The application instances.
+	DWORD instancesLength; //!< The number of instances.
+} GP211_MANIFEST;
+
+#define GP211_PLAN_DELETE 1 //!< DELETE the object with the AID of the step and its related objects.
+#define GP211_PLAN_LOAD 2 //!< INSTALL [for load] and LOAD the package with the index of the step.
+#define GP211_PLAN_INSTALL 3 //!< INSTALL [for install and make selectable] the instance with the index of the step.
+
+/**
+ * A step of a plan computed by #GP211_plan_card_content().
+ */
+typedef struct {
+	DWORD action; //!< The action. See #GP211_PLAN_DELETE and related.
+	DWORD index; //!< The index of the package or instance in the manifest. Not used for #GP211_PLAN_DELETE.
+	OPGP_AID AID; //!< The AID of the deleted, loaded or installed object.
+} GP211_PLAN_STEP;
+
+/**
+ * One data object requested with #GP211_get_data_batch().
+ */
+typedef struct {
+	BYTE identifier[2]; //!< [in] High and low order tag value of the data object.
+	BYTE iso7816; //!< [in] If not 0 the ISO/IEC 7816-4 GET DATA is sent outside the secure channel like #GP211_get_data_iso7816_4().
+	PBYTE data; //!< [out] The buffer for the data object.
+	DWORD dataLength; //!< [in, out] The size of data and the length of the returned data object.
+	OPGP_ERROR_STATUS status; //!< [out] The result of this GET DATA command.
+} GP211_GET_DATA_REQUEST;
+
+#define OPGP_OPERATION_FINISHED 1 //!< The operation is completed and has no further command.
+
+/**
+ * A resumable operation which does no I/O itself. It is started with one of the GP211_begin_* functions.
+ * Then #OPGP_operation_get_command returns the next command APDU to transmit and the complete response APDU
+ * must be passed to #OPGP_operation_process_response until finished contains #OPGP_OPERATION_FINISHED.
+ * So one thread can drive many cards from an event loop. All members are internal to the library.
+ * Buffers and pointers passed to the GP211_begin_* functions must stay valid until the operation is finished.
+ */
+typedef struct {
+	DWORD type; //!< The kind of operation.
+	DWORD step; //!< The current step of the operation.
+	DWORD finished; //!< #OPGP_OPERATION_FINISHED if the operation is completed.
+	OPGP_CARD_INFO cardInfo; //!< The card the operation is running on.
+	GP211_SECURITY_INFO *secInfo; //!< The security information used for wrapping the commands. Can be NULL.
+	BYTE command[261]; //!< The current unwrapped command APDU.
+	DWORD commandLength; //!< The length of the current command APDU.
+	union {
+		struct {
+			BYTE cardElement; //!< The requested card element.
+			GP211_APPLICATION_DATA *applData; //!< The application data to fill.
+			GP211_EXECUTABLE_MODULES_DATA *executableData; //!< The executable modules data to fill.
+			PDWORD dataLength; //!< The size of the passed array and the number of returned entries.
+			DWORD count; //!< The number of entries returned so far.
+			GP211_GET_STATUS_CALLBACK *callback; //!< The callback receiving the entries. If not NULL applData, executableData and dataLength are not used.
+			BYTE format; //!< The response data format. See #GP211_STATUS_FORMAT_LEGACY.
+		} getStatus; //!< GET STATUS parameters.
+		struct {
+			BYTE baseKey[16]; //!< The Secure Channel base key.
+			BYTE sEnc[16]; //!< The static encryption key.
+			BYTE sMac[16]; //!< The static MAC key.
+			BYTE dek[16]; //!< The static data encryption key.
+			BYTE keySetVersion; //!< The key set version.
+			BYTE keyIndex; //!< The key index.
+			BYTE securityLevel; //!< The requested security level.
+			BYTE derivationMethod; //!< The key derivation method.
+			BYTE hostChallenge[8]; //!< The host challenge.
+			GP211_SECURITY_INFO *secInfo; //!< The security information to establish.
+			OPGP_CRYPTO_REQUEST pendingRequests[2]; //!< The session key requests submitted to the crypto provider which are completed at the EXTERNAL AUTHENTICATE response.
+			BYTE pendingDerivationData[2][32]; //!< The derivation data of the pending requests.
+			DWORD pendingRequestsLength; //!< The number of pending requests.
+		} mutualAuthentication; //!< Mutual authentication parameters.
+		struct {
+			GP211_DAP_BLOCK *loadFileDataBlockSignature; //!< The Load File Data Block Signatures.
+			DWORD loadFileDataBlockSignatureLength; //!< The number of Load File Data Block Signatures.
+			DWORD signatureIndex; //!< The next Load File Data Block Signature to send.
+			PBYTE loadFileBuf; //!< The Executable Load File.
+			DWORD loadFileBufSize; //!< The size of the Executable Load File.
+			DWORD total; //!< The number of bytes of the Executable Load File already sent.
+			DWORD fileSizeSize; //!< The number of bytes of the length of the Load File Data Block.
+			DWORD headerSent; //!< 1 if the Load File Data Block tag and length are part of a prepared command.
+			DWORD commandTotal; //!< The value of total after the current command.
+			BYTE sequenceNumber; //!< The block number of the next LOAD command.
+			GP211_RECEIPT_DATA *receiptData; //!< The receipt data to fill.
+			PDWORD receiptDataAvailable; //!< Set to 1 if a receipt is available.
+			OPGP_PROGRESS_CALLBACK *callback; //!< An optional progress callback.
+			DWORD callbackFinished; //!< 1 if the callback was notified about the end of the task.
+			PVOID hashContext; //!< The context of the Load File Data Block Hash calculated while sending or NULL.
+			PBYTE hash; //!< The buffer for the Load File Data Block Hash.
+			PDWORD hashLength; //!< The size of the hash buffer and the length of the hash after the last LOAD command.
+		} load; //!< LOAD parameters.
+		struct {
+			GP211_RECEIPT_DATA *receiptData; //!< The receipt data to fill.
+			PDWORD receiptDataLength; //!< The number of receipts returned or if a receipt is available.
+		} receipt; //!< Parameters of commands returning receipts.
+		struct {
+			GP211_RECEIPT_DATA *receiptData; //!< The receipt data to fill.
+			PDWORD receiptDataLength; //!< The number of receipts returned.
+			DWORD receiptDataSize; //!< The size of the receiptData array.
+			OPGP_AID *AIDs; //!< The AIDs to delete.
+			DWORD AIDsLength; //!< The number of AIDs to delete.
+			DWORD nextAID; //!< The index of the first AID not contained in a prepared command.
+			DWORD mode; //!< OpenPlatform 2.0.1' or GlobalPlatform 2.1.1 delete command.
+		} deletion; //!< DELETE parameters.
+	} data; //!< Parameters of the operation.
+} OPGP_OPERATION;
+
+/**
+ * A Logical Channel opened with #OPGP_open_logical_channel(). Each Logical Channel has its own secure channel.
+ * Pass cardInfo and secInfo to the functions which should use this Logical Channel, e.g. GP211_select_application()
+ * and GP211_mutual_authentication() or one of the GP211_begin_* functions.
+ */
+typedef struct {
+	OPGP_CARD_INFO cardInfo; //!< The card information addressing this Logical Channel.
+	GP211_SECURITY_INFO secInfo; //!< The security information of this Logical Channel. Initially no secure channel is used.
+} OPGP_LOGICAL_CHANNEL;
+
+#define GP211_WRAPPED_SCRIPT_MAX_CARD_IDENTIFIER_LENGTH 32 //!< Maximum length of the card identifier of a pre-wrapped script.
+
+/**
+ * A script of commands wrapped in advance with an implicitly opened SCP02 Secure Channel, e.g. in a back-office
+ * batch job. It is created with #GP211_begin_wrapped_script and sent with #GP211_send_wrapped_script without
+ * any host cryptography. The script is only valid for the predicted Sequence Counter of the card.
+ *
+ * The script is stored in a binary format, all numbers are big endian:
+ * - 4 bytes "GPWS", 1 byte format version 1, 4 bytes length of the whole script
+ * - 1 byte Secure Channel Protocol implementation, 1 byte security level, 2 bytes Sequence Counter
+ * - 1 byte length and the card identifier, 1 byte length and the Security Domain AID
+ * - 2 bytes number of commands, each command as 2 bytes length and the wrapped command APDU
+ */
+typedef struct {
+	PBYTE buffer; //!< The buffer receiving the script.
+	DWORD bufferSize; //!< The size of the buffer.
+	DWORD length; //!< The length of the script.
+	DWORD commandsLength; //!< The number of commands in the script.
+	GP211_SECURITY_INFO secInfo; //!< The Secure Channel the commands are wrapped with. Cleared by #GP211_end_wrapped_script.
+} GP211_WRAPPED_SCRIPT;
+
+/**
+ * The header of a pre-wrapped script returned by #GP211_read_wrapped_script_header.
+ */
+typedef struct {
+	DWORD scriptLength; //!< The length of the whole script.
+	BYTE secureChannelProtocolImpl; //!< The Secure Channel Protocol implementation.
+	BYTE securityLevel; //!< The security level of the commands.
+	BYTE sequenceCounter[2]; //!< The Sequence Counter the script was wrapped for.
+	BYTE cardIdentifier[GP211_WRAPPED_SCRIPT_MAX_CARD_IDENTIFIER_LENGTH]; //!< The card identifier.
+	DWORD cardIdentifierLength; //!< The length of the card identifier.
+	OPGP_AID AID; //!< The AID of the Security Domain.
+	DWORD commandsLength; //!< The number of commands.
+	DWORD headerLength; //!< The length of the header, i.e. the offset of the first command.
+} GP211_WRAPPED_SCRIPT_HEADER;
+
 //! \brief GlobalPlatform2.1.1: Selects an application on a card by AID.
 OPGP_API
 OPGP_ERROR_STATUS OPGP_select_application(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, PBYTE AID, DWORD AIDLength);
@@ -348,6 +588,44 @@ OPGP_ERROR_STATUS GP211_get_status(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO
 				BYTE cardElement, GP211_APPLICATION_DATA *applData,
 				GP211_EXECUTABLE_MODULES_DATA *executableData, PDWORD dataLength);
 
+//! \brief GlobalPlatform2.1.1: Gets the life cycle status like GP211_get_status() but passes each entry to a callback as it is received.
+OPGP_API
+OPGP_ERROR_STATUS GP211_get_status_with_callback(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				BYTE cardElement, GP211_GET_STATUS_CALLBACK *callback);
+
+//! \brief GlobalPlatform2.1.1: Gets the life cycle status of the entries whose AID starts with the given AID and passes each entry to a callback.
+OPGP_API
+OPGP_ERROR_STATUS GP211_get_status_with_criteria(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				BYTE cardElement, PBYTE AID, DWORD AIDLength, BYTE format, GP211_GET_STATUS_CALLBACK *callback);
+
+//! \brief GlobalPlatform2.1.1: Computes the commands needed to turn the current card content into the content of a manifest.
+OPGP_API
+OPGP_ERROR_STATUS GP211_plan_card_content(GP211_MANIFEST *manifest, GP211_LOAD_FILE_INVENTORY *loadFiles,
+				GP211_APPLICATION_DATA *applData, DWORD applDataLength, GP211_PLAN_STEP *plan, PDWORD planLength);
+
+//! \brief GlobalPlatform2.1.1: Executes a plan computed by GP211_plan_card_content().
+OPGP_API
+OPGP_ERROR_STATUS GP211_execute_plan(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				GP211_MANIFEST *manifest, GP211_PLAN_STEP *plan, DWORD planLength);
+
+//! \brief GlobalPlatform2.1.1: Reads the card content, plans and executes the commands to reach the content of a manifest.
+OPGP_API
+OPGP_ERROR_STATUS GP211_provision_card_content(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				GP211_MANIFEST *manifest);
+
+//! \brief Initializes an empty inventory of Executable Load Files.
+OPGP_API
+OPGP_ERROR_STATUS GP211_load_file_inventory_init(GP211_LOAD_FILE_INVENTORY *inventory);
+
+//! \brief Releases all memory of an inventory of Executable Load Files.
+OPGP_API
+OPGP_ERROR_STATUS GP211_load_file_inventory_release(GP211_LOAD_FILE_INVENTORY *inventory);
+
+//! \brief GlobalPlatform2.1.1: Lists the Executable Load Files and their Executable Modules into a compact inventory.
+OPGP_API
+OPGP_ERROR_STATUS GP211_get_load_file_inventory(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				GP211_LOAD_FILE_INVENTORY *inventory);
+
 //! \brief GlobalPlatform2.1.1: Sets the life cycle status of Applications, Security Domains or the Card Manager.
 OPGP_API
 OPGP_ERROR_STATUS GP211_set_status(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo, BYTE cardElement, PBYTE AID, DWORD AIDLength, BYTE lifeCycleState);
@@ -381,11 +659,22 @@ OPGP_ERROR_STATUS GP211_get_data(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO c
 OPGP_API
 OPGP_ERROR_STATUS GP211_get_data_iso7816_4(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, BYTE identifier[2], PBYTE recvBuffer, PDWORD recvBufferLength);
 
+//! \brief GlobalPlatform2.1.1: Retrieve several card data objects within one card transaction.
+OPGP_API
+OPGP_ERROR_STATUS GP211_get_data_batch(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+			  GP211_GET_DATA_REQUEST *requests, DWORD requestsLength);
+
 //! \brief GlobalPlatform2.1.1: This returns the Secure Channel Protocol and the Secure Channel Protocol implementation.
 OPGP_API
 OPGP_ERROR_STATUS GP211_get_secure_channel_protocol_details(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo,
 										 BYTE *secureChannelProtocol, BYTE *secureChannelProtocolImpl);
 
+//! \brief Returns the profile of a card from the database or discovers and stores it if the card is unknown.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_discover_card_profile(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo,
+										 OPGP_CARD_PROFILE_DATABASE *database, PBYTE IIN, DWORD IINLength,
+										 OPGP_CARD_PROFILE *profile);
+
 //! \brief GlobalPlatform2.1.1: This returns the current Sequence Counter.
 OPGP_API
 OPGP_ERROR_STATUS GP211_get_sequence_counter(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo,
@@ -495,6 +784,11 @@ OPGP_API
 OPGP_ERROR_STATUS GP211_calculate_load_file_data_block_hash(OPGP_STRING executableLoadFileName,
 							 unsigned char hash[20]);
 
+//! \brief GlobalPlatform2.1.1: Calculates a Load File Data Block Hash of an Executable Load File buffer with SHA-1 or SHA-256.
+OPGP_API
+OPGP_ERROR_STATUS GP211_calculate_load_file_data_block_hash_from_buffer(PBYTE loadFileBuf, DWORD loadFileBufSize,
+							 BYTE hashAlgorithm, PBYTE hash, PDWORD hashLength);
+
 //! \brief GlobalPlatform2.1.1: Loads a Executable Load File (containing an application) to the card.
 OPGP_API
 OPGP_ERROR_STATUS GP211_load(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
@@ -508,6 +802,13 @@ OPGP_ERROR_STATUS GP211_load_from_buffer(OPGP_CARD_CONTEXT cardContext, OPGP_CAR
 				 PBYTE loadFileBuffer, DWORD loadFileBufSize,
 				 GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable, OPGP_PROGRESS_CALLBACK *callback);
 
+//! \brief GlobalPlatform2.1.1: Loads a Executable Load File buffer and calculates the Load File Data Block Hash of the sent blocks.
+OPGP_API
+OPGP_ERROR_STATUS GP211_load_from_buffer_with_hash(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				 GP211_DAP_BLOCK *dapBlock, DWORD dapBlockLength,
+				 PBYTE loadFileBuffer, DWORD loadFileBufSize, BYTE hashAlgorithm, PBYTE hash, PDWORD hashLength,
+				 GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable, OPGP_PROGRESS_CALLBACK *callback);
+
 //! \brief GlobalPlatform2.1.1: Installs an application on the card.
 OPGP_API
 OPGP_ERROR_STATUS GP211_install_for_install(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
@@ -534,6 +835,28 @@ OPGP_ERROR_STATUS GP211_install_for_install_and_make_selectable(OPGP_CARD_CONTEX
 						 PBYTE installParameters, DWORD installParametersLength,
 						 BYTE installToken[128], GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable);
 
+//! \brief Returns the free non volatile and volatile memory reported by the card.
+OPGP_API
+OPGP_ERROR_STATUS GP211_get_free_memory(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						 PDWORD freeNonVolatileMemory, PDWORD freeVolatileMemory);
+
+//! \brief Checks that the card has enough free memory before e.g. a LOAD is started.
+OPGP_API
+OPGP_ERROR_STATUS GP211_check_free_memory(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						 DWORD nonVolatileMemoryRequired, DWORD volatileMemoryRequired);
+
+//! \brief GlobalPlatform2.1.1: Loads an Executable Load File and installs and makes selectable an application of it in one card transaction.
+OPGP_API
+OPGP_ERROR_STATUS GP211_deploy(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						 BYTE checkFreeMemory, PBYTE loadFileBuf, DWORD loadFileBufSize, OPGP_LOAD_FILE_PARAMETERS *loadFileParams,
+						 PBYTE securityDomainAID, DWORD securityDomainAIDLength, BYTE loadFileDataBlockHash[20],
+						 PBYTE executableModuleAID, DWORD executableModuleAIDLength, PBYTE applicationAID,
+						 DWORD applicationAIDLength, BYTE applicationPrivileges,
+						 DWORD volatileDataSpaceLimit, DWORD nonVolatileDataSpaceLimit,
+						 PBYTE installParameters, DWORD installParametersLength,
+						 GP211_RECEIPT_DATA *loadReceiptData, PDWORD loadReceiptDataAvailable,
+						 GP211_RECEIPT_DATA *installReceiptData, PDWORD installReceiptDataAvailable);
+
 //! \brief GlobalPlatform2.1.1: Informs a Security Domain that a associated application will retrieve personalization data.
 OPGP_API
 OPGP_ERROR_STATUS GP211_install_for_personalization(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo,
@@ -889,6 +1212,140 @@ OPGP_API
 OPGP_ERROR_STATUS EMV_CPS11_derive_keys(BYTE baseKeyDiversificationData[10], BYTE masterKey[16],
 							BYTE S_ENC[16], BYTE S_MAC[16], BYTE DEK[16]);
 
+//! \brief Returns the next command APDU of a resumable operation. The command is already wrapped for the secure channel.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_operation_get_command(OPGP_OPERATION *operation, PBYTE capdu, PDWORD capduLength);
+
+//! \brief Passes the response APDU of the last command to a resumable operation.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_operation_process_response(OPGP_OPERATION *operation, PBYTE rapdu, DWORD rapduLength);
+
+//! \brief Executes several resumable operations by interleaving their commands, e.g. on different Logical Channels.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_run_operations(OPGP_CARD_CONTEXT cardContext, OPGP_OPERATION *operations, DWORD operationsLength,
+						OPGP_ERROR_STATUS *results);
+
+//! \brief ISO 7816-4: Opens a further Logical Channel with its own security information.
+OPGP_API
+OPGP_ERROR_STATUS OPGP_open_logical_channel(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, OPGP_LOGICAL_CHANNEL *channel);
+
+//! \brief ISO 7816-4: Closes a Logical Channel opened with #OPGP_open_logical_channel().
+OPGP_API
+OPGP_ERROR_STATUS OPGP_close_logical_channel(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, OPGP_LOGICAL_CHANNEL *channel);
+
+//! \brief GlobalPlatform2.1.1: Starts a resumable mutual authentication. See GP211_mutual_authentication().
+OPGP_API
+OPGP_ERROR_STATUS GP211_begin_mutual_authentication(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, BYTE baseKey[16],
+						   BYTE S_ENC[16], BYTE S_MAC[16],
+						   BYTE DEK[16], BYTE keySetVersion,
+						   BYTE keyIndex, BYTE secureChannelProtocol,
+						   BYTE secureChannelProtocolImpl, BYTE securityLevel,
+						   BYTE derivationMethod,
+						   GP211_SECURITY_INFO *secInfo);
+
+//! \brief GlobalPlatform2.1.1: Starts a resumable GET STATUS. See GP211_get_status().
+OPGP_API
+OPGP_ERROR_STATUS GP211_begin_get_status(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						   BYTE cardElement, GP211_APPLICATION_DATA *applData, GP211_EXECUTABLE_MODULES_DATA *executableData,
+						   PDWORD dataLength);
+
+//! \brief GlobalPlatform2.1.1: Starts a resumable GET STATUS passing each entry to a callback. See GP211_get_status_with_callback().
+OPGP_API
+OPGP_ERROR_STATUS GP211_begin_get_status_with_callback(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						   BYTE cardElement, GP211_GET_STATUS_CALLBACK *callback);
+
+//! \brief GlobalPlatform2.1.1: Starts a resumable GET STATUS with search criteria. See GP211_get_status_with_criteria().
+OPGP_API
+OPGP_ERROR_STATUS GP211_begin_get_status_with_criteria(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						   BYTE cardElement, PBYTE AID, DWORD AIDLength, BYTE format, GP211_GET_STATUS_CALLBACK *callback);
+
+//! \brief GlobalPlatform2.1.1: Starts a resumable LOAD of an Executable Load File buffer. See GP211_load_from_buffer().
+OPGP_API
+OPGP_ERROR_STATUS GP211_begin_load_from_buffer(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				 GP211_DAP_BLOCK *loadFileDataBlockSignature, DWORD loadFileDataBlockSignatureLength,
+				 PBYTE loadFileBuf, DWORD loadFileBufSize,
+				 GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable, OPGP_PROGRESS_CALLBACK *callback);
+
+//! \brief GlobalPlatform2.1.1: Starts a resumable LOAD calculating the Load File Data Block Hash. See GP211_load_from_buffer_with_hash().
+OPGP_API
+OPGP_ERROR_STATUS GP211_begin_load_from_buffer_with_hash(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				 GP211_DAP_BLOCK *loadFileDataBlockSignature, DWORD loadFileDataBlockSignatureLength,
+				 PBYTE loadFileBuf, DWORD loadFileBufSize, BYTE hashAlgorithm, PBYTE hash, PDWORD hashLength,
+				 GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable, OPGP_PROGRESS_CALLBACK *callback);
+
+//! \brief GlobalPlatform2.1.1: Starts a resumable DELETE. See GP211_delete_application().
+OPGP_API
+OPGP_ERROR_STATUS GP211_begin_delete_application(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						OPGP_AID *AIDs, DWORD AIDsLength, GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataLength);
+
+//! \brief GlobalPlatform2.1.1: Starts a resumable INSTALL [for load]. See GP211_install_for_load().
+OPGP_API
+OPGP_ERROR_STATUS GP211_begin_install_for_load(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+					  PBYTE executableLoadFileAID, DWORD executableLoadFileAIDLength, PBYTE securityDomainAID,
+					  DWORD securityDomainAIDLength, BYTE loadFileDataBlockHash[20], BYTE loadToken[128],
+					  DWORD nonVolatileCodeSpaceLimit, DWORD volatileDataSpaceLimit,
+					  DWORD nonVolatileDataSpaceLimit);
+
+//! \brief GlobalPlatform2.1.1: Starts a resumable INSTALL [for install]. See GP211_install_for_install().
+OPGP_API
+OPGP_ERROR_STATUS GP211_begin_install_for_install(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						 PBYTE executableLoadFileAID, DWORD executableLoadFileAIDLength,
+						 PBYTE executableModuleAID,
+						 DWORD executableModuleAIDLength, PBYTE applicationAID,
+						 DWORD applicationAIDLength, BYTE applicationPrivileges,
+						 DWORD volatileDataSpaceLimit, DWORD nonVolatileDataSpaceLimit,
+						 PBYTE installParameters, DWORD installParametersLength,
+						 BYTE installToken[128], GP211_RECEIPT_DATA *receiptData, PDWORD receiptDataAvailable);
+
+//! \brief GlobalPlatform2.1.1: Starts a resumable INSTALL [for install and make selectable]. See GP211_install_for_install_and_make_selectable().
+OPGP_API
+OPGP_ERROR_STATUS GP211_begin_install_for_install_and_make_selectable(OPGP_OPERATION *operation, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+						 PBYTE executableLoadFileAID, DWORD executableLoadFileAIDLength, PBYTE executableModuleAID,
+						 DWORD executableModuleAIDLength, PBYTE applicationAID,
+						 DWORD applicationAIDLength, BYTE applicationPrivileges,
+						 DWORD volatileDataSpaceLimit, DWORD nonVolatileDataSpaceLimit,
+						 PBYTE installParameters, DWORD installParametersLength,
+						 BYTE installToken[128], GP211_RECEIPT_DATA *receiptData,
+						 PDWORD receiptDataAvailable);
+
+//! \brief GlobalPlatform2.1.1: Starts a script of commands wrapped in advance for a predicted Sequence Counter.
+OPGP_API
+OPGP_ERROR_STATUS GP211_begin_wrapped_script(GP211_WRAPPED_SCRIPT *script, PBYTE buffer, DWORD bufferSize,
+								  PBYTE cardIdentifier, DWORD cardIdentifierLength, PBYTE AID, DWORD AIDLength,
+								  BYTE baseKey[16], BYTE S_ENC[16], BYTE S_MAC[16], BYTE DEK[16],
+								  BYTE secureChannelProtocolImpl, BYTE securityLevel, BYTE sequenceCounter[2]);
+
+//! \brief GlobalPlatform2.1.1: Wraps a command APDU and adds it to a pre-wrapped script.
+OPGP_API
+OPGP_ERROR_STATUS GP211_add_wrapped_script_command(GP211_WRAPPED_SCRIPT *script, PBYTE capdu, DWORD capduLength);
+
+//! \brief GlobalPlatform2.1.1: Wraps all commands of a resumable operation and adds them to a pre-wrapped script.
+OPGP_API
+OPGP_ERROR_STATUS GP211_add_wrapped_script_operation(GP211_WRAPPED_SCRIPT *script, OPGP_OPERATION *operation);
+
+//! \brief GlobalPlatform2.1.1: Completes a pre-wrapped script.
+OPGP_API
+OPGP_ERROR_STATUS GP211_end_wrapped_script(GP211_WRAPPED_SCRIPT *script);
+
+//! \brief GlobalPlatform2.1.1: Appends a completed pre-wrapped script to a file.
+OPGP_API
+OPGP_ERROR_STATUS GP211_append_wrapped_script_to_file(GP211_WRAPPED_SCRIPT *script, OPGP_CSTRING fileName);
+
+//! \brief GlobalPlatform2.1.1: Parses the header of a pre-wrapped script.
+OPGP_API
+OPGP_ERROR_STATUS GP211_read_wrapped_script_header(PBYTE script, DWORD scriptLength, GP211_WRAPPED_SCRIPT_HEADER *header);
+
+//! \brief GlobalPlatform2.1.1: Sends a pre-wrapped script to the card without host cryptography.
+OPGP_API
+OPGP_ERROR_STATUS GP211_send_wrapped_script(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo,
+								  PBYTE script, DWORD scriptLength, PDWORD failedCommand);
+
+//! \brief GlobalPlatform2.1.1: Finds the pre-wrapped script of a card in a file and sends it.
+OPGP_API
+OPGP_ERROR_STATUS GP211_send_wrapped_script_from_file(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo,
+								  OPGP_CSTRING fileName, PBYTE cardIdentifier, DWORD cardIdentifierLength,
+								  PDWORD failedCommand);
+
 #ifdef __cplusplus
 }
 #endif
@@ -140,6 +140,10 @@ extern "C"
 #define GP211_KEY_TYPE_DES_ECB 0x83 //!<'83' DES in ECB mode.
 #define GP211_KEY_TYPE_DES_CBC 0x84 //!<'84' DES in CBC mode.
 
+#define GP211_HASH_ALGORITHM_SHA1 0x01 //!< SHA-1 Load File Data Block Hash. Used up to GlobalPlatform 2.2.
+#define GP211_HASH_ALGORITHM_SHA256 0x02 //!< SHA-256 Load File Data Block Hash. Used by newer GlobalPlatform versions.
+#define GP211_MAX_HASH_LENGTH 32 //!< The maximum length of a Load File Data Block Hash.
+
 #define OP201_SECURITY_LEVEL_ENC_MAC 0x03 //!< Command messages are signed and encrypted.
 #define OP201_SECURITY_LEVEL_MAC 0x01 //!< Command messages are signed.
 #define OP201_SECURITY_LEVEL_PLAIN 0x00 //!< Command messages are plaintext.
@@ -175,7 +179,7 @@ typedef struct {
 	BYTE C_MACSessionKey[16]; //!< The Secure Channel C-MAC session key.
 	BYTE R_MACSessionKey[16]; //!< The Secure Channel R-MAC session key.
 	BYTE encryptionSessionKey[16]; //!< The Secure Channel encryption session key.
-	BYTE dataEncryptionSessionKey[16]; //!< Secure Channel data encryption key.
+	BYTE dataEncryptionSessionKey[16]; //!< Secure Channel data encryption key. The DEK session key for SCP02. The static DEK for SCP01 and SCP03, i.e. its key handle if a crypto provider is set.
     /* 
      * Philip Wendland: lastC_MAC must be 16 Bytes for SCP03 because the MAC chaining value 
      * for MAC code generation is 16 Bytes (according to GP 2.2 Amendment D), not 8.
@@ -34,6 +34,8 @@
 #define _tcsncpy strncpy
 #define _tcscpy strcpy
 #define _tcslen strlen
+#define _tcscmp strcmp
+#define _tcsstr strstr
 #define _tprintf printf
 #define _tfopen fopen
 #define _stprintf sprintf
@@ -0,0 +1,305 @@
+/*  Copyright (c) 2026, GlobalPlatform Library contributors
+ *  This file is part of GlobalPlatform.
+ *
+ *  GlobalPlatform is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GlobalPlatform is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Micro benchmarks of the host side cryptography. No card is needed.
+ * The results are written as JSON, one object per benchmark with the operations per second
+ * and the latency percentiles in nanoseconds.
+ *
+ * Usage: globalplatformBenchmark [-n iterations] [-f filter] [-o file]
+ */
+
+#ifdef WIN32
+#include "stdafx.h"
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globalplatform/globalplatform.h"
+#include "crypto.h"
+
+/**
+ * Default number of measured iterations of each benchmark.
+ */
+#define DEFAULT_ITERATIONS 10000
+
+/**
+ * Number of not measured iterations before each benchmark.
+ */
+#define WARMUP_ITERATIONS 100
+
+/**
+ * Length of the data field of the benchmarked commands. The size of a typical LOAD block.
+ */
+#define DATA_LENGTH 128
+
+/**
+ * The library version the results belong to. Set by the build.
+ */
+#ifndef BENCHMARK_VERSION
+#define BENCHMARK_VERSION "unknown"
+#endif
+
+static BYTE key[16] = {0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F};
+static BYTE chainingValue[16];
+static BYTE cardChallenge[8] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+static BYTE hostChallenge[8] = {0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18};
+static BYTE sequenceCounter[2] = {0x00, 0x2A};
+static BYTE constant[2] = {0x01, 0x01};
+static BYTE baseKeyDiversificationData[10] = {0x00, 0x00, 0x47, 0x90, 0x50, 0x12, 0x34, 0x56, 0x78, 0x9A};
+static BYTE data[DATA_LENGTH];
+static BYTE apduCommand[5+DATA_LENGTH];
+static BYTE result[256];
+static GP211_SECURITY_INFO secInfo;
+
+/**
+ * A benchmark.
+ */
+typedef struct {
+	const char *name; //!< The name of the benchmark.
+	BYTE secureChannelProtocol; //!< The Secure Channel Protocol for wrap_command() benchmarks or 0.
+	BYTE secureChannelProtocolImpl; //!< The Secure Channel Protocol implementation.
+	BYTE securityLevel; //!< The security level.
+	OPGP_ERROR_STATUS (*run)(); //!< Executes one operation.
+} BENCHMARK;
+
+static OPGP_ERROR_STATUS bench_calculate_MAC() {
+	return calculate_MAC(key, data, DATA_LENGTH, chainingValue, result);
+}
+
+static OPGP_ERROR_STATUS bench_calculate_MAC_aes() {
+	return calculate_MAC_aes(key, data, DATA_LENGTH, result);
+}
+
+static OPGP_ERROR_STATUS bench_calculate_CMAC_aes() {
+	return calculate_CMAC_aes(key, data, DATA_LENGTH, chainingValue, result);
+}
+
+static OPGP_ERROR_STATUS bench_calculate_enc_cbc() {
+	int resultLength = sizeof(result);
+	return calculate_enc_cbc(key, data, DATA_LENGTH, result, &resultLength);
+}
+
+static OPGP_ERROR_STATUS bench_calculate_enc_cbc_SCP02() {
+	int resultLength = sizeof(result);
+	return calculate_enc_cbc_SCP02(key, data, DATA_LENGTH, result, &resultLength);
+}
+
+static OPGP_ERROR_STATUS bench_create_session_key_SCP01() {
+	return create_session_key_SCP01(key, cardChallenge, hostChallenge, result);
+}
+
+static OPGP_ERROR_STATUS bench_create_session_key_SCP02() {
+	return create_session_key_SCP02(key, constant, sequenceCounter, result);
+}
+
+static OPGP_ERROR_STATUS bench_create_session_key_SCP03() {
+	return create_session_key_SCP03(key, 0x04, cardChallenge, hostChallenge, result);
+}
+
+static OPGP_ERROR_STATUS bench_wrap_command() {
+	DWORD resultLength = sizeof(result);
+	return wrap_command(apduCommand, sizeof(apduCommand), result, &resultLength, &secInfo);
+}
+
+static OPGP_ERROR_STATUS bench_VISA2_derive_keys() {
+	return VISA2_derive_keys(baseKeyDiversificationData, key, result, result+16, result+32);
+}
+
+static OPGP_ERROR_STATUS bench_VISA1_derive_keys() {
+	return VISA1_derive_keys(baseKeyDiversificationData+2, key, result, result+16, result+32);
+}
+
+static OPGP_ERROR_STATUS bench_EMV_CPS11_derive_keys() {
+	return EMV_CPS11_derive_keys(baseKeyDiversificationData, key, result, result+16, result+32);
+}
+
+static BENCHMARK benchmarks[] = {
+	{"calculate_MAC", 0, 0, 0, bench_calculate_MAC},
+	{"calculate_MAC_aes", 0, 0, 0, bench_calculate_MAC_aes},
+	{"calculate_CMAC_aes", 0, 0, 0, bench_calculate_CMAC_aes},
+	{"calculate_enc_cbc", 0, 0, 0, bench_calculate_enc_cbc},
+	{"calculate_enc_cbc_SCP02", 0, 0, 0, bench_calculate_enc_cbc_SCP02},
+	{"create_session_key_SCP01", 0, 0, 0, bench_create_session_key_SCP01},
+	{"create_session_key_SCP02", 0, 0, 0, bench_create_session_key_SCP02},
+	{"create_session_key_SCP03", 0, 0, 0, bench_create_session_key_SCP03},
+	{"wrap_command_SCP01_C_MAC", GP211_SCP01, GP211_SCP01_IMPL_i05, GP211_SCP01_SECURITY_LEVEL_C_MAC, bench_wrap_command},
+	{"wrap_command_SCP01_C_DEC_C_MAC", GP211_SCP01, GP211_SCP01_IMPL_i05, GP211_SCP01_SECURITY_LEVEL_C_DEC_C_MAC, bench_wrap_command},
+	{"wrap_command_SCP02_C_MAC", GP211_SCP02, GP211_SCP02_IMPL_i55, GP211_SCP02_SECURITY_LEVEL_C_MAC, bench_wrap_command},
+	{"wrap_command_SCP02_C_DEC_C_MAC", GP211_SCP02, GP211_SCP02_IMPL_i55, GP211_SCP02_SECURITY_LEVEL_C_DEC_C_MAC, bench_wrap_command},
+	{"wrap_command_SCP02_C_MAC_R_MAC", GP211_SCP02, GP211_SCP02_IMPL_i55, GP211_SCP02_SECURITY_LEVEL_C_MAC_R_MAC, bench_wrap_command},
+	{"wrap_command_SCP02_C_DEC_C_MAC_R_MAC", GP211_SCP02, GP211_SCP02_IMPL_i55, GP211_SCP02_SECURITY_LEVEL_C_DEC_C_MAC_R_MAC, bench_wrap_command},
+	{"wrap_command_SCP03_C_MAC", GP211_SCP03, GP211_SCP03_IMPL_i00, GP211_SCP03_SECURITY_LEVEL_C_MAC, bench_wrap_command},
+	{"VISA2_derive_keys", 0, 0, 0, bench_VISA2_derive_keys},
+	{"VISA1_derive_keys", 0, 0, 0, bench_VISA1_derive_keys},
+	{"EMV_CPS11_derive_keys", 0, 0, 0, bench_EMV_CPS11_derive_keys}
+};
+
+/**
+ * Returns a monotonic time stamp in nanoseconds.
+ */
+static double now_ns() {
+#ifdef WIN32
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	if (frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart * 1e9 / (double)frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#endif
+}
+
+static int compare_double(const void *a, const void *b) {
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * Returns the percentile of sorted latencies with the nearest rank method.
+ */
+static double percentile(double *latencies, DWORD length, DWORD p) {
+	DWORD rank = (DWORD)(((double)p / 100.0) * length + 0.5);
+	if (rank < 1) {
+		rank = 1;
+	}
+	if (rank > length) {
+		rank = length;
+	}
+	return latencies[rank-1];
+}
+
+/**
+ * Initializes the security information of a wrap_command() benchmark with a freshly opened secure channel.
+ */
+static void init_security_info(BENCHMARK *benchmark) {
+	memset(&secInfo, 0, sizeof(secInfo));
+	secInfo.secureChannelProtocol = benchmark->secureChannelProtocol;
+	secInfo.secureChannelProtocolImpl = benchmark->secureChannelProtocolImpl;
+	secInfo.securityLevel = benchmark->securityLevel;
+	memcpy(secInfo.C_MACSessionKey, key, 16);
+	memcpy(secInfo.R_MACSessionKey, key, 16);
+	memcpy(secInfo.encryptionSessionKey, key, 16);
+	memcpy(secInfo.dataEncryptionSessionKey, key, 16);
+}
+
+/**
+ * Runs a benchmark and writes the result.
+ * \return 0 on success, -1 if the operation failed.
+ */
+static int run_benchmark(FILE *out, BENCHMARK *benchmark, DWORD iterations, double *latencies, int first) {
+	OPGP_ERROR_STATUS status;
+	DWORD i;
+	double start, stop, total = 0;
+	init_security_info(benchmark);
+	for (i=0; i<WARMUP_ITERATIONS; i++) {
+		status = benchmark->run();
+		if (OPGP_ERROR_CHECK(status)) {
+			fprintf(stderr, "%s failed: %s\n", benchmark->name, status.errorMessage);
+			return -1;
+		}
+	}
+	for (i=0; i<iterations; i++) {
+		start = now_ns();
+		benchmark->run();
+		stop = now_ns();
+		latencies[i] = stop - start;
+		total += latencies[i];
+	}
+	qsort(latencies, iterations, sizeof(double), compare_double);
+	fprintf(out, "%s    {\"name\": \"%s\", \"iterations\": %lu, \"ops_per_second\": %.1f, "
+		"\"mean_ns\": %.1f, \"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f}",
+		first ? "" : ",\n", benchmark->name, (unsigned long)iterations, iterations * 1e9 / total,
+		total / iterations, percentile(latencies, iterations, 50), percentile(latencies, iterations, 90),
+		percentile(latencies, iterations, 99), latencies[iterations-1]);
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	DWORD iterations = DEFAULT_ITERATIONS;
+	const char *filter = NULL;
+	const char *outputFileName = NULL;
+	FILE *out = stdout;
+	double *latencies;
+	DWORD i;
+	int first = 1;
+	int rv = 0;
+	for (i=1; i<(DWORD)argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i+1 < (DWORD)argc) {
+			iterations = (DWORD)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "-f") == 0 && i+1 < (DWORD)argc) {
+			filter = argv[++i];
+		} else if (strcmp(argv[i], "-o") == 0 && i+1 < (DWORD)argc) {
+			outputFileName = argv[++i];
+		} else {
+			fprintf(stderr, "Usage: %s [-n iterations] [-f filter] [-o file]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (iterations == 0) {
+		iterations = 1;
+	}
+	latencies = (double *)malloc(sizeof(double) * iterations);
+	if (latencies == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		return EXIT_FAILURE;
+	}
+	if (outputFileName != NULL) {
+		out = fopen(outputFileName, "w");
+		if (out == NULL) {
+			fprintf(stderr, "Cannot open %s.\n", outputFileName);
+			free(latencies);
+			return EXIT_FAILURE;
+		}
+	}
+	for (i=0; i<DATA_LENGTH; i++) {
+		data[i] = (BYTE)i;
+	}
+	// LOAD command with a full data field
+	apduCommand[0] = 0x80;
+	apduCommand[1] = 0xE8;
+	apduCommand[2] = 0x00;
+	apduCommand[3] = 0x00;
+	apduCommand[4] = DATA_LENGTH;
+	memcpy(apduCommand+5, data, DATA_LENGTH);
+
+	fprintf(out, "{\n  \"version\": \"%s\",\n  \"data_length\": %d,\n  \"benchmarks\": [\n", BENCHMARK_VERSION, DATA_LENGTH);
+	for (i=0; i<sizeof(benchmarks)/sizeof(BENCHMARK); i++) {
+		if (filter != NULL && strstr(benchmarks[i].name, filter) == NULL) {
+			continue;
+		}
+		if (run_benchmark(out, benchmarks + i, iterations, latencies, first)) {
+			rv = EXIT_FAILURE;
+			continue;
+		}
+		first = 0;
+	}
+	fprintf(out, "\n  ]\n}\n");
+	if (out != stdout) {
+		fclose(out);
+	}
+	free(latencies);
+	return rv;
+}
@@ -0,0 +1,108 @@
+/*  Copyright (c) 2026, GlobalPlatform Library contributors
+ *  This file is part of GlobalPlatform.
+ *
+ *  GlobalPlatform is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GlobalPlatform is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Known answer tests of the internal cryptographic functions. They are only visible in the static library.
+ */
+
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globalplatform/globalplatform.h"
+#include "crypto.h"
+
+/**
+ * The AES-128 key of the CMAC examples of NIST SP 800-38B.
+ */
+static BYTE cmacKey[16] = {0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C};
+
+/**
+ * The 64 byte message of the CMAC examples of NIST SP 800-38B. The examples use the first 0, 16, 40 and 64 bytes.
+ */
+static BYTE cmacMessage[64] = {
+	0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96, 0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+	0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C, 0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+	0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11, 0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+	0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17, 0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10};
+
+static BYTE cmacEmpty[16] = {0xBB, 0x1D, 0x69, 0x29, 0xE9, 0x59, 0x37, 0x28, 0x7F, 0xA3, 0x7D, 0x12, 0x9B, 0x75, 0x67, 0x46};
+static BYTE cmac16[16] = {0x07, 0x0A, 0x16, 0xB4, 0x6B, 0x4D, 0x41, 0x44, 0xF7, 0x9B, 0xDD, 0x9D, 0xD0, 0x4A, 0x28, 0x7C};
+static BYTE cmac40[16] = {0xDF, 0xA6, 0x67, 0x47, 0xDE, 0x9A, 0xE6, 0x30, 0x30, 0xCA, 0x32, 0x61, 0x14, 0x97, 0xC8, 0x27};
+static BYTE cmac64[16] = {0x51, 0xF0, 0xBE, 0xBF, 0x7E, 0x3B, 0x9D, 0x92, 0xFC, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3C, 0xFE};
+
+/**
+ * Tests the cached CMAC key state with the examples of NIST SP 800-38B. The first 16 bytes of the message
+ * are passed as chaining value like the last C-MAC of SCP03.
+ */
+START_TEST (test_calculate_CMAC_aes_with_state) {
+	OPGP_ERROR_STATUS status;
+	BYTE mac[16];
+	BYTE reference[16];
+
+	// empty message, the only block is the padded block with K2
+	status = calculate_CMAC_aes_with_state(cmacKey, cmacMessage, 0, NULL, mac);
+	fail_unless(status.errorStatus == OPGP_ERROR_STATUS_SUCCESS, "CMAC of the empty message failed: %s", status.errorMessage);
+	fail_unless(memcmp(mac, cmacEmpty, 16) == 0, "CMAC of the empty message is wrong");
+
+	status = calculate_CMAC_aes_with_state(cmacKey, cmacMessage, 16, NULL, mac);
+	fail_unless(status.errorStatus == OPGP_ERROR_STATUS_SUCCESS, "CMAC failed: %s", status.errorMessage);
+	fail_unless(memcmp(mac, cmac16, 16) == 0, "CMAC of a complete block is wrong");
+
+	// empty message after the chaining value, the chaining value is the last complete block with K1
+	status = calculate_CMAC_aes_with_state(cmacKey, cmacMessage+16, 0, cmacMessage, mac);
+	fail_unless(status.errorStatus == OPGP_ERROR_STATUS_SUCCESS, "CMAC failed: %s", status.errorMessage);
+	fail_unless(memcmp(mac, cmac16, 16) == 0, "CMAC of the chaining value only is wrong");
+	status = calculate_CMAC_aes(cmacKey, cmacMessage+16, 0, cmacMessage, reference);
+	fail_unless(status.errorStatus == OPGP_ERROR_STATUS_SUCCESS, "CMAC failed: %s", status.errorMessage);
+	fail_unless(memcmp(mac, reference, 16) == 0, "CMAC differs from calculate_CMAC_aes()");
+
+	// padded last block
+	status = calculate_CMAC_aes_with_state(cmacKey, cmacMessage+16, 24, cmacMessage, mac);
+	fail_unless(status.errorStatus == OPGP_ERROR_STATUS_SUCCESS, "CMAC failed: %s", status.errorMessage);
+	fail_unless(memcmp(mac, cmac40, 16) == 0, "CMAC with a padded last block is wrong");
+
+	// complete last block
+	status = calculate_CMAC_aes_with_state(cmacKey, cmacMessage+16, 48, cmacMessage, mac);
+	fail_unless(status.errorStatus == OPGP_ERROR_STATUS_SUCCESS, "CMAC failed: %s", status.errorMessage);
+	fail_unless(memcmp(mac, cmac64, 16) == 0, "CMAC with a complete last block is wrong");
+
+	// the state is computed again after the session ended
+	release_CMAC_key_states(cmacKey);
+	status = calculate_CMAC_aes_with_state(cmacKey, cmacMessage+16, 24, cmacMessage, mac);
+	fail_unless(status.errorStatus == OPGP_ERROR_STATUS_SUCCESS, "CMAC failed: %s", status.errorMessage);
+	fail_unless(memcmp(mac, cmac40, 16) == 0, "CMAC after releasing the key state is wrong");
+	release_CMAC_key_states(NULL);
+} END_TEST
+
+Suite * GlobalPlatformCrypto_suite(void) {
+	Suite *s = suite_create("GlobalPlatformCrypto");
+	TCase *tc_kat = tcase_create("KnownAnswer");
+	tcase_add_test (tc_kat, test_calculate_CMAC_aes_with_state);
+	suite_add_tcase(s, tc_kat);
+	return s;
+}
+
+int main(void) {
+	int number_failed;
+	Suite *s = GlobalPlatformCrypto_suite();
+	SRunner *sr = srunner_create(s);
+
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
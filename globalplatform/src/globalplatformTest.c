@@ -212,8 +212,10 @@ static OPGP_ERROR_STATUS internal_delete() {
 	memcpy(deleteApplet.AID, appletAID, sizeof(appletAID));
 	deleteApplet.AIDLength = sizeof(appletAID);
 	// first try to delete applet
+	receiptDataLength = 1;
 	GP211_delete_application(cardContext, cardInfo, &securityInfo211, &deleteApplet, 1, &receiptData, &receiptDataLength);
 	// now delete package
+	receiptDataLength = 1;
 	status = GP211_delete_application(cardContext, cardInfo, &securityInfo211, &deletePackage, 1, &receiptData, &receiptDataLength);
 	if (OPGP_ERROR_CHECK(status)) {
 		return status;
@@ -583,10 +585,1183 @@ START_TEST (test_install_callback) {
 		}
 	}END_TEST
 
+/**
+ * Tests that the software crypto provider resolving key handles returns the same keys as the library
+ * calculating with the key values.
+ */
+START_TEST (test_software_crypto_provider) {
+		OPGP_ERROR_STATUS status;
+		OPGP_SOFTWARE_CRYPTO_PROVIDER softwareProvider;
+		OPGP_CRYPTO_PROVIDER provider;
+		BYTE masterKey[16] = {0x40,0x41,0x42,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4A,0x4B,0x4C,0x4D,0x4E,0x4F};
+		BYTE masterKeyHandle[16] = {'m','a','s','t','e','r',0,0,0,0,0,0,0,0,0,1};
+		BYTE sEncHandle[16] = {'s','-','e','n','c',0,0,0,0,0,0,0,0,0,0,1};
+		BYTE sMacHandle[16] = {'s','-','m','a','c',0,0,0,0,0,0,0,0,0,0,1};
+		BYTE dekHandle[16] = {'d','e','k',0,0,0,0,0,0,0,0,0,0,0,0,1};
+		BYTE keyDiversificationData[10] = {0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09};
+		BYTE sequenceCounter[2] = {0x00,0x2A};
+		BYTE S_ENC[16], S_MAC[16], DEK[16];
+		BYTE providerS_ENC[16], providerS_MAC[16], providerDEK[16];
+		GP211_SECURITY_INFO secInfo, providerSecInfo;
+
+		// local path
+		status = VISA2_derive_keys(keyDiversificationData, masterKey, S_ENC, S_MAC, DEK);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not derive keys: %s", status.errorMessage);
+		}
+		status = GP211_init_implicit_secure_channel((PBYTE)appletAID, sizeof(appletAID), NULL, S_ENC, S_MAC, DEK,
+			GP211_SCP02_IMPL_i0B, sequenceCounter, &secInfo);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not create session keys: %s", status.errorMessage);
+		}
+
+		// the same keys known by the provider only by their handles
+		OPGP_software_crypto_provider_init(&softwareProvider, &provider);
+		OPGP_software_crypto_provider_add_key(&softwareProvider, masterKeyHandle, masterKey);
+		OPGP_software_crypto_provider_add_key(&softwareProvider, sEncHandle, S_ENC);
+		OPGP_software_crypto_provider_add_key(&softwareProvider, sMacHandle, S_MAC);
+		OPGP_software_crypto_provider_add_key(&softwareProvider, dekHandle, DEK);
+		status = OPGP_set_crypto_provider(&provider);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not set crypto provider: %s", status.errorMessage);
+		}
+		status = VISA2_derive_keys(keyDiversificationData, masterKeyHandle, providerS_ENC, providerS_MAC, providerDEK);
+		if (OPGP_ERROR_CHECK(status)) {
+			OPGP_set_crypto_provider(NULL);
+			fail("Could not derive keys with the provider: %s", status.errorMessage);
+		}
+		status = GP211_init_implicit_secure_channel((PBYTE)appletAID, sizeof(appletAID), NULL, sEncHandle, sMacHandle,
+			dekHandle, GP211_SCP02_IMPL_i0B, sequenceCounter, &providerSecInfo);
+		OPGP_set_crypto_provider(NULL);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not create session keys with the provider: %s", status.errorMessage);
+		}
+
+		fail_unless(memcmp(S_ENC, providerS_ENC, 16) == 0, "Incorrect derived S-ENC");
+		fail_unless(memcmp(S_MAC, providerS_MAC, 16) == 0, "Incorrect derived S-MAC");
+		fail_unless(memcmp(DEK, providerDEK, 16) == 0, "Incorrect derived DEK");
+		fail_unless(memcmp(secInfo.encryptionSessionKey, providerSecInfo.encryptionSessionKey, 16) == 0, "Incorrect encryption session key");
+		fail_unless(memcmp(secInfo.C_MACSessionKey, providerSecInfo.C_MACSessionKey, 16) == 0, "Incorrect C-MAC session key");
+		fail_unless(memcmp(secInfo.R_MACSessionKey, providerSecInfo.R_MACSessionKey, 16) == 0, "Incorrect R-MAC session key");
+		fail_unless(memcmp(secInfo.dataEncryptionSessionKey, providerSecInfo.dataEncryptionSessionKey, 16) == 0, "Incorrect DEK session key");
+		// the ICV is a C-MAC calculated locally with the session key returned by the provider
+		fail_unless(memcmp(secInfo.lastC_MAC, providerSecInfo.lastC_MAC, 8) == 0, "Incorrect ICV");
+} END_TEST
+
+/**
+ * Fetches the next command of a resumable operation, compares it with the expected command and passes a canned response.
+ * \param *operation [in, out] The operation.
+ * \param expectedCommand [in] The expected command APDU. NULL if the command is not compared.
+ * \param expectedCommandLength [in] The length of the expected command APDU.
+ * \param response [in] The canned response APDU.
+ * \param responseLength [in] The length of the response APDU.
+ * \return The status of processing the response.
+ */
+static OPGP_ERROR_STATUS exchange_canned_apdu(OPGP_OPERATION *operation, const BYTE *expectedCommand, DWORD expectedCommandLength,
+		const BYTE *response, DWORD responseLength) {
+	OPGP_ERROR_STATUS status;
+	BYTE capdu[261];
+	DWORD capduLength = sizeof(capdu);
+	BYTE rapdu[258];
+	status = OPGP_operation_get_command(operation, capdu, &capduLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		fail("Could not get command: %s", status.errorMessage);
+	}
+	if (expectedCommand != NULL) {
+		fail_unless(capduLength == expectedCommandLength, "Incorrect command length %d", (int)capduLength);
+		fail_unless(memcmp(capdu, expectedCommand, expectedCommandLength) == 0, "Incorrect command");
+	}
+	memcpy(rapdu, response, responseLength);
+	return OPGP_operation_process_response(operation, rapdu, responseLength);
+}
+
+/**
+ * Card info of the offline tests.
+ */
+static OPGP_CARD_INFO offlineCardInfo(void) {
+	OPGP_CARD_INFO offlineCardInfo;
+	memset(&offlineCardInfo, 0, sizeof(offlineCardInfo));
+	offlineCardInfo.specVersion = GP_211;
+	return offlineCardInfo;
+}
+
+/**
+ * Replaces the random host challenge of a begun mutual authentication, so the known answers apply.
+ */
+static void set_host_challenge(OPGP_OPERATION *operation, const BYTE hostChallenge[8]) {
+	memcpy(operation->data.mutualAuthentication.hostChallenge, hostChallenge, 8);
+	memcpy(operation->command+5, hostChallenge, 8);
+}
+
+/**
+ * Returns 1 if the buffer only contains zeros.
+ */
+static int is_cleared(const BYTE *buffer, DWORD bufferLength) {
+	DWORD i;
+	for (i=0; i<bufferLength; i++) {
+		if (buffer[i] != 0) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Tests the SCP03 mutual authentication state machine with canned INITIALIZE UPDATE and EXTERNAL AUTHENTICATE responses.
+ * The session keys, cryptograms and C-MACs are known answers calculated independently of the library.
+ */
+START_TEST (test_operation_mutual_authentication) {
+		OPGP_ERROR_STATUS status;
+		OPGP_OPERATION operation;
+		GP211_SECURITY_INFO secInfo;
+		BYTE S_ENC[16] = {0x40,0x41,0x42,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4A,0x4B,0x4C,0x4D,0x4E,0x4F};
+		BYTE S_MAC[16] = {0x50,0x51,0x52,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5A,0x5B,0x5C,0x5D,0x5E,0x5F};
+		BYTE DEK[16] = {0x60,0x61,0x62,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6A,0x6B,0x6C,0x6D,0x6E,0x6F};
+		BYTE hostChallenge[8] = {0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08};
+		BYTE sessionMacKey[16] = {0x94,0xD7,0x5E,0x43,0xD0,0x54,0x20,0x72,0xCC,0x3A,0x10,0x5E,0x02,0x7B,0x4C,0x7D};
+		BYTE sessionEncKey[16] = {0xF7,0x60,0xBF,0x07,0x6F,0xC4,0x5C,0xCF,0xC9,0xC9,0x8C,0x29,0xE7,0x0A,0xD8,0x59};
+		BYTE initializeUpdate[] = {0x80,0x50,0x30,0x00,0x08,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x00};
+		// key diversification data, key information, card challenge C1..C8, card cryptogram
+		BYTE response[] = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x30,GP211_SCP03,GP211_SCP03_IMPL_i00,
+			0xC1,0xC2,0xC3,0xC4,0xC5,0xC6,0xC7,0xC8,0x6B,0xA8,0x96,0x2E,0xBE,0x9B,0x4A,0x75,0x90,0x00};
+		// host cryptogram and C-MAC over the zero chaining value
+		BYTE externalAuthenticate[] = {0x84,0x82,GP211_SCP03_SECURITY_LEVEL_C_MAC,0x00,0x10,
+			0x93,0xB1,0x55,0x2F,0x57,0x03,0xD2,0xA8,0x1F,0x6D,0x2E,0x63,0x0D,0xF8,0x76,0x6A};
+		// C-MAC over the full C-MAC of EXTERNAL AUTHENTICATE
+		BYTE wrappedGetStatus[] = {0x84,0xF2,GP211_STATUS_APPLICATIONS,0x00,0x0A,0x4F,0x00,0xFD,0x6B,0xF5,0x1E,0x77,0x7D,0x96,0x2A};
+		BYTE lastC_MAC[16] = {0x1F,0x6D,0x2E,0x63,0x0D,0xF8,0x76,0x6A,0xAE,0x4F,0xBD,0xA5,0x79,0x4D,0x4A,0x77};
+		BYTE capdu[261];
+		DWORD capduLength = sizeof(capdu);
+		BYTE sw9000[2] = {0x90,0x00};
+		BYTE sw6A88[2] = {0x6A,0x88};
+
+		// referenced key set not found
+		status = GP211_begin_mutual_authentication(&operation, offlineCardInfo(), NULL, S_ENC, S_MAC, DEK, 0x30, 0,
+			GP211_SCP03, GP211_SCP03_IMPL_i00, GP211_SCP03_SECURITY_LEVEL_C_MAC, OPGP_DERIVATION_METHOD_NONE, &secInfo);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin mutual authentication: %s", status.errorMessage);
+		}
+		status = exchange_canned_apdu(&operation, NULL, 0, sw6A88, 2);
+		fail_unless(status.errorCode == OPGP_ISO7816_ERROR_DATA_NOT_FOUND, "Incorrect status 0x%08X", (unsigned int)status.errorCode);
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(is_cleared(operation.data.mutualAuthentication.sMac, 16) && is_cleared(operation.data.mutualAuthentication.sEnc, 16)
+			&& is_cleared(operation.data.mutualAuthentication.dek, 16), "Static keys not cleared");
+
+		// wrong card cryptogram
+		status = GP211_begin_mutual_authentication(&operation, offlineCardInfo(), NULL, S_ENC, S_MAC, DEK, 0x30, 0,
+			GP211_SCP03, GP211_SCP03_IMPL_i00, GP211_SCP03_SECURITY_LEVEL_C_MAC, OPGP_DERIVATION_METHOD_NONE, &secInfo);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin mutual authentication: %s", status.errorMessage);
+		}
+		set_host_challenge(&operation, hostChallenge);
+		response[21] ^= 0x01;
+		status = exchange_canned_apdu(&operation, initializeUpdate, sizeof(initializeUpdate), response, sizeof(response));
+		response[21] ^= 0x01;
+		fail_unless(status.errorCode == OPGP_ERROR_CARD_CRYPTOGRAM_VERIFICATION, "Incorrect status 0x%08X", (unsigned int)status.errorCode);
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(is_cleared(operation.data.mutualAuthentication.sMac, 16) && is_cleared(operation.data.mutualAuthentication.sEnc, 16)
+			&& is_cleared(operation.data.mutualAuthentication.dek, 16), "Static keys not cleared");
+
+		status = GP211_begin_mutual_authentication(&operation, offlineCardInfo(), NULL, S_ENC, S_MAC, DEK, 0x30, 0,
+			GP211_SCP03, GP211_SCP03_IMPL_i00, GP211_SCP03_SECURITY_LEVEL_C_MAC, OPGP_DERIVATION_METHOD_NONE, &secInfo);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin mutual authentication: %s", status.errorMessage);
+		}
+		set_host_challenge(&operation, hostChallenge);
+		status = exchange_canned_apdu(&operation, initializeUpdate, sizeof(initializeUpdate), response, sizeof(response));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not process INITIALIZE UPDATE response: %s", status.errorMessage);
+		}
+		status = exchange_canned_apdu(&operation, externalAuthenticate, sizeof(externalAuthenticate), sw9000, 2);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not process EXTERNAL AUTHENTICATE response: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(memcmp(secInfo.C_MACSessionKey, sessionMacKey, 16) == 0, "Incorrect S-MAC session key");
+		fail_unless(memcmp(secInfo.encryptionSessionKey, sessionEncKey, 16) == 0, "Incorrect S-ENC session key");
+		fail_unless(memcmp(secInfo.lastC_MAC, lastC_MAC, 16) == 0, "Incorrect chaining value");
+		fail_unless(secInfo.securityLevel == GP211_SCP03_SECURITY_LEVEL_C_MAC, "Incorrect security level");
+		fail_unless(is_cleared(operation.data.mutualAuthentication.baseKey, 16) && is_cleared(operation.data.mutualAuthentication.sMac, 16)
+			&& is_cleared(operation.data.mutualAuthentication.sEnc, 16) && is_cleared(operation.data.mutualAuthentication.dek, 16),
+			"Static keys not cleared");
+		fail_unless(is_cleared((PBYTE)operation.data.mutualAuthentication.pendingRequests, sizeof(operation.data.mutualAuthentication.pendingRequests)),
+			"Session key requests not cleared");
+		status = OPGP_operation_get_command(&operation, capdu, &capduLength);
+		fail_unless(status.errorCode == OPGP_ERROR_OPERATION_FINISHED, "Finished operation returned a command");
+
+		// the next command is MACed with the chaining value of the EXTERNAL AUTHENTICATE C-MAC
+		{
+			OPGP_OPERATION getStatus;
+			GP211_APPLICATION_DATA applData[1];
+			DWORD applDataLength = 1;
+			status = GP211_begin_get_status(&getStatus, offlineCardInfo(), &secInfo, GP211_STATUS_APPLICATIONS, applData, NULL, &applDataLength);
+			if (OPGP_ERROR_CHECK(status)) {
+				fail("Could not begin GET STATUS: %s", status.errorMessage);
+			}
+			capduLength = sizeof(capdu);
+			status = OPGP_operation_get_command(&getStatus, capdu, &capduLength);
+			if (OPGP_ERROR_CHECK(status)) {
+				fail("Could not get GET STATUS: %s", status.errorMessage);
+			}
+			fail_unless(capduLength >= sizeof(wrappedGetStatus) && memcmp(capdu, wrappedGetStatus, sizeof(wrappedGetStatus)) == 0,
+				"Incorrect wrapped GET STATUS");
+		}
+} END_TEST
+
+/**
+ * Tests the SCP03 mutual authentication with key handles of the software crypto provider. The provider completes
+ * the S-ENC session key request submitted at the INITIALIZE UPDATE response only when the operation waits for it,
+ * at the EXTERNAL AUTHENTICATE response or when the operation finishes early.
+ */
+START_TEST (test_operation_mutual_authentication_provider) {
+		OPGP_ERROR_STATUS status;
+		OPGP_OPERATION operation;
+		GP211_SECURITY_INFO secInfo;
+		OPGP_SOFTWARE_CRYPTO_PROVIDER softwareProvider;
+		OPGP_CRYPTO_PROVIDER provider;
+		BYTE S_ENC[16] = {0x40,0x41,0x42,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4A,0x4B,0x4C,0x4D,0x4E,0x4F};
+		BYTE S_MAC[16] = {0x50,0x51,0x52,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5A,0x5B,0x5C,0x5D,0x5E,0x5F};
+		BYTE DEK[16] = {0x60,0x61,0x62,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6A,0x6B,0x6C,0x6D,0x6E,0x6F};
+		BYTE sEncHandle[16] = {'s','-','e','n','c',0,0,0,0,0,0,0,0,0,0,3};
+		BYTE sMacHandle[16] = {'s','-','m','a','c',0,0,0,0,0,0,0,0,0,0,3};
+		BYTE dekHandle[16] = {'d','e','k',0,0,0,0,0,0,0,0,0,0,0,0,3};
+		BYTE hostChallenge[8] = {0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08};
+		BYTE sessionMacKey[16] = {0x94,0xD7,0x5E,0x43,0xD0,0x54,0x20,0x72,0xCC,0x3A,0x10,0x5E,0x02,0x7B,0x4C,0x7D};
+		BYTE sessionEncKey[16] = {0xF7,0x60,0xBF,0x07,0x6F,0xC4,0x5C,0xCF,0xC9,0xC9,0x8C,0x29,0xE7,0x0A,0xD8,0x59};
+		BYTE response[] = {0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x30,GP211_SCP03,GP211_SCP03_IMPL_i00,
+			0xC1,0xC2,0xC3,0xC4,0xC5,0xC6,0xC7,0xC8,0x6B,0xA8,0x96,0x2E,0xBE,0x9B,0x4A,0x75,0x90,0x00};
+		BYTE externalAuthenticate[] = {0x84,0x82,GP211_SCP03_SECURITY_LEVEL_C_MAC,0x00,0x10,
+			0x93,0xB1,0x55,0x2F,0x57,0x03,0xD2,0xA8,0x1F,0x6D,0x2E,0x63,0x0D,0xF8,0x76,0x6A};
+		BYTE sw9000[2] = {0x90,0x00};
+		BYTE sw6982[2] = {0x69,0x82};
+		int i;
+
+		OPGP_software_crypto_provider_init(&softwareProvider, &provider);
+		OPGP_software_crypto_provider_add_key(&softwareProvider, sMacHandle, S_MAC);
+		status = OPGP_set_crypto_provider(&provider);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not set crypto provider: %s", status.errorMessage);
+		}
+
+		// the S-ENC handle is not known, the session key fails when it is waited for
+		for (i=0; i<2; i++) {
+			memset(&secInfo, 0, sizeof(secInfo));
+			status = GP211_begin_mutual_authentication(&operation, offlineCardInfo(), NULL, sEncHandle, sMacHandle, dekHandle, 0x30, 0,
+				GP211_SCP03, GP211_SCP03_IMPL_i00, GP211_SCP03_SECURITY_LEVEL_C_MAC, OPGP_DERIVATION_METHOD_NONE, &secInfo);
+			if (OPGP_ERROR_CHECK(status)) {
+				break;
+			}
+			set_host_challenge(&operation, hostChallenge);
+			status = exchange_canned_apdu(&operation, NULL, 0, response, sizeof(response));
+			if (OPGP_ERROR_CHECK(status)) {
+				break;
+			}
+			// still pending while the card processes EXTERNAL AUTHENTICATE
+			if (softwareProvider.pendingRequestsLength != 1 || memcmp(secInfo.C_MACSessionKey, sessionMacKey, 16) != 0
+					|| memcmp(secInfo.encryptionSessionKey, sessionEncKey, 16) == 0) {
+				break;
+			}
+			if (i == 0) {
+				status = exchange_canned_apdu(&operation, externalAuthenticate, sizeof(externalAuthenticate), sw9000, 2);
+				if (status.errorCode != OPGP_ERROR_UNKNOWN_KEY_HANDLE) {
+					break;
+				}
+				OPGP_software_crypto_provider_add_key(&softwareProvider, sEncHandle, S_ENC);
+				OPGP_software_crypto_provider_add_key(&softwareProvider, dekHandle, DEK);
+			}
+			else {
+				status = exchange_canned_apdu(&operation, externalAuthenticate, sizeof(externalAuthenticate), sw9000, 2);
+				if (OPGP_ERROR_CHECK(status) || memcmp(secInfo.encryptionSessionKey, sessionEncKey, 16) != 0) {
+					break;
+				}
+			}
+			if (operation.finished != OPGP_OPERATION_FINISHED || softwareProvider.pendingRequestsLength != 0) {
+				break;
+			}
+		}
+		if (i < 2) {
+			OPGP_set_crypto_provider(NULL);
+			fail("Incorrect session keys in round %d: 0x%08X", i, (unsigned int)status.errorCode);
+		}
+
+		// early finish: EXTERNAL AUTHENTICATE fails, the pending request is completed before the operation is released
+		status = GP211_begin_mutual_authentication(&operation, offlineCardInfo(), NULL, sEncHandle, sMacHandle, dekHandle, 0x30, 0,
+			GP211_SCP03, GP211_SCP03_IMPL_i00, GP211_SCP03_SECURITY_LEVEL_C_MAC, OPGP_DERIVATION_METHOD_NONE, &secInfo);
+		if (OPGP_ERROR_CHECK(status)) {
+			OPGP_set_crypto_provider(NULL);
+			fail("Could not begin mutual authentication: %s", status.errorMessage);
+		}
+		set_host_challenge(&operation, hostChallenge);
+		status = exchange_canned_apdu(&operation, NULL, 0, response, sizeof(response));
+		i = (int)softwareProvider.pendingRequestsLength;
+		if (!OPGP_ERROR_CHECK(status)) {
+			status = exchange_canned_apdu(&operation, externalAuthenticate, sizeof(externalAuthenticate), sw6982, 2);
+		}
+		OPGP_set_crypto_provider(NULL);
+		fail_unless(i == 1, "Session key not pending after INITIALIZE UPDATE");
+		fail_unless(status.errorCode == OPGP_ISO7816_ERROR_SECURITY_STATUS_NOT_SATISFIED, "Incorrect status 0x%08X", (unsigned int)status.errorCode);
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(softwareProvider.pendingRequestsLength == 0, "Pending session key not completed");
+		fail_unless(is_cleared((PBYTE)operation.data.mutualAuthentication.pendingRequests, sizeof(operation.data.mutualAuthentication.pendingRequests)),
+			"Session key requests not cleared");
+
+		// a request with an unknown key handle fails
+		{
+			OPGP_CRYPTO_REQUEST request;
+			BYTE data[16];
+			BYTE result[16];
+			memset(&request, 0, sizeof(request));
+			memset(data, 0, sizeof(data));
+			request.operation = OPGP_CRYPTO_OPERATION_DERIVE_KEY;
+			memcpy(request.key, S_ENC, 16);
+			request.data = data;
+			request.dataLength = sizeof(data);
+			request.result = result;
+			request.resultLength = sizeof(result);
+			OPGP_set_crypto_provider(&provider);
+			status = OPGP_crypto_execute(&request);
+			OPGP_set_crypto_provider(NULL);
+			fail_unless(status.errorCode == OPGP_ERROR_UNKNOWN_KEY_HANDLE, "Key value accepted as key handle");
+		}
+} END_TEST
+
+/**
+ * Tests the GET STATUS state machine with a 6310 continuation and a 6A88 response.
+ */
+START_TEST (test_operation_get_status) {
+		OPGP_ERROR_STATUS status;
+		OPGP_OPERATION operation;
+		GP211_APPLICATION_DATA applData[4];
+		DWORD applDataLength = 4;
+		BYTE firstCommand[] = {0x80,0xF2,GP211_STATUS_APPLICATIONS,0x00,0x02,0x4F,0x00,0x00};
+		BYTE nextCommand[] = {0x80,0xF2,GP211_STATUS_APPLICATIONS,0x01,0x02,0x4F,0x00,0x00};
+		BYTE firstResponse[] = {0x08,0xD0,0xD1,0xD2,0xD3,0xD4,0xD5,0x01,0x01,0x07,0x00,0x63,0x10};
+		BYTE nextResponse[] = {0x05,0xA0,0x00,0x00,0x00,0x01,0x0F,0x80,0x90,0x00};
+		BYTE sw6A88[2] = {0x6A,0x88};
+
+		status = GP211_begin_get_status(&operation, offlineCardInfo(), NULL, GP211_STATUS_APPLICATIONS, applData, NULL, &applDataLength);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin GET STATUS: %s", status.errorMessage);
+		}
+		status = exchange_canned_apdu(&operation, firstCommand, sizeof(firstCommand), firstResponse, sizeof(firstResponse));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not process first GET STATUS response: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished != OPGP_OPERATION_FINISHED, "Operation finished although more data is available");
+		status = exchange_canned_apdu(&operation, nextCommand, sizeof(nextCommand), nextResponse, sizeof(nextResponse));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not process next GET STATUS response: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(applDataLength == 2, "Incorrect number of applications %d", (int)applDataLength);
+		fail_unless(applData[0].AIDLength == 8 && memcmp(applData[0].AID, appletAID, 8) == 0, "Incorrect first AID");
+		fail_unless(applData[0].lifeCycleState == 0x07 && applData[0].privileges == 0x00, "Incorrect first entry");
+		fail_unless(applData[1].AIDLength == 5 && applData[1].lifeCycleState == 0x0F && applData[1].privileges == 0x80,
+			"Incorrect second entry");
+
+		applDataLength = 4;
+		status = GP211_begin_get_status(&operation, offlineCardInfo(), NULL, GP211_STATUS_APPLICATIONS, applData, NULL, &applDataLength);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin GET STATUS: %s", status.errorMessage);
+		}
+		status = exchange_canned_apdu(&operation, firstCommand, sizeof(firstCommand), sw6A88, 2);
+		fail_unless(status.errorCode == OPGP_ISO7816_ERROR_DATA_NOT_FOUND, "Incorrect status 0x%08X", (unsigned int)status.errorCode);
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+} END_TEST
+
+/**
+ * Parameters of collect_get_status_entry().
+ */
+typedef struct {
+	GP211_APPLICATION_DATA entries[4]; //!< The received entries.
+	DWORD entriesLength; //!< The number of received entries.
+	DWORD stopAfter; //!< The number of entries after which the listing is stopped. 0 lists all entries.
+} GET_STATUS_ENTRIES;
+
+/**
+ * GET STATUS callback copying the entries into a GET_STATUS_ENTRIES.
+ */
+static DWORD collect_get_status_entry(GP211_GET_STATUS_CALLBACK_PARAMETERS *callbackParameters) {
+	GET_STATUS_ENTRIES *entries = (GET_STATUS_ENTRIES *)callbackParameters->parameters;
+	fail_unless(entries->entriesLength < 4, "Too many entries");
+	entries->entries[entries->entriesLength++] = *callbackParameters->applData;
+	if (entries->stopAfter != 0 && entries->entriesLength == entries->stopAfter) {
+		return GP211_GET_STATUS_STOP;
+	}
+	return 0;
+}
+
+/**
+ * Begins a GET STATUS for Applications in the GlobalPlatform 2.2 format with the AID prefix A000000001 as search criteria
+ * and passes one canned response.
+ */
+static OPGP_ERROR_STATUS exchange_tlv_get_status(OPGP_OPERATION *operation, GP211_GET_STATUS_CALLBACK *callback,
+		const BYTE *response, DWORD responseLength) {
+	OPGP_ERROR_STATUS status;
+	BYTE AIDPrefix[] = {0xA0,0x00,0x00,0x00,0x01};
+	BYTE command[] = {0x80,0xF2,GP211_STATUS_APPLICATIONS,GP211_STATUS_FORMAT_TLV,0x07,0x4F,0x05,0xA0,0x00,0x00,0x00,0x01,0x00};
+	status = GP211_begin_get_status_with_criteria(operation, offlineCardInfo(), NULL, GP211_STATUS_APPLICATIONS, AIDPrefix,
+		sizeof(AIDPrefix), GP211_STATUS_FORMAT_TLV, callback);
+	if (OPGP_ERROR_CHECK(status)) {
+		fail("Could not begin GET STATUS: %s", status.errorMessage);
+	}
+	return exchange_canned_apdu(operation, command, sizeof(command), response, responseLength);
+}
+
+/**
+ * Tests GET STATUS with search criteria and GlobalPlatform 2.2 E3 templates: the 4F search criteria, the P2 continuation,
+ * the two byte tag 9F70, unknown tags, 6A88 if no entry matches and truncated and overlong lengths.
+ */
+START_TEST (test_operation_get_status_tlv) {
+		OPGP_ERROR_STATUS status;
+		OPGP_OPERATION operation;
+		GP211_GET_STATUS_CALLBACK callback;
+		GET_STATUS_ENTRIES entries;
+		BYTE nextCommand[] = {0x80,0xF2,GP211_STATUS_APPLICATIONS,GP211_STATUS_FORMAT_TLV|0x01,0x07,0x4F,0x05,0xA0,0x00,0x00,0x00,0x01,0x00};
+		BYTE firstResponse[] = {0xE3,0x0E,0x4F,0x05,0xA0,0x00,0x00,0x00,0x01,0x9F,0x70,0x01,0x07,0xC5,0x01,0x80,0x63,0x10};
+		// the privileges are 3 bytes, the unknown tag CC and the Executable Load File AID tag C4 are skipped
+		BYTE nextResponse[] = {0xE3,0x1A,0xCC,0x00,0x4F,0x06,0xA0,0x00,0x00,0x00,0x01,0x02,0x9F,0x70,0x01,0x0F,
+			0xC5,0x03,0x40,0x00,0x00,0xC4,0x05,0xA0,0x00,0x00,0x00,0x01,0x90,0x00};
+		BYTE sw6A88[2] = {0x6A,0x88};
+		// the template is longer than the response
+		BYTE truncatedTemplate[] = {0xE3,0x10,0x4F,0x05,0xA0,0x00,0x00,0x00,0x01,0x9F,0x70,0x01,0x07,0xC5,0x01,0x80,0x90,0x00};
+		// the AID is longer than the template
+		BYTE overlongAID[] = {0xE3,0x07,0x4F,0x06,0xA0,0x00,0x00,0x00,0x01,0x90,0x00};
+		// the second byte of the tag 9F70 is missing
+		BYTE truncatedTag[] = {0xE3,0x01,0x9F,0x90,0x00};
+		// lengths with more than one length byte are not supported
+		BYTE longLength[] = {0xE3,0x82,0x00,0x07,0x4F,0x05,0xA0,0x00,0x00,0x00,0x01,0x90,0x00};
+		// a template of another tag
+		BYTE wrongTemplate[] = {0xE2,0x07,0x4F,0x05,0xA0,0x00,0x00,0x00,0x01,0x90,0x00};
+
+		memset(&entries, 0, sizeof(entries));
+		callback.callback = (PVOID)collect_get_status_entry;
+		callback.parameters = &entries;
+		status = exchange_tlv_get_status(&operation, &callback, firstResponse, sizeof(firstResponse));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not process first GET STATUS response: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished != OPGP_OPERATION_FINISHED, "Operation finished although more data is available");
+		status = exchange_canned_apdu(&operation, nextCommand, sizeof(nextCommand), nextResponse, sizeof(nextResponse));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not process next GET STATUS response: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(entries.entriesLength == 2, "Incorrect number of applications %d", (int)entries.entriesLength);
+		fail_unless(entries.entries[0].AIDLength == 5 && memcmp(entries.entries[0].AID, nextCommand+7, 5) == 0,
+			"Incorrect first AID");
+		fail_unless(entries.entries[0].lifeCycleState == 0x07 && entries.entries[0].privileges == 0x80, "Incorrect first entry");
+		fail_unless(entries.entries[1].AIDLength == 6 && memcmp(entries.entries[1].AID, nextResponse+6, 6) == 0,
+			"Incorrect second AID");
+		fail_unless(entries.entries[1].lifeCycleState == 0x0F && entries.entries[1].privileges == 0x40, "Incorrect second entry");
+
+		// no entry matches the search criteria, with a callback this is an empty listing
+		memset(&entries, 0, sizeof(entries));
+		status = exchange_tlv_get_status(&operation, &callback, sw6A88, sizeof(sw6A88));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("No match not accepted: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(entries.entriesLength == 0, "Entries without a match");
+
+		status = exchange_tlv_get_status(&operation, &callback, truncatedTemplate, sizeof(truncatedTemplate));
+		fail_unless(status.errorCode == OPGP_ERROR_INVALID_RESPONSE_DATA, "Truncated template accepted");
+		status = exchange_tlv_get_status(&operation, &callback, overlongAID, sizeof(overlongAID));
+		fail_unless(status.errorCode == OPGP_ERROR_INVALID_RESPONSE_DATA, "Overlong AID accepted");
+		status = exchange_tlv_get_status(&operation, &callback, truncatedTag, sizeof(truncatedTag));
+		fail_unless(status.errorCode == OPGP_ERROR_INVALID_RESPONSE_DATA, "Truncated tag accepted");
+		status = exchange_tlv_get_status(&operation, &callback, longLength, sizeof(longLength));
+		fail_unless(status.errorCode == OPGP_ERROR_INVALID_RESPONSE_DATA, "Unsupported length accepted");
+		status = exchange_tlv_get_status(&operation, &callback, wrongTemplate, sizeof(wrongTemplate));
+		fail_unless(status.errorCode == OPGP_ERROR_INVALID_RESPONSE_DATA, "Wrong template accepted");
+		fail_unless(entries.entriesLength == 0, "Entries of invalid responses");
+} END_TEST
+
+/**
+ * Tests GET STATUS with a callback: the entries of a 6310 continuation are passed one at a time
+ * and returning GP211_GET_STATUS_STOP finishes the operation without fetching the remaining entries.
+ */
+START_TEST (test_operation_get_status_callback) {
+		OPGP_ERROR_STATUS status;
+		OPGP_OPERATION operation;
+		GP211_GET_STATUS_CALLBACK callback;
+		GET_STATUS_ENTRIES entries;
+		BYTE capdu[261];
+		DWORD capduLength = sizeof(capdu);
+		BYTE firstCommand[] = {0x80,0xF2,GP211_STATUS_APPLICATIONS,0x00,0x02,0x4F,0x00,0x00};
+		BYTE nextCommand[] = {0x80,0xF2,GP211_STATUS_APPLICATIONS,0x01,0x02,0x4F,0x00,0x00};
+		BYTE firstResponse[] = {0x08,0xD0,0xD1,0xD2,0xD3,0xD4,0xD5,0x01,0x01,0x07,0x00,
+			0x05,0xA0,0x00,0x00,0x00,0x01,0x0F,0x80,0x63,0x10};
+		BYTE nextResponse[] = {0x05,0xA0,0x00,0x00,0x00,0x02,0x83,0x00,0x90,0x00};
+
+		memset(&entries, 0, sizeof(entries));
+		callback.callback = (PVOID)collect_get_status_entry;
+		callback.parameters = &entries;
+		status = GP211_begin_get_status_with_callback(&operation, offlineCardInfo(), NULL, GP211_STATUS_APPLICATIONS, &callback);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin GET STATUS: %s", status.errorMessage);
+		}
+		status = exchange_canned_apdu(&operation, firstCommand, sizeof(firstCommand), firstResponse, sizeof(firstResponse));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not process first GET STATUS response: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished != OPGP_OPERATION_FINISHED, "Operation finished although more data is available");
+		fail_unless(entries.entriesLength == 2, "Entries of the first response not passed");
+		status = exchange_canned_apdu(&operation, nextCommand, sizeof(nextCommand), nextResponse, sizeof(nextResponse));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not process next GET STATUS response: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(entries.entriesLength == 3, "Incorrect number of applications %d", (int)entries.entriesLength);
+		fail_unless(entries.entries[0].AIDLength == 8 && memcmp(entries.entries[0].AID, appletAID, 8) == 0, "Incorrect first AID");
+		fail_unless(entries.entries[0].lifeCycleState == 0x07 && entries.entries[0].privileges == 0x00, "Incorrect first entry");
+		fail_unless(entries.entries[1].AIDLength == 5 && memcmp(entries.entries[1].AID, firstResponse+12, 5) == 0
+			&& entries.entries[1].lifeCycleState == 0x0F && entries.entries[1].privileges == 0x80, "Incorrect second entry");
+		fail_unless(entries.entries[2].AIDLength == 5 && memcmp(entries.entries[2].AID, nextResponse+1, 5) == 0
+			&& entries.entries[2].lifeCycleState == 0x83 && entries.entries[2].privileges == 0x00, "Incorrect third entry");
+
+		// stop after the first entry although the card has more entries
+		memset(&entries, 0, sizeof(entries));
+		entries.stopAfter = 1;
+		status = GP211_begin_get_status_with_callback(&operation, offlineCardInfo(), NULL, GP211_STATUS_APPLICATIONS, &callback);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin GET STATUS: %s", status.errorMessage);
+		}
+		status = exchange_canned_apdu(&operation, firstCommand, sizeof(firstCommand), firstResponse, sizeof(firstResponse));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Stopping the listing failed: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished after stopping");
+		fail_unless(entries.entriesLength == 1, "Entries passed after stopping");
+		status = OPGP_operation_get_command(&operation, capdu, &capduLength);
+		fail_unless(status.errorCode == OPGP_ERROR_OPERATION_FINISHED, "Command after stopping");
+} END_TEST
+
+static DWORD inventoryLoadFiles; //!< The number of Executable Load Files of the canned GET STATUS responses.
+static DWORD inventoryServed; //!< The number of Executable Load Files already returned.
+
+/**
+ * Sends nothing, but answers GET STATUS for Executable Load Files and Executable Modules with up to 5 entries per response.
+ * Load File i has the AID A0000000 10 i and i%4+1 Executable Modules with the AIDs A0000000 10 i j.
+ */
+static OPGP_ERROR_STATUS send_canned_inventory(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, PBYTE capdu, DWORD capduLength,
+		PBYTE rapdu, PDWORD rapduLength) {
+	OPGP_ERROR_STATUS status;
+	DWORD i, j, k=0;
+	DWORD sw;
+	fail_unless(capdu[1] == 0xF2 && capdu[2] == GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES, "Not a GET STATUS for Executable Modules");
+	fail_unless(capdu[3] == (inventoryServed == 0 ? 0x00 : 0x01), "Incorrect P2 0x%02X", (unsigned int)capdu[3]);
+	for (i=inventoryServed; i<inventoryLoadFiles && i<inventoryServed+5; i++) {
+		rapdu[k++] = 6;
+		rapdu[k++] = 0xA0; rapdu[k++] = 0x00; rapdu[k++] = 0x00; rapdu[k++] = 0x00; rapdu[k++] = 0x10; rapdu[k++] = (BYTE)i;
+		rapdu[k++] = 0x01;
+		rapdu[k++] = 0x00;
+		rapdu[k++] = (BYTE)(i%4+1);
+		for (j=0; j<i%4+1; j++) {
+			rapdu[k++] = 7;
+			rapdu[k++] = 0xA0; rapdu[k++] = 0x00; rapdu[k++] = 0x00; rapdu[k++] = 0x00; rapdu[k++] = 0x10; rapdu[k++] = (BYTE)i;
+			rapdu[k++] = (BYTE)j;
+		}
+	}
+	inventoryServed = i;
+	sw = inventoryServed < inventoryLoadFiles ? 0x6310 : 0x9000;
+	rapdu[k++] = (BYTE)(sw >> 8);
+	rapdu[k++] = (BYTE)sw;
+	*rapduLength = k;
+	OPGP_ERROR_CREATE_NO_ERROR_WITH_CODE(status, OPGP_ISO7816_ERROR_PREFIX | sw, OPGP_stringify_error(OPGP_ISO7816_ERROR_PREFIX | sw));
+	return status;
+}
+
+/**
+ * Reads the canned inventory of send_canned_inventory() and checks the Executable Load Files and the offsets of their Executable Modules.
+ */
+static void check_load_file_inventory(GP211_LOAD_FILE_INVENTORY *inventory, DWORD loadFiles) {
+	OPGP_ERROR_STATUS status;
+	OPGP_CARD_CONTEXT offlineContext;
+	GP211_LOAD_FILE_DATA *loadFile;
+	OPGP_AID *module;
+	DWORD i, j, offset=0;
+	memset(&offlineContext, 0, sizeof(offlineContext));
+	offlineContext.connectionFunctions.sendAPDU = (PVOID)send_canned_inventory;
+	inventoryLoadFiles = loadFiles;
+	inventoryServed = 0;
+	status = GP211_get_load_file_inventory(offlineContext, offlineCardInfo(), NULL, inventory);
+	if (OPGP_ERROR_CHECK(status)) {
+		fail("Could not get load file inventory: %s", status.errorMessage);
+	}
+	fail_unless(inventory->loadFilesLength == loadFiles, "Incorrect number of load files %d", (int)inventory->loadFilesLength);
+	for (i=0; i<loadFiles; i++) {
+		loadFile = inventory->loadFiles + i;
+		fail_unless(loadFile->AIDLength == 6 && loadFile->AID[4] == 0x10 && loadFile->AID[5] == i, "Incorrect AID of load file %d", (int)i);
+		fail_unless(loadFile->lifeCycleState == 0x01, "Incorrect life cycle state of load file %d", (int)i);
+		fail_unless(loadFile->numExecutableModules == i%4+1, "Incorrect number of modules of load file %d", (int)i);
+		// the modules of all load files are stored without gaps
+		fail_unless(loadFile->executableModulesOffset == offset, "Incorrect module offset of load file %d", (int)i);
+		for (j=0; j<loadFile->numExecutableModules; j++) {
+			module = inventory->executableModules + loadFile->executableModulesOffset + j;
+			fail_unless(module->AIDLength == 7 && module->AID[5] == i && module->AID[6] == j, "Incorrect module %d of load file %d",
+				(int)j, (int)i);
+		}
+		offset += loadFile->numExecutableModules;
+	}
+	fail_unless(inventory->executableModulesLength == offset, "Incorrect number of modules %d", (int)inventory->executableModulesLength);
+}
+
+/**
+ * Tests that the load file inventory grows over several GET STATUS responses, stores the Executable Modules contiguously
+ * and keeps its memory when it is filled again.
+ */
+START_TEST (test_load_file_inventory) {
+		GP211_LOAD_FILE_INVENTORY inventory;
+		GP211_LOAD_FILE_DATA *loadFiles;
+		OPGP_AID *executableModules;
+
+		GP211_load_file_inventory_init(&inventory);
+		// 20 load files with 50 modules in 4 responses exceed the initial 16 load files and 32 modules
+		check_load_file_inventory(&inventory, 20);
+		fail_unless(inventory.executableModulesLength == 50, "Incorrect number of modules %d", (int)inventory.executableModulesLength);
+		fail_unless(inventory.loadFilesSize == 32 && inventory.executableModulesSize == 64, "Inventory not grown");
+
+		loadFiles = inventory.loadFiles;
+		executableModules = inventory.executableModules;
+		check_load_file_inventory(&inventory, 3);
+		fail_unless(inventory.executableModulesLength == 6, "Incorrect number of modules %d", (int)inventory.executableModulesLength);
+		fail_unless(inventory.loadFiles == loadFiles && inventory.executableModules == executableModules
+			&& inventory.loadFilesSize == 32 && inventory.executableModulesSize == 64, "Memory of the inventory not reused");
+
+		GP211_load_file_inventory_release(&inventory);
+		fail_unless(inventory.loadFiles == NULL && inventory.executableModules == NULL && inventory.loadFilesLength == 0
+			&& inventory.loadFilesSize == 0, "Inventory not released");
+} END_TEST
+
+/**
+ * Tests the DELETE state machine with deletion receipts and a 6A88 response.
+ */
+START_TEST (test_operation_delete) {
+		OPGP_ERROR_STATUS status;
+		OPGP_OPERATION operation;
+		OPGP_AID AIDs[2];
+		GP211_RECEIPT_DATA receiptData[2];
+		DWORD receiptDataLength = 2;
+		BYTE command[] = {0x80,0xE4,0x00,0x80,0x13,
+			0x4F,0x08,0xD0,0xD1,0xD2,0xD3,0xD4,0xD5,0x01,0x01,
+			0x4F,0x07,0xD0,0xD1,0xD2,0xD3,0xD4,0xD5,0x01,0x00};
+		BYTE receiptResponse[] = {0x08,0xE1,0xE2,0xE3,0xE4,0xE5,0xE6,0xE7,0xE8,0x02,0x00,0x01,
+			0x0A,0xF0,0xF1,0xF2,0xF3,0xF4,0xF5,0xF6,0xF7,0xF8,0xF9,0x90,0x00};
+		BYTE sw6A88[2] = {0x6A,0x88};
+
+		memcpy(AIDs[0].AID, appletAID, sizeof(appletAID));
+		AIDs[0].AIDLength = sizeof(appletAID);
+		memcpy(AIDs[1].AID, packageAID, sizeof(packageAID));
+		AIDs[1].AIDLength = sizeof(packageAID);
+
+		status = GP211_begin_delete_application(&operation, offlineCardInfo(), NULL, AIDs, 2, receiptData, &receiptDataLength);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin DELETE: %s", status.errorMessage);
+		}
+		status = exchange_canned_apdu(&operation, command, sizeof(command), receiptResponse, sizeof(receiptResponse));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not process DELETE response: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(receiptDataLength == 1, "Incorrect number of receipts %d", (int)receiptDataLength);
+		fail_unless(memcmp(receiptData[0].receipt, receiptResponse+1, 8) == 0, "Incorrect receipt");
+		fail_unless(receiptData[0].confirmationCounter[0] == 0x00 && receiptData[0].confirmationCounter[1] == 0x01,
+			"Incorrect confirmation counter");
+
+		receiptDataLength = 2;
+		status = GP211_begin_delete_application(&operation, offlineCardInfo(), NULL, AIDs, 2, receiptData, &receiptDataLength);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin DELETE: %s", status.errorMessage);
+		}
+		status = exchange_canned_apdu(&operation, command, sizeof(command), sw6A88, 2);
+		fail_unless(status.errorCode == OPGP_ISO7816_ERROR_DATA_NOT_FOUND, "Incorrect status 0x%08X", (unsigned int)status.errorCode);
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(receiptDataLength == 0, "Receipt returned for a failed DELETE");
+} END_TEST
+
+/**
+ * Tests the LOAD state machine splitting a Load File Data Block into two LOAD commands and returning a load receipt.
+ */
+START_TEST (test_operation_load) {
+		OPGP_ERROR_STATUS status;
+		OPGP_OPERATION operation;
+		BYTE loadFile[300];
+		GP211_RECEIPT_DATA receiptData;
+		DWORD receiptDataAvailable = 0;
+		BYTE firstCommand[5+4+235];
+		BYTE lastCommand[5+65+1];
+		BYTE receiptResponse[] = {0x08,0xE1,0xE2,0xE3,0xE4,0xE5,0xE6,0xE7,0xE8,0x02,0x00,0x02,
+			0x0A,0xF0,0xF1,0xF2,0xF3,0xF4,0xF5,0xF6,0xF7,0xF8,0xF9,0x90,0x00};
+		BYTE sw9000[2] = {0x90,0x00};
+		DWORD i;
+
+		for (i=0; i<sizeof(loadFile); i++) {
+			loadFile[i] = (BYTE)i;
+		}
+		firstCommand[0] = 0x80;
+		firstCommand[1] = 0xE8;
+		firstCommand[2] = 0x00;
+		firstCommand[3] = 0x00;
+		firstCommand[4] = 239;
+		firstCommand[5] = 0xC4;
+		firstCommand[6] = 0x82;
+		firstCommand[7] = 0x01;
+		firstCommand[8] = 0x2C;
+		memcpy(firstCommand+9, loadFile, 235);
+		lastCommand[0] = 0x80;
+		lastCommand[1] = 0xE8;
+		lastCommand[2] = 0x80;
+		lastCommand[3] = 0x01;
+		lastCommand[4] = 65;
+		memcpy(lastCommand+5, loadFile+235, 65);
+		lastCommand[70] = 0x00;
+
+		status = GP211_begin_load_from_buffer(&operation, offlineCardInfo(), NULL, NULL, 0, loadFile, sizeof(loadFile),
+			&receiptData, &receiptDataAvailable, NULL);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin LOAD: %s", status.errorMessage);
+		}
+		status = exchange_canned_apdu(&operation, firstCommand, sizeof(firstCommand), sw9000, 2);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not process first LOAD response: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished != OPGP_OPERATION_FINISHED, "Operation finished before the last block");
+		status = exchange_canned_apdu(&operation, lastCommand, sizeof(lastCommand), receiptResponse, sizeof(receiptResponse));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not process last LOAD response: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(receiptDataAvailable == 1, "No load receipt");
+		fail_unless(memcmp(receiptData.receipt, receiptResponse+1, 8) == 0, "Incorrect load receipt");
+		fail_unless(receiptData.confirmationCounter[1] == 0x02, "Incorrect confirmation counter");
+} END_TEST
+
+/**
+ * Tests the INSTALL [for install] state machine with an unresolved 61xx response and an install receipt.
+ */
+START_TEST (test_operation_install) {
+		OPGP_ERROR_STATUS status;
+		OPGP_OPERATION operation;
+		GP211_RECEIPT_DATA receiptData;
+		DWORD receiptDataAvailable = 0;
+		BYTE command[] = {0x80,0xE6,0x04,0x00,0x20,
+			0x07,0xD0,0xD1,0xD2,0xD3,0xD4,0xD5,0x01,
+			0x08,0xD0,0xD1,0xD2,0xD3,0xD4,0xD5,0x01,0x01,
+			0x08,0xD0,0xD1,0xD2,0xD3,0xD4,0xD5,0x01,0x01,
+			0x01,0x00,0x02,0xC9,0x00,0x00,0x00};
+		BYTE receiptResponse[] = {0x08,0xE1,0xE2,0xE3,0xE4,0xE5,0xE6,0xE7,0xE8,0x02,0x00,0x03,
+			0x0A,0xF0,0xF1,0xF2,0xF3,0xF4,0xF5,0xF6,0xF7,0xF8,0xF9,0x90,0x00};
+		BYTE sw6117[2] = {0x61,0x17};
+
+		// 61xx must be resolved with GET RESPONSE by the transport
+		status = GP211_begin_install_for_install(&operation, offlineCardInfo(), NULL, (PBYTE)packageAID, sizeof(packageAID),
+			(PBYTE)appletAID, sizeof(appletAID), (PBYTE)appletAID, sizeof(appletAID), 0, 0, 0, NULL, 0, NULL,
+			&receiptData, &receiptDataAvailable);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin INSTALL: %s", status.errorMessage);
+		}
+		status = exchange_canned_apdu(&operation, command, sizeof(command), sw6117, 2);
+		fail_unless(status.errorCode == (OPGP_ISO7816_ERROR_PREFIX | 0x6117), "Incorrect status 0x%08X", (unsigned int)status.errorCode);
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(receiptDataAvailable == 0, "Receipt returned for a failed INSTALL");
+
+		status = GP211_begin_install_for_install(&operation, offlineCardInfo(), NULL, (PBYTE)packageAID, sizeof(packageAID),
+			(PBYTE)appletAID, sizeof(appletAID), (PBYTE)appletAID, sizeof(appletAID), 0, 0, 0, NULL, 0, NULL,
+			&receiptData, &receiptDataAvailable);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin INSTALL: %s", status.errorMessage);
+		}
+		status = exchange_canned_apdu(&operation, command, sizeof(command), receiptResponse, sizeof(receiptResponse));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not process INSTALL response: %s", status.errorMessage);
+		}
+		fail_unless(operation.finished == OPGP_OPERATION_FINISHED, "Operation not finished");
+		fail_unless(receiptDataAvailable == 1, "No install receipt");
+		fail_unless(memcmp(receiptData.receipt, receiptResponse+1, 8) == 0, "Incorrect install receipt");
+} END_TEST
+
+/**
+ * Card content and expected plan of a test_plan_card_content() case.
+ * The manifest has a library package, an applet package importing it and one instance of the applet.
+ */
+typedef struct {
+	const char *name; //!< The name of the case for failure messages.
+	BYTE libraryPresent; //!< If the library package is on the card.
+	BYTE packagePresent; //!< If the applet package is on the card.
+	BYTE moduleStale; //!< If the applet package on the card lacks the Executable Module of the instance.
+	DWORD reloadLibrary; //!< The reload flag of the library package.
+	BYTE instancePrivileges; //!< The privileges of the instance on the card, 0xFF if it is not installed.
+	DWORD planLength; //!< The number of expected steps.
+	struct {
+		DWORD action; //!< The expected action.
+		DWORD index; //!< The index of the package or instance in the manifest.
+		BYTE package; //!< If the step refers to a package, otherwise to the instance.
+	} steps[5]; //!< The expected steps.
+} PLAN_TEST_CASE;
+
+static const PLAN_TEST_CASE planTestCases[] = {
+	{"already installed", 1, 1, 0, 0, 0x00, 0, {{0}}},
+	{"missing package", 1, 0, 0, 0, 0xFF, 2,
+		{{GP211_PLAN_LOAD, 1, 1}, {GP211_PLAN_INSTALL, 0, 0}}},
+	{"missing library", 0, 0, 0, 0, 0xFF, 3,
+		{{GP211_PLAN_LOAD, 0, 1}, {GP211_PLAN_LOAD, 1, 1}, {GP211_PLAN_INSTALL, 0, 0}}},
+	{"stale package", 1, 1, 1, 0, 0x00, 3,
+		{{GP211_PLAN_DELETE, 1, 1}, {GP211_PLAN_LOAD, 1, 1}, {GP211_PLAN_INSTALL, 0, 0}}},
+	{"stale library", 1, 1, 0, 1, 0x00, 5,
+		{{GP211_PLAN_DELETE, 1, 1}, {GP211_PLAN_DELETE, 0, 1}, {GP211_PLAN_LOAD, 0, 1}, {GP211_PLAN_LOAD, 1, 1},
+		{GP211_PLAN_INSTALL, 0, 0}}},
+	{"changed privileges", 1, 1, 0, 0, 0x04, 2,
+		{{GP211_PLAN_DELETE, 0, 0}, {GP211_PLAN_INSTALL, 0, 0}}}
+};
+
+/**
+ * Tests the planner against already installed, stale and missing packages without a card.
+ */
+START_TEST (test_plan_card_content) {
+		OPGP_ERROR_STATUS status;
+		const BYTE libraryAID[] = {0xD0,0xD1,0xD2,0xD3,0xD4,0xD5,0x02};
+		const BYTE instanceAID[] = {0xD0,0xD1,0xD2,0xD3,0xD4,0xD5,0x01,0x01,0x01};
+		const BYTE otherModuleAID[] = {0xD0,0xD1,0xD2,0xD3,0xD4,0xD5,0x01,0x02};
+		const PLAN_TEST_CASE *testCase;
+		GP211_MANIFEST_PACKAGE packages[2];
+		GP211_MANIFEST_INSTANCE instance;
+		GP211_MANIFEST manifest;
+		DWORD dependency = 0;
+		GP211_LOAD_FILE_DATA loadFiles[2];
+		OPGP_AID executableModules[1];
+		GP211_LOAD_FILE_INVENTORY inventory;
+		GP211_APPLICATION_DATA applData;
+		GP211_PLAN_STEP plan[6];
+		DWORD planLength;
+		OPGP_AID *AID;
+		DWORD i, j;
+
+		memset(packages, 0, sizeof(packages));
+		memcpy(packages[0].AID.AID, libraryAID, sizeof(libraryAID));
+		packages[0].AID.AIDLength = sizeof(libraryAID);
+		memcpy(packages[1].AID.AID, packageAID, sizeof(packageAID));
+		packages[1].AID.AIDLength = sizeof(packageAID);
+		packages[1].dependencies = &dependency;
+		packages[1].dependenciesLength = 1;
+		memset(&instance, 0, sizeof(instance));
+		instance.package = 1;
+		memcpy(instance.moduleAID.AID, appletAID, sizeof(appletAID));
+		instance.moduleAID.AIDLength = sizeof(appletAID);
+		memcpy(instance.AID.AID, instanceAID, sizeof(instanceAID));
+		instance.AID.AIDLength = sizeof(instanceAID);
+		manifest.packages = packages;
+		manifest.packagesLength = 2;
+		manifest.instances = &instance;
+		manifest.instancesLength = 1;
+
+		for (i=0; i<sizeof(planTestCases)/sizeof(planTestCases[0]); i++) {
+			testCase = planTestCases + i;
+			packages[0].reload = testCase->reloadLibrary;
+			memset(&inventory, 0, sizeof(inventory));
+			memset(loadFiles, 0, sizeof(loadFiles));
+			inventory.loadFiles = loadFiles;
+			inventory.executableModules = executableModules;
+			if (testCase->libraryPresent) {
+				memcpy(loadFiles[inventory.loadFilesLength].AID, libraryAID, sizeof(libraryAID));
+				loadFiles[inventory.loadFilesLength++].AIDLength = sizeof(libraryAID);
+			}
+			if (testCase->packagePresent) {
+				memcpy(loadFiles[inventory.loadFilesLength].AID, packageAID, sizeof(packageAID));
+				loadFiles[inventory.loadFilesLength].AIDLength = sizeof(packageAID);
+				loadFiles[inventory.loadFilesLength++].numExecutableModules = 1;
+				if (testCase->moduleStale) {
+					memcpy(executableModules[0].AID, otherModuleAID, sizeof(otherModuleAID));
+					executableModules[0].AIDLength = sizeof(otherModuleAID);
+				}
+				else {
+					executableModules[0] = instance.moduleAID;
+				}
+				inventory.executableModulesLength = 1;
+			}
+			memcpy(applData.AID, instanceAID, sizeof(instanceAID));
+			applData.AIDLength = sizeof(instanceAID);
+			applData.lifeCycleState = 0x07;
+			applData.privileges = testCase->instancePrivileges;
+
+			planLength = sizeof(plan)/sizeof(plan[0]);
+			status = GP211_plan_card_content(&manifest, &inventory, &applData, testCase->instancePrivileges == 0xFF ? 0 : 1,
+				plan, &planLength);
+			if (OPGP_ERROR_CHECK(status)) {
+				fail("%s: Could not plan card content: %s", testCase->name, status.errorMessage);
+			}
+			fail_unless(planLength == testCase->planLength, "%s: Incorrect number of steps %d", testCase->name, (int)planLength);
+			for (j=0; j<planLength; j++) {
+				fail_unless(plan[j].action == testCase->steps[j].action, "%s: Incorrect action of step %d", testCase->name, (int)j);
+				fail_unless(plan[j].index == testCase->steps[j].index, "%s: Incorrect index of step %d", testCase->name, (int)j);
+				AID = testCase->steps[j].package ? &packages[plan[j].index].AID : &instance.AID;
+				fail_unless(plan[j].AID.AIDLength == AID->AIDLength && memcmp(plan[j].AID.AID, AID->AID, AID->AIDLength) == 0,
+					"%s: Incorrect AID of step %d", testCase->name, (int)j);
+			}
+		}
+
+		planLength = 3;
+		packages[0].reload = 1;
+		status = GP211_plan_card_content(&manifest, &inventory, &applData, 1, plan, &planLength);
+		fail_unless(status.errorCode == OPGP_ERROR_INSUFFICIENT_BUFFER, "Too small plan accepted");
+} END_TEST
+
+/**
+ * Returns the next command of a GET STATUS for applications, wrapped with the given Secure Channel if not NULL.
+ * \param *secInfo [in, out] The Secure Channel or NULL.
+ * \param capdu [out] The command APDU.
+ * \param *capduLength [in, out] The size of the buffer and the length of the command APDU.
+ * \return The status of fetching the command.
+ */
+static OPGP_ERROR_STATUS get_status_command(GP211_SECURITY_INFO *secInfo, PBYTE capdu, PDWORD capduLength) {
+	OPGP_ERROR_STATUS status;
+	OPGP_OPERATION operation;
+	GP211_APPLICATION_DATA applData[1];
+	DWORD applDataLength = 1;
+	status = GP211_begin_get_status(&operation, offlineCardInfo(), secInfo, GP211_STATUS_APPLICATIONS, applData, NULL, &applDataLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		return status;
+	}
+	return OPGP_operation_get_command(&operation, capdu, capduLength);
+}
+
+/**
+ * Tests creating a pre-wrapped script, parsing its header and rejecting truncated and corrupt scripts.
+ * The C-MACs of the script are compared with commands wrapped by an independently opened implicit Secure Channel.
+ */
+START_TEST (test_wrapped_script) {
+		OPGP_ERROR_STATUS status;
+		GP211_WRAPPED_SCRIPT script;
+		GP211_WRAPPED_SCRIPT_HEADER header;
+		GP211_SECURITY_INFO secInfo;
+		BYTE buffer[512];
+		BYTE corrupt[512];
+		BYTE S_ENC[16] = {0x40,0x41,0x42,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4A,0x4B,0x4C,0x4D,0x4E,0x4F};
+		BYTE S_MAC[16] = {0x50,0x51,0x52,0x53,0x54,0x55,0x56,0x57,0x58,0x59,0x5A,0x5B,0x5C,0x5D,0x5E,0x5F};
+		BYTE DEK[16] = {0x60,0x61,0x62,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6A,0x6B,0x6C,0x6D,0x6E,0x6F};
+		BYTE sequenceCounter[2] = {0x00,0x2A};
+		BYTE cardIdentifier[8] = {0x47,0x90,0x50,0x40,0x12,0x34,0x56,0x78};
+		BYTE ISDAID[8] = {0xA0,0x00,0x00,0x01,0x51,0x00,0x00,0x00};
+		BYTE capdu[261];
+		DWORD capduLength;
+		BYTE wrapped[261];
+		DWORD wrappedLength;
+		DWORD offset;
+		BYTE icv[8];
+		BYTE macData[16];
+		BYTE mac[16];
+		OPGP_CRYPTO_REQUEST request;
+		OPGP_CARD_CONTEXT offlineContext;
+		FILE *file;
+		int i, j;
+
+		status = GP211_begin_wrapped_script(&script, buffer, sizeof(buffer), cardIdentifier, sizeof(cardIdentifier),
+			ISDAID, sizeof(ISDAID), NULL, S_ENC, S_MAC, DEK, GP211_SCP02_IMPL_i0A, GP211_SCP02_SECURITY_LEVEL_C_MAC,
+			sequenceCounter);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not begin wrapped script: %s", status.errorMessage);
+		}
+		capduLength = sizeof(capdu);
+		status = get_status_command(NULL, capdu, &capduLength);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not get GET STATUS command: %s", status.errorMessage);
+		}
+		// the second command checks the chaining of the C-MAC
+		for (i=0; i<2; i++) {
+			status = GP211_add_wrapped_script_command(&script, capdu, capduLength);
+			if (OPGP_ERROR_CHECK(status)) {
+				fail("Could not add wrapped script command: %s", status.errorMessage);
+			}
+		}
+		status = GP211_end_wrapped_script(&script);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not end wrapped script: %s", status.errorMessage);
+		}
+
+		status = GP211_read_wrapped_script_header(buffer, script.length, &header);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not read wrapped script header: %s", status.errorMessage);
+		}
+		fail_unless(header.scriptLength == script.length, "Incorrect script length %d", (int)header.scriptLength);
+		fail_unless(header.secureChannelProtocolImpl == GP211_SCP02_IMPL_i0A, "Incorrect Secure Channel Protocol implementation");
+		fail_unless(header.securityLevel == GP211_SCP02_SECURITY_LEVEL_C_MAC, "Incorrect security level");
+		fail_unless(memcmp(header.sequenceCounter, sequenceCounter, 2) == 0, "Incorrect Sequence Counter");
+		fail_unless(header.cardIdentifierLength == sizeof(cardIdentifier)
+			&& memcmp(header.cardIdentifier, cardIdentifier, sizeof(cardIdentifier)) == 0, "Incorrect card identifier");
+		fail_unless(header.AID.AIDLength == sizeof(ISDAID) && memcmp(header.AID.AID, ISDAID, sizeof(ISDAID)) == 0, "Incorrect AID");
+		fail_unless(header.commandsLength == 2, "Incorrect number of commands %d", (int)header.commandsLength);
+
+		status = GP211_init_implicit_secure_channel(ISDAID, sizeof(ISDAID), NULL, S_ENC, S_MAC, DEK, GP211_SCP02_IMPL_i0A,
+			sequenceCounter, &secInfo);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not init implicit Secure Channel: %s", status.errorMessage);
+		}
+		secInfo.securityLevel = GP211_SCP02_SECURITY_LEVEL_C_MAC;
+		memcpy(icv, secInfo.lastC_MAC, 8);
+		fail_unless(capduLength == 8, "GET STATUS is not a case 4 command");
+		offset = header.headerLength;
+		for (i=0; i<2; i++) {
+			wrappedLength = sizeof(wrapped);
+			status = get_status_command(&secInfo, wrapped, &wrappedLength);
+			if (OPGP_ERROR_CHECK(status)) {
+				fail("Could not wrap GET STATUS command: %s", status.errorMessage);
+			}
+			fail_unless(((DWORD)buffer[offset] << 8 | buffer[offset+1]) == wrappedLength, "Incorrect length of command %d", i);
+			fail_unless(memcmp(buffer+offset+2, wrapped, wrappedLength) == 0, "Incorrect C-MAC of command %d", i);
+			// the unmodified header and data without Le fit into one padded block, so the retail MAC is
+			// the triple DES encryption of the block XOR the ICV
+			memset(macData, 0, sizeof(macData));
+			memcpy(macData, capdu, 7);
+			macData[7] = 0x80;
+			for (j=0; j<8; j++) {
+				macData[j] ^= icv[j];
+			}
+			memset(&request, 0, sizeof(request));
+			request.operation = OPGP_CRYPTO_OPERATION_SESSION_KEY_SCP02;
+			memcpy(request.key, secInfo.C_MACSessionKey, 16);
+			request.data = macData;
+			request.dataLength = sizeof(macData);
+			request.result = mac;
+			request.resultLength = sizeof(mac);
+			status = OPGP_crypto_execute(&request);
+			if (OPGP_ERROR_CHECK(status)) {
+				fail("Could not calculate C-MAC: %s", status.errorMessage);
+			}
+			fail_unless(memcmp(buffer+offset+2+7, mac, 8) == 0, "C-MAC of command %d differs from the retail MAC", i);
+			memcpy(icv, mac, 8);
+			offset += 2 + wrappedLength;
+		}
+		fail_unless(offset == script.length, "Unexpected data after the commands");
+
+		// truncated
+		status = GP211_read_wrapped_script_header(buffer, header.headerLength - 1, &header);
+		fail_unless(status.errorCode == OPGP_ERROR_INSUFFICIENT_BUFFER, "Truncated header accepted");
+		fail_unless(header.scriptLength == script.length, "Script length not set for a truncated header");
+		status = GP211_read_wrapped_script_header(buffer, 16, &header);
+		fail_unless(status.errorCode == OPGP_ERROR_INVALID_WRAPPED_SCRIPT, "Truncated fixed header accepted");
+
+		// corrupt
+		memcpy(corrupt, buffer, script.length);
+		corrupt[0] = 'X';
+		status = GP211_read_wrapped_script_header(corrupt, script.length, &header);
+		fail_unless(status.errorCode == OPGP_ERROR_INVALID_WRAPPED_SCRIPT, "Incorrect magic accepted");
+		memcpy(corrupt, buffer, script.length);
+		corrupt[13] = 0xFF;
+		status = GP211_read_wrapped_script_header(corrupt, script.length, &header);
+		fail_unless(status.errorCode == OPGP_ERROR_INVALID_WRAPPED_SCRIPT, "Over long card identifier accepted");
+		memcpy(corrupt, buffer, script.length);
+		corrupt[5] = corrupt[6] = corrupt[7] = corrupt[8] = 0xFF;
+		status = GP211_read_wrapped_script_header(corrupt, script.length, &header);
+		fail_unless(status.errorCode == OPGP_ERROR_INVALID_WRAPPED_SCRIPT, "Over long script length accepted");
+		memcpy(corrupt, buffer, script.length);
+		corrupt[5] = corrupt[6] = corrupt[7] = 0x00;
+		corrupt[8] = 20;
+		status = GP211_read_wrapped_script_header(corrupt, script.length, &header);
+		fail_unless(status.errorCode == OPGP_ERROR_INVALID_WRAPPED_SCRIPT, "Script length shorter than the header accepted");
+
+		// a corrupt length in a file must be rejected before anything is sent to the card
+		memcpy(corrupt, buffer, script.length);
+		corrupt[6] = 0x10;
+		file = fopen("wrappedscripts.bin", "wb");
+		fail_unless(file != NULL, "Could not create script file");
+		fwrite(corrupt, 1, script.length, file);
+		fclose(file);
+		memset(&offlineContext, 0, sizeof(offlineContext));
+		status = GP211_send_wrapped_script_from_file(offlineContext, offlineCardInfo(), _T("wrappedscripts.bin"),
+			cardIdentifier, sizeof(cardIdentifier), NULL);
+		fail_unless(status.errorCode == OPGP_ERROR_INVALID_WRAPPED_SCRIPT, "Script length beyond the file accepted");
+		remove("wrappedscripts.bin");
+} END_TEST
+
+/**
+ * Tests that a saved card profile database is loaded again unchanged and that an over long ATR is rejected.
+ */
+START_TEST (test_card_profile_database) {
+		OPGP_ERROR_STATUS status;
+		OPGP_CARD_PROFILE_DATABASE database;
+		OPGP_CARD_PROFILE profile;
+		OPGP_CARD_PROFILE loaded;
+		BYTE ATR[] = {0x3B,0xE9,0x00,0x00,0x81,0x31,0xFE,0x45,0x4A,0x43,0x4F,0x50};
+		BYTE IIN[] = {0x42,0x07,0x89,0x00};
+		FILE *file;
+		int i;
+
+		memset(&profile, 0, sizeof(profile));
+		memcpy(profile.ATR, ATR, sizeof(ATR));
+		profile.ATRLength = sizeof(ATR);
+		memcpy(profile.IIN, IIN, sizeof(IIN));
+		profile.IINLength = sizeof(IIN);
+		profile.secureChannelProtocol = GP211_SCP03;
+		profile.secureChannelProtocolImpl = 0x70;
+		profile.derivationMethod = OPGP_DERIVATION_METHOD_EMV_CPS11;
+		OPGP_card_profile_database_init(&database);
+		status = OPGP_card_profile_store(&database, &profile);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not store card profile: %s", status.errorMessage);
+		}
+		status = OPGP_card_profile_database_save(&database, _T("cardprofiles.txt"));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not save card profiles: %s", status.errorMessage);
+		}
+		OPGP_card_profile_database_release(&database);
+
+		status = OPGP_card_profile_database_load(&database, _T("cardprofiles.txt"));
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not load card profiles: %s", status.errorMessage);
+		}
+		status = OPGP_card_profile_lookup(&database, ATR, sizeof(ATR), IIN, sizeof(IIN), &loaded);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not look up card profile: %s", status.errorMessage);
+		}
+		fail_unless(loaded.secureChannelProtocol == GP211_SCP03, "Incorrect Secure Channel Protocol");
+		fail_unless(loaded.secureChannelProtocolImpl == 0x70, "Incorrect Secure Channel Protocol implementation");
+		fail_unless(loaded.derivationMethod == OPGP_DERIVATION_METHOD_EMV_CPS11, "Incorrect derivation method");
+		OPGP_card_profile_database_release(&database);
+
+		file = fopen("cardprofiles.txt", "w");
+		fail_unless(file != NULL, "Could not create card profile file");
+		for (i=0; i<MAX_ATR_SIZE+1; i++) {
+			fputs("3B", file);
+		}
+		fputs(" - 03 70 02\n", file);
+		fclose(file);
+		status = OPGP_card_profile_database_load(&database, _T("cardprofiles.txt"));
+		fail_unless(status.errorCode == OPGP_ERROR_INVALID_CARD_PROFILE, "Over long ATR accepted");
+		OPGP_card_profile_database_release(&database);
+		remove("cardprofiles.txt");
+} END_TEST
+
+/**
+ * Tests that a binary trace is converted into byte wise text lines.
+ */
+START_TEST (test_convert_binary_trace) {
+		OPGP_ERROR_STATUS status;
+		BYTE binaryTrace[] = {OPGP_TRACE_RECORD_COMMAND,0x00,0x05,0x80,0xCA,0x00,0x66,0x00,
+			OPGP_TRACE_RECORD_RESPONSE,0x00,0x02,0x6A,0x88};
+		const char text[] = "Command --> 80CA006600\nResponse <-- 6A88\n";
+		char converted[64];
+		size_t convertedLength;
+		FILE *in = tmpfile();
+		FILE *out = tmpfile();
+		fail_unless(in != NULL && out != NULL, "Could not create temporary files");
+		fwrite(binaryTrace, 1, sizeof(binaryTrace), in);
+		rewind(in);
+		status = OPGP_convert_binary_trace(in, out);
+		if (OPGP_ERROR_CHECK(status)) {
+			fail("Could not convert binary trace: %s", status.errorMessage);
+		}
+		rewind(out);
+		convertedLength = fread(converted, 1, sizeof(converted), out);
+		fclose(in);
+		fclose(out);
+		fail_unless(convertedLength == strlen(text) && memcmp(converted, text, convertedLength) == 0, "Incorrect text trace");
+} END_TEST
+
 Suite * GlobalPlatform_suite(void) {
 	Suite *s = suite_create("GlobalPlatform");
 	/* Core test case */
 	TCase *tc_core = tcase_create("Core");
+	TCase *tc_offline;
     tcase_set_timeout(tc_core, 0);
 	tcase_add_test (tc_core, test_list_readers);
 	tcase_add_test (tc_core, test_connect_card);
@@ -601,6 +1776,24 @@ Suite * GlobalPlatform_suite(void) {
     //tcase_add_test (tc_core, test_delete_key);
 	suite_add_tcase(s, tc_core);
 
+	/* Tests without a card */
+	tc_offline = tcase_create("Offline");
+	tcase_add_test (tc_offline, test_software_crypto_provider);
+	tcase_add_test (tc_offline, test_operation_mutual_authentication);
+	tcase_add_test (tc_offline, test_operation_mutual_authentication_provider);
+	tcase_add_test (tc_offline, test_operation_get_status);
+	tcase_add_test (tc_offline, test_operation_get_status_tlv);
+	tcase_add_test (tc_offline, test_operation_get_status_callback);
+	tcase_add_test (tc_offline, test_load_file_inventory);
+	tcase_add_test (tc_offline, test_operation_delete);
+	tcase_add_test (tc_offline, test_operation_load);
+	tcase_add_test (tc_offline, test_operation_install);
+	tcase_add_test (tc_offline, test_plan_card_content);
+	tcase_add_test (tc_offline, test_wrapped_script);
+	tcase_add_test (tc_offline, test_card_profile_database);
+	tcase_add_test (tc_offline, test_convert_binary_trace);
+	suite_add_tcase(s, tc_offline);
+
 	return s;
 }
 
@@ -15,6 +15,8 @@
  *  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define OPGP_LOG_CATEGORY OPGP_LOG_CATEGORY_LOAD //!< Category of the log messages of this file.
+
 #include "loadfile.h"
 #include <stdio.h>
 #include <errno.h>
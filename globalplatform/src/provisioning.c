@@ -0,0 +1,384 @@
+/*  Copyright (c) 2026, GlobalPlatform Library contributors
+ *  This file is part of GlobalPlatform.
+ *
+ *  GlobalPlatform is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GlobalPlatform is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef WIN32
+#include "stdafx.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "globalplatform/globalplatform.h"
+#include "globalplatform/debug.h"
+
+#define MAX_DELETE_RECEIPTS 19 //!< A DELETE response of at most 256 bytes holds at most 19 receipts of 14 bytes.
+
+/**
+ * Compares two AIDs.
+ * \param AID [in] The first AID.
+ * \param AIDLength [in] The length of the first AID.
+ * \param other [in] The second AID.
+ * \param otherLength [in] The length of the second AID.
+ * \return 1 if the AIDs are equal, 0 otherwise.
+ */
+static int equal_AID(PBYTE AID, DWORD AIDLength, PBYTE other, DWORD otherLength) {
+	return AIDLength == otherLength && memcmp(AID, other, AIDLength) == 0;
+}
+
+/**
+ * Finds an Executable Load File in an inventory.
+ * \param *loadFiles [in] The inventory.
+ * \param *AID [in] The AID of the Executable Load File.
+ * \return The Executable Load File or NULL if it is not present.
+ */
+static GP211_LOAD_FILE_DATA *find_load_file(GP211_LOAD_FILE_INVENTORY *loadFiles, OPGP_AID *AID) {
+	DWORD i;
+	for (i=0; i<loadFiles->loadFilesLength; i++) {
+		if (equal_AID(loadFiles->loadFiles[i].AID, loadFiles->loadFiles[i].AIDLength, AID->AID, AID->AIDLength)) {
+			return loadFiles->loadFiles + i;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Finds an application in the GET STATUS result.
+ * \param *applData [in] The applications.
+ * \param applDataLength [in] The number of applications.
+ * \param *AID [in] The AID of the application.
+ * \return The application or NULL if it is not present.
+ */
+static GP211_APPLICATION_DATA *find_application(GP211_APPLICATION_DATA *applData, DWORD applDataLength, OPGP_AID *AID) {
+	DWORD i;
+	for (i=0; i<applDataLength; i++) {
+		if (equal_AID(applData[i].AID, applData[i].AIDLength, AID->AID, AID->AIDLength)) {
+			return applData + i;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Checks if an Executable Load File on the card contains an Executable Module.
+ * \param *loadFiles [in] The inventory.
+ * \param *loadFile [in] The Executable Load File.
+ * \param *moduleAID [in] The AID of the Executable Module.
+ * \return 1 if the Executable Module is present, 0 otherwise.
+ */
+static int has_module(GP211_LOAD_FILE_INVENTORY *loadFiles, GP211_LOAD_FILE_DATA *loadFile, OPGP_AID *moduleAID) {
+	DWORD i;
+	OPGP_AID *module;
+	for (i=0; i<loadFile->numExecutableModules; i++) {
+		module = loadFiles->executableModules + loadFile->executableModulesOffset + i;
+		if (equal_AID(module->AID, module->AIDLength, moduleAID->AID, moduleAID->AIDLength)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Appends a step to a plan.
+ * \param plan [out] The plan.
+ * \param *planLength [in, out] The number of steps in the plan.
+ * \param planSize [in] The number of steps the plan can hold.
+ * \param action [in] The action of the step.
+ * \param index [in] The index of the package or instance.
+ * \param *AID [in] The AID of the object.
+ * \return 0 if the step was added, -1 if the plan is full.
+ */
+static int add_step(GP211_PLAN_STEP *plan, PDWORD planLength, DWORD planSize, DWORD action, DWORD index, OPGP_AID *AID) {
+	if (*planLength >= planSize) {
+		return -1;
+	}
+	plan[*planLength].action = action;
+	plan[*planLength].index = index;
+	plan[*planLength].AID = *AID;
+	(*planLength)++;
+	return 0;
+}
+
+/**
+ * The card content is compared with the manifest and only the necessary commands are planned:
+ * - A package is loaded if it is not present, if the card lacks an Executable Module used by an instance of the manifest,
+ * if reload is set or if one of its dependencies is loaded again.
+ * - An instance is installed if it is not present, if its package is loaded or if its privileges differ.
+ * The Load File Data Block Hash cannot be read from the card, a caller knowing a package changed must set reload.
+ * Install parameters cannot be read either, so they are not compared.
+ *
+ * Instances with different privileges are deleted first, then changed packages which are present on the card are
+ * deleted together with their instances in reverse dependency order. Then the packages are loaded in dependency order
+ * and at last the instances are installed.
+ * The plan must hold at least 2 * (packagesLength + instancesLength) steps.
+ * \param *manifest [in] The desired card content.
+ * \param *loadFiles [in] The Executable Load Files on the card returned by GP211_get_load_file_inventory().
+ * \param *applData [in] The applications on the card returned by GP211_get_status() for GP211_STATUS_APPLICATIONS.
+ * \param applDataLength [in] The number of applications.
+ * \param *plan [out] The steps of the plan.
+ * \param planLength [in, out] The number of steps the plan can hold and the number of planned steps.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_plan_card_content(GP211_MANIFEST *manifest, GP211_LOAD_FILE_INVENTORY *loadFiles,
+				GP211_APPLICATION_DATA *applData, DWORD applDataLength, GP211_PLAN_STEP *plan, PDWORD planLength) {
+	OPGP_ERROR_STATUS status;
+	PBYTE reload = NULL;
+	PBYTE install = NULL;
+	DWORD planSize = *planLength;
+	DWORD i, j, dependency;
+	GP211_MANIFEST_PACKAGE *package;
+	GP211_MANIFEST_INSTANCE *instance;
+	GP211_LOAD_FILE_DATA *loadFile;
+	GP211_APPLICATION_DATA *application;
+	OPGP_LOG_START(_T("GP211_plan_card_content"));
+	*planLength = 0;
+	reload = (PBYTE)calloc(manifest->packagesLength + 1, 1);
+	install = (PBYTE)calloc(manifest->instancesLength + 1, 1);
+	if (reload == NULL || install == NULL) {
+		OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM));
+		goto end;
+	}
+	for (i=0; i<manifest->instancesLength; i++) {
+		if (manifest->instances[i].package >= manifest->packagesLength) {
+			{ OPGP_ERROR_CREATE_ERROR(status, EINVAL, OPGP_stringify_error(EINVAL)); goto end; }
+		}
+	}
+	// packages which are missing or incomplete
+	for (i=0; i<manifest->packagesLength; i++) {
+		package = manifest->packages + i;
+		loadFile = find_load_file(loadFiles, &package->AID);
+		if (loadFile == NULL || package->reload) {
+			reload[i] = 1;
+		}
+		for (j=0; j<manifest->instancesLength && !reload[i]; j++) {
+			instance = manifest->instances + j;
+			if (instance->package == i && !has_module(loadFiles, loadFile, &instance->moduleAID)) {
+				reload[i] = 1;
+			}
+		}
+		for (j=0; j<package->dependenciesLength; j++) {
+			dependency = package->dependencies[j];
+			if (dependency >= i) {
+				{ OPGP_ERROR_CREATE_ERROR(status, EINVAL, OPGP_stringify_error(EINVAL)); goto end; }
+			}
+			// an imported package can only be deleted after this package, so this package must be loaded again
+			if (reload[dependency]) {
+				reload[i] = 1;
+			}
+		}
+	}
+	// instances which are missing, have different privileges or are removed with their package
+	for (i=0; i<manifest->instancesLength; i++) {
+		instance = manifest->instances + i;
+		application = find_application(applData, applDataLength, &instance->AID);
+		if (application == NULL || reload[instance->package]) {
+			install[i] = 1;
+		}
+		else if (application->privileges != instance->privileges) {
+			install[i] = 1;
+			if (add_step(plan, planLength, planSize, GP211_PLAN_DELETE, i, &instance->AID)) {
+				goto insufficient;
+			}
+		}
+	}
+	for (i=manifest->packagesLength; i>0; i--) {
+		package = manifest->packages + i - 1;
+		if (reload[i-1] && find_load_file(loadFiles, &package->AID) != NULL) {
+			if (add_step(plan, planLength, planSize, GP211_PLAN_DELETE, i-1, &package->AID)) {
+				goto insufficient;
+			}
+		}
+	}
+	for (i=0; i<manifest->packagesLength; i++) {
+		if (reload[i]) {
+			if (add_step(plan, planLength, planSize, GP211_PLAN_LOAD, i, &manifest->packages[i].AID)) {
+				goto insufficient;
+			}
+		}
+	}
+	for (i=0; i<manifest->instancesLength; i++) {
+		if (install[i]) {
+			if (add_step(plan, planLength, planSize, GP211_PLAN_INSTALL, i, &manifest->instances[i].AID)) {
+				goto insufficient;
+			}
+		}
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+insufficient:
+	OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_BUFFER, OPGP_stringify_error(OPGP_ERROR_INSUFFICIENT_BUFFER));
+end:
+	if (reload != NULL) {
+		free(reload);
+	}
+	if (install != NULL) {
+		free(install);
+	}
+	OPGP_LOG_END(_T("GP211_plan_card_content"), status);
+	return status;
+}
+
+/**
+ * The steps are executed in order. The execution stops at the first failing step.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param *manifest [in] The manifest the plan was computed for.
+ * \param *plan [in] The steps of the plan.
+ * \param planLength [in] The number of steps.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_execute_plan(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				GP211_MANIFEST *manifest, GP211_PLAN_STEP *plan, DWORD planLength) {
+	OPGP_ERROR_STATUS status;
+	GP211_RECEIPT_DATA receipts[MAX_DELETE_RECEIPTS];
+	DWORD receiptsLength;
+	DWORD i;
+	GP211_MANIFEST_PACKAGE *package;
+	GP211_MANIFEST_INSTANCE *instance;
+	OPGP_LOG_START(_T("GP211_execute_plan"));
+	for (i=0; i<planLength; i++) {
+		switch (plan[i].action) {
+			case GP211_PLAN_DELETE:
+				receiptsLength = MAX_DELETE_RECEIPTS;
+				status = GP211_delete_application(cardContext, cardInfo, secInfo, &plan[i].AID, 1, receipts, &receiptsLength);
+				break;
+			case GP211_PLAN_LOAD:
+				package = manifest->packages + plan[i].index;
+				status = GP211_install_for_load(cardContext, cardInfo, secInfo, package->AID.AID, package->AID.AIDLength,
+					package->securityDomainAID.AID, package->securityDomainAID.AIDLength, package->loadFileDataBlockHash,
+					NULL, 0, 0, 0);
+				if (OPGP_ERROR_CHECK(status)) {
+					goto end;
+				}
+				status = GP211_load_from_buffer(cardContext, cardInfo, secInfo, NULL, 0, package->loadFileBuf,
+					package->loadFileBufSize, receipts, &receiptsLength, NULL);
+				break;
+			case GP211_PLAN_INSTALL:
+				instance = manifest->instances + plan[i].index;
+				package = manifest->packages + instance->package;
+				status = GP211_install_for_install_and_make_selectable(cardContext, cardInfo, secInfo,
+					package->AID.AID, package->AID.AIDLength, instance->moduleAID.AID, instance->moduleAID.AIDLength,
+					instance->AID.AID, instance->AID.AIDLength, instance->privileges, instance->volatileDataSpaceLimit,
+					instance->nonVolatileDataSpaceLimit, instance->installParameters, instance->installParametersLength,
+					NULL, receipts, &receiptsLength);
+				break;
+			default:
+				{ OPGP_ERROR_CREATE_ERROR(status, EINVAL, OPGP_stringify_error(EINVAL)); goto end; }
+		}
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
+		}
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("GP211_execute_plan"), status);
+	return status;
+}
+
+/**
+ * Parameters of add_application().
+ */
+typedef struct {
+	GP211_APPLICATION_DATA *applData; //!< The collected applications.
+	DWORD applDataLength; //!< The number of collected applications.
+	DWORD applDataSize; //!< The number of allocated applications.
+	DWORD errorCode; //!< The error code if the memory could not be allocated, otherwise 0.
+} APPLICATION_LIST_PARAMETERS;
+
+/**
+ * GET STATUS callback collecting the applications.
+ * \param *callbackParameters [in] The GET STATUS entry.
+ * \return 0 or #GP211_GET_STATUS_STOP if the memory could not be allocated.
+ */
+static DWORD add_application(GP211_GET_STATUS_CALLBACK_PARAMETERS *callbackParameters) {
+	APPLICATION_LIST_PARAMETERS *parameters = (APPLICATION_LIST_PARAMETERS *)callbackParameters->parameters;
+	GP211_APPLICATION_DATA *applData;
+	DWORD size;
+	if (parameters->applDataLength == parameters->applDataSize) {
+		size = parameters->applDataSize == 0 ? 32 : parameters->applDataSize * 2;
+		applData = (GP211_APPLICATION_DATA *)realloc(parameters->applData, size * sizeof(GP211_APPLICATION_DATA));
+		if (applData == NULL) {
+			parameters->errorCode = ENOMEM;
+			return GP211_GET_STATUS_STOP;
+		}
+		parameters->applData = applData;
+		parameters->applDataSize = size;
+	}
+	parameters->applData[parameters->applDataLength++] = *callbackParameters->applData;
+	return 0;
+}
+
+/**
+ * The Executable Load Files and applications are read with GET STATUS, the plan is computed with GP211_plan_card_content()
+ * and executed with GP211_execute_plan(). So only the changed content is deleted, loaded and installed.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param *secInfo [in, out] The pointer to the GP211_SECURITY_INFO structure returned by GP211_mutual_authentication().
+ * \param *manifest [in] The desired card content.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_provision_card_content(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, GP211_SECURITY_INFO *secInfo,
+				GP211_MANIFEST *manifest) {
+	OPGP_ERROR_STATUS status;
+	GP211_LOAD_FILE_INVENTORY loadFiles;
+	APPLICATION_LIST_PARAMETERS applications;
+	GP211_GET_STATUS_CALLBACK callback;
+	GP211_PLAN_STEP *plan = NULL;
+	DWORD planLength;
+	OPGP_LOG_START(_T("GP211_provision_card_content"));
+	GP211_load_file_inventory_init(&loadFiles);
+	memset(&applications, 0, sizeof(applications));
+	status = GP211_get_load_file_inventory(cardContext, cardInfo, secInfo, &loadFiles);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	callback.callback = (PVOID)add_application;
+	callback.parameters = &applications;
+	status = GP211_get_status_with_callback(cardContext, cardInfo, secInfo, GP211_STATUS_APPLICATIONS, &callback);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	if (applications.errorCode != 0) {
+		{ OPGP_ERROR_CREATE_ERROR(status, applications.errorCode, OPGP_stringify_error(applications.errorCode)); goto end; }
+	}
+	planLength = 2 * (manifest->packagesLength + manifest->instancesLength);
+	plan = (GP211_PLAN_STEP *)malloc((planLength + 1) * sizeof(GP211_PLAN_STEP));
+	if (plan == NULL) {
+		OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM));
+		goto end;
+	}
+	status = GP211_plan_card_content(manifest, &loadFiles, applications.applData, applications.applDataLength, plan, &planLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = GP211_execute_plan(cardContext, cardInfo, secInfo, manifest, plan, planLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	if (plan != NULL) {
+		free(plan);
+	}
+	if (applications.applData != NULL) {
+		free(applications.applData);
+	}
+	GP211_load_file_inventory_release(&loadFiles);
+	OPGP_LOG_END(_T("GP211_provision_card_content"), status);
+	return status;
+}
@@ -135,6 +135,20 @@ OPGP_STRING OPGP_stringify_error(DWORD errorCode) {
 		return _T("SCP03 with security level 3 is not supported.");
 	if (errorCode == OPGP_ERROR_SCP03_SECURITY_LEVEL_3_NOT_SUPPORTED)
 		return _T("SCP03 with security level 3 is not supported.");
+	if (errorCode == OPGP_ERROR_OPERATION_FINISHED)
+		return _T("The operation is already finished and has no further command.");
+	if (errorCode == OPGP_ERROR_CARD_PROFILE_NOT_FOUND)
+		return _T("No card profile is known for this card.");
+	if (errorCode == OPGP_ERROR_INVALID_CARD_PROFILE)
+		return _T("A card profile or card profile database file is invalid.");
+	if (errorCode == OPGP_ERROR_INSUFFICIENT_CARD_MEMORY)
+		return _T("The card has not enough free memory for the operation.");
+	if (errorCode == OPGP_ERROR_INVALID_WRAPPED_SCRIPT)
+		return _T("A pre-wrapped script is invalid.");
+	if (errorCode == OPGP_ERROR_WRAPPED_SCRIPT_NOT_FOUND)
+		return _T("No pre-wrapped script exists for this card.");
+	if (errorCode == OPGP_ERROR_UNKNOWN_KEY_HANDLE)
+		return _T("The key handle is not known by the crypto provider.");
 	if ((errorCode & ((DWORD)0xFFFFFF00L)) == OPGP_ISO7816_ERROR_CORRECT_LENGTH) {
         _sntprintf(strError, strErrorSize, _T("Wrong length Le: Exact length: 0x%02lX"),
 					errorCode&0x000000ff);
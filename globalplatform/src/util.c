@@ -18,6 +18,27 @@
 #include "util.h"
 #include <string.h>
 
+/**
+ * The hex representation of each byte value.
+ */
+static const TCHAR hexPairs[] =
+	_T("000102030405060708090A0B0C0D0E0F")
+	_T("101112131415161718191A1B1C1D1E1F")
+	_T("202122232425262728292A2B2C2D2E2F")
+	_T("303132333435363738393A3B3C3D3E3F")
+	_T("404142434445464748494A4B4C4D4E4F")
+	_T("505152535455565758595A5B5C5D5E5F")
+	_T("606162636465666768696A6B6C6D6E6F")
+	_T("707172737475767778797A7B7C7D7E7F")
+	_T("808182838485868788898A8B8C8D8E8F")
+	_T("909192939495969798999A9B9C9D9E9F")
+	_T("A0A1A2A3A4A5A6A7A8A9AAABACADAEAF")
+	_T("B0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF")
+	_T("C0C1C2C3C4C5C6C7C8C9CACBCCCDCECF")
+	_T("D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF")
+	_T("E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEF")
+	_T("F0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF");
+
 /**
  * \param b [in] The Le BYTE.
  * \return Value of b.
@@ -63,3 +84,77 @@ end:
 	return result;
 }
 
+/**
+ * Reads the tag and length of a BER-TLV object. Tags of 1 or 2 bytes and lengths up to 255 are supported.
+ * \param buffer [in] The buffer.
+ * \param length [in] The length of the buffer.
+ * \param *tag [out] The tag.
+ * \param *valueLength [out] The length of the value. The value follows the consumed bytes.
+ * \return -1 in case of error, the length of the tag and length fields otherwise.
+ */
+LONG read_BER_TLV_header(PBYTE buffer, DWORD length, PDWORD tag, PDWORD valueLength) {
+	LONG result;
+	DWORD i=0;
+	if (length < 2) {
+		result = -1;
+		goto end;
+	}
+	*tag = buffer[i++];
+	if ((*tag & 0x1F) == 0x1F) {
+		*tag = (*tag << 8) | buffer[i++];
+	}
+	if (i >= length) {
+		result = -1;
+		goto end;
+	}
+	if (buffer[i] == 0x81) {
+		i++;
+		if (i >= length) {
+			result = -1;
+			goto end;
+		}
+	}
+	else if (buffer[i] > 0x7F) {
+		result = -1;
+		goto end;
+	}
+	*valueLength = buffer[i++];
+	if (length - i < *valueLength) {
+		result = -1;
+		goto end;
+	}
+	result = (LONG)i;
+end:
+	return result;
+}
+
+/**
+ * The bytes are converted with a lookup table of the hex pairs, 4 bytes per loop iteration.
+ * The hex string is not terminated.
+ * \param buffer [in] The buffer.
+ * \param length [in] The length of the buffer.
+ * \param hex [out] The hex string. Must have space for 2*length characters.
+ * \return The number of written characters.
+ */
+DWORD to_hex(PBYTE buffer, DWORD length, TCHAR *hex) {
+	DWORD i = 0;
+	const TCHAR *pair;
+	TCHAR *out = hex;
+	for (; i+4<=length; i+=4) {
+		pair = hexPairs + 2*buffer[i];
+		out[0] = pair[0]; out[1] = pair[1];
+		pair = hexPairs + 2*buffer[i+1];
+		out[2] = pair[0]; out[3] = pair[1];
+		pair = hexPairs + 2*buffer[i+2];
+		out[4] = pair[0]; out[5] = pair[1];
+		pair = hexPairs + 2*buffer[i+3];
+		out[6] = pair[0]; out[7] = pair[1];
+		out += 8;
+	}
+	for (; i<length; i++) {
+		pair = hexPairs + 2*buffer[i];
+		out[0] = pair[0]; out[1] = pair[1];
+		out += 2;
+	}
+	return 2*length;
+}
@@ -33,6 +33,13 @@ extern "C"
 
 #include "globalplatform/types.h"
 #include "globalplatform/library.h"
+#include "globalplatform/unicode.h"
+
+#ifdef WIN32
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
 
 /**
  * A TLV object. Only simple objects with tags sizes of 1 byte and lengths <= 127 are supported.
@@ -47,6 +54,10 @@ typedef struct {
 OPGP_NO_API
 LONG read_TLV(PBYTE buffer, DWORD length, TLV *tlv);
 
+//! \brief Reads the tag and length of a BER-TLV object from the given buffer.
+OPGP_NO_API
+LONG read_BER_TLV_header(PBYTE buffer, DWORD length, PDWORD tag, PDWORD valueLength);
+
 //! \brief Converts a ISO 7816-4 Le Byte into its value.
 OPGP_NO_API
 DWORD convert_byte(BYTE b);
@@ -55,6 +66,10 @@ DWORD convert_byte(BYTE b);
 OPGP_NO_API
 DWORD get_short(PBYTE buf, DWORD offset);
 
+//! \brief Converts a buffer into an upper case hex string.
+OPGP_NO_API
+DWORD to_hex(PBYTE buffer, DWORD length, TCHAR *hex);
+
 #ifdef __cplusplus
 }
 #endif
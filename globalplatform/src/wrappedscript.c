@@ -0,0 +1,470 @@
+/*  Copyright (c) 2026, GlobalPlatform Library contributors
+ *  This file is part of GlobalPlatform.
+ *
+ *  GlobalPlatform is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GlobalPlatform is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef WIN32
+#include "stdafx.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "globalplatform/globalplatform.h"
+#include "globalplatform/errorcodes.h"
+#include "globalplatform/stringify.h"
+#include "globalplatform/debug.h"
+#include "crypto.h"
+
+static const BYTE scriptMagic[4] = {'G', 'P', 'W', 'S'}; //!< The magic bytes at the start of each pre-wrapped script.
+
+#define SCRIPT_FORMAT_VERSION 1 //!< The version of the pre-wrapped script format.
+#define SCRIPT_LENGTH_OFFSET 5 //!< The offset of the script length in the header.
+#define SCRIPT_CARD_IDENTIFIER_OFFSET 13 //!< The offset of the card identifier length in the header.
+#define SCRIPT_MIN_HEADER_LENGTH 17 //!< The length of the header without card identifier and AID.
+#define SCRIPT_MAX_LENGTH (SCRIPT_MIN_HEADER_LENGTH + GP211_WRAPPED_SCRIPT_MAX_CARD_IDENTIFIER_LENGTH + 16 + 0xFFFF * (2 + 261)) //!< The length of a script with the maximum number of commands of maximum length.
+
+/**
+ * Writes a 2 or 4 byte big endian number.
+ */
+static void put_number(PBYTE buf, DWORD value, DWORD length) {
+	DWORD i;
+	for (i=0; i<length; i++) {
+		buf[i] = (BYTE)(value >> (8*(length-1-i)));
+	}
+}
+
+/**
+ * Reads a 2 or 4 byte big endian number.
+ */
+static DWORD get_number(PBYTE buf, DWORD length) {
+	DWORD i;
+	DWORD value = 0;
+	for (i=0; i<length; i++) {
+		value = (value << 8) | buf[i];
+	}
+	return value;
+}
+
+/**
+ * Appends an already wrapped command to the script.
+ * \param *script [in, out] The script.
+ * \param wrappedCommand [in] The wrapped command APDU.
+ * \param wrappedCommandLength [in] The length of the wrapped command APDU.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+static OPGP_ERROR_STATUS append_command(GP211_WRAPPED_SCRIPT *script, PBYTE wrappedCommand, DWORD wrappedCommandLength) {
+	OPGP_ERROR_STATUS status;
+	if (script->commandsLength == 0xFFFF) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_COMMAND_TOO_LARGE, OPGP_stringify_error(OPGP_ERROR_COMMAND_TOO_LARGE)); goto end; }
+	}
+	if (script->bufferSize - script->length < 2 + wrappedCommandLength) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_BUFFER, OPGP_stringify_error(OPGP_ERROR_INSUFFICIENT_BUFFER)); goto end; }
+	}
+	put_number(script->buffer+script->length, wrappedCommandLength, 2);
+	memcpy(script->buffer+script->length+2, wrappedCommand, wrappedCommandLength);
+	script->length += 2 + wrappedCommandLength;
+	script->commandsLength++;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	return status;
+}
+
+/**
+ * The card's Sequence Counter must be known in advance, e.g. it is the counter read with
+ * GP211_get_sequence_counter() at the last personalization step plus the number of implicit sessions opened since.
+ * The session keys are derived with GP211_init_implicit_secure_channel() and only kept in the script until
+ * GP211_end_wrapped_script() is called.
+ * \param *script [out] The script to create.
+ * \param buffer [out] The buffer receiving the script.
+ * \param bufferSize [in] The size of the buffer.
+ * \param cardIdentifier [in] An identifier of the card the script is made for, e.g. the IC serial number from the CPLC data.
+ * \param cardIdentifierLength [in] The length of the card identifier. At most #GP211_WRAPPED_SCRIPT_MAX_CARD_IDENTIFIER_LENGTH.
+ * \param AID [in] The AID of the Security Domain the implicit Secure Channel is opened with.
+ * \param AIDLength [in] The length of the AID.
+ * \param baseKey [in] Secure Channel base key. See GP211_init_implicit_secure_channel().
+ * \param S_ENC [in] Secure Channel Encryption Key.
+ * \param S_MAC [in] Secure Channel Message Authentication Code Key.
+ * \param DEK [in] Data Encryption Key.
+ * \param secureChannelProtocolImpl [in] The SCP02 implementation. Must use implicit initiation.
+ * \param securityLevel [in] #GP211_SCP02_SECURITY_LEVEL_C_MAC or #GP211_SCP02_SECURITY_LEVEL_C_DEC_C_MAC.
+ * \param sequenceCounter [in] The predicted Sequence Counter of the card.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_begin_wrapped_script(GP211_WRAPPED_SCRIPT *script, PBYTE buffer, DWORD bufferSize,
+								  PBYTE cardIdentifier, DWORD cardIdentifierLength, PBYTE AID, DWORD AIDLength,
+								  BYTE baseKey[16], BYTE S_ENC[16], BYTE S_MAC[16], BYTE DEK[16],
+								  BYTE secureChannelProtocolImpl, BYTE securityLevel, BYTE sequenceCounter[2]) {
+	OPGP_ERROR_STATUS status;
+	DWORD i = 0;
+	OPGP_LOG_START(_T("GP211_begin_wrapped_script"));
+	memset(script, 0, sizeof(GP211_WRAPPED_SCRIPT));
+	if (cardIdentifierLength > GP211_WRAPPED_SCRIPT_MAX_CARD_IDENTIFIER_LENGTH || AIDLength > 16
+			|| (securityLevel != GP211_SCP02_SECURITY_LEVEL_C_MAC && securityLevel != GP211_SCP02_SECURITY_LEVEL_C_DEC_C_MAC)) {
+		{ OPGP_ERROR_CREATE_ERROR(status, EINVAL, OPGP_stringify_error(EINVAL)); goto end; }
+	}
+	if (bufferSize < SCRIPT_MIN_HEADER_LENGTH + cardIdentifierLength + AIDLength) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_BUFFER, OPGP_stringify_error(OPGP_ERROR_INSUFFICIENT_BUFFER)); goto end; }
+	}
+	status = GP211_init_implicit_secure_channel(AID, AIDLength, baseKey, S_ENC, S_MAC, DEK,
+		secureChannelProtocolImpl, sequenceCounter, &script->secInfo);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	script->secInfo.securityLevel = securityLevel;
+
+	memcpy(buffer, scriptMagic, sizeof(scriptMagic));
+	i += sizeof(scriptMagic);
+	buffer[i++] = SCRIPT_FORMAT_VERSION;
+	// script length is set by GP211_end_wrapped_script()
+	i += 4;
+	buffer[i++] = secureChannelProtocolImpl;
+	buffer[i++] = securityLevel;
+	buffer[i++] = sequenceCounter[0];
+	buffer[i++] = sequenceCounter[1];
+	buffer[i++] = (BYTE)cardIdentifierLength;
+	memcpy(buffer+i, cardIdentifier, cardIdentifierLength);
+	i += cardIdentifierLength;
+	buffer[i++] = (BYTE)AIDLength;
+	memcpy(buffer+i, AID, AIDLength);
+	i += AIDLength;
+	// number of commands is set by GP211_end_wrapped_script()
+	i += 2;
+
+	script->buffer = buffer;
+	script->bufferSize = bufferSize;
+	script->length = i;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	if (OPGP_ERROR_CHECK(status)) {
+		memset(&script->secInfo, 0, sizeof(GP211_SECURITY_INFO));
+	}
+	OPGP_LOG_END(_T("GP211_begin_wrapped_script"), status);
+	return status;
+}
+
+/**
+ * Commands must be added in the order they are sent, because the C-MAC of each command is chained to the previous one.
+ * \param *script [in, out] The script started with GP211_begin_wrapped_script().
+ * \param capdu [in] The unwrapped command APDU.
+ * \param capduLength [in] The length of the command APDU.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_add_wrapped_script_command(GP211_WRAPPED_SCRIPT *script, PBYTE capdu, DWORD capduLength) {
+	OPGP_ERROR_STATUS status;
+	BYTE wrappedCommand[261];
+	DWORD wrappedCommandLength = sizeof(wrappedCommand);
+	OPGP_LOG_START(_T("GP211_add_wrapped_script_command"));
+	status = wrap_command(capdu, capduLength, wrappedCommand, &wrappedCommandLength, &script->secInfo);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	status = append_command(script, wrappedCommand, wrappedCommandLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("GP211_add_wrapped_script_command"), status);
+	return status;
+}
+
+/**
+ * Records all commands of a resumable operation, e.g. one started with GP211_begin_load_from_buffer() or
+ * GP211_begin_install_for_install_and_make_selectable(). Each command is assumed to be answered with '9000',
+ * so only operations whose commands do not depend on response data can be recorded.
+ * The commands are wrapped with the Secure Channel of the script, the security information passed when starting the operation is replaced.
+ * \param *script [in, out] The script started with GP211_begin_wrapped_script().
+ * \param *operation [in, out] The started operation. It is finished afterwards.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_add_wrapped_script_operation(GP211_WRAPPED_SCRIPT *script, OPGP_OPERATION *operation) {
+	OPGP_ERROR_STATUS status;
+	BYTE success[2] = {0x90, 0x00};
+	BYTE wrappedCommand[261];
+	DWORD wrappedCommandLength;
+	OPGP_LOG_START(_T("GP211_add_wrapped_script_operation"));
+	operation->secInfo = &script->secInfo;
+	while (operation->finished != OPGP_OPERATION_FINISHED) {
+		wrappedCommandLength = sizeof(wrappedCommand);
+		status = OPGP_operation_get_command(operation, wrappedCommand, &wrappedCommandLength);
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
+		}
+		status = append_command(script, wrappedCommand, wrappedCommandLength);
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
+		}
+		status = OPGP_operation_process_response(operation, success, sizeof(success));
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
+		}
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("GP211_add_wrapped_script_operation"), status);
+	return status;
+}
+
+/**
+ * Completes the header and removes the session keys from the script structure.
+ * Afterwards script->length bytes of the buffer contain the script.
+ * \param *script [in, out] The script started with GP211_begin_wrapped_script().
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_end_wrapped_script(GP211_WRAPPED_SCRIPT *script) {
+	OPGP_ERROR_STATUS status;
+	DWORD offset;
+	OPGP_LOG_START(_T("GP211_end_wrapped_script"));
+	put_number(script->buffer+SCRIPT_LENGTH_OFFSET, script->length, 4);
+	// behind the card identifier and AID
+	offset = SCRIPT_CARD_IDENTIFIER_OFFSET + 1 + script->buffer[SCRIPT_CARD_IDENTIFIER_OFFSET];
+	offset += 1 + script->buffer[offset];
+	put_number(script->buffer+offset, script->commandsLength, 2);
+	memset(&script->secInfo, 0, sizeof(GP211_SECURITY_INFO));
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("GP211_end_wrapped_script"), status);
+	return status;
+}
+
+/**
+ * Several scripts can be stored in one file, e.g. the scripts of a whole batch of cards.
+ * \param *script [in] The script completed with GP211_end_wrapped_script().
+ * \param fileName [in] The file the script is appended to.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_append_wrapped_script_to_file(GP211_WRAPPED_SCRIPT *script, OPGP_CSTRING fileName) {
+	OPGP_ERROR_STATUS status;
+	FILE *file = NULL;
+	OPGP_LOG_START(_T("GP211_append_wrapped_script_to_file"));
+	file = _tfopen(fileName, _T("ab"));
+	if (file == NULL) {
+		OPGP_ERROR_CREATE_ERROR(status, errno, OPGP_stringify_error(errno)); goto end;
+	}
+	if (fwrite(script->buffer, 1, script->length, file) != script->length) {
+		OPGP_ERROR_CREATE_ERROR(status, errno, OPGP_stringify_error(errno)); goto end;
+	}
+	if (fclose(file) != 0) {
+		file = NULL;
+		OPGP_ERROR_CREATE_ERROR(status, errno, OPGP_stringify_error(errno)); goto end;
+	}
+	file = NULL;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	if (file != NULL) {
+		fclose(file);
+	}
+	OPGP_LOG_END(_T("GP211_append_wrapped_script_to_file"), status);
+	return status;
+}
+
+/**
+ * Only the first 17 bytes of the header must be available to get the script length, so a reader can
+ * read the header first and then the rest of the script. If these bytes are valid but the rest of the header
+ * is not available yet #OPGP_ERROR_INSUFFICIENT_BUFFER is returned.
+ * \param script [in] The script.
+ * \param scriptLength [in] The number of available bytes of the script.
+ * \param *header [out] The header. scriptLength is always set if the first 17 bytes of the header are valid.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_read_wrapped_script_header(PBYTE script, DWORD scriptLength, GP211_WRAPPED_SCRIPT_HEADER *header) {
+	OPGP_ERROR_STATUS status;
+	DWORD i = SCRIPT_LENGTH_OFFSET;
+	OPGP_LOG_START(_T("GP211_read_wrapped_script_header"));
+	memset(header, 0, sizeof(GP211_WRAPPED_SCRIPT_HEADER));
+	if (scriptLength < SCRIPT_MIN_HEADER_LENGTH || memcmp(script, scriptMagic, sizeof(scriptMagic)) != 0
+			|| script[sizeof(scriptMagic)] != SCRIPT_FORMAT_VERSION) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_WRAPPED_SCRIPT, OPGP_stringify_error(OPGP_ERROR_INVALID_WRAPPED_SCRIPT)); goto end; }
+	}
+	header->scriptLength = get_number(script+i, 4);
+	i += 4;
+	if (header->scriptLength < SCRIPT_MIN_HEADER_LENGTH || header->scriptLength > SCRIPT_MAX_LENGTH) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_WRAPPED_SCRIPT, OPGP_stringify_error(OPGP_ERROR_INVALID_WRAPPED_SCRIPT)); goto end; }
+	}
+	header->secureChannelProtocolImpl = script[i++];
+	header->securityLevel = script[i++];
+	header->sequenceCounter[0] = script[i++];
+	header->sequenceCounter[1] = script[i++];
+	header->cardIdentifierLength = script[i++];
+	if (header->cardIdentifierLength > GP211_WRAPPED_SCRIPT_MAX_CARD_IDENTIFIER_LENGTH
+			|| header->scriptLength < i + header->cardIdentifierLength + 1) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_WRAPPED_SCRIPT, OPGP_stringify_error(OPGP_ERROR_INVALID_WRAPPED_SCRIPT)); goto end; }
+	}
+	if (scriptLength < i + header->cardIdentifierLength + 1) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_BUFFER, OPGP_stringify_error(OPGP_ERROR_INSUFFICIENT_BUFFER)); goto end; }
+	}
+	memcpy(header->cardIdentifier, script+i, header->cardIdentifierLength);
+	i += header->cardIdentifierLength;
+	header->AID.AIDLength = script[i++];
+	if (header->AID.AIDLength > sizeof(header->AID.AID) || header->scriptLength < i + header->AID.AIDLength + 2) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_WRAPPED_SCRIPT, OPGP_stringify_error(OPGP_ERROR_INVALID_WRAPPED_SCRIPT)); goto end; }
+	}
+	if (scriptLength < i + header->AID.AIDLength + 2) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_BUFFER, OPGP_stringify_error(OPGP_ERROR_INSUFFICIENT_BUFFER)); goto end; }
+	}
+	memcpy(header->AID.AID, script+i, header->AID.AIDLength);
+	i += header->AID.AIDLength;
+	header->commandsLength = get_number(script+i, 2);
+	i += 2;
+	header->headerLength = i;
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("GP211_read_wrapped_script_header"), status);
+	return status;
+}
+
+/**
+ * Selects the Security Domain, which opens the implicit Secure Channel, and sends the already wrapped commands.
+ * No cryptographic operation is done by the host. Each command must be answered with '9000'.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param script [in] The script.
+ * \param scriptLength [in] The length of the script.
+ * \param failedCommand [out] The index of the command which failed. Can be NULL.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_send_wrapped_script(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo,
+								  PBYTE script, DWORD scriptLength, PDWORD failedCommand) {
+	OPGP_ERROR_STATUS status;
+	GP211_WRAPPED_SCRIPT_HEADER header;
+	BYTE recvBuffer[258];
+	DWORD recvBufferLength;
+	DWORD offset;
+	DWORD commandLength;
+	DWORD i;
+	OPGP_LOG_START(_T("GP211_send_wrapped_script"));
+	status = GP211_read_wrapped_script_header(script, scriptLength, &header);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	if (header.scriptLength > scriptLength) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_WRAPPED_SCRIPT, OPGP_stringify_error(OPGP_ERROR_INVALID_WRAPPED_SCRIPT)); goto end; }
+	}
+	status = OPGP_select_application(cardContext, cardInfo, header.AID.AID, header.AID.AIDLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		goto end;
+	}
+	offset = header.headerLength;
+	for (i=0; i<header.commandsLength; i++) {
+		if (failedCommand != NULL) {
+			*failedCommand = i;
+		}
+		if (header.scriptLength - offset < 2) {
+			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_WRAPPED_SCRIPT, OPGP_stringify_error(OPGP_ERROR_INVALID_WRAPPED_SCRIPT)); goto end; }
+		}
+		commandLength = get_number(script+offset, 2);
+		offset += 2;
+		if (header.scriptLength - offset < commandLength) {
+			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_WRAPPED_SCRIPT, OPGP_stringify_error(OPGP_ERROR_INVALID_WRAPPED_SCRIPT)); goto end; }
+		}
+		recvBufferLength = sizeof(recvBuffer);
+		status = OPGP_send_APDU(cardContext, cardInfo, NULL, script+offset, commandLength, recvBuffer, &recvBufferLength);
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
+		}
+		if (recvBufferLength < 2) {
+			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_RESPONSE_DATA, OPGP_stringify_error(OPGP_ERROR_INVALID_RESPONSE_DATA)); goto end; }
+		}
+		if (recvBuffer[recvBufferLength-2] != 0x90 || recvBuffer[recvBufferLength-1] != 0x00) {
+			OPGP_ERROR_CREATE_ERROR(status, OPGP_ISO7816_ERROR_PREFIX | (recvBuffer[recvBufferLength-2] << 8) | recvBuffer[recvBufferLength-1],
+				OPGP_stringify_error(OPGP_ISO7816_ERROR_PREFIX | (recvBuffer[recvBufferLength-2] << 8) | recvBuffer[recvBufferLength-1]));
+			goto end;
+		}
+		offset += commandLength;
+	}
+	{ OPGP_ERROR_CREATE_NO_ERROR(status); goto end; }
+end:
+	OPGP_LOG_END(_T("GP211_send_wrapped_script"), status);
+	return status;
+}
+
+/**
+ * The file is read script by script until the script of the card is found, so batch files of any size can be used.
+ * \param cardContext [in] The valid OPGP_CARD_CONTEXT returned by OPGP_establish_context()
+ * \param cardInfo [in] The OPGP_CARD_INFO structure returned by OPGP_card_connect().
+ * \param fileName [in] The file with the scripts written by GP211_append_wrapped_script_to_file().
+ * \param cardIdentifier [in] The identifier of the card passed to GP211_begin_wrapped_script().
+ * \param cardIdentifierLength [in] The length of the card identifier.
+ * \param failedCommand [out] The index of the command which failed. Can be NULL.
+ * \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+ */
+OPGP_ERROR_STATUS GP211_send_wrapped_script_from_file(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo,
+								  OPGP_CSTRING fileName, PBYTE cardIdentifier, DWORD cardIdentifierLength,
+								  PDWORD failedCommand) {
+	OPGP_ERROR_STATUS status;
+	FILE *file = NULL;
+	PBYTE script = NULL;
+	BYTE fixedHeader[SCRIPT_MIN_HEADER_LENGTH];
+	GP211_WRAPPED_SCRIPT_HEADER header;
+	size_t read;
+	long fileSize;
+	long position;
+	OPGP_LOG_START(_T("GP211_send_wrapped_script_from_file"));
+	file = _tfopen(fileName, _T("rb"));
+	if (file == NULL) {
+		OPGP_ERROR_CREATE_ERROR(status, errno, OPGP_stringify_error(errno)); goto end;
+	}
+	if (fseek(file, 0, SEEK_END) != 0 || (fileSize = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0) {
+		OPGP_ERROR_CREATE_ERROR(status, errno, OPGP_stringify_error(errno)); goto end;
+	}
+	while ((read = fread(fixedHeader, 1, sizeof(fixedHeader), file)) == sizeof(fixedHeader)) {
+		status = GP211_read_wrapped_script_header(fixedHeader, sizeof(fixedHeader), &header);
+		// only the script length is needed here, the complete header is parsed after the script was read
+		if (OPGP_ERROR_CHECK(status) && status.errorCode != OPGP_ERROR_INSUFFICIENT_BUFFER) {
+			goto end;
+		}
+		position = ftell(file);
+		if (position < 0) {
+			OPGP_ERROR_CREATE_ERROR(status, errno, OPGP_stringify_error(errno)); goto end;
+		}
+		// a corrupt length must not allocate more than the file can contain
+		if (header.scriptLength - sizeof(fixedHeader) > (unsigned long)(fileSize - position)) {
+			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_WRAPPED_SCRIPT, OPGP_stringify_error(OPGP_ERROR_INVALID_WRAPPED_SCRIPT)); goto end; }
+		}
+		script = (PBYTE)malloc(header.scriptLength);
+		if (script == NULL) {
+			{ OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM)); goto end; }
+		}
+		memcpy(script, fixedHeader, sizeof(fixedHeader));
+		if (fread(script+sizeof(fixedHeader), 1, header.scriptLength-sizeof(fixedHeader), file) != header.scriptLength-sizeof(fixedHeader)) {
+			{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_WRAPPED_SCRIPT, OPGP_stringify_error(OPGP_ERROR_INVALID_WRAPPED_SCRIPT)); goto end; }
+		}
+		status = GP211_read_wrapped_script_header(script, header.scriptLength, &header);
+		if (OPGP_ERROR_CHECK(status)) {
+			goto end;
+		}
+		if (header.cardIdentifierLength == cardIdentifierLength
+				&& memcmp(header.cardIdentifier, cardIdentifier, cardIdentifierLength) == 0) {
+			status = GP211_send_wrapped_script(cardContext, cardInfo, script, header.scriptLength, failedCommand);
+			goto end;
+		}
+		free(script);
+		script = NULL;
+	}
+	if (read != 0) {
+		{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_WRAPPED_SCRIPT, OPGP_stringify_error(OPGP_ERROR_INVALID_WRAPPED_SCRIPT)); goto end; }
+	}
+	{ OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_WRAPPED_SCRIPT_NOT_FOUND, OPGP_stringify_error(OPGP_ERROR_WRAPPED_SCRIPT_NOT_FOUND)); goto end; }
+end:
+	if (script != NULL) {
+		free(script);
+	}
+	if (file != NULL) {
+		fclose(file);
+	}
+	OPGP_LOG_END(_T("GP211_send_wrapped_script_from_file"), status);
+	return status;
+}
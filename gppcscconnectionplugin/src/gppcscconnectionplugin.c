@@ -23,6 +23,8 @@
 *
 */
 
+#define OPGP_LOG_CATEGORY OPGP_LOG_CATEGORY_TRANSPORT //!< Category of the log messages of this file.
+
 #include <globalplatform/connectionplugin.h>
 #include "gppcscconnectionplugin.h"
 #include <globalplatform/debug.h>
@@ -35,6 +37,8 @@
 #include <string.h>
 #include "util.h"
 
+#define MAX_RESPONSE_SIZE (65536 + 2) //!< Maximum size of a response collected with GET RESPONSE. ISO 7816-4 limits the response data to 65536 bytes.
+
 
 #define CHECK_CARD_CONTEXT_INITIALIZATION(cardContext, status)	if (cardContext.librarySpecific == NULL) { OPGP_ERROR_CREATE_ERROR(status, OPGP_PL_ERROR_NO_CARD_CONTEXT_INITIALIZED, OPGP_PL_stringify_error(OPGP_PL_ERROR_NO_CARD_CONTEXT_INITIALIZED)); goto end;}
 
@@ -140,9 +144,7 @@ OPGP_ERROR_STATUS OPGP_PL_list_readers(OPGP_CARD_CONTEXT cardContext, OPGP_STRIN
 	if ( SCARD_S_SUCCESS != result ) {
 		goto end;
 	}
-#ifdef DEBUG
-	OPGP_log_Msg(_T("OPGP_PL_list_readers: readerSize: %d"), readersSize);
-#endif
+	OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_TRANSPORT, _T("OPGP_PL_list_readers: readerSize: %d"), readersSize);
 	if (readerNames == NULL) {
 		*readerNamesLength = readersSize;
 		result = SCARD_S_SUCCESS;
@@ -230,10 +232,8 @@ OPGP_ERROR_STATUS OPGP_PL_card_connect(OPGP_CARD_CONTEXT cardContext, OPGP_CSTRI
 		pcscCardInfo->protocol = dummy;
 		pcscCardInfo->state = state;
 
-#ifdef DEBUG
-		OPGP_log_Msg(_T("OPGP_PL_card_connect: Connected to card in reader %s with protocol %d in card state %d"), readerName, pcscCardInfo->protocol, pcscCardInfo->state);
-		OPGP_log_Hex(_T("OPGP_PL_card_connect: Card ATR: "), cardInfo->ATR, cardInfo->ATRLength);
-#endif
+		OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_TRANSPORT, _T("OPGP_PL_card_connect: Connected to card in reader %s with protocol %d in card state %d"), readerName, pcscCardInfo->protocol, pcscCardInfo->state);
+		OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_TRANSPORT, _T("OPGP_PL_card_connect: Card ATR: "), cardInfo->ATR, cardInfo->ATRLength);
 
 		cardInfo->logicalChannel = 0;
 
@@ -290,8 +290,11 @@ OPGP_ERROR_STATUS OPGP_PL_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INF
 	DWORD offset = 0;
 
 	PBYTE responseData = NULL;
+	PBYTE tempData = NULL;
 	DWORD responseDataLength = *rapduLength;
+	DWORD responseDataSize = *rapduLength;
 	DWORD tempDataLength = 0;
+	BYTE getResponse[5] = {0x00, 0xC0, 0x00, 0x00, 0x00};
 
 	OPGP_LOG_START(_T("OPGP_PL_send_APDU"));
 	CHECK_CARD_CONTEXT_INITIALIZATION(cardContext, status)
@@ -321,6 +324,48 @@ OPGP_ERROR_STATUS OPGP_PL_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INF
 			goto end;
 		} // if ( SCARD_S_SUCCESS != result)
 		offset += responseDataLength - 2;
+
+		// The card has more data available. Collect all remaining chunks with GET RESPONSE
+		// and grow the response buffer on demand, so that large responses are returned in one call.
+		while (responseData[offset] == 0x61) {
+			la = responseData[offset + 1];
+			// GET RESPONSE must be sent on the Logical Channel of the command
+			getResponse[0] = get_response_class(capdu[0]);
+			getResponse[4] = la;
+			// a card which never stops answering 61xx must not exhaust the memory
+			if (offset + convert_byte(la) + 2 > MAX_RESPONSE_SIZE) {
+				OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_RESPONSE_DATA, OPGP_PL_stringify_error(OPGP_ERROR_INVALID_RESPONSE_DATA));
+				goto end;
+			}
+			if (offset + convert_byte(la) + 2 > responseDataSize) {
+				responseDataSize = offset + convert_byte(la) + 2;
+				tempData = (PBYTE)realloc(responseData, sizeof(BYTE)*responseDataSize);
+				if (tempData == NULL) {
+					result = ENOMEM;
+					HANDLE_STATUS(status, result);
+					goto end;
+				}
+				responseData = tempData;
+			}
+			responseDataLength = responseDataSize - offset;
+			result = SCardTransmit(GET_PCSC_CARD_INFO_SPECIFIC(cardInfo)->cardHandle,
+				SCARD_PCI_T1,
+				getResponse,
+				sizeof(getResponse),
+				NULL,
+				responseData+offset,
+				&responseDataLength
+				);
+			if (SCARD_S_SUCCESS != result) {
+				HANDLE_STATUS(status, result);
+				goto end;
+			} // if ( SCARD_S_SUCCESS != result)
+			if (responseDataLength < 2) {
+				OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INVALID_RESPONSE_DATA, OPGP_PL_stringify_error(OPGP_ERROR_INVALID_RESPONSE_DATA));
+				goto end;
+			}
+			offset += responseDataLength - 2;
+		} // while (61)
 	} else {
 		// Determine which type of Exchange between the reader
 		if (capduLength == 4) {
@@ -446,7 +491,7 @@ OPGP_ERROR_STATUS OPGP_PL_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INF
 						// These two cases behave the same way
 						la = responseData[offset + 1];
 
-						capdu[0] = 0x00;
+						capdu[0] = get_response_class(capdu[0]);
 						capdu[1] = 0xC0; // INS (Get Response)
 						capdu[2] = 0x00; // P1
 						capdu[3] = 0x00; // P2
@@ -493,7 +538,7 @@ OPGP_ERROR_STATUS OPGP_PL_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INF
 				|| responseData[offset] == 0x90
 				|| responseData[offset] == 0x9F) {
 
-					capdu[0] = 0x00;
+					capdu[0] = get_response_class(capdu[0]);
 					capdu[1] = 0xC0; // INS (Get Response)
 					capdu[2] = 0x00; // P1
 					capdu[3] = 0x00; // P2
@@ -613,7 +658,7 @@ OPGP_ERROR_STATUS OPGP_PL_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INF
 
 							la = responseData[offset + 1];
 
-							capdu[0] = 0x00;
+							capdu[0] = get_response_class(capdu[0]);
 							capdu[1] = 0xC0; // INS (Get Response)
 							capdu[2] = 0x00; // P1
 							capdu[3] = 0x00; // P2
@@ -655,7 +700,7 @@ OPGP_ERROR_STATUS OPGP_PL_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INF
 
 		la = responseData[offset + 1];
 
-		capdu[0] = 0x00;;
+		capdu[0] = get_response_class(capdu[0]);
 		capdu[1] = 0xC0; // INS (Get Response)
 		capdu[2] = 0x00; // P1
 		capdu[3] = 0x00; // P2
@@ -680,6 +725,10 @@ OPGP_ERROR_STATUS OPGP_PL_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INF
 		offset += responseDataLength - 2;
 	} // if (61)
 
+	if (offset + 2 > *rapduLength) {
+		OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_BUFFER, OPGP_PL_stringify_error(OPGP_ERROR_INSUFFICIENT_BUFFER));
+		goto end;
+	}
 	memcpy(rapdu, responseData, offset + 2);
 	*rapduLength = offset + 2;
 
@@ -695,6 +744,43 @@ end:
 	return status;
 }
 
+/**
+* \param cardContext [in] The valid OPGP_CARDCONTEXT returned by establish_context()
+* \param cardInfo [in] The OPGP_CARD_INFO structure returned by card_connect().
+* \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct.
+*/
+OPGP_ERROR_STATUS OPGP_PL_begin_transaction(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo) {
+	OPGP_ERROR_STATUS status;
+	LONG result;
+	OPGP_LOG_START(_T("OPGP_PL_begin_transaction"));
+	CHECK_CARD_CONTEXT_INITIALIZATION(cardContext, status)
+	CHECK_CARD_INFO_INITIALIZATION(cardInfo, status)
+	result = SCardBeginTransaction(GET_PCSC_CARD_INFO_SPECIFIC(cardInfo)->cardHandle);
+	HANDLE_STATUS(status, result);
+end:
+	OPGP_LOG_END(_T("OPGP_PL_begin_transaction"), status);
+	return status;
+}
+
+/**
+* The card is left in its current state.
+* \param cardContext [in] The valid OPGP_CARDCONTEXT returned by establish_context()
+* \param cardInfo [in] The OPGP_CARD_INFO structure returned by card_connect().
+* \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct.
+*/
+OPGP_ERROR_STATUS OPGP_PL_end_transaction(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo) {
+	OPGP_ERROR_STATUS status;
+	LONG result;
+	OPGP_LOG_START(_T("OPGP_PL_end_transaction"));
+	CHECK_CARD_CONTEXT_INITIALIZATION(cardContext, status)
+	CHECK_CARD_INFO_INITIALIZATION(cardInfo, status)
+	result = SCardEndTransaction(GET_PCSC_CARD_INFO_SPECIFIC(cardInfo)->cardHandle, SCARD_LEAVE_CARD);
+	HANDLE_STATUS(status, result);
+end:
+	OPGP_LOG_END(_T("OPGP_PL_end_transaction"), status);
+	return status;
+}
+
 /**
 * \param errorCode [in] The error code.
 * \return OPGP_STRING representation of the error code.
@@ -14,6 +14,10 @@
  *  You should have received a copy of the GNU Lesser General Public License
  *  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
  */
+#ifdef __linux__
+#define _GNU_SOURCE // RTLD_NEXT
+#include <dlfcn.h>
+#endif
 #include <check.h>
 #include <stdlib.h>
 #include <globalplatform/globalplatform.h>
@@ -180,16 +184,115 @@ START_TEST (test_send_APDU)
 		internal_release_context(&cardContext);
 	}END_TEST
 
+#ifdef __linux__
+#define STUB_CARD_HANDLE 0x5EED //!< The card handle answered by the SCardTransmit() stub instead of PC/SC.
+
+/**
+ * The responses of the SCardTransmit() stub. The response data is returned in two parts with 61xx.
+ */
+static BYTE stubResponses[2][5] = {{0x01, 0x02, 0x61, 0x03}, {0x03, 0x04, 0x05, 0x90, 0x00}};
+static DWORD stubResponseLengths[2] = {4, 5};
+static BYTE stubCommands[2][261]; //!< The commands received by the stub.
+static DWORD stubCommandLengths[2]; //!< The lengths of the commands received by the stub.
+static DWORD stubCalls = 0; //!< The number of commands received by the stub.
+
+/**
+ * Replaces SCardTransmit() of PC/SC for the stub card handle. Other cards are passed to PC/SC.
+ */
+PCSC_API LONG SCardTransmit(SCARDHANDLE hCard, LPCSCARD_IO_REQUEST pioSendPci, LPCBYTE pbSendBuffer, DWORD cbSendLength,
+		LPSCARD_IO_REQUEST pioRecvPci, LPBYTE pbRecvBuffer, LPDWORD pcbRecvLength) {
+	LONG (*pcscTransmit)(SCARDHANDLE, LPCSCARD_IO_REQUEST, LPCBYTE, DWORD, LPSCARD_IO_REQUEST, LPBYTE, LPDWORD);
+	if (hCard != STUB_CARD_HANDLE) {
+		*(void **)(&pcscTransmit) = dlsym(RTLD_NEXT, "SCardTransmit");
+		if (pcscTransmit == NULL) {
+			return SCARD_E_NO_SERVICE;
+		}
+		return pcscTransmit(hCard, pioSendPci, pbSendBuffer, cbSendLength, pioRecvPci, pbRecvBuffer, pcbRecvLength);
+	}
+	if (stubCalls >= 2 || *pcbRecvLength < stubResponseLengths[stubCalls]) {
+		return SCARD_E_INSUFFICIENT_BUFFER;
+	}
+	memcpy(stubCommands[stubCalls], pbSendBuffer, cbSendLength);
+	stubCommandLengths[stubCalls] = cbSendLength;
+	memcpy(pbRecvBuffer, stubResponses[stubCalls], stubResponseLengths[stubCalls]);
+	*pcbRecvLength = stubResponseLengths[stubCalls];
+	stubCalls++;
+	return SCARD_S_SUCCESS;
+}
+
+/**
+ * Sends a command to the stub card with T=1 and checks the GET RESPONSE command and the collected response.
+ * \param cla [in] The class byte of the command.
+ * \param getResponseClass [in] The expected class byte of GET RESPONSE.
+ */
+static void check_get_response(BYTE cla, BYTE getResponseClass) {
+	OPGP_ERROR_STATUS status;
+	OPGP_CARD_CONTEXT cardContext;
+	OPGP_CARD_INFO cardInfo;
+	PCSC_CARD_CONTEXT_SPECIFIC contextSpecific;
+	PCSC_CARD_INFO_SPECIFIC cardInfoSpecific;
+	BYTE capdu[] = {cla, 0xCA, 0x00, 0x66, 0x00};
+	BYTE getResponse[] = {getResponseClass, 0xC0, 0x00, 0x00, 0x03};
+	BYTE expectedResponse[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x90, 0x00};
+	BYTE rapdu[258];
+	DWORD rapduLength = sizeof(rapdu);
+
+	memset(&cardContext, 0, sizeof(cardContext));
+	memset(&cardInfo, 0, sizeof(cardInfo));
+	memset(&contextSpecific, 0, sizeof(contextSpecific));
+	memset(&cardInfoSpecific, 0, sizeof(cardInfoSpecific));
+	cardInfoSpecific.protocol = SCARD_PROTOCOL_T1;
+	cardInfoSpecific.cardHandle = STUB_CARD_HANDLE;
+	cardContext.librarySpecific = &contextSpecific;
+	cardInfo.librarySpecific = &cardInfoSpecific;
+	stubCalls = 0;
+
+	status = OPGP_PL_send_APDU(cardContext, cardInfo, capdu, sizeof(capdu), rapdu, &rapduLength);
+	if (OPGP_ERROR_CHECK(status)) {
+		fail("Could not send APDU: %s", status.errorMessage);
+	}
+	fail_unless(stubCalls == 2, "GET RESPONSE not sent");
+	fail_unless(stubCommandLengths[1] == sizeof(getResponse) && memcmp(stubCommands[1], getResponse, sizeof(getResponse)) == 0,
+		"Incorrect GET RESPONSE for class 0x%02X", (unsigned int)cla);
+	fail_unless(rapduLength == sizeof(expectedResponse) && memcmp(rapdu, expectedResponse, sizeof(expectedResponse)) == 0,
+		"Incorrect response");
+}
+
+/**
+ * Tests that GET RESPONSE with T=1 is sent on the Logical Channel of the command. No card is needed.
+ */
+START_TEST (test_get_response_logical_channel)
+	{
+		check_get_response(0x00, 0x00);
+		// GlobalPlatform command on Logical Channel 2
+		check_get_response(0x82, 0x02);
+		// secure messaging is not used for GET RESPONSE
+		check_get_response(0x87, 0x03);
+		// further interindustry class, Logical Channel 9
+		check_get_response(0xC5, 0x45);
+	}END_TEST
+#endif
+
 Suite * pcscconnectionplugin_suite(void) {
 	Suite *s = suite_create("pcscconnectionplugin");
 	/* Core test case */
 	TCase *tc_core = tcase_create("Core");
+#ifdef __linux__
+	TCase *tc_offline;
+#endif
 	tcase_add_test (tc_core, test_establish_context);
 	tcase_add_test (tc_core, test_list_readers);
 	tcase_add_test (tc_core, test_card_connect);
 	tcase_add_test (tc_core, test_send_APDU);
 	suite_add_tcase(s, tc_core);
 
+#ifdef __linux__
+	/* Tests without a card */
+	tc_offline = tcase_create("Offline");
+	tcase_add_test (tc_offline, test_get_response_logical_channel);
+	suite_add_tcase(s, tc_offline);
+#endif
+
 	return s;
 }
 
@@ -26,6 +26,19 @@ DWORD convert_byte(BYTE b) {
 	return (b == 0) ? 256 : b;
 }
 
+/**
+ * The channel of the command is kept, secure messaging and command chaining are not used for GET RESPONSE.
+ * The first interindustry class encodes the Logical Channels 0 to 3, the further interindustry class the Logical Channels 4 to 19.
+ * \param cla IN The class byte of the command.
+ * \return The class byte of GET RESPONSE.
+ */
+BYTE get_response_class(BYTE cla) {
+	if ((cla & 0x40) == 0x40) {
+		return (BYTE)(0x40 | (cla & 0x0F));
+	}
+	return (BYTE)(cla & 0x03);
+}
+
 /**
  * \param buf IN The buffer.
  * \param offset IN The offset in the buffer.
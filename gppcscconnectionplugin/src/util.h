@@ -51,6 +51,10 @@ LONG read_TLV(PBYTE buffer, DWORD length, TLV *tlv);
 OPGP_NO_API
 DWORD convert_byte(BYTE b);
 
+//! \brief Returns the class byte of a GET RESPONSE command on the Logical Channel of a command.
+OPGP_NO_API
+BYTE get_response_class(BYTE cla);
+
 //! \brief Returns a short int from the given postion,
 OPGP_NO_API
 DWORD get_short(PBYTE buf, DWORD offset);
@@ -190,6 +190,44 @@ static TCHAR *strtokCheckComment(TCHAR *buf)
     }
 }
 
+static DWORD printGP211Status(GP211_GET_STATUS_CALLBACK_PARAMETERS *parameters)
+{
+    int j;
+    int k;
+
+    if (parameters->executableData != NULL)
+    {
+        GP211_EXECUTABLE_MODULES_DATA *execData = parameters->executableData;
+        for (j=0; j<execData->AIDLength; j++)
+        {
+            _tprintf(_T("%02x"), execData->AID[j]);
+        }
+        _tprintf(_T("\t%x\n"), execData->lifeCycleState);
+        for (k=0; k<execData->numExecutableModules; k++)
+        {
+            int h;
+            printf("\t");
+            for (h=0; h<execData->executableModules[k].AIDLength; h++)
+            {
+                _tprintf(_T("%02x"), execData->executableModules[k].AID[h]);
+            }
+        }
+        _tprintf(_T("\n"));
+    }
+    else
+    {
+        GP211_APPLICATION_DATA *appData = parameters->applData;
+        for (j=0; j<appData->AIDLength; j++)
+        {
+            _tprintf(_T("%02x"), appData->AID[j]);
+        }
+
+        _tprintf(_T("\t%x"), appData->lifeCycleState);
+        _tprintf(_T("\t%x\n"), appData->privileges);
+    }
+    return 0;
+}
+
 
 static int handleOptions(OptionStr *pOptionStr)
 {
@@ -1592,21 +1630,9 @@ static int handleCommands(FILE *fd)
                 }
                 else if (platform_mode == PLATFORM_MODE_GP_211)
                 {
-                    GP211_APPLICATION_DATA appData[NUM_APPLICATIONS];
-                    GP211_EXECUTABLE_MODULES_DATA execData[NUM_APPLICATIONS];
-                    status = GP211_get_status(cardContext, cardInfo, &securityInfo211,
-                                          optionStr.element,
-                                          appData,
-                                          execData,
-                                          &numData);
-
-                    if (OPGP_ERROR_CHECK(status))
-                    {
-                        _tprintf (_T("get_status() returns 0x%08lX (%s)\n"),
-                                  status.errorCode, status.errorMessage);
-                        rv = EXIT_FAILURE;
-                        goto end;
-                    }
+                    GP211_GET_STATUS_CALLBACK callback;
+                    callback.callback = (PVOID)printGP211Status;
+                    callback.parameters = NULL;
 
                     if (optionStr.element == GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES)
                     {
@@ -1616,39 +1642,20 @@ static int handleCommands(FILE *fd)
                     {
                         _tprintf(_T("\nList of elements (AID state privileges)\n"));
                     }
-                    for (i=0; i<(int)numData; i++)
-                    {
-                        int j;
-                        int k;
-
-                        if (optionStr.element == GP211_STATUS_LOAD_FILES_AND_EXECUTABLE_MODULES)
-                        {
-                            for (j=0; j<execData[i].AIDLength; j++)
-                            {
-                                _tprintf(_T("%02x"), execData[i].AID[j]);
-                            }
-                            _tprintf(_T("\t%x\n"), execData[i].lifeCycleState);
-                            for (k=0; k<execData[i].numExecutableModules; k++)
-                            {
-                                int h;
-                                printf("\t");
-                                for (h=0; h<execData[i].executableModules[k].AIDLength; h++)
-                                {
-                                    _tprintf(_T("%02x"), execData[i].executableModules[k].AID[h]);
-                                }
-                            }
-                            _tprintf(_T("\n"));
-                        }
-                        else
-                        {
-                            for (j=0; j<appData[i].AIDLength; j++)
-                            {
-                                _tprintf(_T("%02x"), appData[i].AID[j]);
-                            }
+                    // entries are printed as they are received, so the number of entries is not limited
+                    // with -AID only the matching entries are returned by the card
+                    status = GP211_get_status_with_criteria(cardContext, cardInfo, &securityInfo211,
+                                          optionStr.element,
+                                          optionStr.AID, optionStr.AIDLen,
+                                          GP211_STATUS_FORMAT_LEGACY,
+                                          &callback);
 
-                            _tprintf(_T("\t%x"), appData[i].lifeCycleState);
-                            _tprintf(_T("\t%x\n"), appData[i].privileges);
-                        }
+                    if (OPGP_ERROR_CHECK(status))
+                    {
+                        _tprintf (_T("get_status() returns 0x%08lX (%s)\n"),
+                                  status.errorCode, status.errorMessage);
+                        rv = EXIT_FAILURE;
+                        goto end;
                     }
                 }
                 goto timer;
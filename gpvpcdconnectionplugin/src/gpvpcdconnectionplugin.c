@@ -0,0 +1,680 @@
+/*  Copyright (c) 2026, GlobalPlatform Library contributors
+*  This file is part of GlobalPlatform.
+*
+*  GlobalPlatform is free software: you can redistribute it and/or modify
+*  it under the terms of the GNU Lesser General Public License as published by
+*  the Free Software Foundation, either version 3 of the License, or
+*  (at your option) any later version.
+*
+*  GlobalPlatform is distributed in the hope that it will be useful,
+*  but WITHOUT ANY WARRANTY; without even the implied warranty of
+*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*  GNU Lesser General Public License for more details.
+*
+*  You should have received a copy of the GNU Lesser General Public License
+*  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*! \mainpage GlobalPlatform vpcd Connection Plugin
+*
+* \author GlobalPlatform Library contributors
+* \section intro_sec Introduction
+* This plugin connects directly to a virtual smart card speaking the vpcd protocol of the
+* vsmartcard project (e.g. jCardSim or vicc) without using a PC/SC daemon.
+* Each message is framed by a two byte length in network byte order followed by the data.
+* A one byte message is a control message (power off, power on, reset, get ATR), everything else is an APDU.
+*
+* The reader name passed to #OPGP_PL_card_connect selects the connection:
+* - listen:<port> waits for a virtual card connecting to this port (the usual vpcd mode, default port 35963).
+* - tcp:<host>:<port> connects to a virtual card listening on the given host and port.
+* - unix:<path> connects to a virtual card listening on the given Unix domain socket.
+*/
+
+#define OPGP_LOG_CATEGORY OPGP_LOG_CATEGORY_TRANSPORT //!< Category of the log messages of this file.
+
+#include "gpvpcdconnectionplugin.h"
+#include <globalplatform/debug.h>
+#include <globalplatform/error.h>
+#include <globalplatform/errorcodes.h>
+#include <globalplatform/unicode.h>
+#include <globalplatform/stringify.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+
+#ifdef WIN32
+#define VPCD_LAST_ERROR WSAGetLastError()
+#define VPCD_CLOSE_SOCKET(s) closesocket(s)
+#else
+#define VPCD_LAST_ERROR errno
+#define VPCD_CLOSE_SOCKET(s) close(s)
+#endif
+
+/*
+ * A write to a connection closed by the virtual card must return an error instead of raising SIGPIPE.
+ * Linux suppresses the signal per call, macOS per socket with SO_NOSIGPIPE, Windows has no SIGPIPE.
+ */
+#ifdef MSG_NOSIGNAL
+#define VPCD_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define VPCD_SEND_FLAGS 0
+#endif
+
+#define VPCD_MAX_FRAME_SIZE 65535 //!< Maximum data length of a vpcd frame.
+#define VPCD_MAX_SHORT_FRAME_SIZE 261 //!< Maximum length of a short command APDU.
+
+#define CHECK_CARD_CONTEXT_INITIALIZATION(cardContext, status)	if (cardContext.librarySpecific == NULL) { OPGP_ERROR_CREATE_ERROR(status, OPGP_PL_ERROR_NO_CARD_CONTEXT_INITIALIZED, OPGP_PL_stringify_error(OPGP_PL_ERROR_NO_CARD_CONTEXT_INITIALIZED)); goto end;}
+
+#define CHECK_CARD_INFO_INITIALIZATION(cardInfo, status)	if (cardInfo.librarySpecific == NULL) { OPGP_ERROR_CREATE_ERROR(status, OPGP_PL_ERROR_NO_CARD_INFO_INITIALIZED, OPGP_PL_stringify_error(OPGP_PL_ERROR_NO_CARD_INFO_INITIALIZED)); goto end;}
+
+/**
+* Handles the error status for the result.
+*/
+#define HANDLE_STATUS(status, result) if (result != OPGP_ERROR_SUCCESS) {\
+	OPGP_ERROR_CREATE_ERROR(status,result,OPGP_PL_stringify_error((DWORD)result));\
+	}\
+	else {\
+	OPGP_ERROR_CREATE_NO_ERROR(status);\
+	}
+
+/**
+* Convenience function to get a reference to the VPCD_CARD_CONTEXT_SPECIFIC from a OPGP_CARD_CONTEXT struct.
+* @param context The OPGP_CARD_CONTEXT struct.
+*/
+#define GET_VPCD_CARD_CONTEXT_SPECIFIC(context) ((VPCD_CARD_CONTEXT_SPECIFIC *)(context.librarySpecific))
+
+/**
+* Convenience function to get a reference to the VPCD_CARD_INFO_SPECIFIC from a pointer to OPGP_CARD_INFO struct.
+* @param pCardInfo The pointer to a OPGP_CARD_INFO struct.
+*/
+#define GET_VPCD_CARD_INFO_SPECIFIC_P(pCardInfo) ((VPCD_CARD_INFO_SPECIFIC *)(pCardInfo->librarySpecific))
+
+/**
+* Convenience function to get a reference to the VPCD_CARD_INFO_SPECIFIC from a OPGP_CARD_INFO struct.
+* @param cardInfo The OPGP_CARD_INFO struct.
+*/
+#define GET_VPCD_CARD_INFO_SPECIFIC(cardInfo) ((VPCD_CARD_INFO_SPECIFIC *)(cardInfo.librarySpecific))
+
+/**
+ * Writes the complete buffer to the socket.
+ * \param sock [in] The socket.
+ * \param buf [in] The buffer.
+ * \param bufLength [in] The length of the buffer.
+ * \return OPGP_ERROR_SUCCESS, #OPGP_PL_VPCD_ERROR_CONNECTION_CLOSED or the system error code.
+ */
+static LONG send_all(VPCD_SOCKET sock, PBYTE buf, DWORD bufLength) {
+	DWORD offset = 0;
+	int sent;
+	while (offset < bufLength) {
+		sent = send(sock, (const char *)buf+offset, (int)(bufLength-offset), VPCD_SEND_FLAGS);
+		if (sent < 0) {
+#ifdef WIN32
+			if (WSAGetLastError() == WSAECONNRESET || WSAGetLastError() == WSAECONNABORTED) {
+				return OPGP_PL_VPCD_ERROR_CONNECTION_CLOSED;
+			}
+#else
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EPIPE || errno == ECONNRESET) {
+				return OPGP_PL_VPCD_ERROR_CONNECTION_CLOSED;
+			}
+#endif
+			return VPCD_LAST_ERROR;
+		}
+		offset += (DWORD)sent;
+	}
+	return OPGP_ERROR_SUCCESS;
+}
+
+/**
+ * Reads exactly bufLength bytes from the socket.
+ * \param sock [in] The socket.
+ * \param buf [out] The buffer.
+ * \param bufLength [in] The number of bytes to read.
+ * \return OPGP_ERROR_SUCCESS, #OPGP_PL_VPCD_ERROR_CONNECTION_CLOSED or the system error code.
+ */
+static LONG receive_all(VPCD_SOCKET sock, PBYTE buf, DWORD bufLength) {
+	DWORD offset = 0;
+	int received;
+	while (offset < bufLength) {
+		received = recv(sock, (char *)buf+offset, (int)(bufLength-offset), 0);
+		if (received == 0) {
+			return OPGP_PL_VPCD_ERROR_CONNECTION_CLOSED;
+		}
+		if (received < 0) {
+#ifdef WIN32
+			if (WSAGetLastError() == WSAECONNRESET || WSAGetLastError() == WSAECONNABORTED) {
+				return OPGP_PL_VPCD_ERROR_CONNECTION_CLOSED;
+			}
+#else
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == ECONNRESET) {
+				return OPGP_PL_VPCD_ERROR_CONNECTION_CLOSED;
+			}
+#endif
+			return VPCD_LAST_ERROR;
+		}
+		offset += (DWORD)received;
+	}
+	return OPGP_ERROR_SUCCESS;
+}
+
+/**
+ * Appends a vpcd frame (length header and data) to a buffer.
+ * \param buf [out] The buffer. Must have space for dataLength+2 bytes.
+ * \param data [in] The frame data.
+ * \param dataLength [in] The length of the frame data.
+ * \return The number of bytes written.
+ */
+static DWORD put_frame(PBYTE buf, PBYTE data, DWORD dataLength) {
+	buf[0] = (BYTE)((dataLength >> 8) & 0xFF);
+	buf[1] = (BYTE)(dataLength & 0xFF);
+	memcpy(buf+2, data, dataLength);
+	return dataLength + 2;
+}
+
+/**
+ * Reads one vpcd frame from the socket.
+ * \param sock [in] The socket.
+ * \param buf [out] The frame data.
+ * \param bufLength [in, out] The size of buf and the length of the received frame data.
+ * \return OPGP_ERROR_SUCCESS, OPGP_ERROR_INSUFFICIENT_BUFFER, a #OPGP_PL_VPCD_ERROR_CONNECTION_CLOSED or the system error code.
+ */
+static LONG receive_frame(VPCD_SOCKET sock, PBYTE buf, PDWORD bufLength) {
+	LONG result;
+	BYTE header[2];
+	DWORD frameLength;
+	BYTE discard[256];
+	DWORD discardLength;
+	result = receive_all(sock, header, 2);
+	if (result != OPGP_ERROR_SUCCESS) {
+		return result;
+	}
+	frameLength = ((DWORD)header[0] << 8) | header[1];
+	if (frameLength <= *bufLength) {
+		result = receive_all(sock, buf, frameLength);
+		*bufLength = frameLength;
+		return result;
+	}
+	// keep the stream in sync before reporting the error
+	while (frameLength > 0) {
+		discardLength = frameLength < sizeof(discard) ? frameLength : sizeof(discard);
+		result = receive_all(sock, discard, discardLength);
+		if (result != OPGP_ERROR_SUCCESS) {
+			return result;
+		}
+		frameLength -= discardLength;
+	}
+	return OPGP_ERROR_INSUFFICIENT_BUFFER;
+}
+
+/**
+ * Disables the Nagle algorithm for TCP connections. Each APDU is written as a single segment
+ * and must not wait for the acknowledgement of the previous one.
+ * \param sock [in] The socket.
+ * \return OPGP_ERROR_SUCCESS or the system error code.
+ */
+static LONG set_no_delay(VPCD_SOCKET sock) {
+	int flag = 1;
+	if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&flag, sizeof(flag)) != 0) {
+		return VPCD_LAST_ERROR;
+	}
+	return OPGP_ERROR_SUCCESS;
+}
+
+/**
+ * Suppresses SIGPIPE for writes to the socket on platforms without MSG_NOSIGNAL.
+ * \param sock [in] The socket.
+ * \return OPGP_ERROR_SUCCESS or the system error code.
+ */
+static LONG set_no_sigpipe(VPCD_SOCKET sock) {
+#ifdef SO_NOSIGPIPE
+	int flag = 1;
+	if (setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, (const char *)&flag, sizeof(flag)) != 0) {
+		return VPCD_LAST_ERROR;
+	}
+#else
+	(void)sock;
+#endif
+	return OPGP_ERROR_SUCCESS;
+}
+
+/**
+ * Opens a TCP connection to the given host and port.
+ * \param host [in] The host name.
+ * \param port [in] The port as string.
+ * \param sock [out] The connected socket.
+ * \return OPGP_ERROR_SUCCESS or the system error code.
+ */
+static LONG connect_tcp(const char *host, const char *port, VPCD_SOCKET *sock) {
+	LONG result = OPGP_PL_VPCD_ERROR_INVALID_READER_NAME;
+	struct addrinfo hints;
+	struct addrinfo *addresses = NULL;
+	struct addrinfo *address;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, port, &hints, &addresses) != 0) {
+		goto end;
+	}
+	for (address = addresses; address != NULL; address = address->ai_next) {
+		*sock = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (*sock == VPCD_INVALID_SOCKET) {
+			result = VPCD_LAST_ERROR;
+			continue;
+		}
+		if (connect(*sock, address->ai_addr, (int)address->ai_addrlen) == 0) {
+			result = set_no_delay(*sock);
+			if (result == OPGP_ERROR_SUCCESS) {
+				result = set_no_sigpipe(*sock);
+			}
+			goto end;
+		}
+		result = VPCD_LAST_ERROR;
+		VPCD_CLOSE_SOCKET(*sock);
+		*sock = VPCD_INVALID_SOCKET;
+	}
+end:
+	if (addresses) {
+		freeaddrinfo(addresses);
+	}
+	return result;
+}
+
+#ifndef WIN32
+/**
+ * Opens a connection to a Unix domain socket.
+ * \param path [in] The path of the socket.
+ * \param sock [out] The connected socket.
+ * \return OPGP_ERROR_SUCCESS or the system error code.
+ */
+static LONG connect_unix(const char *path, VPCD_SOCKET *sock) {
+	struct sockaddr_un address;
+	LONG result;
+	if (strlen(path) >= sizeof(address.sun_path)) {
+		return OPGP_PL_VPCD_ERROR_INVALID_READER_NAME;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+	*sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (*sock == VPCD_INVALID_SOCKET) {
+		return VPCD_LAST_ERROR;
+	}
+	if (connect(*sock, (struct sockaddr *)&address, sizeof(address)) != 0) {
+		result = VPCD_LAST_ERROR;
+		VPCD_CLOSE_SOCKET(*sock);
+		*sock = VPCD_INVALID_SOCKET;
+		return result;
+	}
+	return set_no_sigpipe(*sock);
+}
+#endif
+
+/**
+ * Waits for a virtual card connecting to the given port. The listening socket is kept in the card context,
+ * so that the card can reconnect after a disconnect.
+ * \param contextSpecific [in, out] The vpcd card context.
+ * \param port [in] The port.
+ * \param sock [out] The connected socket.
+ * \return OPGP_ERROR_SUCCESS or the system error code.
+ */
+static LONG accept_tcp(VPCD_CARD_CONTEXT_SPECIFIC *contextSpecific, DWORD port, VPCD_SOCKET *sock) {
+	struct sockaddr_in address;
+	int flag = 1;
+	LONG result;
+	if (contextSpecific->listenSocket != VPCD_INVALID_SOCKET && contextSpecific->listenPort != port) {
+		VPCD_CLOSE_SOCKET(contextSpecific->listenSocket);
+		contextSpecific->listenSocket = VPCD_INVALID_SOCKET;
+	}
+	if (contextSpecific->listenSocket == VPCD_INVALID_SOCKET) {
+		contextSpecific->listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+		if (contextSpecific->listenSocket == VPCD_INVALID_SOCKET) {
+			return VPCD_LAST_ERROR;
+		}
+		setsockopt(contextSpecific->listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char *)&flag, sizeof(flag));
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_ANY);
+		address.sin_port = htons((unsigned short)port);
+		if (bind(contextSpecific->listenSocket, (struct sockaddr *)&address, sizeof(address)) != 0
+			|| listen(contextSpecific->listenSocket, 1) != 0) {
+			result = VPCD_LAST_ERROR;
+			VPCD_CLOSE_SOCKET(contextSpecific->listenSocket);
+			contextSpecific->listenSocket = VPCD_INVALID_SOCKET;
+			return result;
+		}
+		contextSpecific->listenPort = port;
+	}
+	*sock = accept(contextSpecific->listenSocket, NULL, NULL);
+	if (*sock == VPCD_INVALID_SOCKET) {
+		return VPCD_LAST_ERROR;
+	}
+	result = set_no_delay(*sock);
+	if (result != OPGP_ERROR_SUCCESS) {
+		return result;
+	}
+	return set_no_sigpipe(*sock);
+}
+
+/**
+* Memory is allocated in this method for the card context. It must be freed with a call to #OPGP_PL_release_context.
+* \param cardContext [out] The returned OPGP_CARDCONTEXT.
+* \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+*/
+OPGP_ERROR_STATUS OPGP_PL_establish_context(OPGP_CARD_CONTEXT *cardContext) {
+	OPGP_ERROR_STATUS status;
+	LONG result = OPGP_ERROR_SUCCESS;
+#ifdef WIN32
+	WSADATA wsaData;
+#endif
+	OPGP_LOG_START(_T("OPGP_PL_establish_context"));
+	cardContext->librarySpecific = malloc(sizeof(VPCD_CARD_CONTEXT_SPECIFIC));
+	if (cardContext->librarySpecific == NULL) {
+		OPGP_ERROR_CREATE_ERROR(status, ENOMEM, OPGP_stringify_error(ENOMEM));
+		goto end;
+	}
+	GET_VPCD_CARD_CONTEXT_SPECIFIC((*cardContext))->listenSocket = VPCD_INVALID_SOCKET;
+	GET_VPCD_CARD_CONTEXT_SPECIFIC((*cardContext))->listenPort = 0;
+#ifdef WIN32
+	result = WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+	HANDLE_STATUS(status, result);
+end:
+	OPGP_LOG_END(_T("OPGP_PL_establish_context"), status);
+	return status;
+}
+
+/**
+* \param cardContext [in, out] The valid OPGP_CARDCONTEXT returned by establish_context()
+* \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct
+*/
+OPGP_ERROR_STATUS OPGP_PL_release_context(OPGP_CARD_CONTEXT *cardContext) {
+	OPGP_ERROR_STATUS status;
+	OPGP_LOG_START(_T("OPGP_PL_release_context"));
+	CHECK_CARD_CONTEXT_INITIALIZATION((*cardContext), status)
+	if (GET_VPCD_CARD_CONTEXT_SPECIFIC((*cardContext))->listenSocket != VPCD_INVALID_SOCKET) {
+		VPCD_CLOSE_SOCKET(GET_VPCD_CARD_CONTEXT_SPECIFIC((*cardContext))->listenSocket);
+	}
+#ifdef WIN32
+	WSACleanup();
+#endif
+	// frees the allocated memory
+	free(cardContext->librarySpecific);
+	cardContext->librarySpecific = NULL;
+	OPGP_ERROR_CREATE_NO_ERROR(status);
+end:
+	OPGP_LOG_END(_T("OPGP_PL_release_context"), status);
+	return status;
+}
+
+/**
+* There is no reader enumeration for virtual cards. The default vpcd listening address is returned.
+* Other addresses can be passed directly to #OPGP_PL_card_connect.
+* \param cardContext [in] The valid OPGP_CARDCONTEXT returned by establish_context()
+* \param readerNames [out] The reader names will be a multi-string and separated by a NULL character and ended by a double NULL.
+*  (ReaderA\\0ReaderB\\0\\0). If this value is NULL, list_readers ignores the buffer length supplied in
+*  readerNamesLength, writes the length of the multi-string that would have been returned if this parameter
+*  had not been NULL to readerNamesLength.
+* \param readerNamesLength [in, out] The length of the multi-string including all trailing null characters.
+* \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code and error message are contained in the OPGP_ERROR_STATUS struct
+*/
+OPGP_ERROR_STATUS OPGP_PL_list_readers(OPGP_CARD_CONTEXT cardContext, OPGP_STRING readerNames, PDWORD readerNamesLength) {
+	OPGP_ERROR_STATUS status;
+	DWORD readersSize = (DWORD)_tcslen(VPCD_DEFAULT_READER_NAME) + 2;
+	OPGP_LOG_START(_T("OPGP_PL_list_readers"));
+	CHECK_CARD_CONTEXT_INITIALIZATION(cardContext, status)
+	if (readerNames == NULL || *readerNamesLength < readersSize) {
+		*readerNamesLength = readersSize;
+		if (readerNames == NULL) {
+			OPGP_ERROR_CREATE_NO_ERROR(status);
+		} else {
+			OPGP_ERROR_CREATE_ERROR(status, OPGP_ERROR_INSUFFICIENT_BUFFER, OPGP_PL_stringify_error(OPGP_ERROR_INSUFFICIENT_BUFFER));
+		}
+		goto end;
+	}
+	_tcscpy(readerNames, VPCD_DEFAULT_READER_NAME);
+	readerNames[readersSize-1] = _T('\0');
+	*readerNamesLength = readersSize;
+	OPGP_ERROR_CREATE_NO_ERROR(status);
+end:
+	OPGP_LOG_END(_T("OPGP_PL_list_readers"), status);
+	return status;
+}
+
+/**
+* Memory is allocated in this method for the card context. It must be freed with a call to #OPGP_PL_card_disconnect.
+* The card is powered on and its ATR is requested. Both control messages are written at once.
+* \param cardContext [in] The valid OPGP_CARDCONTEXT returned by establish_context()
+* \param readerName [in] The address of the virtual card: listen:<port>, tcp:<host>:<port> or unix:<path>.
+* \param *cardInfo [out] The returned OPGP_CARD_INFO.
+* \param protocol [in] The transmit protocol type to use. Ignored, virtual cards exchange complete APDUs.
+* \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct.
+*/
+OPGP_ERROR_STATUS OPGP_PL_card_connect(OPGP_CARD_CONTEXT cardContext, OPGP_CSTRING readerName, OPGP_CARD_INFO *cardInfo,
+	DWORD protocol) {
+		OPGP_ERROR_STATUS status;
+		LONG result = OPGP_ERROR_SUCCESS;
+		VPCD_CARD_INFO_SPECIFIC *vpcdCardInfo;
+		char address[256];
+		char *port;
+		BYTE control;
+		BYTE request[6];
+		DWORD requestLength = 0;
+		BYTE ATR[MAX_ATR_SIZE];
+		DWORD ATRLength = MAX_ATR_SIZE;
+
+		OPGP_LOG_START(_T("OPGP_PL_card_connect"));
+		CHECK_CARD_CONTEXT_INITIALIZATION(cardContext, status)
+
+		cardInfo->librarySpecific = malloc(sizeof(VPCD_CARD_INFO_SPECIFIC));
+		if (cardInfo->librarySpecific == NULL) {
+			result = ENOMEM;
+			goto end;
+		}
+		vpcdCardInfo = GET_VPCD_CARD_INFO_SPECIFIC_P(cardInfo);
+		vpcdCardInfo->cardSocket = VPCD_INVALID_SOCKET;
+
+#ifdef _UNICODE
+		if (wcstombs(address, readerName, sizeof(address)) == (size_t)-1) {
+			result = OPGP_PL_VPCD_ERROR_INVALID_READER_NAME;
+			goto end;
+		}
+#else
+		strncpy(address, readerName, sizeof(address));
+#endif
+		address[sizeof(address)-1] = '\0';
+
+		if (strncmp(address, "listen:", 7) == 0) {
+			result = accept_tcp(GET_VPCD_CARD_CONTEXT_SPECIFIC(cardContext), (DWORD)strtoul(address+7, NULL, 10), &(vpcdCardInfo->cardSocket));
+		}
+		else if (strncmp(address, "tcp:", 4) == 0) {
+			port = strrchr(address+4, ':');
+			if (port == NULL) {
+				result = OPGP_PL_VPCD_ERROR_INVALID_READER_NAME;
+				goto end;
+			}
+			*port++ = '\0';
+			result = connect_tcp(address+4, port, &(vpcdCardInfo->cardSocket));
+		}
+#ifndef WIN32
+		else if (strncmp(address, "unix:", 5) == 0) {
+			result = connect_unix(address+5, &(vpcdCardInfo->cardSocket));
+		}
+#endif
+		else {
+			result = OPGP_PL_VPCD_ERROR_INVALID_READER_NAME;
+		}
+		if (result != OPGP_ERROR_SUCCESS) {
+			goto end;
+		}
+
+		// power on and ATR request are pipelined in one write
+		control = VPCD_CTRL_ON;
+		requestLength += put_frame(request+requestLength, &control, 1);
+		control = VPCD_CTRL_ATR;
+		requestLength += put_frame(request+requestLength, &control, 1);
+		result = send_all(vpcdCardInfo->cardSocket, request, requestLength);
+		if (result != OPGP_ERROR_SUCCESS) {
+			goto end;
+		}
+		result = receive_frame(vpcdCardInfo->cardSocket, ATR, &ATRLength);
+		if (result != OPGP_ERROR_SUCCESS) {
+			goto end;
+		}
+		memcpy(cardInfo->ATR, ATR, ATRLength);
+		cardInfo->ATRLength = ATRLength;
+
+		OPGP_LOG_MSG_FOR(OPGP_LOG_CATEGORY_TRANSPORT, _T("OPGP_PL_card_connect: Connected to virtual card at %s"), readerName);
+		OPGP_LOG_HEX_FOR(OPGP_LOG_CATEGORY_TRANSPORT, _T("OPGP_PL_card_connect: Card ATR: "), cardInfo->ATR, cardInfo->ATRLength);
+
+		cardInfo->logicalChannel = 0;
+		OPGP_ERROR_CREATE_NO_ERROR(status);
+
+end:
+		if (result != OPGP_ERROR_SUCCESS) {
+			HANDLE_STATUS(status, result);
+			if (cardInfo->librarySpecific != NULL) {
+				if (GET_VPCD_CARD_INFO_SPECIFIC_P(cardInfo)->cardSocket != VPCD_INVALID_SOCKET) {
+					VPCD_CLOSE_SOCKET(GET_VPCD_CARD_INFO_SPECIFIC_P(cardInfo)->cardSocket);
+				}
+				free(cardInfo->librarySpecific);
+				cardInfo->librarySpecific = NULL;
+			}
+		}
+		OPGP_LOG_END(_T("OPGP_PL_card_connect"), status);
+		return status;
+}
+
+/**
+* The virtual card is powered off and the connection is closed.
+* \param cardContext [in] The valid OPGP_CARDCONTEXT returned by establish_context()
+* \param cardInfo [in, out] The OPGP_CARD_INFO structure returned by card_connect().
+* \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct.
+*/
+OPGP_ERROR_STATUS OPGP_PL_card_disconnect(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO *cardInfo) {
+	OPGP_ERROR_STATUS status;
+	LONG result;
+	BYTE control = VPCD_CTRL_OFF;
+	BYTE request[3];
+	OPGP_LOG_START(_T("OPGP_PL_card_disconnect"));
+	CHECK_CARD_CONTEXT_INITIALIZATION(cardContext, status)
+	CHECK_CARD_INFO_INITIALIZATION((*cardInfo), status)
+	result = send_all(GET_VPCD_CARD_INFO_SPECIFIC_P(cardInfo)->cardSocket, request, put_frame(request, &control, 1));
+	// a virtual card which has already gone is not an error
+	if (result == OPGP_PL_VPCD_ERROR_CONNECTION_CLOSED) {
+		result = OPGP_ERROR_SUCCESS;
+	}
+	HANDLE_STATUS(status, result);
+	VPCD_CLOSE_SOCKET(GET_VPCD_CARD_INFO_SPECIFIC_P(cardInfo)->cardSocket);
+	// frees the allocated memory
+	free(cardInfo->librarySpecific);
+	cardInfo->librarySpecific = NULL;
+	cardInfo->ATRLength = 0;
+end:
+	OPGP_LOG_END(_T("OPGP_PL_card_disconnect"), status);
+	return status;
+}
+
+/**
+* If the transmission is successful then the APDU status word is returned as errorCode in the OPGP_ERROR_STATUS structure.
+* The command APDU is sent with its length header in a single write. The virtual card handles the complete
+* APDU itself, so there is no T=0 GET RESPONSE handling.
+* \param cardContext [in] The valid OPGP_CARDCONTEXT returned by establish_context()
+* \param cardInfo [in] The OPGP_CARD_INFO structure returned by card_connect().
+* \param capdu [in] The command APDU.
+* \param capduLength [in] The length of the command APDU.
+* \param rapdu [out] The response APDU.
+* \param rapduLength [in, out] The length of the the response APDU.
+* \return OPGP_ERROR_STATUS struct with error status OPGP_ERROR_STATUS_SUCCESS if no error occurs, otherwise error code  and error message are contained in the OPGP_ERROR_STATUS struct.
+*/
+OPGP_ERROR_STATUS OPGP_PL_send_APDU(OPGP_CARD_CONTEXT cardContext, OPGP_CARD_INFO cardInfo, PBYTE capdu, DWORD capduLength, PBYTE rapdu, PDWORD rapduLength) {
+	OPGP_ERROR_STATUS status;
+	LONG result;
+	BYTE requestBuffer[VPCD_MAX_SHORT_FRAME_SIZE+2];
+	PBYTE request = requestBuffer;
+	DWORD sw;
+
+	OPGP_LOG_START(_T("OPGP_PL_send_APDU"));
+	CHECK_CARD_CONTEXT_INITIALIZATION(cardContext, status)
+	CHECK_CARD_INFO_INITIALIZATION(cardInfo, status)
+	if (capduLength < 4 || capduLength > VPCD_MAX_FRAME_SIZE) {
+		result = OPGP_ERROR_UNRECOGNIZED_APDU_COMMAND;
+		HANDLE_STATUS(status, result);
+		goto end;
+	}
+	// extended length APDUs do not fit into the stack buffer
+	if (capduLength > VPCD_MAX_SHORT_FRAME_SIZE) {
+		request = (PBYTE)malloc(sizeof(BYTE)*(capduLength+2));
+		if (request == NULL) {
+			result = ENOMEM;
+			HANDLE_STATUS(status, result);
+			goto end;
+		}
+	}
+	result = send_all(GET_VPCD_CARD_INFO_SPECIFIC(cardInfo)->cardSocket, request, put_frame(request, capdu, capduLength));
+	if (result != OPGP_ERROR_SUCCESS) {
+		HANDLE_STATUS(status, result);
+		goto end;
+	}
+	result = receive_frame(GET_VPCD_CARD_INFO_SPECIFIC(cardInfo)->cardSocket, rapdu, rapduLength);
+	if (result != OPGP_ERROR_SUCCESS) {
+		HANDLE_STATUS(status, result);
+		goto end;
+	}
+	if (*rapduLength < 2) {
+		result = OPGP_PL_VPCD_ERROR_INVALID_FRAME;
+		HANDLE_STATUS(status, result);
+		goto end;
+	}
+
+	// get SW
+	sw = ((rapdu[*rapduLength-2] & 0xFF) << 8) | (rapdu[*rapduLength-1] & 0xFF);
+
+	OPGP_ERROR_CREATE_NO_ERROR_WITH_CODE(status, OPGP_ISO7816_ERROR_PREFIX | sw, OPGP_stringify_error(OPGP_ISO7816_ERROR_PREFIX | sw));
+end:
+	if (request != requestBuffer) {
+		free(request);
+	}
+	OPGP_LOG_END(_T("OPGP_PL_send_APDU"), status);
+	return status;
+}
+
+/**
+* \param errorCode [in] The error code.
+* \return OPGP_STRING representation of the error code.
+*/
+OPGP_STRING OPGP_PL_stringify_error(DWORD errorCode) {
+	if (errorCode == OPGP_PL_ERROR_NO_CARD_CONTEXT_INITIALIZED) {
+		return (OPGP_STRING)_T("vpcd plugin is not initialized. A card context must be established first.");
+	}
+	if (errorCode == OPGP_PL_ERROR_NO_CARD_INFO_INITIALIZED) {
+		return (OPGP_STRING)_T("vpcd plugin is not initialized. A card connection must be created first.");
+	}
+	if (errorCode == OPGP_PL_VPCD_ERROR_INVALID_READER_NAME) {
+		return (OPGP_STRING)_T("The reader name must be listen:<port>, tcp:<host>:<port> or unix:<path>.");
+	}
+	if (errorCode == OPGP_PL_VPCD_ERROR_CONNECTION_CLOSED) {
+		return (OPGP_STRING)_T("The virtual card has closed the connection.");
+	}
+	if (errorCode == OPGP_PL_VPCD_ERROR_INVALID_FRAME) {
+		return (OPGP_STRING)_T("The virtual card has sent an invalid response.");
+	}
+	// delegate to general stringify function
+	return OPGP_stringify_error(errorCode);
+}
@@ -0,0 +1,74 @@
+/*  Copyright (c) 2026, GlobalPlatform Library contributors
+ *  This file is part of GlobalPlatform.
+ *
+ *  GlobalPlatform is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GlobalPlatform is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*! \file
+ * This file defines all vpcd socket connection related type definitions.
+*/
+
+#ifndef OPGP_VPCD_CONNECTION_PLUGIN_H
+#define OPGP_VPCD_CONNECTION_PLUGIN_H
+
+#ifdef WIN32
+#include <winsock2.h>
+#endif
+#include <globalplatform/library.h>
+#include <globalplatform/connectionplugin.h>
+
+#ifdef WIN32
+typedef SOCKET VPCD_SOCKET; //!< Socket handle.
+#define VPCD_INVALID_SOCKET INVALID_SOCKET //!< Invalid socket handle.
+#else
+typedef int VPCD_SOCKET; //!< Socket handle.
+#define VPCD_INVALID_SOCKET -1 //!< Invalid socket handle.
+#endif
+
+#define VPCD_DEFAULT_PORT 35963 //!< The TCP port vpcd listens on for virtual cards.
+#define VPCD_DEFAULT_READER_NAME _T("listen:35963") //!< The reader offered by #OPGP_PL_list_readers.
+
+#define VPCD_CTRL_OFF 0x00 //!< vpcd control message: power off the card.
+#define VPCD_CTRL_ON 0x01 //!< vpcd control message: power on the card.
+#define VPCD_CTRL_RESET 0x02 //!< vpcd control message: reset the card.
+#define VPCD_CTRL_ATR 0x04 //!< vpcd control message: request the ATR.
+
+#define OPGP_PL_VPCD_ERROR_INVALID_READER_NAME (OPGP_PL_ERROR_PREFIX | (DWORD)0x0100L) //!< The reader name is not a valid vpcd address.
+#define OPGP_PL_VPCD_ERROR_CONNECTION_CLOSED (OPGP_PL_ERROR_PREFIX | (DWORD)0x0101L) //!< The virtual card closed the connection.
+#define OPGP_PL_VPCD_ERROR_INVALID_FRAME (OPGP_PL_ERROR_PREFIX | (DWORD)0x0102L) //!< A received frame has an invalid length.
+
+/**
+ * vpcd specific context information. Used in OPGP_CARD_CONTEXT.librarySpecific.
+ */
+typedef struct {
+	VPCD_SOCKET listenSocket; //!< The socket accepting virtual cards in listen mode.
+	DWORD listenPort; //!< The port of listenSocket.
+} VPCD_CARD_CONTEXT_SPECIFIC;
+
+/**
+ * vpcd specific card information. Used in OPGP_CARD_INFO.librarySpecific.
+ */
+typedef struct {
+	VPCD_SOCKET cardSocket; //!< The connected socket of the virtual card.
+} VPCD_CARD_INFO_SPECIFIC;
+
+
+/**
+ * \brief Stringifies an error code.
+ */
+OPGP_NO_API
+OPGP_STRING OPGP_PL_stringify_error(DWORD errorCode);
+
+#endif
+
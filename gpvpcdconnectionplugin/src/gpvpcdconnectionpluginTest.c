@@ -0,0 +1,146 @@
+/*  Copyright (c) 2026, GlobalPlatform Library contributors
+ *  This file is part of GlobalPlatform.
+ *
+ *  GlobalPlatform is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  GlobalPlatform is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with GlobalPlatform.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <check.h>
+#include <stdlib.h>
+#include <globalplatform/globalplatform.h>
+#include <globalplatform/connectionplugin.h>
+#include "gpvpcdconnectionplugin.h"
+#include <string.h>
+#include <stdio.h>
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * The ATR of the virtual card.
+ */
+static BYTE virtualCardATR[] = {0x3B, 0x80, 0x80, 0x01, 0x01};
+
+/**
+ * Acts as a virtual card: accepts one connection, answers the power on and ATR request and closes the connection.
+ * \param listenSocket [in] The listening socket.
+ */
+static void run_closing_virtual_card(int listenSocket) {
+	BYTE request[6];
+	BYTE response[2+sizeof(virtualCardATR)];
+	size_t received = 0;
+	ssize_t result;
+	int cardSocket = accept(listenSocket, NULL, NULL);
+	if (cardSocket < 0) {
+		_exit(1);
+	}
+	// power on and ATR request
+	while (received < sizeof(request)) {
+		result = recv(cardSocket, request+received, sizeof(request)-received, 0);
+		if (result <= 0) {
+			_exit(1);
+		}
+		received += (size_t)result;
+	}
+	response[0] = 0;
+	response[1] = sizeof(virtualCardATR);
+	memcpy(response+2, virtualCardATR, sizeof(virtualCardATR));
+	if (send(cardSocket, response, sizeof(response), 0) != (ssize_t)sizeof(response)) {
+		_exit(1);
+	}
+	close(cardSocket);
+	_exit(0);
+}
+
+/**
+ * Tests that a virtual card closing the connection is reported as error instead of killing the process with SIGPIPE.
+ */
+START_TEST (test_peer_close) {
+	OPGP_ERROR_STATUS status;
+	OPGP_CARD_CONTEXT cardContext;
+	OPGP_CARD_INFO cardInfo;
+	struct sockaddr_un address;
+	char path[64];
+	char readerName[80];
+	BYTE capdu[] = {0x00, 0xA4, 0x04, 0x00, 0x00};
+	BYTE rapdu[258];
+	DWORD rapduLength = sizeof(rapdu);
+	int listenSocket;
+	int childStatus;
+	pid_t child;
+
+	snprintf(path, sizeof(path), "/tmp/gpvpcdtest%d", (int)getpid());
+	unlink(path);
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strcpy(address.sun_path, path);
+	listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	fail_unless(listenSocket >= 0, "Could not create socket");
+	fail_unless(bind(listenSocket, (struct sockaddr *)&address, sizeof(address)) == 0
+		&& listen(listenSocket, 1) == 0, "Could not listen on %s", path);
+	child = fork();
+	fail_unless(child >= 0, "Could not start the virtual card");
+	if (child == 0) {
+		run_closing_virtual_card(listenSocket);
+	}
+
+	memset(&cardContext, 0, sizeof(cardContext));
+	memset(&cardInfo, 0, sizeof(cardInfo));
+	status = OPGP_PL_establish_context(&cardContext);
+	fail_unless(status.errorStatus == OPGP_ERROR_STATUS_SUCCESS, "Could not establish context: %s", status.errorMessage);
+	// Unix domain sockets are not available on Windows, so the reader name is never a wide string
+	snprintf(readerName, sizeof(readerName), "unix:%s", path);
+	status = OPGP_PL_card_connect(cardContext, readerName, &cardInfo, OPGP_CARD_PROTOCOL_T1);
+	fail_unless(status.errorStatus == OPGP_ERROR_STATUS_SUCCESS, "Could not connect: %s", status.errorMessage);
+	fail_unless(cardInfo.ATRLength == sizeof(virtualCardATR) && memcmp(cardInfo.ATR, virtualCardATR, sizeof(virtualCardATR)) == 0,
+		"Wrong ATR");
+
+	// the virtual card has closed the connection when it exits
+	fail_unless(waitpid(child, &childStatus, 0) == child && WIFEXITED(childStatus) && WEXITSTATUS(childStatus) == 0,
+		"Virtual card failed");
+	close(listenSocket);
+	unlink(path);
+
+	status = OPGP_PL_send_APDU(cardContext, cardInfo, capdu, sizeof(capdu), rapdu, &rapduLength);
+	fail_unless(status.errorStatus == OPGP_ERROR_STATUS_FAILURE, "APDU to a closed connection succeeded");
+	fail_unless(status.errorCode == OPGP_PL_VPCD_ERROR_CONNECTION_CLOSED, "Closed connection not detected: %s", status.errorMessage);
+	// the power off is written to the closed connection
+	status = OPGP_PL_card_disconnect(cardContext, &cardInfo);
+	fail_unless(status.errorStatus == OPGP_ERROR_STATUS_SUCCESS, "Disconnect of a closed connection failed: %s", status.errorMessage);
+	status = OPGP_PL_release_context(&cardContext);
+	fail_unless(status.errorStatus == OPGP_ERROR_STATUS_SUCCESS, "Could not release context: %s", status.errorMessage);
+} END_TEST
+#endif
+
+Suite * GlobalPlatform_suite(void) {
+	Suite *s = suite_create("gpvpcdconnectionplugin");
+	/* Core test case */
+	TCase *tc_core = tcase_create("Core");
+#ifndef WIN32
+	tcase_add_test (tc_core, test_peer_close);
+#endif
+	suite_add_tcase(s, tc_core);
+	return s;
+}
+
+int main(void) {
+	int number_failed;
+	Suite *s = GlobalPlatform_suite();
+	SRunner *sr = srunner_create(s);
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed = srunner_ntests_failed(sr);
+	srunner_free(sr);
+	return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}